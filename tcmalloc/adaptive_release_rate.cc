@@ -0,0 +1,72 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/adaptive_release_rate.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "absl/time/time.h"
+#include "tcmalloc/internal/config.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+double AdaptiveReleaseRate::PressureMultiplier(double pressure) {
+  return std::clamp(1 + pressure, 1.0, kMaxPressureMultiplier);
+}
+
+size_t AdaptiveReleaseRate::ReleasableBytes(const Signals& signals) {
+  const size_t reserved = signals.demand_bytes > signals.used_bytes
+                              ? signals.demand_bytes - signals.used_bytes
+                              : 0;
+  return signals.free_backed_bytes > reserved
+             ? signals.free_backed_bytes - reserved
+             : 0;
+}
+
+size_t AdaptiveReleaseRate::BytesToRelease(const Signals& signals,
+                                           size_t base_rate,
+                                           absl::Duration elapsed) {
+  const size_t releasable = ReleasableBytes(signals);
+
+  // Rising demand means freed memory is likely to be reused soon, so back off
+  // to the slowest rate; otherwise ramp up so an idle heap shrinks quickly.
+  if (releasable == 0 || signals.demand_bytes > prev_demand_bytes_) {
+    idle_multiplier_ = 1;
+  } else {
+    idle_multiplier_ = std::min(2 * idle_multiplier_, kMaxIdleMultiplier);
+  }
+  prev_demand_bytes_ = signals.demand_bytes;
+
+  // If time goes backwards, release nothing.
+  const double seconds = std::max(absl::ToDoubleSeconds(elapsed), 0.0);
+  if (releasable == 0 || seconds == 0) {
+    return 0;
+  }
+
+  const double pressure = PressureMultiplier(signals.pressure);
+  const double fraction = std::min(
+      kBaseReleaseFraction * idle_multiplier_ * pressure * seconds, 1.0);
+  const double bytes = std::max(static_cast<double>(base_rate) * pressure *
+                                    seconds,
+                                fraction * static_cast<double>(releasable));
+  return bytes >= releasable ? releasable : static_cast<size_t>(bytes);
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
@@ -0,0 +1,80 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_ADAPTIVE_RELEASE_RATE_H_
+#define TCMALLOC_ADAPTIVE_RELEASE_RATE_H_
+
+#include <stddef.h>
+
+#include "absl/time/time.h"
+#include "tcmalloc/internal/config.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+// Chooses how many bytes ProcessBackgroundActions releases on each pass when
+// adaptive background release is enabled.
+//
+// Free backed memory beyond what recent demand predicts will be reused is
+// released at a fraction per second that ramps up exponentially while demand
+// is flat or falling, and is scaled further by memory pressure.  The
+// configured background release rate acts as a floor.  Memory that recent
+// demand predicts will be reused is never released, so an idle heap converges
+// to its predicted demand rather than to zero.
+class AdaptiveReleaseRate {
+ public:
+  struct Signals {
+    // Bytes currently allocated from the page heap.
+    size_t used_bytes = 0;
+    // Bytes that are free in the page heap but still backed.
+    size_t free_backed_bytes = 0;
+    // Bytes recent demand history predicts will be in use (see
+    // PageAllocator::GetRecentDemand).
+    size_t demand_bytes = 0;
+    // Percentage of recent time stalled on memory, as in PSI "some avg10".
+    double pressure = 0;
+  };
+
+  // Fraction of the releasable bytes released per second before scaling.
+  static constexpr double kBaseReleaseFraction = 1.0 / 64;
+  // Bounds for the ramp applied while demand is not rising.
+  static constexpr double kMaxIdleMultiplier = 16;
+  // Bounds for PressureMultiplier().
+  static constexpr double kMaxPressureMultiplier = 16;
+
+  // Returns the factor by which memory pressure scales release: 1 when no task
+  // is stalled, growing by 1 for each percentage point of stall time.
+  static double PressureMultiplier(double pressure);
+
+  // Returns the free backed bytes not predicted to be needed by demand.
+  static size_t ReleasableBytes(const Signals& signals);
+
+  // Returns the number of bytes to release for a pass taking place elapsed
+  // after the previous one, with base_rate bytes/s configured.
+  size_t BytesToRelease(const Signals& signals, size_t base_rate,
+                        absl::Duration elapsed);
+
+  double idle_multiplier() const { return idle_multiplier_; }
+
+ private:
+  double idle_multiplier_ = 1;
+  size_t prev_demand_bytes_ = 0;
+};
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_ADAPTIVE_RELEASE_RATE_H_
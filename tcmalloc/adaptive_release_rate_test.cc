@@ -0,0 +1,255 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/adaptive_release_rate.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "tcmalloc/common.h"
+#include "tcmalloc/huge_page_subrelease.h"
+#include "tcmalloc/internal/clock.h"
+#include "tcmalloc/pages.h"
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+constexpr size_t kMiB = size_t{1} << 20;
+
+using Signals = AdaptiveReleaseRate::Signals;
+
+TEST(AdaptiveReleaseRateTest, PressureMultiplier) {
+  EXPECT_EQ(AdaptiveReleaseRate::PressureMultiplier(0), 1);
+  EXPECT_EQ(AdaptiveReleaseRate::PressureMultiplier(2.5), 3.5);
+  EXPECT_EQ(AdaptiveReleaseRate::PressureMultiplier(100),
+            AdaptiveReleaseRate::kMaxPressureMultiplier);
+}
+
+TEST(AdaptiveReleaseRateTest, ReleasableBytes) {
+  // Demand at or below current usage reserves nothing.
+  EXPECT_EQ(AdaptiveReleaseRate::ReleasableBytes({.used_bytes = 100,
+                                                  .free_backed_bytes = 50,
+                                                  .demand_bytes = 80}),
+            50);
+  // Free memory that demand predicts will be reused is kept.
+  EXPECT_EQ(AdaptiveReleaseRate::ReleasableBytes({.used_bytes = 100,
+                                                  .free_backed_bytes = 50,
+                                                  .demand_bytes = 120}),
+            30);
+  EXPECT_EQ(AdaptiveReleaseRate::ReleasableBytes({.used_bytes = 100,
+                                                  .free_backed_bytes = 50,
+                                                  .demand_bytes = 500}),
+            0);
+}
+
+TEST(AdaptiveReleaseRateTest, RampsWhileIdle) {
+  AdaptiveReleaseRate rate;
+  const Signals idle = {.used_bytes = 100 * kMiB,
+                        .free_backed_bytes = 1024 * kMiB,
+                        .demand_bytes = 100 * kMiB};
+
+  size_t prev = 0;
+  for (int i = 0; i < 10; ++i) {
+    const size_t bytes = rate.BytesToRelease(idle, 0, absl::Seconds(1));
+    EXPECT_GE(bytes, prev) << i;
+    prev = bytes;
+  }
+  EXPECT_EQ(rate.idle_multiplier(), AdaptiveReleaseRate::kMaxIdleMultiplier);
+
+  // Rising demand resets the ramp.
+  Signals rising = idle;
+  rising.demand_bytes = 200 * kMiB;
+  EXPECT_LT(rate.BytesToRelease(rising, 0, absl::Seconds(1)), prev);
+  EXPECT_EQ(rate.idle_multiplier(), 1);
+}
+
+TEST(AdaptiveReleaseRateTest, BaseRateIsFloor) {
+  AdaptiveReleaseRate rate;
+  const Signals signals = {.used_bytes = 0,
+                           .free_backed_bytes = 1024 * kMiB,
+                           .demand_bytes = 0};
+  EXPECT_EQ(rate.BytesToRelease(signals, 512 * kMiB, absl::Seconds(1)),
+            512 * kMiB);
+  // But never more than is releasable.
+  EXPECT_EQ(rate.BytesToRelease(signals, 4096 * kMiB, absl::Seconds(1)),
+            1024 * kMiB);
+  // Nor anything if time went backwards.
+  EXPECT_EQ(rate.BytesToRelease(signals, 512 * kMiB, -absl::Seconds(1)), 0);
+}
+
+// Replays a recorded demand curve (bytes in use, sampled once per second)
+// against a simulated page heap, feeding the same SubreleaseStatsTracker
+// configuration the HugePageFiller uses.  Memory released to the OS and then
+// needed again counts as refaulted.
+class Simulation {
+ public:
+  struct Segment {
+    absl::Duration duration;
+    size_t used_bytes;
+  };
+
+  struct Result {
+    // Backed bytes at each second.
+    std::vector<size_t> backed;
+    size_t refaulted_bytes = 0;
+  };
+
+  static std::vector<size_t> Curve(const std::vector<Segment>& segments) {
+    std::vector<size_t> curve;
+    for (const Segment& s : segments) {
+      curve.insert(curve.end(), absl::ToInt64Seconds(s.duration),
+                   s.used_bytes);
+    }
+    return curve;
+  }
+
+  // Replays curve with the adaptive policy.
+  static Result Adaptive(const std::vector<size_t>& curve, size_t base_rate,
+                         double pressure = 0) {
+    AdaptiveReleaseRate rate;
+    return Run(curve, [&](const Signals& signals) {
+      Signals s = signals;
+      s.pressure = pressure;
+      return rate.BytesToRelease(s, base_rate, absl::Seconds(1));
+    });
+  }
+
+  // Replays curve releasing base_rate bytes per second.
+  static Result Constant(const std::vector<size_t>& curve, size_t base_rate) {
+    return Run(curve, [&](const Signals&) { return base_rate; });
+  }
+
+ private:
+  static int64_t clock_;
+  static int64_t FakeClock() { return clock_; }
+  static double FakeFrequency() { return 1e9; }
+
+  template <typename Policy>
+  static Result Run(const std::vector<size_t>& curve, Policy policy) {
+    clock_ = 0;
+    SubreleaseStatsTracker<3600> tracker(
+        Clock{.now = FakeClock, .freq = FakeFrequency}, absl::Minutes(60),
+        absl::Minutes(5), absl::Minutes(10));
+
+    Result result;
+    size_t backed = curve.empty() ? 0 : curve.front();
+    for (size_t used : curve) {
+      if (used > backed) {
+        result.refaulted_bytes += used - backed;
+        backed = used;
+      }
+
+      tracker.Report({.num_pages = BytesToLengthFloor(used),
+                      .free_pages = BytesToLengthFloor(backed - used)});
+      const size_t demand =
+          tracker.GetRecentDemand(absl::Seconds(60), absl::Seconds(300))
+              .in_bytes();
+
+      const size_t released = std::min(
+          policy(Signals{.used_bytes = used,
+                         .free_backed_bytes = backed - used,
+                         .demand_bytes = std::max(demand, used)}),
+          backed - used);
+      backed -= released;
+      result.backed.push_back(backed);
+      clock_ += absl::ToInt64Nanoseconds(absl::Seconds(1));
+    }
+    return result;
+  }
+};
+
+int64_t Simulation::clock_ = 0;
+
+// Returns the first second at which backed is within 5% of used, or -1.
+int ConvergenceTime(const std::vector<size_t>& curve,
+                    const std::vector<size_t>& backed, int start) {
+  for (int t = start; t < curve.size(); ++t) {
+    if (backed[t] <= curve[t] + curve[t] / 20) {
+      return t;
+    }
+  }
+  return -1;
+}
+
+TEST(AdaptiveReleaseSimulationTest, IdleConvergesToLowRss) {
+  // A batch job that peaks at 1 GiB, then idles at 128 MiB.
+  const std::vector<size_t> curve = Simulation::Curve({
+      {absl::Minutes(10), 1024 * kMiB},
+      {absl::Minutes(30), 128 * kMiB},
+  });
+  constexpr int kIdleStart = 600;
+
+  // With no configured release rate, constant-rate release keeps the peak.
+  Simulation::Result constant = Simulation::Constant(curve, 0);
+  EXPECT_EQ(constant.backed.back(), 1024 * kMiB);
+
+  Simulation::Result adaptive = Simulation::Adaptive(curve, 0);
+  EXPECT_EQ(adaptive.refaulted_bytes, 0);
+  // Nothing is released while recent demand still covers the peak...
+  EXPECT_EQ(adaptive.backed[kIdleStart + 60], 1024 * kMiB);
+  // ...but once it ages out, the heap shrinks to its usage within minutes.
+  const int converged = ConvergenceTime(curve, adaptive.backed, kIdleStart);
+  ASSERT_NE(converged, -1);
+  EXPECT_LE(converged, kIdleStart + 15 * 60);
+  EXPECT_LE(adaptive.backed.back(), 128 * kMiB + kMiB);
+}
+
+TEST(AdaptiveReleaseSimulationTest, KeepsMemoryForPeriodicSpikes) {
+  // A server idling at 256 MiB that spikes to 1 GiB for 10s every 2 minutes.
+  std::vector<Simulation::Segment> segments;
+  for (int i = 0; i < 15; ++i) {
+    segments.push_back({absl::Seconds(110), 256 * kMiB});
+    segments.push_back({absl::Seconds(10), 1024 * kMiB});
+  }
+  const std::vector<size_t> curve = Simulation::Curve(segments);
+  constexpr size_t kSpike = 768 * kMiB;
+
+  // A fixed 16 MiB/s releases each spike's memory before the next, and
+  // refaults it every time.
+  Simulation::Result constant = Simulation::Constant(curve, 16 * kMiB);
+  EXPECT_GE(constant.refaulted_bytes, 14 * kSpike);
+
+  // Adaptive release recognizes the spikes in the demand history, and only
+  // faults in the first one.
+  Simulation::Result adaptive = Simulation::Adaptive(curve, 16 * kMiB);
+  EXPECT_LE(adaptive.refaulted_bytes, kSpike);
+}
+
+TEST(AdaptiveReleaseSimulationTest, PressureSpeedsUpRelease) {
+  const std::vector<size_t> curve = Simulation::Curve({
+      {absl::Minutes(10), 1024 * kMiB},
+      {absl::Minutes(30), 128 * kMiB},
+  });
+  constexpr int kIdleStart = 600;
+
+  const int relaxed = ConvergenceTime(
+      curve, Simulation::Adaptive(curve, 0, /*pressure=*/0).backed,
+      kIdleStart);
+  const int pressured = ConvergenceTime(
+      curve, Simulation::Adaptive(curve, 0, /*pressure=*/10).backed,
+      kIdleStart);
+  ASSERT_NE(relaxed, -1);
+  ASSERT_NE(pressured, -1);
+  EXPECT_LT(pressured, relaxed);
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
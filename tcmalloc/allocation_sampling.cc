@@ -14,6 +14,7 @@
 
 #include "tcmalloc/allocation_sampling.h"
 
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <memory>
@@ -21,6 +22,7 @@
 #include <utility>
 
 #include "absl/base/attributes.h"
+#include "absl/base/internal/spinlock.h"
 #include "absl/base/optimization.h"
 #include "absl/debugging/stacktrace.h"
 #include "absl/time/clock.h"
@@ -58,5 +60,60 @@ std::unique_ptr<const ProfileBase> DumpHeapProfile(Static& state) {
   return profile;
 }
 
+ABSL_CONST_INIT static std::atomic<bool> exact_thread_accounting(false);
+ABSL_CONST_INIT static absl::base_internal::SpinLock thread_accounting_lock(
+    absl::base_internal::SCHEDULE_KERNEL_ONLY);
+
+bool ExactThreadAccountingEnabled() {
+  return exact_thread_accounting.load(std::memory_order_relaxed);
+}
+
+// Delete hook installed in MallocExtension::ThreadAccountingMode::kExact.
+static void RecordExactFree(const MallocHook::DeleteInfo& info) {
+  if (info.ptr == nullptr) return;
+  GetThreadSampler().RecordFree(
+      info.deallocated_size.value_or(info.allocated_size) + 1);
+}
+
 }  // namespace tcmalloc::tcmalloc_internal
+
+using tcmalloc::MallocExtension;
+using tcmalloc::tcmalloc_internal::GetThreadSampler;
+
+extern "C" void MallocExtension_Internal_GetThreadAllocatedBytes(
+    MallocExtension::ThreadAllocatedBytes* ret) {
+  const auto& sampler = GetThreadSampler();
+  ret->allocated = sampler.RecordedAllocatedBytes();
+  ret->freed = sampler.RecordedFreedBytes();
+}
+
+extern "C" MallocExtension::ThreadAccountingMode
+MallocExtension_Internal_GetThreadAccountingMode() {
+  return tcmalloc::tcmalloc_internal::ExactThreadAccountingEnabled()
+             ? MallocExtension::ThreadAccountingMode::kExact
+             : MallocExtension::ThreadAccountingMode::kSampled;
+}
+
+extern "C" void MallocExtension_Internal_SetThreadAccountingMode(
+    MallocExtension::ThreadAccountingMode mode) {
+  using tcmalloc::tcmalloc_internal::exact_thread_accounting;
+  using tcmalloc::tcmalloc_internal::RecordExactFree;
+
+  const bool exact = mode == MallocExtension::ThreadAccountingMode::kExact;
+  absl::base_internal::SpinLockHolder h(
+      tcmalloc::tcmalloc_internal::thread_accounting_lock);
+  if (exact == exact_thread_accounting.load(std::memory_order_relaxed)) {
+    return;
+  }
+  // Install the hook before switching modes (and remove it after), so that a
+  // deallocation is never left uncounted.  One racing with the switch may be
+  // counted by both the hook and its sample.
+  if (exact) {
+    TC_CHECK(tcmalloc::MallocHook::AddDeleteHook(RecordExactFree));
+    exact_thread_accounting.store(true, std::memory_order_relaxed);
+  } else {
+    exact_thread_accounting.store(false, std::memory_order_relaxed);
+    TC_CHECK(tcmalloc::MallocHook::RemoveDeleteHook(RecordExactFree));
+  }
+}
 GOOGLE_MALLOC_SECTION_END
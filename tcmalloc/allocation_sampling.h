@@ -67,6 +67,11 @@ inline Sampler& GetThreadSampler() {
 #endif
 }
 
+// Returns true if the freed bytes reported by GetThreadAllocatedBytes are
+// counted exactly by a delete hook, rather than estimated from sampled
+// deallocations.
+bool ExactThreadAccountingEnabled();
+
 // Performs sampling for already occurred allocation of object.
 //
 // For small object sizes, we allocate a new object in a sampled span.
@@ -258,6 +263,31 @@ static inline AllocationType SimplifyType(AllocationType type) {
   ABSL_UNREACHABLE();
 }
 
+// Checks the size passed to a sized delete of the unsampled page allocation at
+// ptr, which spans maximum_size bytes.
+template <typename Policy>
+void CheckUnsampledLargeSize(Static& state, Policy policy,
+                             void* absl_nonnull ptr, std::optional<size_t> size,
+                             size_t maximum_size) {
+  if (ABSL_PREDICT_TRUE(size.has_value())) {
+    const size_t minimum_size = maximum_size - (kPageSize - 1u);
+
+    // *size should fall in [minimum_size, maximum_size], but a size of 0
+    // bytes is rounded up to 1 page if overaligned, we must allow 0 bytes if
+    // the span is 1 page.
+    if (ABSL_PREDICT_FALSE(*size < minimum_size || *size > maximum_size) &&
+        ABSL_PREDICT_TRUE(
+            !(*size == 0 && maximum_size == kPageSize &&
+              static_cast<size_t>(policy.align()) > kPageSize))) {
+      // While we don't have precise allocation-time information because
+      // this span was not sampled, the deallocated object's purported size
+      // exceeds the span it is on.  This is impossible and indicates
+      // corruption.
+      ReportMismatchedDelete(state, ptr, *size, minimum_size, maximum_size);
+    }
+  }
+}
+
 template <typename Policy>
 void MaybeUnsampleAllocation(Static& state, Policy policy,
                              void* absl_nonnull ptr, std::optional<size_t> size,
@@ -267,25 +297,7 @@ void MaybeUnsampleAllocation(Static& state, Policy policy,
   // otherwise, concurrent writes here would likely report a double-free.
   SampledAllocation* sampled_allocation = span.Unsample();
   if (sampled_allocation == nullptr) {
-    if (ABSL_PREDICT_TRUE(size.has_value())) {
-      const size_t maximum_size = span.bytes_in_span();
-      const size_t minimum_size = maximum_size - (kPageSize - 1u);
-
-      // *size should fall in [minimum_size, maximum_size], but a size of 0
-      // bytes is rounded up to 1 page if overaligned, we must allow 0 bytes if
-      // the span is 1 page.
-      if (ABSL_PREDICT_FALSE(*size < minimum_size || *size > maximum_size) &&
-          ABSL_PREDICT_TRUE(
-              !(*size == 0 && maximum_size == kPageSize &&
-                static_cast<size_t>(policy.align()) > kPageSize))) {
-        // While we don't have precise allocation-time information because
-        // this span was not sampled, the deallocated object's purported size
-        // exceeds the span it is on.  This is impossible and indicates
-        // corruption.
-        ReportMismatchedDelete(state, ptr, *size, minimum_size, maximum_size);
-      }
-    }
-
+    CheckUnsampledLargeSize(state, policy, ptr, size, span.bytes_in_span());
     return;
   }
 
@@ -391,6 +403,12 @@ void MaybeUnsampleAllocation(Static& state, Policy policy,
   MallocHook::InvokeSampledDeleteHook(sampled_alloc);
 
   state.deallocation_samples.ReportFree(sampled_alloc_handle);
+
+  // The sample stands for weight bytes of the allocation stream, so crediting
+  // it to the freeing thread gives an unbiased estimate of its freed bytes.
+  if (!ExactThreadAccountingEnabled()) {
+    GetThreadSampler().RecordFree(weight);
+  }
 }
 
 }  // namespace tcmalloc::tcmalloc_internal
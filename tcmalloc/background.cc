@@ -15,13 +15,16 @@
 #include <algorithm>
 #include <cstddef>
 #include <limits>
+#include <optional>
 
 #include "absl/base/attributes.h"
 #include "absl/base/const_init.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "tcmalloc/adaptive_release_rate.h"
 #include "tcmalloc/central_freelist.h"
+#include "tcmalloc/cgroup_memory_tuner.h"
 #include "tcmalloc/common.h"
 #include "tcmalloc/cpu_cache.h"
 #include "tcmalloc/internal/logging.h"
@@ -34,6 +37,7 @@
 
 // Release memory to the system at a constant rate.
 void MallocExtension_Internal_ProcessBackgroundActions() {
+  using ::tcmalloc::tcmalloc_internal::AdaptiveReleaseRate;
   using ::tcmalloc::tcmalloc_internal::Parameters;
   using ::tcmalloc::tcmalloc_internal::tc_globals;
 
@@ -46,6 +50,7 @@ void MallocExtension_Internal_ProcessBackgroundActions() {
   absl::Time last_size_class_max_capacity_resize = prev_time;
   absl::Time last_slab_resize_check = prev_time;
   absl::Time last_hpaa_hugepage_check = prev_time;
+  absl::Time last_cgroup_check = absl::InfinitePast();
 
 #ifndef TCMALLOC_INTERNAL_SMALL_BUT_SLOW
   absl::Time last_transfer_cache_plunder_check = prev_time;
@@ -58,6 +63,17 @@ void MallocExtension_Internal_ProcessBackgroundActions() {
   // want to separately account for pages released by ProcessBackgroundActions.
   tcmalloc::tcmalloc_internal::ConstantRatePageAllocatorReleaser releaser;
 
+  AdaptiveReleaseRate adaptive_release_rate;
+
+  // When enabled, the cgroup's memory controller drives the soft limit and
+  // contributes memory pressure.
+  const char* cgroup_dir = tcmalloc::tcmalloc_internal::CgroupMemoryTuningDir();
+  std::optional<tcmalloc::tcmalloc_internal::CgroupMemoryTuner> cgroup_tuner;
+  if (cgroup_dir != nullptr) {
+    cgroup_tuner.emplace(cgroup_dir);
+  }
+  double cgroup_pressure = 0;
+
   while (tcmalloc::MallocExtension::GetBackgroundProcessActionsEnabled()) {
     const absl::Duration sleep_time =
         tcmalloc::MallocExtension::GetBackgroundProcessSleepInterval();
@@ -96,6 +112,10 @@ void MallocExtension_Internal_ProcessBackgroundActions() {
     // etc.) once every hpaa_hugepage_check_period.
     const absl::Duration hpaa_hugepage_check_period = 5 * sleep_time;
 
+    // Re-read the cgroup limits and memory pressure once per
+    // cgroup_check_period.  The kernel updates pressure averages every 2s.
+    const absl::Duration cgroup_check_period = 2 * sleep_time;
+
     absl::Time now = absl::Now();
 
     // TODO(b/278618299):  We guard various actions under a single lock, since
@@ -173,20 +193,55 @@ void MallocExtension_Internal_ProcessBackgroundActions() {
         last_hpaa_hugepage_check = now;
       }
 
-      // If time goes backwards, we would like to cap the release rate at 0.
-      //
-      // TODO(b/495452446): Improve test coverage and possibly move to working
-      // integer space entirely.
-      double calculated_bytes =
-          static_cast<size_t>(Parameters::background_release_rate()) *
-          absl::ToDoubleSeconds(now - prev_time);
-      constexpr double kMaxSsize =
-          static_cast<double>(std::numeric_limits<ssize_t>::max());
-
-      ssize_t bytes_to_release = calculated_bytes >= kMaxSsize
-                                     ? std::numeric_limits<ssize_t>::max()
-                                     : calculated_bytes;
-      bytes_to_release = std::max<ssize_t>(bytes_to_release, 0);
+      if (cgroup_tuner.has_value() &&
+          now - last_cgroup_check >= cgroup_check_period) {
+        cgroup_pressure = cgroup_tuner->Update([](size_t soft_limit) {
+          tc_globals.page_allocator().set_limit(
+              soft_limit,
+              tcmalloc::tcmalloc_internal::PageAllocator::kSoft);
+        });
+        last_cgroup_check = now;
+      }
+
+      const double pressure =
+          std::max(cgroup_pressure, Parameters::memory_pressure());
+      ssize_t bytes_to_release;
+      if (Parameters::background_release_adaptive()) {
+        AdaptiveReleaseRate::Signals signals;
+        {
+          tcmalloc::tcmalloc_internal::PageHeapSpinLockHolder l;
+          const tcmalloc::tcmalloc_internal::BackingStats stats =
+              tc_globals.page_allocator().stats();
+          signals.used_bytes =
+              stats.system_bytes - stats.free_bytes - stats.unmapped_bytes;
+          signals.free_backed_bytes = stats.free_bytes;
+          signals.demand_bytes =
+              tc_globals.page_allocator().GetRecentDemand().in_bytes();
+        }
+        signals.pressure = pressure;
+        bytes_to_release = std::min<size_t>(
+            adaptive_release_rate.BytesToRelease(
+                signals,
+                static_cast<size_t>(Parameters::background_release_rate()),
+                now - prev_time),
+            std::numeric_limits<ssize_t>::max());
+      } else {
+        // If time goes backwards, we would like to cap the release rate at 0.
+        //
+        // TODO(b/495452446): Improve test coverage and possibly move to
+        // working integer space entirely.
+        double calculated_bytes =
+            static_cast<size_t>(Parameters::background_release_rate()) *
+            AdaptiveReleaseRate::PressureMultiplier(pressure) *
+            absl::ToDoubleSeconds(now - prev_time);
+        constexpr double kMaxSsize =
+            static_cast<double>(std::numeric_limits<ssize_t>::max());
+
+        bytes_to_release = calculated_bytes >= kMaxSsize
+                               ? std::numeric_limits<ssize_t>::max()
+                               : calculated_bytes;
+        bytes_to_release = std::max<ssize_t>(bytes_to_release, 0);
+      }
 
       // If release rate is set to 0, do not release memory to system. However,
       // if we want to release free and backed hugepages from HugeRegion,
@@ -199,6 +254,9 @@ void MallocExtension_Internal_ProcessBackgroundActions() {
                              PageReleaseReason::kProcessBackgroundActions);
       }
 
+      // Let the application shed memory before we approach its limits.
+      tc_globals.page_allocator().NotifyLimitCallbacks();
+
       prev_time = now;
     }
 
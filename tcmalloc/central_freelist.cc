@@ -112,12 +112,14 @@ void StaticForwarder::MapObjectsToSpans(absl::Span<void*> batch, Span** spans,
 }
 
 Span* StaticForwarder::AllocateSpan(int size_class, size_t objects_per_span,
-                                    Length pages_per_span) {
+                                    Length pages_per_span,
+                                    SpanLifetimePrediction lifetime) {
   const MemoryTag tag = MemoryTagFromSizeClass(size_class);
   const AccessDensityPrediction density = AccessDensity(objects_per_span);
 
   SpanAllocInfo span_alloc_info = {.objects_per_span = objects_per_span,
-                                   .density = density};
+                                   .density = density,
+                                   .lifetime = lifetime};
   TC_ASSERT(density == AccessDensityPrediction::kSparse ||
             (density == AccessDensityPrediction::kDense &&
              pages_per_span == Length(1)));
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
@@ -108,10 +109,9 @@ class StaticForwarder {
   static void MapObjectsToSpans(absl::Span<void*> batch,
                                 Span** absl_nonnull spans,
                                 int expected_size_class);
-  [[nodiscard]] static Span* absl_nullable AllocateSpan(int size_class,
-                                                        size_t objects_per_span,
-                                                        Length pages_per_span)
-      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+  [[nodiscard]] static Span* absl_nullable AllocateSpan(
+      int size_class, size_t objects_per_span, Length pages_per_span,
+      SpanLifetimePrediction lifetime) ABSL_LOCKS_EXCLUDED(pageheap_lock);
   static size_t num_objects_to_move(int size_class);
   static void DeallocateSpans(size_t objects_per_span,
                               absl::Span<Span*> free_spans)
@@ -232,6 +232,14 @@ class CentralFreeList {
 
   size_t objects_per_span() const { return objects_per_span_; }
 
+  // Predicts the lifetime of the next span allocated for this size class from
+  // the lifetimes of recently deallocated ones.
+  SpanLifetimePrediction PredictSpanLifetime() const {
+    return lifetime_score_.load(std::memory_order_relaxed) > 0
+               ? SpanLifetimePrediction::kShortLived
+               : SpanLifetimePrediction::kLongLived;
+  }
+
  private:
   friend class CentralFreeListTestPeer;
 
@@ -347,6 +355,15 @@ class CentralFreeList {
 
   StatsCounter completed_spans_[kLifetimeBuckets];
 
+  // Spans deallocated within kShortLivedSpanLifetime of their allocation are
+  // predicted to be short-lived.
+  static constexpr absl::Duration kShortLivedSpanLifetime = absl::Seconds(1);
+  static constexpr int32_t kLifetimeScoreLimit = 32;
+  // Saturating count of short-lived minus long-lived deallocated spans, in
+  // [-kLifetimeScoreLimit, kLifetimeScoreLimit].  Spans are deallocated without
+  // holding lock_, so concurrent updates may be lost.
+  std::atomic<int32_t> lifetime_score_ = 0;
+
   // Tracks the number of spans used to fill a batch in RemoveRange
   StatsCounters<kSpansUsedStatBuckets> span_allocations_tracker_;
 
@@ -680,13 +697,18 @@ void CentralFreeList<Forwarder>::DeallocateSpans(absl::Span<Span*> spans) {
   if (objects_per_span_ > 1) {
     const double now = forwarder_.clock_now();
     const double frequency = forwarder_.clock_frequency();
+    int32_t score = lifetime_score_.load(std::memory_order_relaxed);
     for (Span* span : spans) {
       const double elapsed =
           std::max<double>(now - static_cast<double>(span->AllocTime()), 0.0);
       const absl::Duration lifetime =
           absl::Milliseconds(elapsed * 1000 / frequency);
       completed_spans_[LifetimeBucketNum(lifetime)].LossyAdd(1);
+      score = lifetime < kShortLivedSpanLifetime
+                  ? std::min(score + 1, kLifetimeScoreLimit)
+                  : std::max(score - 1, -kLifetimeScoreLimit);
     }
+    lifetime_score_.store(score, std::memory_order_relaxed);
   }
   return forwarder_.DeallocateSpans(objects_per_span_, spans);
 }
@@ -826,8 +848,8 @@ inline int CentralFreeList<Forwarder>::Populate(absl::Span<void*> batch) {
 
 template <class Forwarder>
 Span* CentralFreeList<Forwarder>::AllocateSpan() {
-  Span* span =
-      forwarder_.AllocateSpan(size_class_, objects_per_span_, pages_per_span_);
+  Span* span = forwarder_.AllocateSpan(size_class_, objects_per_span_,
+                                       pages_per_span_, PredictSpanLifetime());
   if (ABSL_PREDICT_FALSE(span == nullptr)) {
     TC_LOG("tcmalloc: allocation failed %v", pages_per_span_);
   }
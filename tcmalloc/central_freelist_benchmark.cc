@@ -99,7 +99,8 @@ class BenchmarkStaticForwarder
   }
 
   [[nodiscard]] Span* AllocateSpan(int size_class, size_t objects_per_span,
-                                   Length pages_per_span) {
+                                   Length pages_per_span,
+                                   SpanLifetimePrediction lifetime) {
     absl::MutexLock l(mu_);
     if (!free_spans_.empty()) {
       Span* span = free_spans_.back();
@@ -106,7 +106,7 @@ class StaticForwarderTest : public testing::TestWithParam<size_t> {
 
 TEST_P(StaticForwarderTest, Simple) {
   Span* span = StaticForwarder::AllocateSpan(size_class_, objects_per_span_,
-                                             pages_per_span_);
+                                             pages_per_span_, kLongLived);
   ASSERT_NE(span, nullptr);
 
   absl::FixedArray<void*> batch(objects_per_span_);
@@ -143,7 +143,7 @@ TEST(StaticForwarderDeathTest, MapObjectsToSpansErrors) {
   const size_t size_reciprocal = Span::CalcReciprocal(object_size);
 
   Span* span = StaticForwarder::AllocateSpan(size_class, objects_per_span,
-                                             pages_per_span);
+                                             pages_per_span, kLongLived);
   ASSERT_NE(span, nullptr);
 
   absl::FixedArray<void*> batch(objects_per_span);
@@ -248,7 +248,7 @@ class StaticForwarderEnvironment {
   void Grow() {
     // Allocate a Span
     Span* span = StaticForwarder::AllocateSpan(size_class_, objects_per_span_,
-                                               pages_per_span_);
+                                               pages_per_span_, kLongLived);
     ASSERT_NE(span, nullptr);
 
     auto d = std::make_unique<SpanData>();
@@ -1017,6 +1017,50 @@ TEST_P(CentralFreeListTest, SpanLifetime) {
   CheckLifetimeStats(e, {.completed = {{0, 1}, {100000, 1}}});
 }
 
+TEST_P(CentralFreeListTest, SpanLifetimePrediction) {
+#if ABSL_HAVE_HWADDRESS_SANITIZER
+  GTEST_SKIP()
+      << "Skipping under HWASan, which uses the top bits of the pointer.";
+#endif
+
+  TypeParam e(GetParam().size, GetParam().bytes, GetParam().num_to_move);
+  // Spans with a single object skip the central freelist, so their lifetimes
+  // are not recorded.
+  if (e.objects_per_span() == 1) {
+    GTEST_SKIP() << "Skipping test for objects_per_span = 1.";
+  }
+  EXPECT_EQ(e.central_freelist().PredictSpanLifetime(), kLongLived);
+
+  // Allocates a span, and frees it after lifetime.
+  void* batch[kMaxObjectsToMove];
+  auto allocate_and_free = [&](absl::Duration lifetime) {
+    ASSERT_EQ(e.central_freelist().RemoveRange(absl::MakeSpan(batch, 1)), 1);
+    e.forwarder().AdvanceClock(lifetime);
+    e.central_freelist().InsertRange({batch, 1});
+  };
+
+  allocate_and_free(absl::Milliseconds(10));
+  EXPECT_EQ(e.central_freelist().PredictSpanLifetime(), kShortLived);
+
+  // The prediction is passed on to the page heap.
+  EXPECT_CALL(e.forwarder(), AllocateSpan(testing::_, testing::_, testing::_,
+                                          kShortLived))
+      .Times(1);
+  allocate_and_free(absl::Seconds(10));
+  testing::Mock::VerifyAndClearExpectations(&e.forwarder());
+  EXPECT_EQ(e.central_freelist().PredictSpanLifetime(), kLongLived);
+
+  // Each long-lived span offsets one short-lived span.
+  for (int i = 0; i < 3; ++i) {
+    allocate_and_free(absl::Milliseconds(10));
+  }
+  EXPECT_EQ(e.central_freelist().PredictSpanLifetime(), kShortLived);
+  for (int i = 0; i < 3; ++i) {
+    allocate_and_free(absl::Minutes(1));
+  }
+  EXPECT_EQ(e.central_freelist().PredictSpanLifetime(), kLongLived);
+}
+
 TEST_P(CentralFreeListTest, SpanAllocationTracker) {
 #if ABSL_HAVE_HWADDRESS_SANITIZER
   GTEST_SKIP()
@@ -1245,7 +1289,8 @@ TEST_P(CentralFreeListTest, PassSpanDensityToPageheap) {
   auto test_function = [&](size_t num_objects,
                            AccessDensityPrediction density) {
     std::vector<void*> objects(e.objects_per_span());
-    EXPECT_CALL(e.forwarder(), AllocateSpan(testing::_, testing::_, testing::_))
+    EXPECT_CALL(e.forwarder(),
+                AllocateSpan(testing::_, testing::_, testing::_, testing::_))
         .Times(1);
     const size_t to_fetch = std::min(e.objects_per_span(), e.batch_size());
     const size_t fetched =
@@ -0,0 +1,70 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/cgroup_memory_tuner.h"
+
+#include <stddef.h>
+
+#include <cstring>
+
+#include "absl/functional/function_ref.h"
+#include "tcmalloc/internal/cgroup.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/environment.h"
+#include "tcmalloc/internal/logging.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+const char* CgroupMemoryTuningDir() {
+  const char* e = thread_safe_getenv("TCMALLOC_CGROUP_MEMORY");
+  if (e == nullptr || !strcmp(e, "0")) {
+    return nullptr;
+  }
+  if (!strcmp(e, "1")) {
+    return "/sys/fs/cgroup";
+  }
+  if (e[0] != '/') {
+    TC_BUG("bad TCMALLOC_CGROUP_MEMORY env var '%s'", e);
+  }
+  return e;
+}
+
+size_t CgroupMemoryTuner::SoftLimit(const CgroupMemoryState& state) {
+  const size_t limit = state.limit();
+  if (limit == CgroupMemoryState::kUnlimited) {
+    return CgroupMemoryState::kUnlimited;
+  }
+  return static_cast<size_t>(limit * kSoftLimitFraction);
+}
+
+double CgroupMemoryTuner::Update(
+    absl::FunctionRef<void(size_t)> set_soft_limit) {
+  CgroupMemoryState state;
+  if (!ReadCgroupMemoryState(dir_, state)) {
+    return 0;
+  }
+
+  const size_t soft_limit = SoftLimit(state);
+  if (soft_limit != soft_limit_) {
+    soft_limit_ = soft_limit;
+    set_soft_limit(soft_limit);
+  }
+  return state.pressure_some_avg10;
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
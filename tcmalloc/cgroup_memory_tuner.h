@@ -0,0 +1,70 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_CGROUP_MEMORY_TUNER_H_
+#define TCMALLOC_CGROUP_MEMORY_TUNER_H_
+
+#include <stddef.h>
+
+#include "absl/functional/function_ref.h"
+#include "tcmalloc/internal/cgroup.h"
+#include "tcmalloc/internal/config.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+// Returns the cgroup v2 directory to derive memory limits from, or nullptr if
+// cgroup-aware tuning is disabled.  Controlled by TCMALLOC_CGROUP_MEMORY:
+// unset or "0" disables it, "1" uses /sys/fs/cgroup, and an absolute path
+// names the directory to use instead.
+const char* CgroupMemoryTuningDir();
+
+// Derives TCMalloc's soft limit and background release rate from a cgroup's
+// memory controller.
+//
+// The soft limit tracks a fraction of the tighter of memory.max and
+// memory.high.  It is only rewritten when the derived value changes, so a
+// limit set with MallocExtension::SetMemoryLimit stays in effect until the
+// cgroup limits are next modified.  The memory.pressure stall percentage is
+// passed on to scale the background release rate (see
+// AdaptiveReleaseRate::PressureMultiplier).
+class CgroupMemoryTuner {
+ public:
+  // Fraction of the cgroup limit given to the heap.  The remainder is left for
+  // memory charged to the cgroup outside of TCMalloc: stacks, code, page
+  // cache, and other processes in the cgroup.
+  static constexpr double kSoftLimitFraction = 0.9;
+
+  // Returns the soft limit for state, or CgroupMemoryState::kUnlimited if the
+  // cgroup is not limited.
+  static size_t SoftLimit(const CgroupMemoryState& state);
+
+  explicit CgroupMemoryTuner(const char* dir) : dir_(dir) {}
+
+  // Re-reads the cgroup.  If its derived soft limit changed since the last
+  // call, passes the new value to set_soft_limit.  Returns the "some" memory
+  // pressure percentage, or 0 if the cgroup could not be read.
+  double Update(absl::FunctionRef<void(size_t)> set_soft_limit);
+
+ private:
+  const char* dir_;
+  size_t soft_limit_ = CgroupMemoryState::kUnlimited;
+};
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_CGROUP_MEMORY_TUNER_H_
@@ -0,0 +1,98 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/cgroup_memory_tuner.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tcmalloc/internal/cgroup.h"
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+constexpr size_t kUnlimited = CgroupMemoryState::kUnlimited;
+constexpr size_t kGiB = size_t{1} << 30;
+
+size_t Fraction(size_t limit) {
+  return static_cast<size_t>(limit * CgroupMemoryTuner::kSoftLimitFraction);
+}
+
+TEST(CgroupMemoryTunerTest, SoftLimit) {
+  CgroupMemoryState state;
+  EXPECT_EQ(CgroupMemoryTuner::SoftLimit(state), kUnlimited);
+
+  state.max = 10 * kGiB;
+  EXPECT_EQ(CgroupMemoryTuner::SoftLimit(state), Fraction(10 * kGiB));
+
+  // memory.high is tighter.
+  state.high = 5 * kGiB;
+  EXPECT_EQ(CgroupMemoryTuner::SoftLimit(state), Fraction(5 * kGiB));
+}
+
+TEST(CgroupMemoryTunerTest, UpdateFromFakeCgroup) {
+  std::string dir = testing::TempDir() + "/cgroup_memory_tuner_XXXXXX";
+  ASSERT_NE(mkdtemp(dir.data()), nullptr);
+  const std::string max_path = dir + "/memory.max";
+  const std::string pressure_path = dir + "/memory.pressure";
+  auto write = [](const std::string& path, const char* contents) {
+    FILE* f = fopen(path.c_str(), "w");
+    ASSERT_NE(f, nullptr);
+    fputs(contents, f);
+    fclose(f);
+  };
+
+  std::vector<size_t> soft_limits;
+  auto record = [&](size_t limit) { soft_limits.push_back(limit); };
+  CgroupMemoryTuner tuner(dir.c_str());
+
+  // Nothing to read yet.
+  EXPECT_EQ(tuner.Update(record), 0);
+  EXPECT_TRUE(soft_limits.empty());
+
+  write(max_path, "2147483648\n");
+  write(pressure_path,
+        "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+        "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+  EXPECT_EQ(tuner.Update(record), 0);
+  ASSERT_EQ(soft_limits.size(), 1);
+  EXPECT_EQ(soft_limits[0], Fraction(2 * kGiB));
+
+  // Unchanged limits are not reapplied, but pressure is tracked.
+  write(pressure_path,
+        "some avg10=5.00 avg60=1.00 avg300=0.20 total=1000\n"
+        "full avg10=1.00 avg60=0.20 avg300=0.04 total=200\n");
+  EXPECT_EQ(tuner.Update(record), 5);
+  EXPECT_EQ(soft_limits.size(), 1);
+
+  // Lifting the limit lifts the soft limit.
+  write(max_path, "max\n");
+  tuner.Update(record);
+  ASSERT_EQ(soft_limits.size(), 2);
+  EXPECT_EQ(soft_limits[1], kUnlimited);
+
+  unlink(max_path.c_str());
+  unlink(pressure_path.c_str());
+  rmdir(dir.c_str());
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
@@ -168,8 +168,17 @@ inline constexpr size_t kStealAmount = 1 << 16;
 inline constexpr size_t kDefaultProfileSamplingInterval = 2 << 20;
 
 // Disable NUMA awareness under Sanitizers to avoid failing to mmap memory.
+//
+// NUMA-aware builds support two partitions unless
+// TCMALLOC_INTERNAL_NUMA_PARTITIONS asks for more, e.g. one per socket (or
+// sub-NUMA cluster) of larger machines.  Systems with fewer nodes than
+// partitions only activate one partition per node.
 #if defined(TCMALLOC_INTERNAL_NUMA_AWARE)
-inline constexpr size_t kNumaPartitions = kSanitizerAddressSpace ? 1 : 2;
+#ifndef TCMALLOC_INTERNAL_NUMA_PARTITIONS
+#define TCMALLOC_INTERNAL_NUMA_PARTITIONS 2
+#endif
+inline constexpr size_t kNumaPartitions =
+    kSanitizerAddressSpace ? 1 : TCMALLOC_INTERNAL_NUMA_PARTITIONS;
 inline constexpr size_t kSecurityPartitions = 1;
 #else
 inline constexpr size_t kNumaPartitions = 1;
@@ -178,8 +187,9 @@ inline constexpr size_t kSecurityPartitions = kSanitizerAddressSpace ? 1 : 2;
 
 inline constexpr size_t kNormalPartitions =
     kNumaPartitions * kSecurityPartitions;
-static_assert(kNormalPartitions <= 2,
-              "Error: There can be at most 2 normal partitions.");
+static_assert(kNormalPartitions >= 1);
+static_assert(kNormalPartitions <= kMaxNormalPartitions,
+              "Error: Too many normal partitions for the MemoryTag encoding.");
 
 // We have copies of kNumBaseClasses size classes for each NUMA node, followed
 // by any expanded classes.
@@ -250,15 +260,8 @@ enum class AllocationAccess {
 };
 
 inline MemoryTag MultiNormalTag(size_t partition) {
-  switch (partition) {
-    case 0:
-      return MemoryTag::kNormalP0;
-    case 1:
-      return MemoryTag::kNormalP1;
-    default:
-      ASSUME(false);
-      __builtin_unreachable();
-  }
+  TC_ASSERT_LT(partition, kNormalPartitions);
+  return NormalTag(partition);
 }
 
 inline size_t PartitionFromPointer(const void* ptr) {
@@ -266,25 +269,18 @@ inline size_t PartitionFromPointer(const void* ptr) {
     return 0;
   }
 
-  switch (GetMemoryTag(ptr)) {
-    case MemoryTag::kNormalP1:
-      return 1;
-    default:
-      return 0;
-  }
+  const MemoryTag tag = GetMemoryTag(ptr);
+  return IsNormalTag(tag) ? NormalTagPartition(tag) : 0;
 }
 
 // TODO: b/470136917 - Investigate if we can beautify this by avoiding two
 // PartitionFromPointer functions.
 inline size_t PartitionFromPointerFast(void* ptr) {
-  TC_ASSERT(GetMemoryTag(ptr) == MemoryTag::kNormal ||
-            GetMemoryTag(ptr) == MemoryTag::kNormalP1);
-  static_assert((static_cast<uint8_t>(MemoryTag::kNormal) & 2) == 0);
-  static_assert((static_cast<uint8_t>(MemoryTag::kNormalP1) & 2) == 2);
+  TC_ASSERT(IsNormalTag(GetMemoryTag(ptr)));
   if constexpr (kNormalPartitions == 1) {
     return 0;
   }
-  return !!(static_cast<size_t>(GetMemoryTag(ptr)) & 2);
+  return static_cast<size_t>(GetMemoryTag(ptr)) & kNormalPartitionMask;
 }
 
 // Linker initialized, so this lock can be accessed at any time.
@@ -18,9 +18,12 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <limits>
 #include <new>
 #include <optional>
 #include <tuple>
@@ -46,6 +49,7 @@
 #include "tcmalloc/experiment.h"
 #include "tcmalloc/experiment_config.h"
 #include "tcmalloc/internal/allocation_guard.h"
+#include "tcmalloc/internal/cache_topology.h"
 #include "tcmalloc/internal/clock.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/cpu_utils.h"
@@ -87,10 +91,44 @@ constexpr inline uint8_t kMaxBasePerCpuShift = 18;
 #endif
 constexpr inline uint8_t kNumPossiblePerCpuShifts =
     kMaxBasePerCpuShift - kInitialBasePerCpuShift + 1;
+// TcmallocSlab locates objects with 16-bit offsets counted in pointers, which
+// bounds the per-cpu shift however many partitions share the slab.
+constexpr inline uint8_t kMaxPerCpuSlabShift =
+    16 + absl::countr_zero(sizeof(void*));
+static_assert(kMaxBasePerCpuShift < kMaxPerCpuSlabShift);
 
 constexpr inline uint8_t kResizeSlabCopies = 2;
 constexpr inline uint8_t kTotalPossibleSlabs =
     kNumPossiblePerCpuShifts * kResizeSlabCopies;
+
+// Returns the CPUs the process may run on, as the affinity of its main thread,
+// so that it does not depend on which thread asks.  Falls back to the calling
+// thread if the main thread has exited.  With virtual CPU ids, these are the
+// first ids, as many as there are allowed CPUs.
+static CpuSet FillActiveCpuMask() {
+  CpuSet allowed_cpus;
+  if (!allowed_cpus.GetAffinity(getpid()) && !allowed_cpus.GetAffinity(0)) {
+    allowed_cpus.Zero();
+  }
+
+#ifdef PERCPU_USE_RSEQ
+  const bool real_cpus = !subtle::percpu::UsingVirtualCpus();
+#else
+  const bool real_cpus = true;
+#endif
+
+  if (real_cpus) {
+    return allowed_cpus;
+  }
+
+  const int virtual_cpu_count = allowed_cpus.Count();
+  allowed_cpus.Zero();
+  for (int cpu = 0; cpu < virtual_cpu_count; ++cpu) {
+    allowed_cpus.Set(cpu);
+  }
+  return allowed_cpus;
+}
+
 // StaticForwarder provides access to the SizeMap and transfer caches.
 //
 // This is a class, rather than namespaced globals, so that it can be mocked for
@@ -162,6 +200,33 @@ class StaticForwarder {
     return Parameters::release_drained_slab_metadata();
   }
 
+  static bool per_cpu_caches_on_demand_steal() {
+    return Parameters::per_cpu_caches_on_demand_steal();
+  }
+
+  static bool per_cpu_caches_follow_cpuset() {
+    return Parameters::per_cpu_caches_follow_cpuset();
+  }
+
+  static int32_t partition_per_cpu_cache_percent(size_t partition) {
+    return Parameters::partition_per_cpu_cache_percent(partition);
+  }
+
+  // The CPUs the process may run on.  This is read for the process rather
+  // than the background thread that runs TryDrainingCaches, which may be
+  // pinned more narrowly.
+  static CpuSet allowed_cpus() { return FillActiveCpuMask(); }
+
+  // Returns the L3 cache <cpu> belongs to.  Virtual CPU ids say nothing
+  // about which cache a thread runs on, so all of them share one.
+  static unsigned l3_cache_index(int cpu) {
+    const CacheTopology& topology = CacheTopology::Instance();
+    if (subtle::percpu::UsingVirtualCpus() || topology.l3_count() == 0) {
+      return 0;
+    }
+    return topology.GetL3FromCpuId(cpu);
+  }
+
   bool reuse_size_classes() const {
     return state_.size_class_configuration() ==
                SizeClassConfiguration::kReuse ||
@@ -261,10 +326,17 @@ class CpuCache {
   struct CpuCacheMissStats {
     size_t underflows = 0;
     size_t overflows = 0;
+    // Number of times a failed Grow stole capacity from another CPU sharing
+    // its L3 cache, and the bytes it stole (see StealOnDemand).  Only tracked
+    // in total, not per interval.
+    size_t steals = 0;
+    size_t stolen_bytes = 0;
 
     CpuCacheMissStats& operator+=(const CpuCacheMissStats rhs) {
       underflows += rhs.underflows;
       overflows += rhs.overflows;
+      steals += rhs.steals;
+      stolen_bytes += rhs.stolen_bytes;
       return *this;
     }
   };
@@ -329,6 +401,16 @@ class CpuCache {
   // Sets the lower limit on the capacity that can be stolen from the cpu cache.
   static constexpr double kCacheCapacityThreshold = 0.20;
 
+  // We only steal from a cpu cache whose underflows and overflows are both
+  // below this fraction of those of the cache we steal for.
+  static constexpr double kCacheMissThreshold = 0.80;
+
+  // Minimum time between two on-demand steals for the same cpu cache.
+  // Stealing objects requires stopping the source cpu, which costs a remote
+  // fence.
+  static constexpr absl::Duration kOnDemandStealInterval =
+      absl::Milliseconds(10);
+
   template <typename... Args>
   explicit constexpr CpuCache(Args&&... u)
       : forwarder_(std::forward<Args>(u)...) {};
@@ -374,6 +456,11 @@ class CpuCache {
   // Give the allocated number of bytes in <cpu>'s cache
   uint64_t Allocated(int cpu) const;
 
+  // As UsedBytes and Allocated, but only for the size classes of heap
+  // <partition>.  Expanded size classes belong to no partition.
+  uint64_t PartitionUsedBytes(int cpu, size_t partition) const;
+  uint64_t PartitionAllocated(int cpu, size_t partition) const;
+
   // Whether <cpu>'s cache has ever been populated with objects
   bool HasPopulated(int cpu) const;
 
@@ -412,6 +499,10 @@ class CpuCache {
   // the set of populated cpu caches and drains the caches that:
   // (1) had same number of used bytes since the last interval,
   // (2) had no change in the number of misses since the last interval.
+  //
+  // With per_cpu_caches_follow_cpuset, it also drains the caches of CPUs
+  // outside the process's cpuset regardless of activity, and releases the
+  // slab metadata of drained CPUs.
   void TryDrainingCaches();
 
   // Resize size classes for up to kNumCpuCachesToResize cpu caches per
@@ -469,6 +560,12 @@ class CpuCache {
   // Reports total number of times any CPU has been drained.
   uint64_t GetNumDrains() const;
 
+  // Reports number of times TryDrainingCaches drained a CPU because it had
+  // left the process's cpuset.
+  uint64_t GetNumDrainsOutsideCpuset() const {
+    return num_drains_outside_cpuset_.load(std::memory_order_relaxed);
+  }
+
   // Reports number of times the <cpu> has been unpopulated
   // (which happens when its metadata gets released, after all per-CPU
   // metadata slabs on the same hugepage have been drained).
@@ -483,6 +580,11 @@ class CpuCache {
   // Reports highest CPU ID of any touched CPU.
   int MaxTouchedCpu() const;
 
+  // Reports number of physical cpus we have run on since the last
+  // ClearTouchedCpus.  Unless slabs are indexed by virtual CPU ids, this is
+  // the same as CountTouchedCpus.
+  int CountTouchedPhysicalCpus() const;
+
   // Resets touched to false for all cpus.
   void ClearTouchedCpus();
 
@@ -612,6 +714,20 @@ class CpuCache {
     }
   };
 
+  // Per-size-class resizing state of a single CPU.  This is O(kNumClasses)
+  // and makes up the bulk of the per-CPU bookkeeping, so it is only allocated
+  // when the CPU is populated for the first time (see Populate).  Hosts with
+  // many CPUs, of which the process only runs on a few, never pay for it.
+  struct PerCpuClassInfo {
+    PerClassResizeInfo per_class[kNumClasses];
+    // TODO(b/298229521): Evaluate Cycles32 precision for sizing decisions.
+    struct LastMiss {
+      Cycles32 last_overflow_cycles;
+      Cycles32 last_underflow_cycles;
+    };
+    LastMiss last_miss[kNumClasses];
+  };
+
   struct ABSL_CACHELINE_ALIGNED ResizeInfo {
     // In addition to the limits imposed by how much metadata
     // we can store in our slab, each per-CPU cache has a policy limit
@@ -662,22 +778,22 @@ class CpuCache {
     // Tracks whether we've run on this CPU since the last call to
     // ClearTouchedCpus.
     std::atomic<bool> touched;
+    // As touched, but indexed by physical CPU, when slabs are indexed by
+    // virtual CPU ids.
+    std::atomic<bool> touched_physical;
     // For cross-cpu operations. We can't allocate while holding one of these so
     // please use AllocationGuardSpinLockHolder to hold it.
     absl::base_internal::SpinLock lock ABSL_ACQUIRED_BEFORE(pageheap_lock){
         absl::base_internal::SCHEDULE_KERNEL_ONLY};
-    PerClassResizeInfo per_class[kNumClasses];
+    // Lazily allocated per-size-class state.  Set (once) under <lock> when the
+    // CPU is first populated and never cleared, even if the CPU is later
+    // unpopulated.
+    std::atomic<PerCpuClassInfo*> class_info;
     std::atomic<size_t> num_size_class_resizes;
     // Tracks number of underflows on allocate.
     MissCounts underflows;
     // Tracks number of overflows on deallocate.
     MissCounts overflows;
-    // TODO(b/298229521): Evaluate Cycles32 precision for sizing decisions.
-    struct LastMiss {
-      Cycles32 last_overflow_cycles;
-      Cycles32 last_underflow_cycles;
-    };
-    LastMiss last_miss[kNumClasses];
     // Total cache space available on this CPU (see above).
     // This tracks the total allocated and unallocated bytes on this CPU cache.
     std::atomic<size_t> capacity;
@@ -688,6 +804,16 @@ class CpuCache {
     // Tracks number of times this CPU has been unpopulated
     // (see GetNumUnpopulates()).
     std::atomic<size_t> num_unpopulates;
+    // When Grow on this CPU last tried to steal from another CPU, and how
+    // often and how much it got (see StealOnDemand).
+    Cycles32 last_on_demand_steal;
+    std::atomic<size_t> on_demand_steals;
+    std::atomic<size_t> on_demand_stolen_bytes;
+    // Capacity, in bytes, allocated to each heap partition's size classes.
+    // Updated as capacity changes, so the count can be briefly negative when a
+    // Drain races with a local Grow.
+    std::array<std::atomic<int64_t>, kNormalPartitions> partition_allocated =
+        {};
   };
 
   // Determines how we distribute memory in the per-cpu cache to the various
@@ -711,6 +837,12 @@ class CpuCache {
   std::pair<int, bool> CacheCpuSlab();
   void Populate(int cpu);
 
+  // Returns the per-size-class state of <cpu>, or nullptr if <cpu> has never
+  // been populated.
+  PerCpuClassInfo* absl_nullable GetClassInfo(int cpu) const;
+  // Same as GetClassInfo, for a <cpu> known to have been populated.
+  PerCpuClassInfo& PopulatedClassInfo(int cpu) const;
+
   // Returns true if we bypass cpu cache for a <size_class>. We may bypass
   // per-cpu cache when we enable certain configurations of sharded transfer
   // cache.
@@ -776,10 +908,39 @@ class CpuCache {
   // Try to steal one object from cpu/size_class. Return bytes stolen.
   size_t ShrinkOtherCache(int cpu, size_t size_class);
 
+  // Called when Grow on <cpu> could not get all of its <bytes> from the
+  // cpu's unallocated capacity.  Synchronously steals up to <bytes> of
+  // capacity from the cpu cache with the fewest misses among those sharing
+  // <cpu>'s L3 cache, rather than waiting for the next ShuffleCpuCaches.
+  // Capacity is taken from the source's unallocated capacity first, then by
+  // shrinking its size classes (returning their objects to the backing
+  // cache).  Rate-limited by kOnDemandStealInterval.  Returns bytes added to
+  // <cpu>'s unallocated capacity.
+  size_t StealOnDemand(int cpu, size_t bytes);
+
   // Resizes capacities of up to kMaxSizeClassesToResize size classes for a
   // single <cpu>.
   void ResizeCpuSizeClasses(int cpu);
 
+  // Returns how many more bytes of capacity <cpu> may allocate to the heap
+  // partition of <size_class> before the partition's size classes hold their
+  // share of CacheLimit(), per Parameters::partition_per_cpu_cache_percent.
+  size_t PartitionCapacityHeadroom(int cpu, size_t size_class) const;
+
+  // Accounts <bytes> of capacity gained (or, if negative, lost) by the heap
+  // partition of <size_class> on <cpu>.
+  void AddPartitionAllocated(int cpu, size_t size_class, int64_t bytes);
+
+  // Returns whether any heap partition holds more than its share of
+  // CacheLimit() on <cpu>.
+  bool PartitionsOverLimit(int cpu) const;
+
+  // Shrinks the size classes of heap partitions that hold more than their
+  // share of CacheLimit() on <cpu>, for instance because the share was lowered
+  // after they grew.  Returns the bytes of capacity freed.
+  size_t ShrinkPartitionsToLimit(int cpu)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(resize_[cpu].lock);
+
   // <shift_offset> is the offset of the shift in slabs_by_shift_. Note that we
   // can't calculate this from `shift` directly due to numa shift.
   // Returns the allocated slabs and the number of reused bytes.
@@ -794,6 +955,7 @@ class CpuCache {
   void SetSlabAnonVmaName(void* ptr, size_t size, bool is_drained);
 
   uint8_t PartitionShift() const;
+  uint8_t PartitionCapacityShift() const;
 
   Freelist freelist_;
 
@@ -828,6 +990,9 @@ class CpuCache {
 
   DynamicSlabInfo dynamic_slab_info_{};
 
+  // Only updated by TryDrainingCaches.
+  std::atomic<uint64_t> num_drains_outside_cpuset_{0};
+
   // Pointers to allocations for slabs of each shift value for use in
   // ResizeSlabs. This memory is allocated on the arena, and it is nonresident
   // while not in use.
@@ -871,30 +1036,6 @@ void CpuCache<Forwarder>::MaybeForceSlowPath() {
   }
 }
 
-static CpuSet FillActiveCpuMask() {
-  CpuSet allowed_cpus;
-  if (!allowed_cpus.GetAffinity(0)) {
-    allowed_cpus.Zero();
-  }
-
-#ifdef PERCPU_USE_RSEQ
-  const bool real_cpus = !subtle::percpu::UsingVirtualCpus();
-#else
-  const bool real_cpus = true;
-#endif
-
-  if (real_cpus) {
-    return allowed_cpus;
-  }
-
-  const int virtual_cpu_count = allowed_cpus.Count();
-  allowed_cpus.Zero();
-  for (int cpu = 0; cpu < virtual_cpu_count; ++cpu) {
-    allowed_cpus.Set(cpu);
-  }
-  return allowed_cpus;
-}
-
 template <class Forwarder>
 inline size_t CpuCache<Forwarder>::MaxCapacity(size_t size_class) const {
   // The number of size classes that are commonly used and thus should be
@@ -939,6 +1080,15 @@ inline size_t CpuCache<Forwarder>::MaxCapacity(size_t size_class) const {
     return 0;
   }
 
+  // When the slab cannot grow enough to give every partition the depths above,
+  // the partitions share it by scaling them down, though never below a batch.
+  const uint8_t capacity_shift = PartitionCapacityShift();
+  auto scaled = [&](size_t depth) -> size_t {
+    if (capacity_shift == 0) return depth;
+    return std::max<size_t>(depth >> capacity_shift,
+                            forwarder_.num_objects_to_move(size_class));
+  };
+
   if (BypassCpuCache(size_class)) {
     return 0;
   }
@@ -952,7 +1102,7 @@ inline size_t CpuCache<Forwarder>::MaxCapacity(size_t size_class) const {
     // Small object sizes are very heavily used and need very deep caches for
     // good performance (well over 90% of malloc calls are for size_class
     // <= 10.)
-    return kSmallObjectDepth;
+    return scaled(kSmallObjectDepth);
   }
 
   if (ColdFeatureActive()) {
@@ -969,9 +1119,9 @@ inline size_t CpuCache<Forwarder>::MaxCapacity(size_t size_class) const {
                                         : 36 * kWiderSlabMultiplier;
     absl::Span<const size_t> cold = forwarder_.cold_size_classes();
     if (absl::c_binary_search(cold, size_class)) {
-      return kLargeInterestingObjectDepth;
+      return scaled(kLargeInterestingObjectDepth);
     } else if (!IsExpandedSizeClass(size_class)) {
-      return kLargeUninterestingObjectDepth;
+      return scaled(kLargeUninterestingObjectDepth);
     } else {
       return 0;
     }
@@ -981,7 +1131,7 @@ inline size_t CpuCache<Forwarder>::MaxCapacity(size_t size_class) const {
     return 0;
   }
 
-  return kLargeObjectDepth;
+  return scaled(kLargeObjectDepth);
 }
 
 // Returns estimated bytes required and the bytes available.
@@ -1111,12 +1261,11 @@ inline void CpuCache<Forwarder>::Activate() {
 
   const uint64_t max_cache_size = CacheLimit();
 
+  // Per-size-class state is materialized by Populate, so that activation cost
+  // and resident metadata do not scale with kNumClasses * NumCPUs().
   for (int cpu = 0; cpu < num_cpus; ++cpu) {
     new (&resize_[cpu]) ResizeInfo();
 
-    for (int size_class = 1; size_class < kNumClasses; ++size_class) {
-      resize_[cpu].per_class[size_class].Init();
-    }
     resize_[cpu].available.store(max_cache_size, std::memory_order_relaxed);
     resize_[cpu].capacity.store(max_cache_size, std::memory_order_relaxed);
   }
@@ -1144,6 +1293,14 @@ inline void CpuCache<Forwarder>::Deactivate() {
   }
 
   freelist_.Destroy(&forwarder_.Dealloc);
+  static_assert(std::is_trivially_destructible_v<PerCpuClassInfo>,
+                "PerCpuClassInfo is expected to be trivially destructible");
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    if (PerCpuClassInfo* info = GetClassInfo(cpu); info != nullptr) {
+      forwarder_.Dealloc(info, sizeof(*info),
+                         std::align_val_t{alignof(PerCpuClassInfo)});
+    }
+  }
   static_assert(std::is_trivially_destructible_v<decltype(*resize_)>,
                 "ResizeInfo is expected to be trivially destructible");
   forwarder_.Dealloc(resize_, sizeof(*resize_) * num_cpus,
@@ -1331,15 +1488,15 @@ inline size_t CpuCache<Forwarder>::UpdateCapacity(int cpu, size_t size_class,
   size_t capacity = freelist_.Capacity(cpu, size_class);
   const bool grow_by_one = capacity < 2 * batch_length;
   uint32_t successive = 0;
-  ResizeInfo& resize = resize_[cpu];
+  PerCpuClassInfo& info = PopulatedClassInfo(cpu);
   // TODO(ckennelly): Use a strongly typed enum.
   if (overflow) {
-    resize.last_miss[size_class].last_overflow_cycles.Update();
+    info.last_miss[size_class].last_overflow_cycles.Update();
   } else {
-    resize.last_miss[size_class].last_underflow_cycles.Update();
+    info.last_miss[size_class].last_underflow_cycles.Update();
   }
   bool grow_by_batch =
-      resize.per_class[size_class].Update(overflow, grow_by_one, &successive);
+      info.per_class[size_class].Update(overflow, grow_by_one, &successive);
   if ((grow_by_one || grow_by_batch) && capacity != max_capacity) {
     size_t increase = 1;
     if (grow_by_batch) {
@@ -1356,8 +1513,7 @@ inline size_t CpuCache<Forwarder>::UpdateCapacity(int cpu, size_t size_class,
   // its maximum allowed capacity. Record a miss due to that so that we can
   // potentially grow the max capacity for this size class later.
   if (capacity == max_capacity) {
-    resize_[cpu].per_class[size_class].RecordMiss(
-        PerClassMissType::kMaxCapacityTotal);
+    info.per_class[size_class].RecordMiss(PerClassMissType::kMaxCapacityTotal);
   }
   return TargetOverflowRefillCount(capacity, batch_length, successive);
 }
@@ -1368,6 +1524,13 @@ std::pair<int, bool> CpuCache<Forwarder>::CacheCpuSlab() {
   if (ABSL_PREDICT_FALSE(cached) && ABSL_PREDICT_TRUE(cpu >= 0)) {
     auto& state = resize_[cpu];
     state.touched.store(true, std::memory_order_relaxed);
+    if (ABSL_PREDICT_FALSE(subtle::percpu::UsingVirtualCpus())) {
+      const int real_cpu = subtle::percpu::GetRealCpuUnsafe();
+      if (real_cpu >= 0 && real_cpu < NumCPUs()) {
+        resize_[real_cpu].touched_physical.store(true,
+                                                 std::memory_order_relaxed);
+      }
+    }
 
     if (ABSL_PREDICT_FALSE(!state.populated.load(std::memory_order_acquire))) {
       Populate(cpu);
@@ -1382,10 +1545,35 @@ ABSL_ATTRIBUTE_NOINLINE void CpuCache<Forwarder>::Populate(int cpu) {
   if (resize_[cpu].populated.load(std::memory_order_relaxed)) {
     return;
   }
+  if (resize_[cpu].class_info.load(std::memory_order_relaxed) == nullptr) {
+    // We hold resize_[cpu].lock, which is acquired before pageheap_lock, so we
+    // may allocate metadata here.
+    void* mem = forwarder_.Alloc(sizeof(PerCpuClassInfo),
+                                 std::align_val_t{alignof(PerCpuClassInfo)});
+    PerCpuClassInfo* info = new (mem) PerCpuClassInfo();
+    for (int size_class = 1; size_class < kNumClasses; ++size_class) {
+      info->per_class[size_class].Init();
+    }
+    resize_[cpu].class_info.store(info, std::memory_order_release);
+  }
   freelist_.InitCpu(cpu, GetMaxCapacityFunctor(freelist_.GetShift()));
   resize_[cpu].populated.store(true, std::memory_order_release);
 }
 
+template <class Forwarder>
+inline typename CpuCache<Forwarder>::PerCpuClassInfo* absl_nullable
+CpuCache<Forwarder>::GetClassInfo(int cpu) const {
+  return resize_[cpu].class_info.load(std::memory_order_acquire);
+}
+
+template <class Forwarder>
+inline typename CpuCache<Forwarder>::PerCpuClassInfo&
+CpuCache<Forwarder>::PopulatedClassInfo(int cpu) const {
+  PerCpuClassInfo* info = GetClassInfo(cpu);
+  TC_ASSERT_NE(info, nullptr, "cpu=%d", cpu);
+  return *info;
+}
+
 inline size_t subtract_at_least(std::atomic<size_t>* a, size_t min,
                                 size_t max) {
   size_t cmp = a->load(std::memory_order_relaxed);
@@ -1404,12 +1592,24 @@ template <class Forwarder>
 inline void CpuCache<Forwarder>::Grow(int cpu, size_t size_class,
                                       size_t desired_increase) {
   const size_t size = forwarder_.class_to_size(size_class);
-  const size_t desired_bytes = desired_increase * size;
+  const size_t desired_bytes =
+      std::min(desired_increase * size,
+               PartitionCapacityHeadroom(cpu, size_class) / size * size);
+  if (desired_bytes == 0) {
+    return;
+  }
+  desired_increase = desired_bytes / size;
   size_t acquired_bytes =
       subtract_at_least(&resize_[cpu].available, size, desired_bytes);
   if (acquired_bytes < desired_bytes) {
-    resize_[cpu].per_class[size_class].RecordMiss(
+    PopulatedClassInfo(cpu).per_class[size_class].RecordMiss(
         PerClassMissType::kCapacityTotal);
+    if (StealOnDemand(cpu, desired_bytes - acquired_bytes) != 0) {
+      acquired_bytes +=
+          subtract_at_least(&resize_[cpu].available,
+                            acquired_bytes == 0 ? size : 0,
+                            desired_bytes - acquired_bytes);
+    }
   }
   if (acquired_bytes == 0) {
     return;
@@ -1421,6 +1621,7 @@ inline void CpuCache<Forwarder>::Grow(int cpu, size_t size_class,
   size_t increase = freelist_.Grow(
       cpu, size_class, actual_increase,
       [&](uint8_t shift) { return GetMaxCapacity(size_class, shift); });
+  AddPartitionAllocated(cpu, size_class, increase * size);
   if (size_t unused = acquired_bytes - increase * size) {
     // return whatever we didn't use to the slack.
     resize_[cpu].available.fetch_add(unused, std::memory_order_relaxed);
@@ -1432,13 +1633,26 @@ inline void CpuCache<Forwarder>::TryDrainingCaches()
     ABSL_NO_THREAD_SAFETY_ANALYSIS {
   const int num_cpus = NumCPUs();
 
-  bool any_drained = false;
+  // Caches of CPUs the process may no longer run on will not be used until
+  // the cpuset grows again, so there is no point in waiting for them to
+  // become idle.
+  const bool follow_cpuset = forwarder_.per_cpu_caches_follow_cpuset();
+  CpuSet allowed_cpus;
+  if (follow_cpuset) {
+    allowed_cpus = forwarder_.allowed_cpus();
+  }
+
+  // The CPUs whose slab metadata may have become releasable.
+  CpuSet release_candidates;
+  release_candidates.Zero();
+  bool any_candidates = false;
 
   for (int cpu = 0; cpu < num_cpus; ++cpu) {
     // Nothing to drain if the cpu is not populated.
     if (!HasPopulated(cpu)) {
       continue;
     }
+    const bool outside_cpuset = follow_cpuset && !allowed_cpus.IsSet(cpu);
 
     uint64_t used_bytes = UsedBytes(cpu);
     uint64_t prev_used_bytes =
@@ -1453,9 +1667,14 @@ inline void CpuCache<Forwarder>::TryDrainingCaches()
 
     // Drain the cache if the number of used bytes and total number of misses
     // stayed constant since the last interval.
-    if (used_bytes != 0 && used_bytes == prev_used_bytes && misses == 0) {
+    if (used_bytes != 0 &&
+        (outside_cpuset || (used_bytes == prev_used_bytes && misses == 0))) {
       Drain(cpu);
-      any_drained = true;
+      release_candidates.Set(cpu);
+      any_candidates = true;
+      if (outside_cpuset) {
+        num_drains_outside_cpuset_.fetch_add(1, std::memory_order_relaxed);
+      }
     }
 
     // Takes a snapshot of used bytes in the cache at the end of this interval
@@ -1464,24 +1683,52 @@ inline void CpuCache<Forwarder>::TryDrainingCaches()
     // Drain occurs on a single thread. So, the relaxed store to used_bytes
     // is safe.
     resize_[cpu].drain_used_bytes.store(used_bytes, std::memory_order_relaxed);
+
+    // Populated CPUs outside the cpuset may share a hugepage of slab metadata
+    // with CPUs that were only drained now.
+    if (outside_cpuset) {
+      release_candidates.Set(cpu);
+      any_candidates = true;
+    }
   }
 
-  if (any_drained && forwarder_.release_drained_slab_metadata()) {
-    for (int cpu = 0; cpu < num_cpus; ++cpu) resize_[cpu].lock.lock();
-    freelist_.ReleaseSlabMetadataForDrainedCpus(
-        [this](int cpu) { return HasPopulated(cpu); },
-        [this](int cpu) {
-          TC_CHECK_EQ(
-              resize_[cpu].available, resize_[cpu].capacity,
-              "CPU %u was not actually drained, or available is out of sync",
-              cpu);
-          resize_[cpu].populated.store(false, std::memory_order_release);
-          resize_[cpu].num_unpopulates.fetch_add(1, std::memory_order_relaxed);
-        },
-        [this](void* slab_addr, size_t slab_size) {
-          return MadviseAwaySlabs(slab_addr, slab_size);
-        });
-    for (int cpu = 0; cpu < num_cpus; ++cpu) resize_[cpu].lock.unlock();
+  if (any_candidates &&
+      (follow_cpuset || forwarder_.release_drained_slab_metadata())) {
+    // Only the CPUs sharing a hugepage of slab metadata with a candidate can
+    // be unpopulated, so only those need to be locked.
+    const uint8_t shift = freelist_.GetShift();
+    CpuSet locked;
+    locked.Zero();
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      if (!release_candidates.IsSet(cpu)) continue;
+      const auto [first, last] = freelist_.CpusSharingHugePage(cpu);
+      for (int other = first; other < last; ++other) locked.Set(other);
+    }
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      if (locked.IsSet(cpu)) resize_[cpu].lock.lock();
+    }
+    // Resizing the slabs takes every lock, so the hugepages cannot have moved
+    // unless it ran before we took them.
+    if (freelist_.GetShift() == shift) {
+      freelist_.ReleaseSlabMetadataForDrainedCpus(
+          [&locked](int cpu) { return locked.IsSet(cpu); },
+          [this](int cpu) { return HasPopulated(cpu); },
+          [this](int cpu) {
+            TC_CHECK_EQ(resize_[cpu].available, resize_[cpu].capacity,
+                        "CPU %u was not actually drained, or available is out "
+                        "of sync",
+                        cpu);
+            resize_[cpu].populated.store(false, std::memory_order_release);
+            resize_[cpu].num_unpopulates.fetch_add(1,
+                                                   std::memory_order_relaxed);
+          },
+          [this](void* slab_addr, size_t slab_size) {
+            return MadviseAwaySlabs(slab_addr, slab_size);
+          });
+    }
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      if (locked.IsSet(cpu)) resize_[cpu].lock.unlock();
+    }
   }
 }
 
@@ -1496,9 +1743,10 @@ int CpuCache<Forwarder>::GetUpdatedMaxCapacities(
   for (int cpu = 0; cpu < num_cpus; ++cpu) {
     index = 0;
     if (!HasPopulated(cpu)) continue;
+    PerCpuClassInfo& info = PopulatedClassInfo(cpu);
     for (size_t size_class = 0; size_class < kNumClasses; ++size_class) {
       total_misses[index] +=
-          resize_[cpu].per_class[size_class].GetAndUpdateIntervalMisses(
+          info.per_class[size_class].GetAndUpdateIntervalMisses(
               PerClassMissType::kMaxCapacityTotal,
               PerClassMissType::kMaxCapacityResize);
 
@@ -1737,8 +1985,9 @@ inline void CpuCache<Forwarder>::ResizeSizeClasses() {
 
     // Record full stats in previous full stat counters so that we can collect
     // stats per interval.
+    PerCpuClassInfo& info = PopulatedClassInfo(cpu);
     for (size_t size_class = 1; size_class < kNumClasses; ++size_class) {
-      resize_[cpu].per_class[size_class].UpdateIntervalMisses(
+      info.per_class[size_class].UpdateIntervalMisses(
           PerClassMissType::kCapacityTotal, PerClassMissType::kCapacityResize);
     }
 
@@ -1751,18 +2000,21 @@ inline void CpuCache<Forwarder>::ResizeSizeClasses() {
 
 template <class Forwarder>
 void CpuCache<Forwarder>::ResizeCpuSizeClasses(int cpu) {
-  if (resize_[cpu].available.load(std::memory_order_relaxed) >=
-      kMaxCpuCacheSize) {
-    // We still have enough available capacity, so all size classes can just
-    // grow as they see fit.
+  // We may still have enough available capacity for all size classes to just
+  // grow as they see fit, but partitions over their share must still shrink.
+  const bool has_available =
+      resize_[cpu].available.load(std::memory_order_relaxed) >=
+      kMaxCpuCacheSize;
+  if (has_available && !PartitionsOverLimit(cpu)) {
     return;
   }
 
+  PerCpuClassInfo& info = PopulatedClassInfo(cpu);
   absl::FixedArray<SizeClassMissStat> miss_stats(kNumClasses - 1);
   for (size_t size_class = 1; size_class < kNumClasses; ++size_class) {
     miss_stats[size_class - 1] = SizeClassMissStat{
         .size_class = size_class,
-        .misses = resize_[cpu].per_class[size_class].GetIntervalMisses(
+        .misses = info.per_class[size_class].GetIntervalMisses(
             PerClassMissType::kCapacityTotal,
             PerClassMissType::kCapacityResize)};
   }
@@ -1785,7 +2037,8 @@ void CpuCache<Forwarder>::ResizeCpuSizeClasses(int cpu) {
     AllocationGuardSpinLockHolder h(resize_[cpu].lock);
     subtle::percpu::ScopedSlabCpuStop<kNumClasses> cpu_stop(freelist_, cpu);
     const auto max_capacity = GetMaxCapacityFunctor(freelist_.GetShift());
-    size_t size_classes_to_resize = 5;
+    available += ShrinkPartitionsToLimit(cpu);
+    size_t size_classes_to_resize = has_available ? 0 : 5;
     TC_ASSERT_LT(size_classes_to_resize, kNumClasses);
     for (size_t i = 0; i < size_classes_to_resize; ++i) {
       // If a size class with largest misses is zero, break. Other size classes
@@ -1823,12 +2076,15 @@ void CpuCache<Forwarder>::ResizeCpuSizeClasses(int cpu) {
         available += StealCapacityForSizeClassWithinCpu(
             cpu, {miss_stats.begin(), size_classes_to_resize}, to_steal_bytes);
       }
-      size_t capacity_acquired = std::min<size_t>(can_grow, available / size);
+      size_t capacity_acquired = std::min<size_t>(
+          {static_cast<size_t>(can_grow), available / size,
+           PartitionCapacityHeadroom(cpu, size_class_to_grow) / size});
       if (capacity_acquired != 0) {
         size_t got = freelist_.GrowOtherCache(
             cpu, size_class_to_grow, capacity_acquired, [&](uint8_t shift) {
               return GetMaxCapacity(size_class_to_grow, shift);
             });
+        AddPartitionAllocated(cpu, size_class_to_grow, got * size);
         available -= got * size;
       }
     }
@@ -1910,8 +2166,6 @@ template <class Forwarder>
 inline void CpuCache<Forwarder>::StealFromOtherCache(
     int cpu, int max_populated_cpu, absl::Span<CpuMissStat> skip_cpus,
     size_t bytes) {
-  constexpr double kCacheMissThreshold = 0.80;
-
   const CpuCacheMissStats dest_misses =
       GetIntervalCacheMissStats(cpu, MissCount::kShuffle);
 
@@ -2014,6 +2268,76 @@ inline void CpuCache<Forwarder>::StealFromOtherCache(
   }
 }
 
+template <class Forwarder>
+inline size_t CpuCache<Forwarder>::StealOnDemand(int cpu, size_t bytes) {
+  if (!forwarder_.per_cpu_caches_on_demand_steal()) return 0;
+
+  ResizeInfo& dest = resize_[cpu];
+  // Claim this interval's steal in one step, so that racing Grow calls for the
+  // same cpu (e.g. after a preemption) don't both scan.
+  if (!dest.last_on_demand_steal.UpdateIfElapsed(kOnDemandStealInterval)) {
+    return 0;
+  }
+
+  // Find the coldest cpu cache in our L3 domain, using the same criteria as
+  // StealFromOtherCache.  Capacity moved within an L3 domain stays close to
+  // the objects it caches.
+  const unsigned l3 = forwarder_.l3_cache_index(cpu);
+  const CpuCacheMissStats dest_misses =
+      GetIntervalCacheMissStats(cpu, MissCount::kShuffle);
+  int src_cpu = -1;
+  CpuCacheMissStats src_misses;
+  for (int other = 0, num_cpus = NumCPUs(); other < num_cpus; ++other) {
+    if (other == cpu || !HasPopulated(other)) continue;
+    if (forwarder_.l3_cache_index(other) != l3) continue;
+    if (Capacity(other) < kCacheCapacityThreshold * CacheLimit()) continue;
+
+    const CpuCacheMissStats misses =
+        GetIntervalCacheMissStats(other, MissCount::kShuffle);
+    if (src_cpu < 0 || misses.underflows + misses.overflows <
+                           src_misses.underflows + src_misses.overflows) {
+      src_cpu = other;
+      src_misses = misses;
+    }
+  }
+  if (src_cpu < 0 ||
+      src_misses.underflows > kCacheMissThreshold * dest_misses.underflows ||
+      src_misses.overflows > kCacheMissThreshold * dest_misses.overflows) {
+    return 0;
+  }
+
+  ResizeInfo& src = resize_[src_cpu];
+  // Unallocated capacity is cheap to take.
+  size_t acquired = subtract_at_least(&src.available, 0, bytes);
+  // Shrinking size classes needs the source's lock.  Don't wait for it here,
+  // on the allocation path: whoever holds it is resizing that cache anyway.
+  if (acquired < bytes && src.lock.try_lock()) {
+    {
+      AllocationGuard guard;
+      subtle::percpu::ScopedSlabCpuStop<kNumClasses> cpu_stop(freelist_,
+                                                              src_cpu);
+      size_t source_size_class = src.next_steal;
+      for (size_t i = 1; i < kNumClasses && acquired < bytes;
+           ++i, ++source_size_class) {
+        if (source_size_class >= kNumClasses) {
+          source_size_class = 1;
+        }
+        acquired += ShrinkOtherCache(src_cpu, source_size_class);
+      }
+      src.next_steal = source_size_class;
+    }
+    src.lock.unlock();
+  }
+  if (acquired == 0) return 0;
+
+  src.capacity.fetch_sub(acquired, std::memory_order_relaxed);
+  dest.capacity.fetch_add(acquired, std::memory_order_relaxed);
+  dest.available.fetch_add(acquired, std::memory_order_relaxed);
+  dest.on_demand_steals.fetch_add(1, std::memory_order_relaxed);
+  dest.on_demand_stolen_bytes.fetch_add(acquired, std::memory_order_relaxed);
+  return acquired;
+}
+
 template <class Forwarder>
 size_t CpuCache<Forwarder>::ShrinkOtherCache(int cpu, size_t size_class) {
   TC_ASSERT(cpu >= 0 && cpu < NumCPUs(), "cpu=%d", cpu);
@@ -2059,7 +2383,7 @@ size_t CpuCache<Forwarder>::ShrinkOtherCache(int cpu, size_t size_class) {
   } else if (size <= (64 << 10)) {
     score = (length >= capacity);
   }
-  if (resize_[cpu].per_class[size_class].Tick() < score) {
+  if (PopulatedClassInfo(cpu).per_class[size_class].Tick() < score) {
     return 0;
   }
 
@@ -2072,6 +2396,7 @@ size_t CpuCache<Forwarder>::ShrinkOtherCache(int cpu, size_t size_class) {
           })) {
     return 0;
   }
+  AddPartitionAllocated(cpu, size_class, -static_cast<int64_t>(size));
   return size;
 }
 
@@ -2165,6 +2490,118 @@ inline uint64_t CpuCache<Forwarder>::Allocated(int target_cpu) const {
   return total;
 }
 
+template <class Forwarder>
+inline uint64_t CpuCache<Forwarder>::PartitionAllocated(
+    int target_cpu, size_t partition) const {
+  TC_ASSERT_GE(target_cpu, 0);
+  TC_ASSERT_LT(partition, kNormalPartitions);
+  if (!HasPopulated(target_cpu)) {
+    return 0;
+  }
+
+  const int64_t allocated =
+      resize_[target_cpu].partition_allocated[partition].load(
+          std::memory_order_relaxed);
+  return std::max<int64_t>(allocated, 0);
+}
+
+template <class Forwarder>
+inline uint64_t CpuCache<Forwarder>::PartitionUsedBytes(
+    int target_cpu, size_t partition) const {
+  TC_ASSERT_GE(target_cpu, 0);
+  TC_ASSERT_LT(partition, kNormalPartitions);
+  if (!HasPopulated(target_cpu)) {
+    return 0;
+  }
+
+  uint64_t total = 0;
+  const size_t end = (partition + 1) * kNumBaseClasses;
+  for (size_t size_class = std::max<size_t>(partition * kNumBaseClasses, 1);
+       size_class < end; size_class++) {
+    int size = forwarder_.class_to_size(size_class);
+    total += size * freelist_.Length(target_cpu, size_class);
+  }
+  return total;
+}
+
+template <class Forwarder>
+inline size_t CpuCache<Forwarder>::PartitionCapacityHeadroom(
+    int cpu, size_t size_class) const {
+  if (IsExpandedSizeClass(size_class)) {
+    return std::numeric_limits<size_t>::max();
+  }
+  const size_t partition = size_class / kNumBaseClasses;
+  const int32_t percent = forwarder_.partition_per_cpu_cache_percent(partition);
+  if (percent >= 100) {
+    return std::numeric_limits<size_t>::max();
+  }
+  const uint64_t limit = CacheLimit() * percent / 100;
+  const uint64_t allocated = PartitionAllocated(cpu, partition);
+  return allocated < limit ? limit - allocated : 0;
+}
+
+template <class Forwarder>
+inline void CpuCache<Forwarder>::AddPartitionAllocated(int cpu,
+                                                       size_t size_class,
+                                                       int64_t bytes) {
+  if (IsExpandedSizeClass(size_class)) {
+    return;
+  }
+  resize_[cpu].partition_allocated[size_class / kNumBaseClasses].fetch_add(
+      bytes, std::memory_order_relaxed);
+}
+
+template <class Forwarder>
+inline bool CpuCache<Forwarder>::PartitionsOverLimit(int cpu) const {
+  for (size_t partition = 0; partition < kNormalPartitions; ++partition) {
+    const int32_t percent =
+        forwarder_.partition_per_cpu_cache_percent(partition);
+    if (percent >= 100) continue;
+    if (PartitionAllocated(cpu, partition) > CacheLimit() * percent / 100) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class Forwarder>
+inline size_t CpuCache<Forwarder>::ShrinkPartitionsToLimit(int cpu) {
+  size_t freed = 0;
+  for (size_t partition = 0; partition < kNormalPartitions; ++partition) {
+    const int32_t percent =
+        forwarder_.partition_per_cpu_cache_percent(partition);
+    if (percent >= 100) continue;
+    const uint64_t limit = CacheLimit() * percent / 100;
+    uint64_t allocated = PartitionAllocated(cpu, partition);
+    const size_t begin = std::max<size_t>(partition * kNumBaseClasses, 1);
+    // Larger size classes give back more capacity for each object evicted.
+    for (size_t size_class = (partition + 1) * kNumBaseClasses - 1;
+         allocated > limit && size_class >= begin; --size_class) {
+      const size_t capacity = freelist_.Capacity(cpu, size_class);
+      const size_t size = forwarder_.class_to_size(size_class);
+      if (capacity == 0 || size == 0) continue;
+      const size_t len =
+          std::min<size_t>(capacity, (allocated - limit + size - 1) / size);
+      const size_t shrunk = freelist_.ShrinkOtherCache(
+          cpu, size_class, len,
+          [this](size_t size_class, void** batch, size_t count) {
+            const size_t batch_length =
+                forwarder_.num_objects_to_move(size_class);
+            for (size_t i = 0; i < count; i += batch_length) {
+              size_t n = std::min(batch_length, count - i);
+              ReleaseToBackingCache(size_class,
+                                    absl::Span<void*>(batch + i, n));
+            }
+          });
+      AddPartitionAllocated(cpu, size_class,
+                            -static_cast<int64_t>(shrunk * size));
+      freed += shrunk * size;
+      allocated -= std::min<uint64_t>(allocated, shrunk * size);
+    }
+  }
+  return freed;
+}
+
 template <class Forwarder>
 inline uint64_t CpuCache<Forwarder>::UsedBytes(int target_cpu) const {
   TC_ASSERT_GE(target_cpu, 0);
@@ -2249,6 +2686,8 @@ struct DrainHandler {
     // CPU's slack.
     cache.resize_[cpu].available.fetch_add(cap * size,
                                            std::memory_order_relaxed);
+    cache.AddPartitionAllocated(cpu, size_class,
+                                -static_cast<int64_t>(cap * size));
     for (size_t i = 0; i < count; i += batch_length) {
       size_t n = std::min(batch_length, count - i);
       cache.ReleaseToBackingCache(size_class, absl::Span<void*>(batch + i, n));
@@ -2280,9 +2719,10 @@ inline uint64_t CpuCache<Forwarder>::Drain(int cpu) {
   // Resetting the whole array of last miss timestamps is infrequent on idle
   // CPUs; it prevents 32-bit cycle counter epoch exhaustion if no longer
   // updated when idle.
+  PerCpuClassInfo& info = PopulatedClassInfo(cpu);
   for (int size_class = 0; size_class < kNumClasses; ++size_class) {
-    resize_[cpu].last_miss[size_class].last_overflow_cycles.Reset();
-    resize_[cpu].last_miss[size_class].last_underflow_cycles.Reset();
+    info.last_miss[size_class].last_overflow_cycles.Reset();
+    info.last_miss[size_class].last_underflow_cycles.Reset();
   }
 
   return bytes;
@@ -2355,12 +2795,27 @@ inline int CpuCache<Forwarder>::MaxTouchedCpu() const {
   return 0;
 }
 
+template <class Forwarder>
+inline int CpuCache<Forwarder>::CountTouchedPhysicalCpus() const {
+  if (!subtle::percpu::UsingVirtualCpus()) return CountTouchedCpus();
+  if (resize_ == nullptr) return 0;
+  int count = 0;
+  const int num_cpus = NumCPUs();
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    if (resize_[cpu].touched_physical.load(std::memory_order_relaxed)) {
+      count++;
+    }
+  }
+  return count;
+}
+
 template <class Forwarder>
 inline void CpuCache<Forwarder>::ClearTouchedCpus() {
   if (resize_ == nullptr) return;
   const int num_cpus = NumCPUs();
   for (int cpu = 0; cpu < num_cpus; ++cpu) {
     resize_[cpu].touched.store(false, std::memory_order_relaxed);
+    resize_[cpu].touched_physical.store(false, std::memory_order_relaxed);
   }
 }
 
@@ -2572,6 +3027,10 @@ CpuCache<Forwarder>::GetTotalCacheMissStats(int cpu) const {
       std::memory_order_relaxed);
   stats.overflows =
       resize_[cpu].overflows[MissCount::kTotal].load(std::memory_order_relaxed);
+  stats.steals =
+      resize_[cpu].on_demand_steals.load(std::memory_order_relaxed);
+  stats.stolen_bytes =
+      resize_[cpu].on_demand_stolen_bytes.load(std::memory_order_relaxed);
   return stats;
 }
 
@@ -2632,8 +3091,12 @@ template <class Forwarder>
 size_t CpuCache<Forwarder>::GetIntervalSizeClassMisses(
     int cpu, size_t size_class, PerClassMissType total_type,
     PerClassMissType interval_type) {
-  return resize_[cpu].per_class[size_class].GetIntervalMisses(total_type,
-                                                              interval_type);
+  PerCpuClassInfo* info = GetClassInfo(cpu);
+  if (info == nullptr) {
+    return 0;
+  }
+  return info->per_class[size_class].GetIntervalMisses(total_type,
+                                                       interval_type);
 }
 
 template <class Forwarder>
@@ -2654,11 +3117,15 @@ CpuCache<Forwarder>::GetSizeClassCapacityStats(size_t size_class) const {
     if (!HasPopulated(cpu)) {
       continue;
     }
+    PerCpuClassInfo* info = GetClassInfo(cpu);
+    if (info == nullptr) {
+      continue;
+    }
 
     ++num_populated;
 
-    const typename ResizeInfo::LastMiss& last_miss =
-        resize_[cpu].last_miss[size_class];
+    const typename PerCpuClassInfo::LastMiss& last_miss =
+        info->last_miss[size_class];
 
     size_t cap = freelist_.Capacity(cpu, size_class);
     stats.max_capacity = std::max(stats.max_capacity, cap);
@@ -2699,7 +3166,7 @@ CpuCache<Forwarder>::GetSizeClassCapacityStats(size_t size_class) const {
       stats.max_last_underflow_cpu_id = cpu;
     }
     stats.max_capacity_misses +=
-        resize_[cpu].per_class[size_class].GetIntervalMisses(
+        info->per_class[size_class].GetIntervalMisses(
             PerClassMissType::kMaxCapacityTotal,
             PerClassMissType::kMaxCapacityResize);
   }
@@ -2735,6 +3202,11 @@ inline void CpuCache<Forwarder>::Print(Printer& out) const {
         populated ? " populated" : "");
   }
 
+  out.printf(
+      "%d cpu caches touched, running on %d physical cpus, since the last "
+      "background pass\n",
+      CountTouchedCpus(), CountTouchedPhysicalCpus());
+
   out.printf("------------------------------------------------\n");
   out.printf("Size class capacity statistics in per-cpu caches\n");
   out.printf("------------------------------------------------\n");
@@ -2763,7 +3235,25 @@ inline void CpuCache<Forwarder>::Print(Printer& out) const {
   }
 
   out.printf("------------------------------------------------\n");
-  out.printf("Number of per-CPU cache underflows, overflows, and drains\n");
+  out.printf("Heap partition usage of per-cpu caches\n");
+  out.printf("------------------------------------------------\n");
+  for (size_t partition = 0; partition < forwarder_.active_partitions();
+       ++partition) {
+    uint64_t used = 0, allocated = 0;
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      used += PartitionUsedBytes(cpu, partition);
+      allocated += PartitionAllocated(cpu, partition);
+    }
+    out.printf(
+        "partition %zu: %12u bytes used, %12u bytes capacity, "
+        "%3d%% of per cpu limit allowed\n",
+        partition, used, allocated,
+        forwarder_.partition_per_cpu_cache_percent(partition));
+  }
+
+  out.printf("------------------------------------------------\n");
+  out.printf(
+      "Number of per-CPU cache underflows, overflows, drains, and steals\n");
   out.printf("------------------------------------------------\n");
   const auto print_miss_stats = [&out](CpuCacheMissStats miss_stats,
                                        uint64_t drains, uint64_t resizes) {
@@ -2771,9 +3261,11 @@ inline void CpuCache<Forwarder>::Print(Printer& out) const {
         "%12u underflows,"
         "%12u overflows, overflows / underflows: %5.2f, "
         "%12u drains (reclaims),"
-        "%12u resizes\n",
+        "%12u resizes,"
+        "%12u on-demand steals (%u bytes)\n",
         miss_stats.underflows, miss_stats.overflows,
-        safe_div(miss_stats.overflows, miss_stats.underflows), drains, resizes);
+        safe_div(miss_stats.overflows, miss_stats.underflows), drains, resizes,
+        miss_stats.steals, miss_stats.stolen_bytes);
   };
   out.printf("Total  :");
   print_miss_stats(GetTotalCacheMissStats(), GetNumDrains(), GetNumResizes());
@@ -2782,6 +3274,8 @@ inline void CpuCache<Forwarder>::Print(Printer& out) const {
     print_miss_stats(GetTotalCacheMissStats(cpu), GetNumDrains(cpu),
                      GetNumResizes(cpu));
   }
+  out.printf("%12u drains of CPUs outside the cpuset, %12u unpopulates\n",
+             GetNumDrainsOutsideCpuset(), GetNumUnpopulates());
 
   out.printf("------------------------------------------------\n");
   out.printf("Per-CPU cache slab resizing info:\n");
@@ -2822,6 +3316,8 @@ inline void CpuCache<Forwarder>::PrintInPbtxt(PbtxtRegion& region) const {
     entry.PrintBool("populated", populated);
     entry.PrintI64("underflows", miss_stats.underflows);
     entry.PrintI64("overflows", miss_stats.overflows);
+    entry.PrintI64("on_demand_steals", miss_stats.steals);
+    entry.PrintI64("on_demand_stolen_bytes", miss_stats.stolen_bytes);
     // Name kept for backward compatibility.
     entry.PrintI64("reclaims", drains);
     entry.PrintI64("size_class_resizes", resizes);
@@ -2849,6 +3345,22 @@ inline void CpuCache<Forwarder>::PrintInPbtxt(PbtxtRegion& region) const {
     entry.PrintI64("max_capacity_misses", stats.max_capacity_misses);
   }
 
+  // Record heap partition usage.
+  for (size_t partition = 0; partition < forwarder_.active_partitions();
+       ++partition) {
+    uint64_t used = 0, allocated = 0;
+    for (int cpu = 0, num_cpus = NumCPUs(); cpu < num_cpus; ++cpu) {
+      used += PartitionUsedBytes(cpu, partition);
+      allocated += PartitionAllocated(cpu, partition);
+    }
+    PbtxtRegion entry = region.CreateSubRegion("partition");
+    entry.PrintI64("partition", partition);
+    entry.PrintI64("used", used);
+    entry.PrintI64("capacity", allocated);
+    entry.PrintI64("per_cpu_cache_percent",
+                   forwarder_.partition_per_cpu_cache_percent(partition));
+  }
+
   // Record dynamic slab statistics.
   region.PrintI64("dynamic_per_cpu_slab_size", 1 << freelist_.GetShift());
   for (int shift = 0; shift < kNumPossiblePerCpuShifts; ++shift) {
@@ -2864,8 +3376,12 @@ inline void CpuCache<Forwarder>::PrintInPbtxt(PbtxtRegion& region) const {
       dynamic_slab_info_.madvise_failed_bytes.load(std::memory_order_relaxed));
 
   region.PrintI64("cpu_caches_touched", CountTouchedCpus());
+  region.PrintI64("physical_cpus_touched", CountTouchedPhysicalCpus());
   region.PrintI64("max_cpu_cache_touched", MaxTouchedCpu());
   region.PrintI64("cpu_caches_populated", total_populated);
+  region.PrintI64("cpu_cache_drains_outside_cpuset",
+                  GetNumDrainsOutsideCpuset());
+  region.PrintI64("cpu_cache_unpopulates", GetNumUnpopulates());
 }
 
 template <class Forwarder>
@@ -2874,11 +3390,24 @@ inline uint8_t CpuCache<Forwarder>::PartitionShift() const {
               forwarder_.multiple_non_numa_partitions()),
             "NUMA-awareness should never be enabled with non-NUMA partitions.");
   if (forwarder_.active_partitions() > 1) {
-    return absl::bit_ceil(forwarder_.active_partitions() - 1);
+    // Each partition has its own copy of the size classes, so give the slab
+    // room for all of them, up to the largest slab we can address.
+    return std::min<uint8_t>(
+        absl::bit_width(forwarder_.active_partitions() - 1),
+        kMaxPerCpuSlabShift - kMaxBasePerCpuShift);
   }
   return 0;
 }
 
+// Returns the shift by which MaxCapacity scales down per-partition depths,
+// for partitions that PartitionShift() could not grow the slab for.
+template <class Forwarder>
+inline uint8_t CpuCache<Forwarder>::PartitionCapacityShift() const {
+  if (forwarder_.active_partitions() <= 1) return 0;
+  return absl::bit_width(forwarder_.active_partitions() - 1) -
+         PartitionShift();
+}
+
 template <class Forwarder>
 inline void CpuCache<Forwarder>::PerClassResizeInfo::Init() {
   state_.store(0, std::memory_order_relaxed);
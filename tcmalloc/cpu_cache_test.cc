@@ -18,6 +18,7 @@
 #include <sys/prctl.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
@@ -55,6 +56,7 @@
 #include "tcmalloc/common.h"
 #include "tcmalloc/internal/affinity.h"
 #include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/cpu_utils.h"
 #include "tcmalloc/internal/logging.h"
 #include "tcmalloc/internal/numa.h"
 #include "tcmalloc/internal/optimization.h"
@@ -122,6 +124,21 @@ class CpuCachePeer {
     return cpu_cache.freelist_.GetCpuStateSize();
   }
 
+  template <typename CpuCache>
+  static uint8_t PartitionShift(const CpuCache& cpu_cache) {
+    return cpu_cache.PartitionShift();
+  }
+
+  template <typename CpuCache>
+  static uint8_t PartitionCapacityShift(const CpuCache& cpu_cache) {
+    return cpu_cache.PartitionCapacityShift();
+  }
+
+  template <typename CpuCache>
+  static size_t MaxCapacity(const CpuCache& cpu_cache, size_t size_class) {
+    return cpu_cache.MaxCapacity(size_class);
+  }
+
   template <typename CpuCache>
   static void MadviseAwaySlabs(CpuCache& cpu_cache, void* slab_addr,
                                size_t slab_size) {
@@ -327,10 +344,7 @@ class TestStaticForwarder {
     return false;
   }
 
-  auto active_partitions() const {
-    // TODO(b/446814339): Test other states.
-    return 1u;
-  }
+  auto active_partitions() const { return active_partitions_; }
 
   bool multiple_non_numa_partitions() const {
     // TODO(b/446814339): Test other states.
@@ -341,6 +355,18 @@ class TestStaticForwarder {
     return release_drained_slab_metadata_;
   }
 
+  bool per_cpu_caches_on_demand_steal() const { return on_demand_steal_; }
+
+  unsigned l3_cache_index(int cpu) const { return cpu / cpus_per_l3_cache_; }
+
+  bool per_cpu_caches_follow_cpuset() const { return follow_cpuset_; }
+
+  const CpuSet& allowed_cpus() const { return allowed_cpus_; }
+
+  int32_t partition_per_cpu_cache_percent(size_t partition) const {
+    return partition_per_cpu_cache_percent_[partition];
+  }
+
   size_t arena_reported_nonresident_bytes_ = 0;
   int64_t arena_reported_impending_bytes_ = 0;
   size_t shrink_to_usage_limit_calls_ = 0;
@@ -350,6 +376,17 @@ class TestStaticForwarder {
   DynamicSlab dynamic_slab_ = DynamicSlab::kNoop;
   std::optional<SizeMap> size_map_;
   bool release_drained_slab_metadata_ = false;
+  bool on_demand_steal_ = false;
+  int cpus_per_l3_cache_ = std::numeric_limits<int>::max();
+  bool follow_cpuset_ = false;
+  CpuSet allowed_cpus_;
+  unsigned active_partitions_ = 1;
+  std::array<int32_t, kNormalPartitions> partition_per_cpu_cache_percent_ =
+      [] {
+        std::array<int32_t, kNormalPartitions> percents;
+        percents.fill(100);
+        return percents;
+      }();
 
  private:
   NumaTopology<kNumaPartitions, kNumBaseClasses> numa_topology_;
@@ -1599,6 +1636,209 @@ TEST(CpuCacheTest, ColdHotCacheShuffleTest) {
   cache.Deactivate();
 }
 
+TEST(CpuCacheTest, StealOnDemand) {
+  if (!subtle::percpu::IsFast() || NumCPUs() < 3) {
+    return;
+  }
+
+  CpuCache cache;
+  const size_t max_cpu_cache_size = 1 << 10;
+  cache.SetCacheLimit(max_cpu_cache_size);
+  cache.forwarder().on_demand_steal_ = true;
+  // cpus 0 and 1 share an L3 cache, cpu 2 does not.
+  cache.forwarder().cpus_per_l3_cache_ = 2;
+  cache.Activate();
+
+  constexpr int hot_cpu_id = 0;
+  constexpr int cold_cpu_id = 1;
+  constexpr int remote_cpu_id = 2;
+  const size_t size_class = 2;
+
+  ColdCacheOperations(cache, cold_cpu_id, size_class);
+  ColdCacheOperations(cache, remote_cpu_id, size_class);
+
+  // Grow steals as soon as it runs out of capacity, without waiting for
+  // ShuffleCpuCaches.  Steals are rate-limited, so allow for a few rounds.
+  constexpr int kMaxStealTries = 1000;
+  for (int num_tries = 0;
+       num_tries < kMaxStealTries &&
+       cache.GetTotalCacheMissStats(hot_cpu_id).steals == 0;
+       ++num_tries) {
+    HotCacheOperations(cache, hot_cpu_id, /*drain=*/true);
+  }
+
+  const CpuCache::CpuCacheMissStats stats =
+      cache.GetTotalCacheMissStats(hot_cpu_id);
+  EXPECT_GT(stats.steals, 0);
+  EXPECT_GT(stats.stolen_bytes, 0);
+  EXPECT_GT(cache.Capacity(hot_cpu_id), max_cpu_cache_size);
+  EXPECT_EQ(cache.GetTotalCacheMissStats(cold_cpu_id).steals, 0);
+
+  // Capacity only moves within the L3 cache.
+  EXPECT_LT(cache.Capacity(cold_cpu_id), max_cpu_cache_size);
+  EXPECT_EQ(cache.Capacity(remote_cpu_id), max_cpu_cache_size);
+  EXPECT_EQ(cache.Capacity(hot_cpu_id) + cache.Capacity(cold_cpu_id),
+            2 * max_cpu_cache_size);
+  for (int cpu : {hot_cpu_id, cold_cpu_id, remote_cpu_id}) {
+    EXPECT_EQ(cache.Allocated(cpu) + cache.Unallocated(cpu),
+              cache.Capacity(cpu));
+  }
+
+  // Drain caches.
+  cache.Deactivate();
+}
+
+TEST(CpuCacheTest, PartitionCapacityLimit) {
+  if (!subtle::percpu::IsFast()) {
+    return;
+  }
+
+  CpuCache cache;
+  const size_t max_cpu_cache_size = 1 << 16;
+  cache.SetCacheLimit(max_cpu_cache_size);
+  // Size classes 1 and 2 belong to partition 0.
+  cache.forwarder().partition_per_cpu_cache_percent_[0] = 25;
+  cache.Activate();
+
+  constexpr int kCpuId = 0;
+  for (int i = 0; i < 10; ++i) {
+    HotCacheOperations(cache, kCpuId, /*drain=*/false);
+    cache.ResizeSizeClasses();
+  }
+
+  EXPECT_GT(cache.PartitionAllocated(kCpuId, 0), 0);
+  EXPECT_LE(cache.PartitionAllocated(kCpuId, 0), max_cpu_cache_size / 4);
+  EXPECT_LE(cache.PartitionUsedBytes(kCpuId, 0),
+            cache.PartitionAllocated(kCpuId, 0));
+  // The rest of the capacity stays with the cpu for other partitions.
+  EXPECT_EQ(cache.Allocated(kCpuId) + cache.Unallocated(kCpuId),
+            cache.Capacity(kCpuId));
+  EXPECT_GE(cache.Unallocated(kCpuId), max_cpu_cache_size * 3 / 4);
+
+  // The running count of a partition's capacity matches its size classes.
+  for (size_t partition = 0; partition < kNormalPartitions; ++partition) {
+    uint64_t capacity = 0;
+    for (size_t size_class = std::max<size_t>(partition * kNumBaseClasses, 1);
+         size_class < (partition + 1) * kNumBaseClasses; ++size_class) {
+      capacity += cache.GetCapacityOfSizeClass(kCpuId, size_class) *
+                  cache.forwarder().class_to_size(size_class);
+    }
+    EXPECT_EQ(cache.PartitionAllocated(kCpuId, partition), capacity)
+        << partition;
+  }
+
+  // Draining the cpu returns all of its partitions' capacity.
+  cache.Drain(kCpuId);
+  for (size_t partition = 0; partition < kNormalPartitions; ++partition) {
+    EXPECT_EQ(cache.PartitionAllocated(kCpuId, partition), 0) << partition;
+  }
+
+  // Drain caches.
+  cache.Deactivate();
+}
+
+TEST(CpuCacheTest, PartitionCapacityShift) {
+  using cpu_cache_internal::kMaxBasePerCpuShift;
+  using cpu_cache_internal::kMaxPerCpuSlabShift;
+
+  CpuCache cache;
+  constexpr size_t kSizeClass = 1;
+  const size_t batch = cache.forwarder().num_objects_to_move(kSizeClass);
+  const size_t unpartitioned = CpuCachePeer::MaxCapacity(cache, kSizeClass);
+
+  for (unsigned partitions = 1; partitions <= kMaxNormalPartitions;
+       ++partitions) {
+    SCOPED_TRACE(absl::StrCat("partitions=", partitions));
+    cache.forwarder().active_partitions_ = partitions;
+
+    const uint8_t slab_shift = CpuCachePeer::PartitionShift(cache);
+    const uint8_t capacity_shift = CpuCachePeer::PartitionCapacityShift(cache);
+    // The slab grows for as many partitions as it can address, and the
+    // per-partition depths shrink for the rest.
+    EXPECT_LE(slab_shift, kMaxPerCpuSlabShift - kMaxBasePerCpuShift);
+    EXPECT_EQ(slab_shift + capacity_shift,
+              partitions > 1 ? absl::bit_width(partitions - 1) : 0);
+    if (capacity_shift > 0) {
+      EXPECT_EQ(slab_shift, kMaxPerCpuSlabShift - kMaxBasePerCpuShift);
+    }
+
+    EXPECT_EQ(CpuCachePeer::MaxCapacity(cache, kSizeClass),
+              std::max(unpartitioned >> capacity_shift, batch));
+  }
+  cache.forwarder().active_partitions_ = 1;
+}
+
+TEST(CpuCacheTest, PartitionCapacityLimitLowered) {
+  if (!subtle::percpu::IsFast()) {
+    return;
+  }
+
+  CpuCache cache;
+  const size_t max_cpu_cache_size = 1 << 16;
+  cache.SetCacheLimit(max_cpu_cache_size);
+  cache.Activate();
+
+  constexpr int kCpuId = 0;
+  for (int i = 0; i < 10; ++i) {
+    HotCacheOperations(cache, kCpuId, /*drain=*/false);
+    cache.ResizeSizeClasses();
+  }
+  const uint64_t grown = cache.PartitionAllocated(kCpuId, 0);
+  ASSERT_GT(grown, max_cpu_cache_size / 8);
+
+  // Lowering the share shrinks capacity the partition already holds on the
+  // next resize, and returns it to the cpu.
+  cache.forwarder().partition_per_cpu_cache_percent_[0] = 10;
+  cache.ResizeSizeClasses();
+  EXPECT_LE(cache.PartitionAllocated(kCpuId, 0), max_cpu_cache_size / 10);
+  EXPECT_EQ(cache.Allocated(kCpuId) + cache.Unallocated(kCpuId),
+            cache.Capacity(kCpuId));
+
+  // Drain caches.
+  cache.Deactivate();
+}
+
+TEST(CpuCacheTest, DrainsCpusOutsideCpuset) {
+  if (!subtle::percpu::IsFast() || NumCPUs() < 2) {
+    return;
+  }
+
+  CpuCache cache;
+  cache.forwarder().follow_cpuset_ = true;
+  cache.forwarder().allowed_cpus_.Zero();
+  cache.forwarder().allowed_cpus_.Set(0);
+  cache.Activate();
+
+  const size_t size_class = 2;
+  ColdCacheOperations(cache, 0, size_class);
+  ColdCacheOperations(cache, 1, size_class);
+
+  // cpu 1 is drained right away, without waiting for it to become idle.
+  cache.TryDrainingCaches();
+  EXPECT_EQ(cache.GetNumDrains(0), 0);
+  EXPECT_EQ(cache.GetNumDrains(1), 1);
+  EXPECT_EQ(cache.GetNumDrainsOutsideCpuset(), 1);
+  EXPECT_EQ(cache.UsedBytes(1), 0);
+  EXPECT_NE(cache.UsedBytes(0), 0);
+
+  // Idle caches inside the cpuset are drained as usual, and empty caches
+  // outside it are not drained again.
+  cache.TryDrainingCaches();
+  EXPECT_EQ(cache.GetNumDrains(0), 1);
+  EXPECT_EQ(cache.GetNumDrains(1), 1);
+  EXPECT_EQ(cache.GetNumDrainsOutsideCpuset(), 1);
+
+  // The cache is usable again once the cpuset grows back.
+  cache.forwarder().allowed_cpus_.Set(1);
+  ColdCacheOperations(cache, 1, size_class);
+  EXPECT_TRUE(cache.HasPopulated(1));
+  EXPECT_NE(cache.UsedBytes(1), 0);
+  cache.TryDrainingCaches();
+  EXPECT_EQ(cache.GetNumDrainsOutsideCpuset(), 1);
+
+  cache.Deactivate();
+}
+
 TEST(CpuCacheTest, DrainCpuCache) {
   if (!subtle::percpu::IsFast()) {
     return;
@@ -2230,12 +2470,19 @@ TEST(TouchedCpus, SingleThreaded) {
 #endif
     cache.Deallocate(ptr, 1);
     const int after_deallocate = cache.CountTouchedCpus();
+    const int after_deallocate_physical = cache.CountTouchedPhysicalCpus();
     cache.ClearTouchedCpus();
 
     EXPECT_EQ(after_allocate, 1);
     EXPECT_EQ(after_deallocate, 1);
     EXPECT_EQ(after_clear1, 0);
     EXPECT_EQ(after_clear2, 0);
+    EXPECT_EQ(cache.CountTouchedPhysicalCpus(), 0);
+    if (!mask.Tampered()) {
+      // Whether or not slabs are indexed by virtual CPU ids, we only ran on
+      // kCpuId.
+      EXPECT_EQ(after_deallocate_physical, 1);
+    }
 
     if (mask.Tampered()) {
       EXPECT_EQ(after_allocate_deallocate, 2);
@@ -221,5 +221,28 @@ ABSL_ATTRIBUTE_NOINLINE void ReportCorruptedFree(
          FormatConvert(dealloc_align), FormatConvert(alloc_align));
 }
 
+[[noreturn]]
+ABSL_ATTRIBUTE_NOINLINE void ReportUseAfterFreeWrite(
+    Static& state, const void* ptr, size_t offset, size_t size,
+    absl::Span<void* const> allocation_stack,
+    absl::Span<void* const> deallocation_stack) {
+  TC_LOG("*** GWP-ASan (https://google.github.io/tcmalloc/gwp-asan.html) has detected a memory error ***");
+  TC_LOG(">>> Write at offset %v into freed buffer of length %v", offset, size);
+  TC_LOG("Error originates from memory allocated at:");
+  PrintStackTrace(allocation_stack.data(), allocation_stack.size());
+  TC_LOG("The memory was freed at:");
+  PrintStackTrace(deallocation_stack.data(), deallocation_stack.size());
+  TC_LOG(
+      "NOTE: The write was found when the object left the sampled quarantine, "
+      "so the stack trace that is about to crash is not where it happened.");
+
+  RecordCrash("GWP-ASan", "use-after-free");
+  state.gwp_asan_state().RecordUseAfterFree(ptr, allocation_stack,
+                                            deallocation_stack);
+
+  TC_BUG("Use-after-free write detected at %p (%p + %v)",
+         static_cast<const char*>(ptr) + offset, ptr, offset);
+}
+
 }  // namespace tcmalloc::tcmalloc_internal
 GOOGLE_MALLOC_SECTION_END
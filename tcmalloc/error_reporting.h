@@ -15,8 +15,10 @@
 #ifndef TCMALLOC_ERROR_REPORTING_H_
 #define TCMALLOC_ERROR_REPORTING_H_
 
+#include <cstddef>
 #include <new>
 
+#include "absl/types/span.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/static_vars.h"
 
@@ -62,6 +64,14 @@ ABSL_ATTRIBUTE_NOINLINE void ReportCorruptedFree(
     Static& state, std::align_val_t expected_alignment, const void* ptr,
     absl::Span<void*> allocation_stack);
 
+// Reports that the object at ptr was written to at offset after it was freed,
+// as found by SampledQuarantine.
+[[noreturn]]
+ABSL_ATTRIBUTE_NOINLINE void ReportUseAfterFreeWrite(
+    Static& state, const void* ptr, size_t offset, size_t size,
+    absl::Span<void* const> allocation_stack,
+    absl::Span<void* const> deallocation_stack);
+
 }  // namespace tcmalloc::tcmalloc_internal
 GOOGLE_MALLOC_SECTION_END
 
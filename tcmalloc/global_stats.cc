@@ -20,6 +20,7 @@
 #include <optional>
 #include <utility>
 
+#include "absl/base/internal/spinlock.h"
 #include "absl/base/nullability.h"
 #include "absl/base/optimization.h"
 #include "absl/strings/match.h"
@@ -35,6 +36,7 @@
 #include "tcmalloc/huge_page_filler.h"
 #include "tcmalloc/huge_page_options.h"
 #include "tcmalloc/huge_pages.h"
+#include "tcmalloc/internal/allocation_guard.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/cpu_utils.h"
 #include "tcmalloc/internal/logging.h"
@@ -42,6 +44,7 @@
 #include "tcmalloc/internal/optimization.h"
 #include "tcmalloc/internal/pageflags.h"
 #include "tcmalloc/internal/percpu.h"
+#include "tcmalloc/internal/proc_maps.h"
 #include "tcmalloc/internal/system_allocator.h"
 #include "tcmalloc/malloc_hook_invoke.h"
 #include "tcmalloc/metadata_object_allocator.h"
@@ -123,6 +126,7 @@ void ExtractStats(TCMallocStats& r, uint64_t* absl_nullable class_count,
   r.thread_bytes = 0;
 
   r.span_stats = tc_globals.span_allocator().stats();
+  r.compact_large_spans = tc_globals.pagemap().compact_large_spans();
   r.stack_stats = tc_globals.sampledallocation_allocator().stats();
   r.linked_sample_stats = tc_globals.linked_sample_allocator().stats();
   r.tc_stats = ThreadCache::GetStats(&r.thread_bytes, class_count);
@@ -156,6 +160,8 @@ void ExtractStats(TCMallocStats& r, uint64_t* absl_nullable class_count,
     r.num_released_soft_limit_exceeded = release_stats.soft_limit_exceeded;
     r.num_released_hard_limit_exceeded = release_stats.hard_limit_exceeded;
 
+    r.numa_placement = tc_globals.page_allocator().GetNumaPlacementStats();
+
     r.per_cpu_bytes = 0;
     r.sharded_transfer_bytes = 0;
     r.percpu_metadata_bytes_res = 0;
@@ -269,6 +275,30 @@ static int CountAllowedCpus() {
   return allowed_cpus.Count();
 }
 
+// Walking the process' mappings takes time proportional to their number, which
+// is largest just when the count is most interesting, so stats reuse the last
+// count for up to kMappingCountsRefreshInterval.
+static std::optional<MappingCounts> CachedMappingCounts() {
+  constexpr absl::Duration kMappingCountsRefreshInterval = absl::Seconds(10);
+  ABSL_CONST_INIT static absl::base_internal::SpinLock lock(
+      absl::base_internal::SCHEDULE_KERNEL_ONLY);
+  ABSL_CONST_INIT static absl::Time last_refresh = absl::InfinitePast();
+  ABSL_CONST_INIT static std::optional<MappingCounts> counts;
+
+  const absl::Time now = absl::Now();
+  {
+    AllocationGuardSpinLockHolder h(lock);
+    if (now - last_refresh < kMappingCountsRefreshInterval) return counts;
+  }
+
+  // Count without the lock held, so concurrent callers don't spin on it.
+  std::optional<MappingCounts> fresh = CountMappings();
+  AllocationGuardSpinLockHolder h(lock);
+  counts = fresh;
+  last_refresh = now;
+  return counts;
+}
+
 static absl::string_view SizeClassConfigurationString(
     SizeClassConfiguration config) {
   switch (config) {
@@ -359,6 +389,7 @@ void DumpStats(Printer& out, int level) {
       "MALLOC:\n"
       "MALLOC:   %12u               Spans in use\n"
       "MALLOC:   %12u (%7.1f MiB) Spans created\n"
+      "MALLOC:   %12u (%7.1f MiB) Compact large spans (Span bytes saved)\n"
       "MALLOC:   %12u               Thread heaps in use\n"
       "MALLOC:   %12u (%7.1f MiB) Thread heaps created\n"
       "MALLOC:   %12u               Stack traces in use\n"
@@ -395,6 +426,8 @@ void DumpStats(Printer& out, int level) {
       uint64_t(stats.span_stats.in_use),
       uint64_t(stats.span_stats.total),
       (stats.span_stats.total * sizeof(Span)) / MiB,
+      uint64_t(stats.compact_large_spans),
+      (stats.compact_large_spans * sizeof(Span)) / MiB,
       uint64_t(stats.tc_stats.in_use),
       uint64_t(stats.tc_stats.total),
       (stats.tc_stats.total * sizeof(ThreadCache)) / MiB,
@@ -548,8 +581,10 @@ void DumpStats(Printer& out, int level) {
 
     PageFlags pageflags;
     tc_globals.page_allocator().Print(out, MemoryTag::kNormal, pageflags);
-    if (tc_globals.active_partitions() > 1) {
-      tc_globals.page_allocator().Print(out, MemoryTag::kNormalP1, pageflags);
+    for (size_t partition = 1; partition < tc_globals.active_partitions();
+         ++partition) {
+      tc_globals.page_allocator().Print(out, MultiNormalTag(partition),
+                                        pageflags);
     }
     tc_globals.page_allocator().Print(out, MemoryTag::kSampled, pageflags);
     if (Parameters::heap_partitioning_mode() == HeapPartitioningMode::kFull) {
@@ -557,6 +592,7 @@ void DumpStats(Printer& out, int level) {
     }
     tc_globals.page_allocator().Print(out, MemoryTag::kCold, pageflags);
     tc_globals.guardedpage_allocator().Print(out);
+    tc_globals.sampled_quarantine().Print(out);
 
     out.printf("------------------------------------------------\n");
     out.printf("Configured limits and related statistics\n");
@@ -578,6 +614,8 @@ void DumpStats(Printer& out, int level) {
     out.printf("Number of times memory shrank below hard limit: %lld\n",
                tc_globals.page_allocator().successful_shrinks_after_limit_hit(
                    PageAllocator::kHard));
+    out.printf("Number of allocations failed at hard limit: %lld\n",
+               tc_globals.page_allocator().hard_limit_failed_allocations());
 
     out.printf("Total number of pages released: %llu (%7.1f MiB)\n",
                stats.num_released_total.in_pages().raw_num(),
@@ -608,6 +646,17 @@ void DumpStats(Printer& out, int level) {
                                                                 : "NUMA ")
                    : "",
                tc_globals.active_partitions());
+    out.printf(
+        "NUMA placement of sampled hugepages: %zu local, %zu remote, "
+        "%zu migrated, %zu failed to migrate\n",
+        stats.numa_placement.hits, stats.numa_placement.misses,
+        stats.numa_placement.migrated, stats.numa_placement.migration_failures);
+    if (std::optional<MappingCounts> mappings = CachedMappingCounts()) {
+      out.printf(
+          "Process mappings (VMAs): %zu total, %zu tcmalloc, "
+          "vm.max_map_count %zu\n",
+          mappings->total, mappings->tcmalloc, mappings->limit);
+    }
 
     out.printf("------------------------------------------------\n");
     out.printf("Parameters\n");
@@ -620,6 +669,10 @@ void DumpStats(Printer& out, int level) {
                Parameters::max_total_thread_cache_bytes());
     out.printf("PARAMETER malloc_release_bytes_per_sec %llu\n",
                Parameters::background_release_rate());
+    out.printf("PARAMETER tcmalloc_background_release_adaptive %d\n",
+               Parameters::background_release_adaptive() ? 1 : 0);
+    out.printf("PARAMETER tcmalloc_memory_pressure %f\n",
+               Parameters::memory_pressure());
     out.printf("PARAMETER tcmalloc_skip_subrelease_short_interval %s\n",
                absl::FormatDuration(
                    Parameters::filler_skip_subrelease_short_interval()));
@@ -632,6 +685,11 @@ void DumpStats(Printer& out, int level) {
                Parameters::release_pages_from_huge_region() ? 1 : 0);
     out.printf("PARAMETER tcmalloc_huge_region_adaptive_release %d\n",
                Parameters::huge_region_adaptive_release() ? 1 : 0);
+    out.printf("PARAMETER tcmalloc_huge_region_prefer_backed %d\n",
+               Parameters::huge_region_prefer_backed() ==
+                       HugeRegionPreferBacked::kEnabled
+                   ? 1
+                   : 0);
     out.printf("PARAMETER madvise_cold_regions_nohugepage %d\n",
                Parameters::madvise_cold_regions_nohugepage() ==
                        MadviseRegionsNoHugepage::kEnabled
@@ -664,6 +722,11 @@ void DumpStats(Printer& out, int level) {
                        SubreleaseUnbackedMode::kEnabled
                    ? 1
                    : 0);
+    out.printf("PARAMETER tcmalloc_filler_separate_span_lifetimes %d\n",
+               Parameters::filler_separate_span_lifetimes() ==
+                       SeparateSpanLifetimes::kEnabled
+                   ? 1
+                   : 0);
 
     out.printf("PARAMETER tcmalloc_back_small_allocations %d\n",
                Parameters::back_small_allocations() ? 1 : 0);
@@ -692,6 +755,19 @@ void DumpStats(Printer& out, int level) {
 
     out.printf("PARAMETER tcmalloc_release_drained_slab_metadata %d\n",
                Parameters::release_drained_slab_metadata());
+    out.printf("PARAMETER tcmalloc_per_cpu_caches_on_demand_steal %d\n",
+               Parameters::per_cpu_caches_on_demand_steal());
+    out.printf("PARAMETER tcmalloc_per_cpu_caches_follow_cpuset %d\n",
+               Parameters::per_cpu_caches_follow_cpuset());
+    out.printf("PARAMETER tcmalloc_numa_migrate_remote_hugepages %d\n",
+               Parameters::numa_migrate_remote_hugepages());
+    for (size_t partition = 0; partition < kNormalPartitions; ++partition) {
+      out.printf("PARAMETER tcmalloc_partition_%zu_per_cpu_cache_percent %d\n",
+                 partition,
+                 Parameters::partition_per_cpu_cache_percent(partition));
+      out.printf("PARAMETER tcmalloc_partition_%zu_release_eagerly %d\n",
+                 partition, Parameters::partition_release_eagerly(partition));
+    }
   }
 }
 
@@ -729,6 +805,10 @@ void DumpStatsInPbtxt(Printer& out, int level) {
   region.PrintI64("virtual_address_space_used", virtual_memory_used);
   region.PrintI64("num_spans", uint64_t(stats.span_stats.in_use));
   region.PrintI64("num_spans_created", uint64_t(stats.span_stats.total));
+  region.PrintI64("num_compact_large_spans",
+                  uint64_t(stats.compact_large_spans));
+  region.PrintI64("compact_large_span_bytes_saved",
+                  uint64_t(stats.compact_large_spans * sizeof(Span)));
   region.PrintI64("num_thread_heaps", uint64_t(stats.tc_stats.in_use));
   region.PrintI64("num_thread_heaps_created", uint64_t(stats.tc_stats.total));
   region.PrintI64("num_stack_traces", uint64_t(stats.stack_stats.in_use));
@@ -830,8 +910,9 @@ void DumpStatsInPbtxt(Printer& out, int level) {
   PageFlags pageflags;
   tc_globals.page_allocator().PrintInPbtxt(region, MemoryTag::kNormal,
                                            pageflags);
-  if (tc_globals.active_partitions() > 1) {
-    tc_globals.page_allocator().PrintInPbtxt(region, MemoryTag::kNormalP1,
+  for (size_t partition = 1; partition < tc_globals.active_partitions();
+       ++partition) {
+    tc_globals.page_allocator().PrintInPbtxt(region, MultiNormalTag(partition),
                                              pageflags);
   }
   tc_globals.page_allocator().PrintInPbtxt(region, MemoryTag::kSampled,
@@ -862,6 +943,8 @@ void DumpStatsInPbtxt(Printer& out, int level) {
       "successful_shrinks_after_hard_limit_hit",
       tc_globals.page_allocator().successful_shrinks_after_limit_hit(
           PageAllocator::kHard));
+  region.PrintI64("hard_limit_failed_allocations",
+                  tc_globals.page_allocator().hard_limit_failed_allocations());
 
   region.PrintI64("num_released_total_pages",
                   stats.num_released_total.in_pages().raw_num());
@@ -875,14 +958,28 @@ void DumpStatsInPbtxt(Printer& out, int level) {
                   stats.num_released_soft_limit_exceeded.in_pages().raw_num());
   region.PrintI64("num_released_hard_limit_exceeded_pages",
                   stats.num_released_hard_limit_exceeded.in_pages().raw_num());
+  region.PrintI64("numa_hits", stats.numa_placement.hits);
+  region.PrintI64("numa_misses", stats.numa_placement.misses);
+  region.PrintI64("numa_migrated", stats.numa_placement.migrated);
+  region.PrintI64("numa_migration_failures",
+                  stats.numa_placement.migration_failures);
 
   {
     auto gwp_asan = region.CreateSubRegion("gwp_asan");
     tc_globals.guardedpage_allocator().PrintInPbtxt(gwp_asan);
   }
+  {
+    auto sampled_quarantine = region.CreateSubRegion("sampled_quarantine");
+    tc_globals.sampled_quarantine().PrintInPbtxt(sampled_quarantine);
+  }
 
   region.PrintI64("memory_release_failures",
                   tc_globals.system_allocator().release_errors());
+  if (std::optional<MappingCounts> mappings = CachedMappingCounts()) {
+    region.PrintI64("process_vma_count", mappings->total);
+    region.PrintI64("tcmalloc_vma_count", mappings->tcmalloc);
+    region.PrintI64("max_map_count", mappings->limit);
+  }
 
   region.PrintBool("tcmalloc_per_cpu_caches", Parameters::per_cpu_caches());
   region.PrintI64("tcmalloc_max_per_cpu_cache_size",
@@ -891,6 +988,9 @@ void DumpStatsInPbtxt(Printer& out, int level) {
                   Parameters::max_total_thread_cache_bytes());
   region.PrintI64("malloc_release_bytes_per_sec",
                   static_cast<int64_t>(Parameters::background_release_rate()));
+  region.PrintBool("tcmalloc_background_release_adaptive",
+                   Parameters::background_release_adaptive());
+  region.PrintDouble("tcmalloc_memory_pressure", Parameters::memory_pressure());
   region.PrintI64("tcmalloc_skip_subrelease_short_interval_ns",
                   absl::ToInt64Nanoseconds(
                       Parameters::filler_skip_subrelease_short_interval()));
@@ -903,6 +1003,9 @@ void DumpStatsInPbtxt(Printer& out, int level) {
                    Parameters::release_pages_from_huge_region());
   region.PrintBool("tcmalloc_huge_region_adaptive_release",
                    Parameters::huge_region_adaptive_release());
+  region.PrintBool("tcmalloc_huge_region_prefer_backed",
+                   Parameters::huge_region_prefer_backed() ==
+                       HugeRegionPreferBacked::kEnabled);
   region.PrintBool("madvise_cold_regions_nohugepage",
                    Parameters::madvise_cold_regions_nohugepage() ==
                        MadviseRegionsNoHugepage::kEnabled);
@@ -923,6 +1026,9 @@ void DumpStatsInPbtxt(Printer& out, int level) {
   region.PrintBool("subrelease_unbacked_hugepages",
                    Parameters::subrelease_unbacked_hugepages() ==
                        SubreleaseUnbackedMode::kEnabled);
+  region.PrintBool("filler_separate_span_lifetimes",
+                   Parameters::filler_separate_span_lifetimes() ==
+                       SeparateSpanLifetimes::kEnabled);
 
   region.PrintBool("back_small_allocations",
                    Parameters::back_small_allocations());
@@ -950,6 +1056,20 @@ void DumpStatsInPbtxt(Printer& out, int level) {
 
   region.PrintBool("tcmalloc_release_drained_slab_metadata",
                    Parameters::release_drained_slab_metadata());
+  region.PrintBool("tcmalloc_per_cpu_caches_on_demand_steal",
+                   Parameters::per_cpu_caches_on_demand_steal());
+  region.PrintBool("tcmalloc_per_cpu_caches_follow_cpuset",
+                   Parameters::per_cpu_caches_follow_cpuset());
+  region.PrintBool("tcmalloc_numa_migrate_remote_hugepages",
+                   Parameters::numa_migrate_remote_hugepages());
+  for (size_t partition = 0; partition < kNormalPartitions; ++partition) {
+    PbtxtRegion entry = region.CreateSubRegion("tcmalloc_partition");
+    entry.PrintI64("partition", partition);
+    entry.PrintI64("per_cpu_cache_percent",
+                   Parameters::partition_per_cpu_cache_percent(partition));
+    entry.PrintBool("release_eagerly",
+                    Parameters::partition_release_eagerly(partition));
+  }
 }
 
 bool GetNumericProperty(const char* name_data, size_t name_size,
@@ -1137,6 +1257,10 @@ bool GetNumericProperty(const char* name_data, size_t name_size,
         PageAllocator::kHard);
     return true;
   }
+  if (name == "tcmalloc.hard_limit_failed_allocations") {
+    *value = tc_globals.page_allocator().hard_limit_failed_allocations();
+    return true;
+  }
 
   for (const auto& [property_name, field] :
        std::initializer_list<std::pair<absl::string_view /*property_name*/,
@@ -1158,6 +1282,21 @@ bool GetNumericProperty(const char* name_data, size_t name_size,
     }
   }
 
+  for (const auto& [property_name, field] :
+       std::initializer_list<std::pair<absl::string_view /*property_name*/,
+                                       size_t NumaPlacementStats::* /*field*/>>{
+           {"tcmalloc.numa_hits", &NumaPlacementStats::hits},
+           {"tcmalloc.numa_misses", &NumaPlacementStats::misses},
+           {"tcmalloc.numa_migrated", &NumaPlacementStats::migrated},
+           {"tcmalloc.numa_migration_failures",
+            &NumaPlacementStats::migration_failures}}) {
+    if (name == property_name) {
+      const PageHeapSpinLockHolder l;
+      *value = tc_globals.page_allocator().GetNumaPlacementStats().*field;
+      return true;
+    }
+  }
+
   if (name == "tcmalloc.required_bytes") {
     TCMallocStats stats;
     ExtractTCMallocStats(stats, false);
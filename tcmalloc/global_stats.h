@@ -43,6 +43,7 @@ struct TCMallocStats {
   uint64_t percpu_metadata_bytes_res;  // Resident bytes of the per-CPU metadata
   AllocatorStats tc_stats;             // ThreadCache objects
   AllocatorStats span_stats;           // Span objects
+  size_t compact_large_spans;          // Large allocations without a Span
   AllocatorStats stack_stats;          // StackTrace objects
   AllocatorStats linked_sample_stats;  // StackTraceTable::LinkedSample objects
   size_t pagemap_bytes;                // included in metadata bytes
@@ -57,6 +58,8 @@ struct TCMallocStats {
   Length num_released_soft_limit_exceeded;
   Length num_released_hard_limit_exceeded;
 
+  NumaPlacementStats numa_placement;
+
   ArenaStats arena;  // Stats from the metadata Arena
 
   // Explicitly declare the ctor to put it in the google_malloc section.
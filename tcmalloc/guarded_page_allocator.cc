@@ -28,7 +28,6 @@
 #include "absl/base/attributes.h"
 #include "absl/base/casts.h"
 #include "absl/base/internal/cycleclock.h"
-#include "absl/base/internal/spinlock.h"
 #include "absl/base/internal/sysinfo.h"
 #include "absl/base/nullability.h"
 #include "absl/base/optimization.h"
@@ -37,7 +36,6 @@
 #include "tcmalloc/common.h"
 #include "tcmalloc/error_reporting.h"
 #include "tcmalloc/guarded_allocations.h"
-#include "tcmalloc/internal/allocation_guard.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/logging.h"
 #include "tcmalloc/internal/memory_tag.h"
@@ -73,13 +71,11 @@ void GuardedPageAllocator::Init(size_t max_allocated_pages,
 }
 
 void GuardedPageAllocator::Destroy() {
-  AllocationGuardSpinLockHolder h(guarded_page_lock_);
-  if (initialized_) {
+  if (initialized_.exchange(false, std::memory_order_acq_rel)) {
     size_t len = pages_end_addr_ - pages_base_addr_;
     int err = munmap(reinterpret_cast<void*>(pages_base_addr_), len);
     TC_ASSERT_NE(err, -1);
     (void)err;
-    initialized_ = false;
   }
 }
 
@@ -183,9 +179,8 @@ GuardedAllocWithStatus GuardedPageAllocator::Allocate(
   if (size > 0) {
     if (mprotect(result, page_size_, PROT_READ | PROT_WRITE) == -1) {
       TC_ASSERT(false, "mprotect(.., PROT_READ|PROT_WRITE) failed");
-      AllocationGuardSpinLockHolder h(guarded_page_lock_);
-      failed_allocations_.LossyAdd(1);
-      successful_allocations_.LossyAdd(-1);
+      failed_allocations_.Add(1);
+      successful_allocations_.Add(-1);
       FreeSlot(free_slot);
       return {nullptr, Profile::Sample::GuardedStatus::MProtectFailed};
     }
@@ -194,7 +189,7 @@ GuardedAllocWithStatus GuardedPageAllocator::Allocate(
   }
 
   // Record stack trace.
-  SlotMetadata& d = data_[free_slot];
+  SlotMetadata& d = GetMetadata(free_slot);
   // Count the number of pages that have been used at least once.
   if (ABSL_PREDICT_FALSE(d.allocation_start == 0)) {
     pages_touched_.Add(1);
@@ -233,7 +228,7 @@ void GuardedPageAllocator::Deallocate(void* absl_nonnull ptr) {
   TC_ASSERT(PointerIsMine(ptr));
   const uintptr_t page_addr = GetPageAddr(reinterpret_cast<uintptr_t>(ptr));
   const size_t slot = AddrToSlot(page_addr);
-  SlotMetadata& d = data_[slot];
+  SlotMetadata& d = *FindMetadata(slot);
 
   // On double-free, do not overwrite the original deallocation metadata, so
   // that the report produced shows the original deallocation stack trace.
@@ -241,8 +236,8 @@ void GuardedPageAllocator::Deallocate(void* absl_nonnull ptr) {
     ForceTouchPage(ptr);
   }
 
-  // Record stack trace. Unwinding the stack is expensive, and holding the
-  // guarded_page_lock_ should be avoided here.
+  // Record stack trace.  Unwinding the stack is expensive, so this is done
+  // before the slot is released for reuse.
   d.dealloc_trace.depth =
       absl::GetStackTrace(d.dealloc_trace.stack, kMaxStackDepth,
                           /*skip_count=*/2);
@@ -259,8 +254,6 @@ void GuardedPageAllocator::Deallocate(void* absl_nonnull ptr) {
       d.write_overflow_detected = true;
     }
 
-    // Calling mprotect() should also be done outside the guarded_page_lock_
-    // critical section, since mprotect() can have relatively large latency.
     TC_CHECK_EQ(
         0, mprotect(reinterpret_cast<void*>(page_addr), page_size_, PROT_NONE));
 
@@ -280,7 +273,6 @@ void GuardedPageAllocator::Deallocate(void* absl_nonnull ptr) {
                         {d.alloc_trace.stack, d.alloc_trace.depth});
   }
 
-  AllocationGuardSpinLockHolder h(guarded_page_lock_);
   FreeSlot(slot);
 }
 
@@ -288,7 +280,9 @@ size_t GuardedPageAllocator::GetRequestedSize(
     const void* absl_nonnull ptr) const {
   TC_ASSERT(PointerIsMine(ptr));
   size_t slot = AddrToSlot(GetPageAddr(reinterpret_cast<uintptr_t>(ptr)));
-  return data_[slot].requested_size;
+  const SlotMetadata* d = FindMetadata(slot);
+  TC_ASSERT_NE(d, nullptr);
+  return d->requested_size;
 }
 
 std::pair<off_t, size_t> GuardedPageAllocator::GetAllocationOffsetAndSize(
@@ -296,7 +290,9 @@ std::pair<off_t, size_t> GuardedPageAllocator::GetAllocationOffsetAndSize(
   TC_ASSERT(PointerIsMine(ptr));
   const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
   const size_t slot = GetNearestSlot(addr);
-  return {addr - data_[slot].allocation_start, data_[slot].requested_size};
+  const SlotMetadata* d = FindMetadata(slot);
+  if (d == nullptr) return {addr - SlotToAddr(slot), 0};
+  return {addr - d->allocation_start, d->requested_size};
 }
 
 GuardedAllocationsErrorType GuardedPageAllocator::GetStackTraces(
@@ -305,9 +301,16 @@ GuardedAllocationsErrorType GuardedPageAllocator::GetStackTraces(
   TC_ASSERT(PointerIsMine(ptr));
   const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
   size_t slot = GetNearestSlot(addr);
-  *alloc_trace = &data_[slot].alloc_trace;
-  *dealloc_trace = &data_[slot].dealloc_trace;
-  return GetErrorType(addr, data_[slot]);
+  SlotMetadata* d = FindMetadata(slot);
+  if (d == nullptr) {
+    // Nothing was ever allocated near addr.
+    *alloc_trace = nullptr;
+    *dealloc_trace = nullptr;
+    return GuardedAllocationsErrorType::kUnknown;
+  }
+  *alloc_trace = &d->alloc_trace;
+  *dealloc_trace = &d->dealloc_trace;
+  return GetErrorType(addr, *d);
 }
 
 // We take guarded samples during periodic profiling samples.  Computes the
@@ -382,9 +385,9 @@ void GuardedPageAllocator::PrintInPbtxt(PbtxtRegion& gwp_asan) {
 }
 
 // Maps 2 * total_pages_ + 1 pages so that there are total_pages_ unique pages
-// we can return from Allocate with guard pages before and after them.
+// we can return from Allocate with guard pages before and after them.  The
+// mapping is PROT_NONE, so only pages that are handed out are ever backed.
 void GuardedPageAllocator::MapPages() {
-  AllocationGuardSpinLockHolder h(guarded_page_lock_);
   TC_ASSERT(!first_page_addr_);
   TC_ASSERT_EQ(page_size_ % GetPageSize(), 0);
   size_t len = (2 * total_pages_ + 1) * page_size_;
@@ -402,66 +405,105 @@ void GuardedPageAllocator::MapPages() {
     return;
   }
 
-  // Allocate memory for slot metadata.
-  data_ = reinterpret_cast<SlotMetadata*>(
-      tc_globals.arena().Alloc(sizeof(*data_) * total_pages_));
-  for (size_t i = 0; i < total_pages_; ++i) {
-    new (&data_[i]) SlotMetadata;
-  }
-
   pages_base_addr_ = base_addr;
   pages_end_addr_ = pages_base_addr_ + len;
 
   // Align first page to page_size_.
   first_page_addr_ = GetPageAddr(pages_base_addr_ + page_size_);
 
-  initialized_ = true;
+  initialized_.store(true, std::memory_order_release);
 }
 
-// Selects a random slot in O(1) time.
+GuardedPageAllocator::SlotMetadata& GuardedPageAllocator::GetMetadata(
+    size_t slot) {
+  SlotMetadata* d = FindMetadata(slot);
+  if (ABSL_PREDICT_TRUE(d != nullptr)) return *d;
+
+  // First use of this chunk.  This happens at most kNumChunks times over the
+  // lifetime of the allocator, so it is fine to take the pageheap_lock here.
+  std::atomic<SlotMetadata*>& chunk = metadata_[slot / kSlotsPerChunk];
+  PageHeapSpinLockHolder l;
+  if (chunk.load(std::memory_order_relaxed) == nullptr) {
+    auto* slots = reinterpret_cast<SlotMetadata*>(
+        tc_globals.arena().Alloc(sizeof(SlotMetadata) * kSlotsPerChunk));
+    for (size_t i = 0; i < kSlotsPerChunk; ++i) {
+      new (&slots[i]) SlotMetadata;
+    }
+    chunk.store(slots, std::memory_order_release);
+  }
+  return *FindMetadata(slot);
+}
+
+// Selects a random slot without taking any locks.
 ssize_t GuardedPageAllocator::ReserveFreeSlot() {
-  AllocationGuardSpinLockHolder h(guarded_page_lock_);
-  if (!initialized_ || !allow_allocations_) return -1;
-  if (GetNumAvailablePages() == 0) {
-    skipped_allocations_noslots_.Add(1);
+  if (!initialized_.load(std::memory_order_acquire) ||
+      !allow_allocations_.load(std::memory_order_acquire)) {
     return -1;
   }
-  successful_allocations_.LossyAdd(1);
-
-  const size_t slot = GetFreeSlot();
-  TC_ASSERT(!used_pages_.GetBit(slot));
-  used_pages_.SetBit(slot);
-
-  // Both writes to allocated_pages_ happen under the guarded_page_lock_, so
-  // we do not have to use an atomic fetch_add(), which is more expensive due to
-  // typically imposing a full memory barrier when lowered on e.g. x86. Recent
-  // compiler optimizations will also turn the store(load(relaxed) + N, relaxed)
-  // into a simple add instruction.
-  const size_t nalloced = allocated_pages_.load(std::memory_order_relaxed) + 1;
-  allocated_pages_.store(nalloced, std::memory_order_relaxed);
-  if (nalloced > high_allocated_pages_.load(std::memory_order_relaxed)) {
-    high_allocated_pages_.store(nalloced, std::memory_order_relaxed);
+
+  // Account for the slot before claiming it, so that concurrent callers can
+  // never reserve more than max_allocated_pages_ between them.
+  size_t nalloced = allocated_pages_.load(std::memory_order_relaxed);
+  do {
+    if (nalloced >= max_allocated_pages_) {
+      skipped_allocations_noslots_.Add(1);
+      return -1;
+    }
+  } while (!allocated_pages_.compare_exchange_weak(
+      nalloced, nalloced + 1, std::memory_order_relaxed));
+  ++nalloced;
+  size_t high = high_allocated_pages_.load(std::memory_order_relaxed);
+  while (nalloced > high && !high_allocated_pages_.compare_exchange_weak(
+                                high, nalloced, std::memory_order_relaxed)) {
   }
-  return slot;
+  successful_allocations_.Add(1);
+
+  return GetFreeSlot();
 }
 
 size_t GuardedPageAllocator::GetFreeSlot() {
-  const size_t idx = rand_.Next() % total_pages_;
-  // Find the closest adjacent free slot to the random index.
-  ssize_t slot = used_pages_.FindClearBackwards(idx);
-  if (slot >= 0) return slot;
-  slot = used_pages_.FindClear(idx);
-  TC_ASSERT_LT(slot, total_pages_);
-  return slot;
+  const size_t num_words = (total_pages_ + kSlotsPerChunk - 1) / kSlotsPerChunk;
+  const uint32_t r = rand_.Next();
+  // Start from a random word and a random bit within it, and take the first
+  // free slot at or after that bit, wrapping around.
+  size_t word = (r / kSlotsPerChunk) % num_words;
+  const int start_bit = r % kSlotsPerChunk;
+  for (;;) {
+    const size_t first_slot = word * kSlotsPerChunk;
+    const size_t valid_slots =
+        std::min(kSlotsPerChunk, total_pages_ - first_slot);
+    const uint64_t valid = valid_slots == kSlotsPerChunk
+                               ? ~uint64_t{0}
+                               : (uint64_t{1} << valid_slots) - 1;
+    uint64_t used = used_pages_[word].load(std::memory_order_relaxed);
+    uint64_t free;
+    while ((free = ~used & valid) != 0) {
+      const int bit =
+          (absl::countr_zero(absl::rotr(free, start_bit)) + start_bit) %
+          kSlotsPerChunk;
+      const uint64_t mask = uint64_t{1} << bit;
+      // Acquire pairs with the release in FreeSlot(), so that the previous
+      // owner's metadata updates are visible to the new owner.
+      if (used_pages_[word].compare_exchange_weak(used, used | mask,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed)) {
+        return first_slot + bit;
+      }
+    }
+    // Our reservation in allocated_pages_ guarantees that a free slot exists,
+    // although concurrent callers may claim the ones we see first.
+    word = word + 1 == num_words ? 0 : word + 1;
+  }
 }
 
 void GuardedPageAllocator::FreeSlot(size_t slot) {
   TC_ASSERT_LT(slot, total_pages_);
-  TC_ASSERT(used_pages_.GetBit(slot));
-  used_pages_.ClearBit(slot);
-  // Cheaper decrement - see above.
-  allocated_pages_.store(allocated_pages_.load(std::memory_order_relaxed) - 1,
-                         std::memory_order_relaxed);
+  const uint64_t mask = uint64_t{1} << (slot % kSlotsPerChunk);
+  const uint64_t used = used_pages_[slot / kSlotsPerChunk].fetch_and(
+      ~mask, std::memory_order_release);
+  TC_ASSERT_NE(used & mask, 0);
+  (void)used;
+  allocated_pages_.fetch_sub(1, std::memory_order_relaxed);
 }
 
 uintptr_t GuardedPageAllocator::GetPageAddr(uintptr_t addr) const {
@@ -494,8 +536,8 @@ size_t GuardedPageAllocator::GetNearestSlot(uintptr_t addr) const {
 bool GuardedPageAllocator::WriteOverflowOccurred(size_t slot) const {
   if (!ShouldRightAlign(slot)) return false;
   uint8_t magic = GetWriteOverflowMagic(slot);
-  uintptr_t alloc_end =
-      data_[slot].allocation_start + data_[slot].requested_size;
+  const SlotMetadata& d = *FindMetadata(slot);
+  uintptr_t alloc_end = d.allocation_start + d.requested_size;
   uintptr_t page_end = SlotToAddr(slot) + page_size_;
   uintptr_t magic_end = std::min(page_end, alloc_end + kMagicSize);
   for (uintptr_t p = alloc_end; p < magic_end; ++p) {
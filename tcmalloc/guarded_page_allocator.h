@@ -15,14 +15,13 @@
 #ifndef TCMALLOC_GUARDED_PAGE_ALLOCATOR_H_
 #define TCMALLOC_GUARDED_PAGE_ALLOCATOR_H_
 
+#include <array>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <utility>
 
 #include "absl/base/attributes.h"
-#include "absl/base/const_init.h"
-#include "absl/base/internal/spinlock.h"
 #include "absl/base/nullability.h"
 #include "absl/base/thread_annotations.h"
 #include "tcmalloc/common.h"
@@ -31,7 +30,6 @@
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/exponential_biased.h"
 #include "tcmalloc/internal/logging.h"
-#include "tcmalloc/internal/range_tracker.h"
 #include "tcmalloc/internal/stacktrace_filter.h"
 #include "tcmalloc/pages.h"
 
@@ -48,7 +46,8 @@ namespace tcmalloc_internal {
 //
 // Is safe to use with static storage duration and is thread safe with the
 // exception of calls to Init() and Destroy() (see corresponding function
-// comments).
+// comments).  Slots are reserved and released without locks, so sampled
+// allocations on many threads do not serialize on the allocator.
 //
 // Example:
 //   ABSL_CONST_INIT GuardedPageAllocator gpa;
@@ -72,14 +71,14 @@ namespace tcmalloc_internal {
 //   }
 class GuardedPageAllocator {
  public:
-  // Maximum number of pages this class can allocate.
-  static constexpr size_t kGpaMaxPages = 512;
+  // Maximum number of pages this class can allocate.  Only the address space
+  // for the pool is reserved up front; slot metadata is allocated in chunks of
+  // kSlotsPerChunk as slots are first used.
+  static constexpr size_t kGpaMaxPages = 8192;
 
   constexpr GuardedPageAllocator()
-      : guarded_page_lock_(absl::base_internal::SCHEDULE_KERNEL_ONLY),
-        allocated_pages_(0),
+      : allocated_pages_(0),
         high_allocated_pages_(0),
-        data_(nullptr),
         pages_base_addr_(0),
         pages_end_addr_(0),
         first_page_addr_(0),
@@ -136,12 +135,11 @@ class GuardedPageAllocator {
   // Precondition:  alignment is 0 or a power of 2
   GuardedAllocWithStatus Allocate(size_t size, std::align_val_t alignment,
                                   const StackTrace& stack_trace)
-      ABSL_LOCKS_EXCLUDED(guarded_page_lock_);
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
 
   // Deallocates memory pointed to by ptr.  ptr must have been previously
   // returned by a call to Allocate.
-  void Deallocate(void* absl_nonnull ptr)
-      ABSL_LOCKS_EXCLUDED(guarded_page_lock_);
+  void Deallocate(void* absl_nonnull ptr);
 
   // Returns the size requested when ptr was allocated.  ptr must have been
   // previously returned by a call to Allocate.
@@ -167,9 +165,8 @@ class GuardedPageAllocator {
 
   // Writes a human-readable summary of GuardedPageAllocator's internal state to
   // *out.
-  void Print(Printer& out) ABSL_LOCKS_EXCLUDED(guarded_page_lock_);
-  void PrintInPbtxt(PbtxtRegion& gwp_asan)
-      ABSL_LOCKS_EXCLUDED(guarded_page_lock_);
+  void Print(Printer& out);
+  void PrintInPbtxt(PbtxtRegion& gwp_asan);
 
   // Returns true if ptr points to memory managed by this class.
   bool ABSL_ATTRIBUTE_ALWAYS_INLINE
@@ -181,14 +178,13 @@ class GuardedPageAllocator {
   [[nodiscard]] bool PointerIsCorrectlyAligned(const void* ptr) const {
     const uintptr_t addr = absl::bit_cast<uintptr_t>(ptr);
     size_t slot = GetNearestSlot(addr);
-    const SlotMetadata& metadata = data_[slot];
-    return metadata.allocation_start == addr;
+    const SlotMetadata* metadata = FindMetadata(slot);
+    return metadata != nullptr && metadata->allocation_start == addr;
   }
 
   // Allows Allocate() to start returning allocations.
-  void AllowAllocations() ABSL_LOCKS_EXCLUDED(guarded_page_lock_) {
-    AllocationGuardSpinLockHolder h(guarded_page_lock_);
-    allow_allocations_ = true;
+  void AllowAllocations() {
+    allow_allocations_.store(true, std::memory_order_release);
   }
 
   // Returns the number of pages available for allocation, based on how many are
@@ -220,20 +216,39 @@ class GuardedPageAllocator {
   // Max number of magic bytes we use to detect write-overflows at deallocation.
   static constexpr size_t kMagicSize = 32;
 
+  // Slots tracked by each word of used_pages_, and the granularity at which
+  // slot metadata is allocated.
+  static constexpr size_t kSlotsPerChunk = 64;
+  static constexpr size_t kNumChunks = kGpaMaxPages / kSlotsPerChunk;
+  static_assert(kGpaMaxPages % kSlotsPerChunk == 0);
+
   // Maps pages into memory.
-  void MapPages() ABSL_LOCKS_EXCLUDED(guarded_page_lock_)
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+  void MapPages() ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
   // Reserves and returns a slot randomly selected from the free slots in
   // used_pages_.  Returns -1 if no slots available, or if AllowAllocations()
   // hasn't been called yet.
-  ssize_t ReserveFreeSlot() ABSL_LOCKS_EXCLUDED(guarded_page_lock_);
+  ssize_t ReserveFreeSlot();
 
-  // Returns a random free slot in used_pages_.
-  size_t GetFreeSlot() ABSL_EXCLUSIVE_LOCKS_REQUIRED(guarded_page_lock_);
+  // Claims a random free slot in used_pages_.  The caller must already have
+  // accounted for the slot in allocated_pages_, which guarantees that one is
+  // free.
+  size_t GetFreeSlot();
 
   // Marks the specified slot as unreserved.
-  void FreeSlot(size_t slot) ABSL_EXCLUSIVE_LOCKS_REQUIRED(guarded_page_lock_);
+  void FreeSlot(size_t slot);
+
+  // Returns the metadata for slot, allocating its chunk on first use.
+  SlotMetadata& GetMetadata(size_t slot) ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
+  // Returns the metadata for slot, or nullptr if no slot in its chunk has ever
+  // been allocated.
+  SlotMetadata* absl_nullable FindMetadata(size_t slot) const {
+    SlotMetadata* chunk =
+        metadata_[slot / kSlotsPerChunk].load(std::memory_order_acquire);
+    if (chunk == nullptr) return nullptr;
+    return &chunk[slot % kSlotsPerChunk];
+  }
 
   // Returns the address of the page that addr resides on.
   uintptr_t GetPageAddr(uintptr_t addr) const;
@@ -283,14 +298,13 @@ class GuardedPageAllocator {
   // 80% or below, the probability of false positives will be below 10%.
   DecayingStackTraceFilter<kGpaMaxPages * 3, 2, 32> stacktrace_filter_;
 
-  absl::base_internal::SpinLock guarded_page_lock_;
-
-  // Maps each bool to one page.
-  // true: reserved. false: freed.
-  Bitmap<kGpaMaxPages> used_pages_ ABSL_GUARDED_BY(guarded_page_lock_);
+  // Maps each bit to one page.
+  // 1: reserved. 0: freed.
+  std::array<std::atomic<uint64_t>, kNumChunks> used_pages_ = {};
 
-  // Number of currently allocated pages. Atomic so it may be accessed outside
-  // the guarded_page_lock_ to calculate heuristics based on pool utilization.
+  // Number of currently allocated pages.  Incremented before a slot is
+  // claimed in used_pages_ and decremented after it is released, so it never
+  // undercounts the reserved slots and bounds them by max_allocated_pages_.
   std::atomic<size_t> allocated_pages_;
   // The high-water mark for allocated_pages_.
   std::atomic<size_t> high_allocated_pages_;
@@ -308,10 +322,10 @@ class GuardedPageAllocator {
   // Number of pages allocated at least once from page pool.
   tcmalloc_internal::StatsCounter pages_touched_;
 
-  // A dynamically-allocated array of stack trace data captured when each page
-  // is allocated/deallocated.  Printed by the SEGV handler when a memory error
-  // is detected.
-  SlotMetadata* data_;
+  // Stack trace data captured when each page is allocated/deallocated, in
+  // arena-allocated chunks of kSlotsPerChunk slots.  Printed by the SEGV
+  // handler when a memory error is detected.
+  std::array<std::atomic<SlotMetadata*>, kNumChunks> metadata_ = {};
 
   uintptr_t pages_base_addr_;   // Points to start of mapped region.
   uintptr_t pages_end_addr_;    // Points to the end of mapped region.
@@ -322,10 +336,10 @@ class GuardedPageAllocator {
   Random rand_;
 
   // True if this object has been fully initialized.
-  bool initialized_ ABSL_GUARDED_BY(guarded_page_lock_);
+  std::atomic<bool> initialized_;
 
   // Flag to control whether we can return allocations or not.
-  bool allow_allocations_ ABSL_GUARDED_BY(guarded_page_lock_);
+  std::atomic<bool> allow_allocations_;
 };
 
 }  // namespace tcmalloc_internal
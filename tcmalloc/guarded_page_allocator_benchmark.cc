@@ -37,6 +37,8 @@ namespace {
 using GuardedStatus = Profile::Sample::GuardedStatus;
 
 constexpr size_t kMaxGpaPages = GuardedPageAllocator::kGpaMaxPages;
+// Upper bound for multi-threaded runs; kMaxGpaPages threads would be too many.
+constexpr int kMaxThreads = 64;
 
 // Size of pages used by GuardedPageAllocator. See GuardedPageAllocator::Init().
 size_t GetGpaPageSize() {
@@ -89,7 +91,35 @@ void BM_AllocDealloc(benchmark::State& state) {
 }
 
 BENCHMARK(BM_AllocDealloc)->Range(1, GetGpaPageSize());
-BENCHMARK(BM_AllocDealloc)->Arg(1)->ThreadRange(1, kMaxGpaPages);
+BENCHMARK(BM_AllocDealloc)->Arg(1)->ThreadRange(1, kMaxThreads);
+
+// Each thread keeps state.range(0) guarded allocations live and replaces the
+// oldest one per iteration, so that threads contend on a partially occupied
+// pool rather than on an empty one.
+void BM_AllocDeallocLive(benchmark::State& state) {
+  const size_t num_live = state.range(0);
+  auto gpa = GetGuardedPageAllocator();
+  std::vector<void*> live(num_live, nullptr);
+  size_t next = 0;
+  size_t no_slots = 0;
+  for (auto _ : state) {
+    if (live[next] != nullptr) gpa->Deallocate(live[next]);
+    live[next] =
+        gpa->Allocate(1, std::align_val_t{0}, GetStackTrace(next)).alloc;
+    if (live[next] == nullptr) ++no_slots;
+    next = (next + 1) % num_live;
+  }
+  for (void* p : live) {
+    if (p != nullptr) gpa->Deallocate(p);
+  }
+  state.counters["no_slots"] = benchmark::Counter(
+      no_slots, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_AllocDeallocLive)
+    ->Arg(1)
+    ->Arg(kMaxGpaPages / kMaxThreads)
+    ->ThreadRange(1, kMaxThreads);
 
 auto& GetReserved() {
   static auto* ret =
@@ -174,7 +204,7 @@ BENCHMARK(BM_TrySample)
     ->Teardown(ReleasePool);
 BENCHMARK(BM_TrySample)
     ->Arg(1)
-    ->ThreadRange(1, kMaxGpaPages)
+    ->ThreadRange(1, kMaxThreads)
     ->Setup(ReservePool)
     ->Teardown(ReleasePool);
 
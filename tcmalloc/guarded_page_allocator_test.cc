@@ -28,6 +28,7 @@
 #include "absl/base/attributes.h"
 #include "absl/container/flat_hash_set.h"
 #include "tcmalloc/common.h"
+#include "tcmalloc/guarded_allocations.h"
 #include "tcmalloc/internal/logging.h"
 #include "tcmalloc/internal/page_size.h"
 #include "tcmalloc/internal/sysinfo.h"
@@ -227,6 +228,26 @@ TEST_F(GuardedPageAllocatorTest, PointerIsMine) {
   EXPECT_FALSE(gpa_.PointerIsMine(malloc_ptr.get()));
 }
 
+TEST_F(GuardedPageAllocatorTest, UntouchedSlotsHaveNoMetadata) {
+  auto alloc_with_status =
+      gpa_.Allocate(1, std::align_val_t{0}, GetStackTrace());
+  ASSERT_EQ(alloc_with_status.status, Profile::Sample::GuardedStatus::Guarded);
+  char* buf = reinterpret_cast<char*>(alloc_with_status.alloc);
+
+  // Slot metadata is allocated 64 slots at a time, so a slot 128 slots away
+  // has never been used.
+  const size_t distance = 2 * 128 * PageSize();
+  char* other = gpa_.PointerIsMine(buf + distance) ? buf + distance
+                                                   : buf - distance;
+  ASSERT_TRUE(gpa_.PointerIsMine(other));
+  GuardedAllocationsStackTrace *alloc_trace, *dealloc_trace;
+  EXPECT_EQ(gpa_.GetStackTraces(other, &alloc_trace, &dealloc_trace),
+            GuardedAllocationsErrorType::kUnknown);
+  EXPECT_FALSE(gpa_.PointerIsCorrectlyAligned(other));
+
+  gpa_.Deallocate(buf);
+}
+
 TEST_F(GuardedPageAllocatorTest, Print) {
   std::string buf = PrintToString(1024, [&](Printer& out) { gpa_.Print(out); });
   EXPECT_THAT(buf, testing::ContainsRegex("GWP-ASan Status"));
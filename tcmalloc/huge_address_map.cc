@@ -19,6 +19,7 @@
 #include <cstdint>
 
 #include "absl/base/internal/cycleclock.h"
+#include "absl/numeric/bits.h"
 #include "tcmalloc/huge_pages.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/exponential_biased.h"
@@ -112,6 +113,54 @@ void HugeAddressMap::Check() {
   TC_CHECK_EQ(nodes, nranges());
   TC_CHECK_EQ(size, total_mapped());
   TC_CHECK_EQ(total_nodes_, used_nodes_ + freelist_size_);
+  CheckIndex();
+}
+
+namespace {
+
+// Order of the size treap.
+bool SizeLess(HugeRange a, HugeRange b) {
+  if (a.len() != b.len()) return a.len() < b.len();
+  return a.start() < b.start();
+}
+
+}  // namespace
+
+void HugeAddressMap::CheckIndex() const {
+  size_t nodes = 0;
+  HugeLength size = NHugePages(0);
+  for (size_t i = 0; i < kSizeBuckets; ++i) {
+    TC_CHECK_EQ(buckets_[i] != nullptr, ((nonempty_buckets_ >> i) & 1) != 0,
+                "%zu", i);
+    const Node* prev = nullptr;
+    for (const Node* n = buckets_[i]; n != nullptr; n = n->size_right_) {
+      TC_CHECK_EQ(n->range_.len(), NHugePages(i));
+      TC_CHECK_EQ(n->size_left_, prev);
+      TC_CHECK_EQ(Predecessor(n->range_.start()), n);
+      ++nodes;
+      size += n->range_.len();
+      prev = n;
+    }
+  }
+
+  const Node* prev = nullptr;
+  auto check_tree = [&](auto& self, const Node* n) -> void {
+    if (n == nullptr) return;
+    TC_CHECK(n->size_left_ == nullptr || n->size_left_->prio_ <= n->prio_);
+    TC_CHECK(n->size_right_ == nullptr || n->size_right_->prio_ <= n->prio_);
+    self(self, n->size_left_);
+    TC_CHECK_GE(n->range_.len(), NHugePages(kSizeBuckets));
+    TC_CHECK(prev == nullptr || SizeLess(prev->range_, n->range_));
+    TC_CHECK_EQ(Predecessor(n->range_.start()), n);
+    ++nodes;
+    size += n->range_.len();
+    prev = n;
+    self(self, n->size_right_);
+  };
+  check_tree(check_tree, size_root_);
+
+  TC_CHECK_EQ(nodes, nranges());
+  TC_CHECK_EQ(size, total_mapped());
 }
 
 size_t HugeAddressMap::nranges() const { return used_nodes_; }
@@ -158,6 +207,104 @@ HugeAddressMap::Node* HugeAddressMap::Predecessor(HugePage p) {
   return const_cast<Node*>(n);
 }
 
+HugeAddressMap::Node* HugeAddressMap::BestFit(HugeLength n) {
+  if (n < NHugePages(kSizeBuckets)) {
+    const uint64_t fits = nonempty_buckets_ & (~uint64_t{0} << n.raw_num());
+    if (fits != 0) return buckets_[absl::countr_zero(fits)];
+    n = NHugePages(kSizeBuckets);
+  }
+
+  Node* best = nullptr;
+  Node* curr = size_root_;
+  while (curr != nullptr) {
+    if (curr->range_.len() >= n) {
+      best = curr;
+      curr = curr->size_left_;
+    } else {
+      curr = curr->size_right_;
+    }
+  }
+  return best;
+}
+
+void HugeAddressMap::IndexInsert(Node* n) {
+  const HugeLength len = n->range_.len();
+  if (len < NHugePages(kSizeBuckets)) {
+    Node*& head = buckets_[len.raw_num()];
+    n->size_left_ = nullptr;
+    n->size_right_ = head;
+    if (head != nullptr) head->size_left_ = n;
+    head = n;
+    nonempty_buckets_ |= uint64_t{1} << len.raw_num();
+    return;
+  }
+
+  // Walk down to n's place in the heap order, then split what was there
+  // into n's children.
+  Node** link = &size_root_;
+  while (*link != nullptr && (*link)->prio_ >= n->prio_) {
+    link = SizeLess(n->range_, (*link)->range_) ? &(*link)->size_left_
+                                                : &(*link)->size_right_;
+  }
+  Node* curr = *link;
+  *link = n;
+  Node** less = &n->size_left_;
+  Node** more = &n->size_right_;
+  while (curr != nullptr) {
+    if (SizeLess(curr->range_, n->range_)) {
+      *less = curr;
+      less = &curr->size_right_;
+      curr = curr->size_right_;
+    } else {
+      *more = curr;
+      more = &curr->size_left_;
+      curr = curr->size_left_;
+    }
+  }
+  *less = *more = nullptr;
+}
+
+void HugeAddressMap::IndexRemove(Node* n) {
+  const HugeLength len = n->range_.len();
+  if (len < NHugePages(kSizeBuckets)) {
+    if (n->size_left_ != nullptr) {
+      n->size_left_->size_right_ = n->size_right_;
+    } else {
+      TC_ASSERT_EQ(buckets_[len.raw_num()], n);
+      buckets_[len.raw_num()] = n->size_right_;
+      if (n->size_right_ == nullptr) {
+        nonempty_buckets_ &= ~(uint64_t{1} << len.raw_num());
+      }
+    }
+    if (n->size_right_ != nullptr) {
+      n->size_right_->size_left_ = n->size_left_;
+    }
+    return;
+  }
+
+  Node** link = &size_root_;
+  while (*link != n) {
+    TC_ASSERT_NE(*link, nullptr);
+    link = SizeLess(n->range_, (*link)->range_) ? &(*link)->size_left_
+                                                : &(*link)->size_right_;
+  }
+  // Merge n's children, whose keys are all ordered, in its place.
+  Node* less = n->size_left_;
+  Node* more = n->size_right_;
+  while (less != nullptr && more != nullptr) {
+    if (less->prio_ >= more->prio_) {
+      *link = less;
+      link = &less->size_right_;
+      less = less->size_right_;
+    } else {
+      *link = more;
+      link = &more->size_left_;
+      more = more->size_left_;
+    }
+  }
+  *link = less != nullptr ? less : more;
+}
+
 void HugeAddressMap::Merge(Node* b, HugeRange r, Node* a) {
   auto merge_when = [](HugeRange x, int64_t x_when, HugeRange y,
                        int64_t y_when) {
@@ -173,12 +320,16 @@ void HugeAddressMap::Merge(Node* b, HugeRange r, Node* a) {
   // Two way merges are easy.
   if (a == nullptr) {
     b->when_ = merge_when(b->range_, b->when(), r, when);
+    IndexRemove(b);
     b->range_ = Join(b->range_, r);
+    IndexInsert(b);
     FixLongest(b);
     return;
   } else if (b == nullptr) {
     a->when_ = merge_when(r, when, a->range_, a->when());
+    IndexRemove(a);
     a->range_ = Join(r, a->range_);
+    IndexInsert(a);
     FixLongest(a);
     return;
   }
@@ -193,7 +344,9 @@ void HugeAddressMap::Merge(Node* b, HugeRange r, Node* a) {
   // we actually don't change lengths at all; undo that.
   total_size_ += a->range_.len();
   Remove(a);
+  IndexRemove(b);
   b->range_ = full;
+  IndexInsert(b);
   b->when_ = full_when;
   FixLongest(b);
 }
@@ -221,6 +374,7 @@ void HugeAddressMap::Insert(HugeRange r) {
   TC_CHECK(!after || !r.precedes(after->range_));
   // No merging possible; just add a new node.
   Node* n = Get(r);
+  IndexInsert(n);
   Node* curr = root();
   Node* parent = nullptr;
   Node** link = &root_;
@@ -288,6 +442,7 @@ void HugeAddressMap::FixLongest(HugeAddressMap::Node* n) {
 
 void HugeAddressMap::Remove(HugeAddressMap::Node* n) {
   total_size_ -= n->range_.len();
+  IndexRemove(n);
   // We need to merge the left and right children of n into one
   // treap, then glue it into place wherever n was.
   Node** link;
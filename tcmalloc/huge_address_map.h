@@ -32,6 +32,11 @@ namespace tcmalloc_internal {
 // augmented with the largest range in each subtree (this allows fairly simple
 // allocation algorithms from the contained ranges.
 //
+// Alongside the address order, ranges are indexed by size: ranges shorter than
+// kSizeBuckets hugepages sit on one list per length, and longer ones in a
+// second treap ordered by (length, address).  BestFit uses this to find the
+// shortest range that fits in O(log n).
+//
 // This class scales well and is *reasonably* performant, but it is not intended
 // for use on extremely hot paths.
 class HugeAddressMap {
@@ -69,6 +74,9 @@ class HugeAddressMap {
     Node* parent_;
     HugeLength longest_;
     int64_t when_;
+    // Links in the size index: children in the size treap, or previous and
+    // next on a size bucket's list.
+    Node *size_left_, *size_right_;
     // Expensive, recursive consistency check.
     // Accumulates node count and range sizes into passed arguments.
     void Check(size_t* num_nodes, HugeLength* size) const;
@@ -90,6 +98,10 @@ class HugeAddressMap {
   Node* Predecessor(HugePage p);
   const Node* Predecessor(HugePage p) const;
 
+  // Returns a shortest range of at least n hugepages (if any).  Among ranges
+  // of kSizeBuckets or more hugepages, it is the lowest-addressed one.
+  Node* BestFit(HugeLength n);
+
   // Expensive consistency check.
   void Check();
 
@@ -114,6 +126,17 @@ class HugeAddressMap {
   // cache of unused nodes
   Node* freelist_{nullptr};
   size_t freelist_size_{0};
+
+  // The size index.  buckets_[i] lists the ranges of exactly i hugepages, and
+  // bit i of nonempty_buckets_ is set iff that list is nonempty.
+  static constexpr size_t kSizeBuckets = 64;
+  Node* buckets_[kSizeBuckets]{};
+  uint64_t nonempty_buckets_{0};
+  Node* size_root_{nullptr};
+  void IndexInsert(Node* n);
+  void IndexRemove(Node* n);
+  void CheckIndex() const;
+
   // How we get more
   MetadataAllocator& meta_;
   Node* Get(HugeRange r);
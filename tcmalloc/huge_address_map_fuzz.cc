@@ -0,0 +1,210 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <variant>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "fuzztest/fuzztest.h"
+#include "absl/strings/str_format.h"
+#include "tcmalloc/huge_address_map.h"
+#include "tcmalloc/huge_pages.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/mock_metadata_allocator.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc::tcmalloc_internal {
+namespace {
+
+// Addresses are kept in [1, kMaxHugePage) so that ranges collide and merge
+// often.  Page 0 is avoided, as it is not a valid range.
+constexpr size_t kMaxHugePage = 4096;
+
+struct State {
+  FakeMetadataAllocator metadata_allocator;
+  HugeAddressMap map{metadata_allocator};
+  // Start -> length of the ranges in map, fully merged.
+  std::map<size_t, size_t> model;
+
+  // Returns true iff [start, start + len) overlaps nothing in the model.
+  bool Disjoint(size_t start, size_t len) const {
+    auto next = model.lower_bound(start);
+    if (next != model.end() && next->first < start + len) return false;
+    if (next == model.begin()) return true;
+    auto prev = std::prev(next);
+    return prev->first + prev->second <= start;
+  }
+
+  void ModelInsert(size_t start, size_t len) {
+    auto next = model.lower_bound(start);
+    if (next != model.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == start) {
+        start = prev->first;
+        len += prev->second;
+        model.erase(prev);
+      }
+    }
+    if (next != model.end() && next->first == start + len) {
+      len += next->second;
+      model.erase(next);
+    }
+    model[start] = len;
+  }
+
+  void ModelRemove(HugeRange r) {
+    auto it = model.find(r.start().index());
+    TC_CHECK(it != model.end());
+    TC_CHECK_EQ(it->second, r.len().raw_num());
+    model.erase(it);
+  }
+
+  void CheckInvariants() {
+    map.Check();
+    TC_CHECK_EQ(map.nranges(), model.size());
+    size_t total = 0;
+    auto it = model.begin();
+    for (const HugeAddressMap::Node* node = map.first(); node != nullptr;
+         node = node->next(), ++it) {
+      TC_CHECK(it != model.end());
+      TC_CHECK_EQ(node->range().start().index(), it->first);
+      TC_CHECK_EQ(node->range().len().raw_num(), it->second);
+      total += it->second;
+    }
+    TC_CHECK_EQ(map.total_mapped(), NHugePages(total));
+  }
+};
+
+struct Insert {
+  size_t start;
+  size_t len;
+
+  template <typename Sink>
+  friend void AbslStringify(Sink& sink, const Insert& i) {
+    absl::Format(&sink, "Insert{.start=%v, .len=%v}", i.start, i.len);
+  }
+
+  void Perform(State& state) const {
+    const size_t s = 1 + start % (kMaxHugePage - 1);
+    const size_t n = 1 + len % (kMaxHugePage - s);
+    if (!state.Disjoint(s, n)) return;
+    state.map.Insert(HugeRange::Make(HugePage{s}, NHugePages(n)));
+    state.ModelInsert(s, n);
+  }
+};
+
+// Removes the range containing (or preceding) a page.
+struct Remove {
+  size_t page;
+
+  template <typename Sink>
+  friend void AbslStringify(Sink& sink, const Remove& r) {
+    absl::Format(&sink, "Remove{.page=%v}", r.page);
+  }
+
+  void Perform(State& state) const {
+    HugeAddressMap::Node* node =
+        state.map.Predecessor(HugePage{page % kMaxHugePage});
+    if (node == nullptr) return;
+    state.ModelRemove(node->range());
+    state.map.Remove(node);
+  }
+};
+
+// Allocates from the best fit, the way HugeAllocator::Get does.
+struct Get {
+  size_t len;
+
+  template <typename Sink>
+  friend void AbslStringify(Sink& sink, const Get& g) {
+    absl::Format(&sink, "Get{.len=%v}", g.len);
+  }
+
+  void Perform(State& state) const {
+    const size_t n = 1 + len % kMaxHugePage;
+    size_t expected = 0;
+    for (const auto& [start, length] : state.model) {
+      if (length >= n && (expected == 0 || length < expected)) {
+        expected = length;
+      }
+    }
+
+    HugeAddressMap::Node* node = state.map.BestFit(NHugePages(n));
+    if (expected == 0) {
+      TC_CHECK_EQ(node, nullptr);
+      return;
+    }
+    TC_CHECK_NE(node, nullptr);
+    const HugeRange r = node->range();
+    TC_CHECK_EQ(r.len(), NHugePages(expected));
+    state.ModelRemove(r);
+    state.map.Remove(node);
+    if (r.len() > NHugePages(n)) {
+      const HugeRange extra =
+          HugeRange::Make(r.start() + NHugePages(n), r.len() - NHugePages(n));
+      state.map.Insert(extra);
+      state.ModelInsert(extra.start().index(), extra.len().raw_num());
+    }
+  }
+};
+
+using Instruction = std::variant<Insert, Remove, Get>;
+
+template <typename Sink>
+void AbslStringify(Sink& sink, const Instruction& i) {
+  std::visit([&](auto&& arg) { absl::Format(&sink, "%v", arg); }, i);
+}
+
+void FuzzHugeAddressMap(const std::vector<Instruction>& instructions) {
+  State state;
+  for (const auto& inst : instructions) {
+    std::visit([&](auto&& arg) { arg.Perform(state); }, inst);
+    state.CheckInvariants();
+  }
+}
+
+fuzztest::Domain<Instruction> GetInstructionDomain() {
+  return fuzztest::OneOf(
+      fuzztest::Map([](Insert i) -> Instruction { return Instruction{i}; },
+                    fuzztest::Arbitrary<Insert>()),
+      fuzztest::Map([](Remove r) -> Instruction { return Instruction{r}; },
+                    fuzztest::Arbitrary<Remove>()),
+      fuzztest::Map([](Get g) -> Instruction { return Instruction{g}; },
+                    fuzztest::Arbitrary<Get>()));
+}
+
+FUZZ_TEST(HugeAddressMapTest, FuzzHugeAddressMap)
+    .WithDomains(fuzztest::VectorOf(GetInstructionDomain()));
+
+TEST(HugeAddressMapTest, Regression) {
+  FuzzHugeAddressMap({
+      Insert{.start = 100, .len = 70},
+      Insert{.start = 10, .len = 3},
+      Insert{.start = 13, .len = 86},
+      Get{.len = 1},
+      Insert{.start = 300, .len = 5},
+      Insert{.start = 200, .len = 99},
+      Get{.len = 100},
+      Remove{.page = 305},
+      Remove{.page = 1},
+  });
+}
+
+}  // namespace
+}  // namespace tcmalloc::tcmalloc_internal
+GOOGLE_MALLOC_SECTION_END
@@ -17,10 +17,14 @@
 #include <stddef.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <optional>
 #include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/algorithm/container.h"
+#include "absl/random/random.h"
 #include "tcmalloc/internal/mock_metadata_allocator.h"
 
 namespace tcmalloc {
@@ -103,6 +107,199 @@ TEST_F(HugeAddressMapTest, Predecessor) {
   EXPECT_EQ(node->range(), r2);
 }
 
+TEST_F(HugeAddressMapTest, BestFit) {
+  EXPECT_EQ(map_.BestFit(hl(1)), nullptr);
+
+  // Ranges on both sides of the size buckets, with gaps between them.
+  const HugeRange small1 = HugeRange::Make(hp(10), hl(3));
+  const HugeRange small2 = HugeRange::Make(hp(20), hl(5));
+  const HugeRange large1 = HugeRange::Make(hp(1000), hl(200));
+  const HugeRange large2 = HugeRange::Make(hp(100), hl(100));
+  const HugeRange large3 = HugeRange::Make(hp(2000), hl(100));
+  for (HugeRange r : {large1, small2, large3, small1, large2}) {
+    map_.Insert(r);
+  }
+  map_.Check();
+
+  auto best_fit = [&](size_t n) {
+    auto* node = map_.BestFit(hl(n));
+    return node ? node->range() : HugeRange::Nil();
+  };
+  EXPECT_EQ(best_fit(1), small1);
+  EXPECT_EQ(best_fit(3), small1);
+  EXPECT_EQ(best_fit(4), small2);
+  // Ties go to the lower address.
+  EXPECT_EQ(best_fit(6), large2);
+  EXPECT_EQ(best_fit(100), large2);
+  EXPECT_EQ(best_fit(101), large1);
+  EXPECT_EQ(best_fit(200), large1);
+  EXPECT_FALSE(best_fit(201).valid());
+
+  // Merging moves ranges between the buckets and the tree.
+  map_.Insert(HugeRange::Make(hp(13), hl(7)));
+  map_.Check();
+  EXPECT_EQ(best_fit(15), HugeRange::Make(hp(10), hl(15)));
+  map_.Insert(HugeRange::Make(hp(25), hl(75)));
+  map_.Check();
+  EXPECT_EQ(best_fit(15), large3);
+  EXPECT_EQ(best_fit(101), HugeRange::Make(hp(10), hl(190)));
+
+  map_.Remove(map_.BestFit(hl(1)));
+  map_.Check();
+  EXPECT_EQ(best_fit(1), HugeRange::Make(hp(10), hl(190)));
+}
+
+// Compare BestFit against a linear scan while inserting and removing ranges
+// at random.
+TEST_F(HugeAddressMapTest, BestFitMatchesScan) {
+  absl::BitGen rng;
+  std::vector<HugeRange> removed;
+  for (size_t i = 1; i < 100000; i += 64) {
+    removed.push_back(
+        HugeRange::Make(hp(i), hl(absl::Uniform<size_t>(rng, 1, 64))));
+  }
+
+  for (int iter = 0; iter < 20000; ++iter) {
+    if (!removed.empty() && absl::Bernoulli(rng, 0.6)) {
+      const size_t i = absl::Uniform<size_t>(rng, 0, removed.size());
+      map_.Insert(removed[i]);
+      removed[i] = removed.back();
+      removed.pop_back();
+    } else if (map_.nranges() > 0) {
+      // Carve a random piece out of a random range.
+      auto* node = map_.Predecessor(
+          hp(absl::Uniform<size_t>(rng, 1, 100000 + 128)));
+      if (node == nullptr) continue;
+      const HugeRange r = node->range();
+      map_.Remove(node);
+      const size_t len = absl::Uniform<size_t>(rng, 1, r.len().raw_num() + 1);
+      const size_t offset =
+          absl::Uniform<size_t>(rng, 0, r.len().raw_num() - len + 1);
+      removed.push_back(HugeRange::Make(r.start() + hl(offset), hl(len)));
+      if (offset > 0) map_.Insert(HugeRange::Make(r.start(), hl(offset)));
+      if (offset + len < r.len().raw_num()) {
+        map_.Insert(HugeRange::Make(r.start() + hl(offset + len),
+                                    r.len() - hl(offset + len)));
+      }
+    }
+
+    const HugeLength n = hl(absl::Uniform<size_t>(rng, 1, 256));
+    HugeLength expected = hl(0);
+    for (const auto* node = map_.first(); node; node = node->next()) {
+      const HugeLength len = node->range().len();
+      if (len >= n && (expected == hl(0) || len < expected)) expected = len;
+    }
+    const auto* best = map_.BestFit(n);
+    if (expected == hl(0)) {
+      EXPECT_EQ(best, nullptr);
+    } else {
+      ASSERT_NE(best, nullptr);
+      EXPECT_EQ(best->range().len(), expected);
+    }
+    if (iter % 1000 == 0) map_.Check();
+  }
+  map_.Check();
+}
+
+// Map a dense, 1TiB heap as a quarter of a million ranges, inserted in random
+// order: first every other one, which must stay separate, then the rest, which
+// must merge everything back into a single range.
+TEST_F(HugeAddressMapTest, DenseAtScale) {
+  constexpr size_t kHugePages = (size_t{1} << 40) / kHugePageSize;
+  absl::BitGen rng;
+  std::vector<HugeRange> ranges;
+  for (size_t i = 1; i <= kHugePages;) {
+    const size_t n = std::min(absl::Uniform<size_t>(rng, 1, 8),
+                              kHugePages + 1 - i);
+    ranges.push_back(HugeRange::Make(hp(i), hl(n)));
+    i += n;
+  }
+
+  std::vector<HugeRange> gapped, fill;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    (i % 2 == 0 ? gapped : fill).push_back(ranges[i]);
+  }
+  absl::c_shuffle(gapped, rng);
+  absl::c_shuffle(fill, rng);
+
+  HugeLength mapped = hl(0);
+  for (const HugeRange& r : gapped) {
+    map_.Insert(r);
+    mapped += r.len();
+  }
+  map_.Check();
+  EXPECT_EQ(map_.nranges(), gapped.size());
+  EXPECT_EQ(map_.total_mapped(), mapped);
+
+  for (const HugeRange& r : fill) {
+    map_.Insert(r);
+  }
+  map_.Check();
+  EXPECT_EQ(map_.nranges(), 1);
+  EXPECT_EQ(map_.total_mapped(), hl(kHugePages));
+  EXPECT_THAT(Contents(),
+              testing::ElementsAre(HugeRange::Make(hp(1), hl(kHugePages))));
+}
+
+// With a VMA budget, HugeAllocator requests grow with the heap, so its free
+// ranges are mostly longer than the size buckets and BestFit takes the size
+// treap instead.  Carve a large heap of such ranges the way HugeAllocator::Get
+// does and check each fit against a linear scan.
+TEST_F(HugeAddressMapTest, BudgetedGrowthAtScale) {
+  // Matches HugeAddressMap::kSizeBuckets.
+  const HugeLength kSizeBuckets = hl(64);
+  constexpr size_t kRanges = 4096;
+  constexpr size_t kGets = 2000;
+  absl::BitGen rng;
+  std::vector<HugeRange> ranges;
+  size_t next = 1;
+  for (size_t i = 0; i < kRanges; ++i) {
+    const size_t n = absl::LogUniform<size_t>(rng, 64, 1 << 14);
+    ranges.push_back(HugeRange::Make(hp(next), hl(n)));
+    // Leave a hole, so that the system's requests stay separate.
+    next += n + 1;
+  }
+  absl::c_shuffle(ranges, rng);
+  for (const HugeRange& r : ranges) {
+    map_.Insert(r);
+  }
+  map_.Check();
+  ASSERT_EQ(map_.nranges(), kRanges);
+
+  for (size_t i = 0; i < kGets; ++i) {
+    const HugeLength n = hl(absl::LogUniform<size_t>(rng, 1, 1 << 14));
+    // The shortest range that fits, and the lowest-addressed among those.
+    std::optional<HugeRange> want;
+    for (const HugeRange& r : Contents()) {
+      if (r.len() >= n && (!want.has_value() || r.len() < want->len())) {
+        want = r;
+      }
+    }
+
+    HugeAddressMap::Node* node = map_.BestFit(n);
+    if (!want.has_value()) {
+      EXPECT_EQ(node, nullptr);
+      continue;
+    }
+    ASSERT_NE(node, nullptr);
+    const HugeRange got = node->range();
+    // Short remainders are carved from the size buckets, which are not kept in
+    // address order.
+    if (want->len() >= kSizeBuckets) {
+      ASSERT_EQ(got, *want);
+    } else {
+      ASSERT_EQ(got.len(), want->len());
+    }
+
+    map_.Remove(node);
+    if (got.len() > n) {
+      map_.Insert(HugeRange::Make(got.start() + n, got.len() - n));
+    }
+    if (i % 256 == 0) map_.Check();
+  }
+  map_.Check();
+}
+
 }  // namespace
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
@@ -16,6 +16,8 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include "tcmalloc/huge_address_map.h"
 #include "tcmalloc/huge_pages.h"
 #include "tcmalloc/internal/config.h"
@@ -32,59 +34,23 @@ void HugeAllocator::Print(Printer& out) {
   out.printf("HugeAllocator: %zu requested - %zu in use = %zu hugepages free\n",
              from_system_.raw_num(), in_use_.raw_num(),
              (from_system_ - in_use_).raw_num());
+  out.printf("HugeAllocator: requesting memory in units of %zu hugepages\n",
+             granularity_.raw_num());
+  out.printf(
+      "HugeAllocator: %zu requests to the system and %zu moves in %zu "
+      "mappings (budget %zu)\n",
+      system_requests_, moves_, mappings(), vma_budget_);
 }
 
 void HugeAllocator::PrintInPbtxt(PbtxtRegion& hpaa) const {
   free_.PrintInPbtxt(hpaa);
   hpaa.PrintI64("num_total_requested_huge_pages", from_system_.raw_num());
   hpaa.PrintI64("num_in_use_huge_pages", in_use_.raw_num());
-}
-
-HugeAddressMap::Node* HugeAllocator::Find(HugeLength n) {
-  HugeAddressMap::Node* curr = free_.root();
-  // invariant: curr != nullptr && curr->longest >= n
-  // we favor smaller gaps and lower nodes and lower addresses, in that
-  // order. The net effect is that we are neither a best-fit nor a
-  // lowest-address allocator but vaguely close to both.
-  HugeAddressMap::Node* best = nullptr;
-  while (curr && curr->longest() >= n) {
-    if (curr->range().len() >= n) {
-      if (!best || best->range().len() > curr->range().len()) {
-        best = curr;
-      }
-    }
-
-    // Either subtree could contain a better fit and we don't want to
-    // search the whole tree. Pick a reasonable child to look at.
-    auto left = curr->left();
-    auto right = curr->right();
-    if (!left || left->longest() < n) {
-      curr = right;
-      continue;
-    }
-
-    if (!right || right->longest() < n) {
-      curr = left;
-      continue;
-    }
-
-    // Here, we have a nontrivial choice.
-    if (left->range().len() == right->range().len()) {
-      if (left->longest() <= right->longest()) {
-        curr = left;
-      } else {
-        curr = right;
-      }
-    } else if (left->range().len() < right->range().len()) {
-      // Here, the longest range in both children is the same...look
-      // in the subtree with the smaller root, as that's slightly
-      // more likely to be our best.
-      curr = left;
-    } else {
-      curr = right;
-    }
-  }
-  return best;
+  hpaa.PrintI64("huge_allocator_granularity_bytes", granularity_.in_bytes());
+  hpaa.PrintI64("huge_allocator_system_requests", system_requests_);
+  hpaa.PrintI64("huge_allocator_moves", moves_);
+  hpaa.PrintI64("huge_allocator_mappings", mappings());
+  hpaa.PrintI64("huge_allocator_vma_budget", vma_budget_);
 }
 
 void HugeAllocator::CheckFreelist() {
@@ -101,8 +67,32 @@ void HugeAllocator::CheckFreelist() {
 
 HugeRange HugeAllocator::AllocateRange(HugeLength n) {
   if (n.overflows()) return HugeRange::Nil();
+  if (vma_budget_ > 0) {
+    // Trade (unbacked) address space for mappings as we approach the budget:
+    // ask for up to system() more, in proportion to the budget used.
+    const size_t used = std::min(mappings(), vma_budget_);
+    const HugeLength growth =
+        NHugePages(from_system_.raw_num() / vma_budget_ * used +
+                   from_system_.raw_num() % vma_budget_ * used / vma_budget_);
+    if (growth > n) {
+      HugeRange r = RequestFromSystem(growth);
+      if (r.valid()) return r;
+      // Address space may be short; settle for what we need.
+    }
+  }
+  return RequestFromSystem(n);
+}
+
+HugeRange HugeAllocator::RequestFromSystem(HugeLength n) {
+  // Round up to whole, aligned granules, so that they can be backed by (and
+  // later released as) pages of that size.
+  const HugeLength partial = n % granularity_;
+  if (partial != NHugePages(0)) {
+    n += granularity_ - partial;
+    if (n.overflows()) return HugeRange::Nil();
+  }
   size_t bytes = n.in_bytes();
-  size_t align = kHugePageSize;
+  size_t align = granularity_.in_bytes();
   auto [ptr, actual] = allocate_(bytes, align);
   if (ptr == nullptr) {
     // OOM...
@@ -113,19 +103,24 @@ HugeRange HugeAllocator::AllocateRange(HugeLength n) {
   TC_CHECK_EQ(actual % kHugePageSize, 0);
   n = HLFromBytes(actual);
   from_system_ += n;
-  return HugeRange::Make(HugePageContaining(ptr), n);
+  const HugeRange r = HugeRange::Make(HugePageContaining(ptr), n);
+  ++system_requests_;
+  // The system may carve requests out of a mapping in either direction, or
+  // fill a hole between earlier ones.
+  system_ranges_.Insert(r);
+  return r;
 }
 
 HugeRange HugeAllocator::Get(HugeLength n) {
   TC_CHECK_GT(n, NHugePages(0));
-  auto* node = Find(n);
+  auto* node = free_.BestFit(n);
   if (!node) {
     // Get more memory, then "delete" it
     HugeRange r = AllocateRange(n);
     if (!r.valid()) return r;
     in_use_ += r.len();
     Release(r);
-    node = Find(n);
+    node = free_.BestFit(n);
     TC_CHECK_NE(node, nullptr);
   }
   in_use_ += n;
@@ -148,6 +143,27 @@ HugeRange HugeAllocator::Get(HugeLength n) {
   return r;
 }
 
+bool HugeAllocator::MaybeGetAt(HugeRange r) {
+  TC_CHECK_GT(r.len(), NHugePages(0));
+  HugeAddressMap::Node* node = free_.Predecessor(r.start());
+  if (node == nullptr || !node->range().contains(r)) return false;
+
+  HugeRange whole = node->range();
+  free_.Remove(node);
+  in_use_ += whole.len();
+  // Put back whatever surrounds r.
+  if (whole.start() < r.start()) {
+    Release(HugeRange::Make(whole.start(), r.start() - whole.start()));
+  }
+  const HugePage end = r.start() + r.len();
+  const HugePage whole_end = whole.start() + whole.len();
+  if (end < whole_end) {
+    Release(HugeRange::Make(end, whole_end - end));
+  }
+  DebugCheckFreelist();
+  return true;
+}
+
 void HugeAllocator::Release(HugeRange r) {
   in_use_ -= r.len();
 
@@ -155,6 +171,14 @@ void HugeAllocator::Release(HugeRange r) {
   DebugCheckFreelist();
 }
 
+bool HugeAllocator::ReserveMove() {
+  if (vma_budget_ > 0 && mappings() + kMappingsPerMove > vma_budget_) {
+    return false;
+  }
+  ++moves_;
+  return true;
+}
+
 void HugeAllocator::AddSpanStats(SmallSpanStats* small,
                                  LargeSpanStats* large) const {
   for (const HugeAddressMap::Node* node = free_.first(); node != nullptr;
@@ -50,27 +50,80 @@ class VirtualAllocator {
 // This tracks available ranges of hugepages and fulfills requests for
 // usable memory, allocating more from the system as needed.  All
 // hugepages are treated as (and assumed to be) unbacked.
+//
+// Memory is obtained from the system in aligned multiples of <granularity>
+// hugepages.  A granularity of kHugePagesPerGigaPage lets the system back the
+// heap with 1GiB pages, which HugeCache then hands out in hugepage slices.
+//
+// Each request to the system may cost the process a mapping (VMA), unless it
+// lands next to address space we already have.  We keep the ranges obtained
+// from the system in their own HugeAddressMap, which merges adjacent ones, and
+// count its ranges as our mappings.  This is a lower bound: the kernel only
+// merges neighboring VMAs with the same protection, flags and name, and the
+// page heap names its spans and regions (see SetAnonVmaName), so a contiguous
+// range may still be split into several VMAs.  Remapping hugepages with
+// SystemAllocator::MovePages splits them further (see ReserveMove), and those
+// splits are counted too.  A nonzero <vma_budget> bounds how many we would
+// like to spend: requests grow with the fraction of the budget already used,
+// up to doubling system(), so that the number of mappings grows
+// logarithmically with the heap and later Gets reuse address space we already
+// have rather than mapping more.  Once the budget is spent, no more moves are
+// allowed.
 class HugeAllocator {
  public:
   constexpr HugeAllocator(
       VirtualAllocator& allocate ABSL_ATTRIBUTE_LIFETIME_BOUND,
-      MetadataAllocator& meta_allocate ABSL_ATTRIBUTE_LIFETIME_BOUND)
-      : free_(meta_allocate), allocate_(allocate) {}
+      MetadataAllocator& meta_allocate ABSL_ATTRIBUTE_LIFETIME_BOUND,
+      HugeLength granularity = NHugePages(1), size_t vma_budget = 0)
+      : free_(meta_allocate),
+        system_ranges_(meta_allocate),
+        allocate_(allocate),
+        granularity_(granularity),
+        vma_budget_(vma_budget) {}
 
   // Obtain a range of n unbacked hugepages, distinct from all other
   // calls to Get (other than those that have been Released.)
   HugeRange Get(HugeLength n);
 
+  // As Get, but for the specific range r.  Returns false if any hugepage in r
+  // is in use (or has not yet been obtained from the system.)
+  bool MaybeGetAt(HugeRange r);
+
   // Returns a range of hugepages for reuse by subsequent Gets().
   // REQUIRES: <r> is the return value (or a subrange thereof) of a previous
   // call to Get(); neither <r> nor any overlapping range has been released
   // since that Get().
   void Release(HugeRange r);
 
+  // Returns true, and counts kMappingsPerMove more mappings, if hugepages in
+  // our ranges may be remapped to or from elsewhere without exceeding the VMA
+  // budget.  Moving a range into or out of the middle of a mapping splits it
+  // in three, and the kernel does not merge the pieces back: the moved pages
+  // keep the offset of the mapping they came from.  Moves are never
+  // uncounted; without a budget they are only counted.
+  bool ReserveMove();
+  // Uncounts a move reserved by ReserveMove that did not happen.
+  void UnreserveMove() {
+    TC_ASSERT_GT(moves_, 0);
+    --moves_;
+  }
+
   // Total memory requested from the system, whether in use or not,
   HugeLength system() const { return from_system_; }
   // Unused memory in the allocator.
   HugeLength size() const { return from_system_ - in_use_; }
+  // Unit in which memory is requested from the system.
+  HugeLength granularity() const { return granularity_; }
+  // Number of successful requests to the system.
+  size_t system_requests() const { return system_requests_; }
+  // Number of contiguous ranges of address space obtained from the system,
+  // plus the mappings that moves may have split them into.
+  size_t mappings() const {
+    return system_ranges_.nranges() + kMappingsPerMove * moves_;
+  }
+  // Number of moves reserved by ReserveMove.
+  size_t moves() const { return moves_; }
+  size_t vma_budget() const { return vma_budget_; }
 
   void AddSpanStats(SmallSpanStats* small, LargeSpanStats* large) const;
 
@@ -91,6 +144,8 @@ class HugeAllocator {
   void PrintInPbtxt(PbtxtRegion& hpaa) const;
 
  private:
+  static constexpr size_t kMappingsPerMove = 2;
+
   // We're constrained in several ways by existing code.  Hard requirements:
   // * no radix tree or similar O(address space) external space tracking
   // * support sub releasing
@@ -98,13 +153,15 @@ class HugeAllocator {
   // * no pre-allocation.
   // * reasonable space overhead
   //
-  // We use a treap ordered on addresses to track.  This isn't the most
+  // We use a treap ordered on addresses to track, with a size index on the
+  // side for best-fit Gets (see HugeAddressMap).  This isn't the most
   // efficient thing ever but we're about to hit 100usec+/hugepage
   // backing costs if we've gotten this far; the last few bits of performance
   // don't matter, and most of the simple ideas can't hit all of the above
   // requirements.
   HugeAddressMap free_;
-  HugeAddressMap::Node* Find(HugeLength n);
+  // Everything obtained from the system, whether in use or not.
+  HugeAddressMap system_ranges_;
 
   void CheckFreelist();
   void DebugCheckFreelist() {
@@ -116,8 +173,14 @@ class HugeAllocator {
   HugeLength from_system_{NHugePages(0)};
   HugeLength in_use_{NHugePages(0)};
 
+  size_t system_requests_{0};
+  size_t moves_{0};
+
   VirtualAllocator& allocate_;
+  const HugeLength granularity_;
+  const size_t vma_budget_;
   HugeRange AllocateRange(HugeLength n);
+  HugeRange RequestFromSystem(HugeLength n);
 };
 
 }  // namespace tcmalloc_internal
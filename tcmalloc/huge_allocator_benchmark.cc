@@ -0,0 +1,113 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/base/internal/cycleclock.h"
+#include "absl/random/random.h"
+#include "benchmark/benchmark.h"
+#include "tcmalloc/huge_allocator.h"
+#include "tcmalloc/huge_pages.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/mock_metadata_allocator.h"
+#include "tcmalloc/mock_virtual_allocator.h"
+#include "tcmalloc/stats.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+// Mostly small requests with a tail of large ones, so that free ranges of all
+// sizes pile up.
+HugeLength RandomLength(absl::BitGen& rng) {
+  if (absl::Bernoulli(rng, 0.9)) {
+    return NHugePages(absl::Uniform<size_t>(rng, 1, 16));
+  }
+  return NHugePages(absl::Uniform<size_t>(rng, 16, 256));
+}
+
+// Replaces random live ranges with new ones of random sizes, so that each Get
+// searches a fragmented free list.  Reports the latency percentiles of Get.
+void BM_GetReleaseChurn(benchmark::State& state) {
+  const size_t num_live = state.range(0);
+
+  FakeVirtualAllocator vm_allocator;
+  FakeMetadataAllocator metadata_allocator;
+  vm_allocator.backing_.resize(1024);
+  HugeAllocator allocator(vm_allocator, metadata_allocator);
+  absl::BitGen rng;
+
+  std::vector<HugeRange> live;
+  live.reserve(num_live * 2);
+  for (size_t i = 0; i < num_live * 2; ++i) {
+    live.push_back(allocator.Get(RandomLength(rng)));
+    TC_CHECK(live.back().valid());
+  }
+  // Free every other range to fragment the address space.
+  for (size_t i = 0; i < live.size(); i += 2) {
+    allocator.Release(live[i]);
+    live[i] = live.back();
+    live.pop_back();
+  }
+
+  std::vector<int64_t> latencies;
+  latencies.reserve(1 << 20);
+  for (auto s : state) {
+    const size_t victim = absl::Uniform<size_t>(rng, 0, live.size());
+    allocator.Release(live[victim]);
+    const HugeLength n = RandomLength(rng);
+
+    const int64_t start = absl::base_internal::CycleClock::Now();
+    const HugeRange r = allocator.Get(n);
+    const int64_t end = absl::base_internal::CycleClock::Now();
+
+    if (!r.valid()) {
+      state.SkipWithError("out of address space");
+      break;
+    }
+    live[victim] = r;
+    if (latencies.size() < latencies.capacity()) {
+      latencies.push_back(end - start);
+    }
+  }
+
+  LargeSpanStats large;
+  allocator.AddSpanStats(nullptr, &large);
+  for (const HugeRange& r : live) allocator.Release(r);
+  if (latencies.empty()) return;
+
+  const double ns_per_cycle =
+      1e9 / absl::base_internal::CycleClock::Frequency();
+  auto percentile = [&](double p) {
+    auto it = latencies.begin() +
+              static_cast<size_t>(p * (latencies.size() - 1));
+    std::nth_element(latencies.begin(), it, latencies.end());
+    return *it * ns_per_cycle;
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["free_ranges"] = large.spans;
+}
+
+BENCHMARK(BM_GetReleaseChurn)->Range(256, 16384);
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
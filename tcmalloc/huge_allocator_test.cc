@@ -370,6 +370,130 @@ TEST_P(HugeAllocatorTest, Contains) {
   EXPECT_FALSE(allocator_.Contains(r1.start() - NHugePages(1)));
 }
 
+TEST_P(HugeAllocatorTest, GigaPageGranularity) {
+  constexpr HugeLength kGiga = kHugePagesPerGigaPage;
+  HugeAllocator allocator{vm_allocator_, metadata_allocator_, kGiga};
+  EXPECT_EQ(allocator.granularity(), kGiga);
+
+  HugeRange r1 = allocator.Get(NHugePages(1));
+  ASSERT_TRUE(r1.valid());
+  EXPECT_EQ(r1.start().index() % kGiga.raw_num(), 0);
+  EXPECT_EQ(HugePagesRequested(), kGiga);
+
+  // The rest of the 1GiB page is used before asking the system for more.
+  HugeRange r2 = allocator.Get(kGiga - NHugePages(1));
+  ASSERT_TRUE(r2.valid());
+  EXPECT_EQ(HugePagesRequested(), kGiga);
+
+  HugeRange r3 = allocator.Get(NHugePages(2));
+  ASSERT_TRUE(r3.valid());
+  EXPECT_EQ(r3.start().index() % kGiga.raw_num(), 0);
+  EXPECT_EQ(HugePagesRequested(), kGiga * 2);
+
+  allocator.Release(r1);
+  allocator.Release(r2);
+  allocator.Release(r3);
+  EXPECT_EQ(allocator.size(), allocator.system());
+}
+
+TEST_P(HugeAllocatorTest, VmaBudget) {
+  constexpr size_t kBudget = 16;
+  constexpr int kGets = 1000;
+  constexpr HugeLength kLen = NHugePages(4);
+  HugeAllocator frugal{vm_allocator_, metadata_allocator_};
+  HugeAllocator budgeted{vm_allocator_, metadata_allocator_, NHugePages(1),
+                         kBudget};
+  EXPECT_EQ(frugal.vma_budget(), 0);
+  EXPECT_EQ(budgeted.vma_budget(), kBudget);
+
+  for (HugeAllocator* allocator : {&frugal, &budgeted}) {
+    for (int i = 0; i < kGets; ++i) {
+      // Leave a hole before each request, so that no two are adjacent.
+      vm_allocator_.backing_.resize(vm_allocator_.backing_.size() + 1);
+      ASSERT_TRUE(allocator->Get(kLen).valid());
+    }
+    EXPECT_EQ(allocator->mappings(), allocator->system_requests());
+  }
+
+  EXPECT_EQ(frugal.system_requests(), kGets);
+
+  // Once the budget is spent, each request at least doubles system(), so
+  // only logarithmically many more are needed.
+  EXPECT_LE(budgeted.system_requests(), 2 * kBudget);
+  EXPECT_LE(budgeted.system(), kLen * kGets * 2 + NHugePages(kBudget));
+}
+
+// Moves are counted as mappings, and stop once the budget is spent.
+TEST_P(HugeAllocatorTest, MovesCountAgainstVmaBudget) {
+  constexpr size_t kBudget = 8;
+  HugeAllocator frugal{vm_allocator_, metadata_allocator_};
+  HugeAllocator budgeted{vm_allocator_, metadata_allocator_, NHugePages(1),
+                         kBudget};
+  for (HugeAllocator* allocator : {&frugal, &budgeted}) {
+    ASSERT_TRUE(allocator->Get(NHugePages(4)).valid());
+    ASSERT_EQ(allocator->mappings(), 1);
+  }
+
+  // Without a budget, moves are only counted.
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_TRUE(frugal.ReserveMove());
+  }
+  EXPECT_EQ(frugal.moves(), 100);
+  EXPECT_EQ(frugal.mappings(), 1 + 2 * 100);
+
+  // With one, the mappings moves may split off stay within it.
+  size_t moves = 0;
+  while (budgeted.ReserveMove()) {
+    ++moves;
+    ASSERT_LE(moves, kBudget);
+  }
+  EXPECT_EQ(moves, (kBudget - 1) / 2);
+  EXPECT_LE(budgeted.mappings(), kBudget);
+
+  // A move that did not happen gives its mappings back.
+  budgeted.UnreserveMove();
+  EXPECT_EQ(budgeted.moves(), moves - 1);
+  EXPECT_TRUE(budgeted.ReserveMove());
+}
+
+// Requests that land next to the previous one do not cost another mapping.
+TEST_P(HugeAllocatorTest, AdjacentRequestsShareMapping) {
+  for (int i = 1; i < 100; ++i) {
+    ASSERT_TRUE(allocator_.Get(NHugePages(i)).valid());
+  }
+  EXPECT_GT(allocator_.system_requests(), 1);
+  EXPECT_EQ(allocator_.mappings(), 1);
+}
+
+// A request that fills the hole between two earlier ones joins them, even
+// though it adjoins more than just the previous request.
+TEST_P(HugeAllocatorTest, RequestFillingHoleJoinsMappings) {
+  // The fake allocator hands out an extra hugepage when overallocating; use it
+  // up so that each Get below goes to the system.
+  const size_t received = GetParam() ? 2 : 1;
+  auto get_from_system = [&]() {
+    const size_t requests = allocator_.system_requests();
+    HugeRange r = allocator_.Get(NHugePages(1));
+    EXPECT_EQ(allocator_.system_requests(), requests + 1);
+    if (allocator_.size() > NHugePages(0)) {
+      EXPECT_TRUE(allocator_.Get(allocator_.size()).valid());
+    }
+    return r;
+  };
+
+  ASSERT_TRUE(get_from_system().valid());
+  const size_t hole = vm_allocator_.backing_.size();
+  vm_allocator_.backing_.resize(hole + received);
+  ASSERT_TRUE(get_from_system().valid());
+  EXPECT_EQ(allocator_.mappings(), 2);
+
+  vm_allocator_.next_index_ = hole;
+  HugeRange r = get_from_system();
+  ASSERT_TRUE(r.valid());
+  EXPECT_EQ(r.start().index(), hole);
+  EXPECT_EQ(allocator_.mappings(), 1);
+}
+
 INSTANTIATE_TEST_SUITE_P(
     NormalOverAlloc, HugeAllocatorTest, testing::Values(false, true),
     +[](const testing::TestParamInfo<bool>& info) {
@@ -25,6 +25,8 @@
 #include "tcmalloc/huge_pages.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/memory_tag.h"
+#include "tcmalloc/internal/page_heap_tracer.h"
 #include "tcmalloc/pages.h"
 #include "tcmalloc/stats.h"
 
@@ -108,10 +110,11 @@ template class MinMaxTracker<600>;
 // The logic for actually allocating from the cache or backing, and keeping
 // the hit rates specified.
 HugeRange HugeCache::DoGet(HugeLength n, bool* from_released) {
-  auto* node = Find(n);
+  auto* node = cache_.BestFit(n);
   if (!node) {
     misses_++;
     weighted_misses_ += n.raw_num();
+    if (granularity_ > NHugePages(1)) return GetGranules(n, from_released);
     HugeRange res = allocator_->Get(n);
     if (res.valid()) {
       *from_released = true;
@@ -134,6 +137,27 @@ HugeRange HugeCache::DoGet(HugeLength n, bool* from_released) {
   return result;
 }
 
+HugeRange HugeCache::GetGranules(HugeLength n, bool* from_released) {
+  // Take whole granules from the allocator, so that it only ever tracks whole
+  // granules, and cache what we do not need.  A granule is backed as a whole
+  // (by a single 1GiB page), so the rest of it is as good as backed.
+  const HugeLength partial = n % granularity_;
+  const HugeLength len =
+      partial == NHugePages(0) ? n : n + (granularity_ - partial);
+  HugeRange res = allocator_->Get(len);
+  if (!res.valid()) return res;
+  *from_released = true;
+
+  HugeRange result, leftover;
+  std::tie(result, leftover) = Split(res, n);
+  if (leftover.valid()) {
+    cache_.Insert(leftover);
+    size_ += leftover.len();
+    UpdateSize(size());
+  }
+  return result;
+}
+
 void HugeCache::MaybeGrowCacheLimit(HugeLength missed) {
   // Our goal is to make the cache size = the largest "brief dip."
   //
@@ -175,6 +199,8 @@ void HugeCache::MaybeGrowCacheLimit(HugeLength missed) {
   const HugeLength lim = dip + slack;
 
   if (lim > limit()) {
+    page_heap_tracer.Record(PageHeapEventType::kCacheGrow, tag_, 0,
+                            (lim - limit()).in_bytes());
     last_limit_change_ = clock_.now();
     limit_ = lim;
   }
@@ -211,6 +237,38 @@ HugeRange HugeCache::Get(HugeLength n, bool* from_released) {
   return r;
 }
 
+bool HugeCache::MaybeGetAt(HugeRange r, bool* from_released) {
+  HugeAddressMap::Node* node = cache_.Predecessor(r.start());
+  if (node != nullptr && node->range().contains(r)) {
+    hits_++;
+    weighted_hits_ += r.len().raw_num();
+    *from_released = false;
+    size_ -= r.len();
+    UpdateSize(size());
+    // Put back whatever surrounds r.
+    const HugeRange whole = node->range();
+    cache_.Remove(node);
+    if (whole.start() < r.start()) {
+      cache_.Insert(HugeRange::Make(whole.start(), r.start() - whole.start()));
+    }
+    const HugePage end = r.start() + r.len();
+    const HugePage whole_end = whole.start() + whole.len();
+    if (end < whole_end) {
+      cache_.Insert(HugeRange::Make(end, whole_end - end));
+    }
+  } else if (granularity_ == NHugePages(1) && allocator_->MaybeGetAt(r)) {
+    misses_++;
+    weighted_misses_ += r.len().raw_num();
+    *from_released = true;
+  } else {
+    return false;
+  }
+
+  IncUsage(r.len());
+  if (*from_released) MaybeGrowCacheLimit(r.len());
+  return true;
+}
+
 void HugeCache::Release(HugeRange r) {
   DecUsage(r.len());
 
@@ -232,6 +290,12 @@ void HugeCache::Release(HugeRange r) {
 }
 
 void HugeCache::ReleaseUnbacked(HugeRange r) {
+  if (granularity_ > NHugePages(1)) {
+    // r is part of a granule that is at least partly backed.  Cache it so
+    // that the granule can be released once it is entirely unused.
+    Release(r);
+    return;
+  }
   DecUsage(r.len());
   // No point in trying to cache it, just hand it back.
   allocator_->Release(r);
@@ -248,16 +312,25 @@ HugeLength HugeCache::MaybeShrinkCacheLimit() {
 
   // Take away half of the unused portion.
   HugeLength drop = std::max(min / 2, NHugePages(1));
+  const HugeLength old_limit = limit();
   limit_ = std::max(limit() <= drop ? NHugePages(0) : limit() - drop,
                     MinCacheLimit());
+  if (limit() < old_limit) {
+    page_heap_tracer.Record(PageHeapEventType::kCacheShrink, tag_, 0,
+                            (old_limit - limit()).in_bytes());
+  }
   return ShrinkCache(limit());
 }
 
-HugeLength HugeCache::ShrinkCache(HugeLength target) {
+HugeLength HugeCache::ShrinkCache(HugeLength target, bool overshoot) {
+  if (granularity_ > NHugePages(1)) {
+    return ShrinkCacheByGranule(target, overshoot);
+  }
+
   HugeLength removed = NHugePages(0);
   while (size_ > target) {
     // Remove smallest-ish nodes, to avoid fragmentation where possible.
-    auto* node = Find(NHugePages(1));
+    auto* node = cache_.BestFit(NHugePages(1));
     TC_CHECK_NE(node, nullptr);
     HugeRange r = node->range();
     cache_.Remove(node);
@@ -292,6 +365,73 @@ HugeLength HugeCache::ShrinkCache(HugeLength target) {
   return removed;
 }
 
+HugeRange HugeCache::FirstGranule(HugeRange r) const {
+  const size_t granule = granularity_.raw_num();
+  const size_t start = (r.start().index() + granule - 1) / granule * granule;
+  if (start + granule > r.start().index() + r.len().raw_num()) {
+    return HugeRange::Nil();
+  }
+  return HugeRange::Make(HugePage{.pn = start}, granularity_);
+}
+
+HugeLength HugeCache::ShrinkCacheByGranule(HugeLength target, bool overshoot) {
+  // Part of a granule cannot be released on its own (madvise fails on part of
+  // a 1GiB page), so we can only give back granules that are entirely cached.
+  // Walk the cache in address order looking for them.
+  HugeLength removed = NHugePages(0);
+  HugeAddressMap::Node* node = cache_.first();
+  while (node != nullptr && size_ > target) {
+    const HugeRange whole = node->range();
+    const HugeRange r = FirstGranule(whole);
+    if (!r.valid() || (!overshoot && size_ - r.len() < target)) {
+      node = node->next();
+      continue;
+    }
+
+    cache_.Remove(node);
+    if (whole.start() < r.start()) {
+      cache_.Insert(HugeRange::Make(whole.start(), r.start() - whole.start()));
+    }
+    const HugePage end = r.start() + r.len();
+    const HugePage whole_end = whole.start() + whole.len();
+    if (end < whole_end) {
+      cache_.Insert(HugeRange::Make(end, whole_end - end));
+    }
+
+    size_ -= r.len();
+    // As in ShrinkCache, this may temporarily drop the page heap lock.
+    if (ABSL_PREDICT_FALSE(!unback_(r).success)) {
+      size_ += r.len();
+      cache_.Insert(r);
+      break;
+    }
+    allocator_->Release(r);
+    removed += r.len();
+
+    // Resume with whatever follows r: the cache may have changed under us.
+    node = cache_.Predecessor(end);
+    if (node == nullptr) {
+      node = cache_.first();
+    } else if (node->range().start() < end) {
+      node = node->next();
+    }
+  }
+
+  return removed;
+}
+
+size_t HugeCache::empty_granules() const {
+  size_t n = 0;
+  for (const HugeAddressMap::Node* node = cache_.first(); node != nullptr;
+       node = node->next()) {
+    const HugeRange r = FirstGranule(node->range());
+    if (!r.valid()) continue;
+    const HugePage end = node->range().start() + node->range().len();
+    n += (end - r.start()) / granularity_;
+  }
+  return n;
+}
+
 HugeLength HugeCache::ReleaseCachedPages(HugeLength n) {
   // This is a good time to check: is our cache going persistently unused?
   HugeLength released = MaybeShrinkCacheLimit();
@@ -299,7 +439,7 @@ HugeLength HugeCache::ReleaseCachedPages(HugeLength n) {
   if (released < n) {
     n -= released;
     const HugeLength target = n > size() ? NHugePages(0) : size() - n;
-    released += ShrinkCache(target);
+    released += ShrinkCache(target, /*overshoot=*/true);
   }
   UpdateSize(size());
   total_periodic_unbacked_ += released;
@@ -319,53 +459,6 @@ void HugeCache::AddSpanStats(SmallSpanStats* small,
   }
 }
 
-HugeAddressMap::Node* HugeCache::Find(HugeLength n) {
-  HugeAddressMap::Node* curr = cache_.root();
-  // invariant: curr != nullptr && curr->longest >= n
-  // we favor smaller gaps and lower nodes and lower addresses, in that
-  // order. The net effect is that we are neither a best-fit nor a
-  // lowest-address allocator but vaguely close to both.
-  HugeAddressMap::Node* best = nullptr;
-  while (curr && curr->longest() >= n) {
-    if (curr->range().len() >= n) {
-      if (!best || best->range().len() > curr->range().len()) {
-        best = curr;
-      }
-    }
-
-    // Either subtree could contain a better fit and we don't want to
-    // search the whole tree. Pick a reasonable child to look at.
-    auto left = curr->left();
-    auto right = curr->right();
-    if (!left || left->longest() < n) {
-      curr = right;
-      continue;
-    }
-
-    if (!right || right->longest() < n) {
-      curr = left;
-      continue;
-    }
-
-    // Here, we have a nontrivial choice.
-    if (left->range().len() == right->range().len()) {
-      if (left->longest() <= right->longest()) {
-        curr = left;
-      } else {
-        curr = right;
-      }
-    } else if (left->range().len() < right->range().len()) {
-      // Here, the longest range in both children is the same...look
-      // in the subtree with the smaller root, as that's slightly
-      // more likely to be our best.
-      curr = left;
-    } else {
-      curr = right;
-    }
-  }
-  return best;
-}
-
 void HugeCache::Print(Printer& out) {
   const int64_t millis = absl::ToInt64Milliseconds(cache_time_);
   out.printf(
@@ -389,6 +482,14 @@ void HugeCache::Print(Printer& out) {
   out.printf("HugeCache: %zu MiB fast unbacked, %zu MiB periodic\n",
              total_fast_unbacked_.in_bytes() / 1024 / 1024,
              total_periodic_unbacked_.in_bytes() / 1024 / 1024);
+  if (granularity_ > NHugePages(1)) {
+    const size_t empty = empty_granules();
+    out.printf(
+        "HugeCache: %zu empty %zu MiB granules, %zu hugepages cached in "
+        "partially used granules\n",
+        empty, granularity_.in_mib(),
+        (size_ - granularity_ * empty).raw_num());
+  }
   UpdateSize(size());
 
   usage_tracker_.Report(usage_);
@@ -441,6 +542,16 @@ void HugeCache::PrintInPbtxt(PbtxtRegion& hpaa) {
   hpaa.PrintI64("fast_unbacked_bytes", total_fast_unbacked_.in_bytes());
   // bytes unbacked by periodic releaser thread
   hpaa.PrintI64("periodic_unbacked_bytes", total_periodic_unbacked_.in_bytes());
+  if (granularity_ > NHugePages(1)) {
+    const size_t empty = empty_granules();
+    // size of the units memory is released in
+    hpaa.PrintI64("huge_cache_granule_bytes", granularity_.in_bytes());
+    // granules that are entirely cached, and can be released
+    hpaa.PrintI64("huge_cache_empty_granules", empty);
+    // cached bytes in granules that are partially in use
+    hpaa.PrintI64("huge_cache_partial_granule_bytes",
+                  (size_ - granularity_ * empty).in_bytes());
+  }
   UpdateSize(size());
 
   usage_tracker_.Report(usage_);
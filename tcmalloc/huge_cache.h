@@ -34,6 +34,7 @@
 #include "tcmalloc/internal/clock.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/memory_tag.h"
 #include "tcmalloc/internal/metadata_allocator.h"
 #include "tcmalloc/internal/system_allocator.h"
 #include "tcmalloc/internal/timeseries_tracker.h"
@@ -60,6 +61,18 @@ class MemoryTagFunction {
   virtual void operator()(Range r, std::optional<absl::string_view> name) = 0;
 };
 
+// Queries and changes which NUMA nodes back the memory of a NUMA partition.
+class NumaPlacementFunction {
+ public:
+  virtual ~NumaPlacementFunction() = default;
+
+  // Returns whether the first page of r is backed by a node of the partition,
+  // or std::nullopt if that is unknown (e.g. the page is not backed).
+  virtual std::optional<bool> IsLocal(Range r) = 0;
+  // Moves the pages of r to a node of the partition.
+  [[nodiscard]] virtual MemoryModifyStatus MoveToLocal(Range r) = 0;
+};
+
 // Track the extreme values of a HugeLength value over the past
 // kWindow (time ranges approximate.)
 template <size_t kSlots = 16>
@@ -147,11 +160,15 @@ class HugeCache {
   // capture the empirical dynamics we've seen.  See "Beyond Malloc
   // Efficiency..." (https://research.google/pubs/pub50370/) for more
   // information.
+  //
+  // tag only labels the limit changes reported to the page heap tracer.
   HugeCache(HugeAllocator& allocator ABSL_ATTRIBUTE_LIFETIME_BOUND,
             MetadataAllocator& meta_allocate ABSL_ATTRIBUTE_LIFETIME_BOUND,
             MemoryModifyFunction& unback ABSL_ATTRIBUTE_LIFETIME_BOUND,
-            absl::Duration cache_time, Clock clock)
+            absl::Duration cache_time, Clock clock,
+            MemoryTag tag = MemoryTag::kNormal)
       : allocator_(&allocator),
+        granularity_(allocator.granularity()),
         cache_(meta_allocate),
         clock_(clock),
         cache_time_ticks_(clock_.freq() * absl::ToDoubleSeconds(cache_time)),
@@ -163,22 +180,33 @@ class HugeCache {
         off_peak_tracker_(clock, cache_time * 2),
         size_tracker_(clock, cache_time * 2),
         unback_(unback),
-        cache_time_(cache_time) {}
+        cache_time_(cache_time),
+        tag_(tag) {}
   // Allocate a usable set of <n> contiguous hugepages.  Try to give out
   // memory that's currently backed from the kernel if we have it available.
   // *from_released is set to false if the return range is already backed;
   // otherwise, it is set to true (and the caller should back it.)
   HugeRange Get(HugeLength n, bool* absl_nonnull from_released);
 
+  // As Get, but for the specific range <r>, which must be entirely cached or
+  // entirely unused in the underlying allocator.  Returns false otherwise.
+  // When working in granules, <r> must be entirely cached.
+  bool MaybeGetAt(HugeRange r, bool* absl_nonnull from_released);
+
   // Deallocate <r> (assumed to be backed by the kernel.)
   void Release(HugeRange r);
 
-  // As Release, but the range is assumed to _not_ be backed.
+  // As Release, but the range is assumed to _not_ be backed.  When working in
+  // granules, it is cached anyway until its granule can be released whole.
   void ReleaseUnbacked(HugeRange r);
 
   // Release to the system up to <n> hugepages of cache contents; returns
   // the number of hugepages released. It also triggers cache shrinking if
   // the cache becomes too big.
+  //
+  // If the allocator hands out memory in granules of more than one hugepage
+  // (e.g. 1GiB pages), only whole, aligned granules are released, and this
+  // may release up to a granule more than <n>.
   HugeLength ReleaseCachedPages(HugeLength n);
 
   // Backed memory available.
@@ -187,6 +215,9 @@ class HugeCache {
   HugeLength limit() const { return limit_; }
   // Sum total of unreleased requests.
   HugeLength usage() const { return usage_; }
+  // Number of aligned granules (see HugeAllocator) that are entirely cached,
+  // and so could be released whole.
+  size_t empty_granules() const;
 
   void AddSpanStats(SmallSpanStats* small, LargeSpanStats* large) const;
 
@@ -208,6 +239,9 @@ class HugeCache {
 
  private:
   HugeAllocator* allocator_;
+  // Unit in which allocator_ obtains memory from the system, and in which we
+  // release it.
+  const HugeLength granularity_;
 
   // We just cache-missed a request for <missed> pages;
   // should we grow?
@@ -217,12 +251,17 @@ class HugeCache {
   HugeLength MaybeShrinkCacheLimit();
 
   // Ensure the cache contains at most <target> hugepages,
-  // returning the number removed.
-  HugeLength ShrinkCache(HugeLength target);
+  // returning the number removed.  When releasing whole granules, it may
+  // only go below <target> if <overshoot> is set.
+  HugeLength ShrinkCache(HugeLength target, bool overshoot = false);
+  HugeLength ShrinkCacheByGranule(HugeLength target, bool overshoot);
 
-  HugeRange DoGet(HugeLength n, bool* from_released);
+  // Returns the first aligned granule contained in <r>, if any.
+  HugeRange FirstGranule(HugeRange r) const;
 
-  HugeAddressMap::Node* Find(HugeLength n);
+  HugeRange DoGet(HugeLength n, bool* from_released);
+  // Handles a cache miss when the allocator works in granules.
+  HugeRange GetGranules(HugeLength n, bool* from_released);
 
   HugeAddressMap cache_;
   HugeLength size_{NHugePages(0)};
@@ -267,6 +306,7 @@ class HugeCache {
 
   MemoryModifyFunction& unback_;
   absl::Duration cache_time_;
+  const MemoryTag tag_;
 
   // Interval used for capping demand calculated for demand-based release:
   // making sure that it is not more than the maximum demand recorded in that
@@ -127,6 +127,42 @@ TEST_P(HugeCacheTest, Backing) {
   Release(r);
 }
 
+TEST_P(HugeCacheTest, MaybeGetAt) {
+  bool from;
+  const HugeRange r = cache_.Get(NHugePages(4), &from);
+  const HugeRange first = HugeRange::Make(r.start(), NHugePages(1));
+  const HugeRange middle =
+      HugeRange::Make(r.start() + NHugePages(1), NHugePages(2));
+  const HugeRange last =
+      HugeRange::Make(r.start() + NHugePages(3), NHugePages(1));
+  // Cache the middle, and return the last hugepage to the allocator.
+  Release(middle);
+  cache_.ReleaseUnbacked(last);
+  EXPECT_EQ(NHugePages(1), cache_.usage());
+
+  // In use.
+  EXPECT_FALSE(cache_.MaybeGetAt(first, &from));
+  // Partly cached, partly not.
+  EXPECT_FALSE(cache_.MaybeGetAt(
+      HugeRange::Make(r.start() + NHugePages(2), NHugePages(2)), &from));
+
+  const HugeRange cached =
+      HugeRange::Make(r.start() + NHugePages(1), NHugePages(1));
+  ASSERT_TRUE(cache_.MaybeGetAt(cached, &from));
+  EXPECT_FALSE(from);
+  EXPECT_EQ(NHugePages(1), cache_.size());
+
+  ASSERT_TRUE(cache_.MaybeGetAt(last, &from));
+  EXPECT_TRUE(from);
+  EXPECT_EQ(NHugePages(3), cache_.usage());
+  EXPECT_FALSE(cache_.MaybeGetAt(last, &from));
+
+  Release(first);
+  Release(cached);
+  Release(last);
+  EXPECT_EQ(NHugePages(0), cache_.usage());
+}
+
 TEST_P(HugeCacheTest, Release) {
   bool from;
   const HugeLength one = NHugePages(1);
@@ -587,6 +623,76 @@ TEST_P(HugeCacheTest, Contains) {
 INSTANTIATE_TEST_SUITE_P(All, HugeCacheTest,
                          testing::Values(absl::Seconds(1), absl::Seconds(30)));
 
+class HugeCacheGigaPageTest : public testing::Test {
+ protected:
+  class CountingUnback final : public MemoryModifyFunction {
+   public:
+    MemoryModifyStatus operator()(Range r) override {
+      unbacked_ += r.n;
+      return {.success = true, .error_number = 0};
+    }
+
+    Length unbacked_ = Length(0);
+  };
+
+  static int64_t FakeClock() { return 1234; }
+  static double GetFakeClockFrequency() {
+    return absl::ToDoubleNanoseconds(absl::Seconds(2));
+  }
+
+  HugeCacheGigaPageTest() { vm_allocator_.backing_.resize(1024); }
+
+  FakeVirtualAllocator vm_allocator_;
+  FakeMetadataAllocator metadata_allocator_;
+  CountingUnback unback_;
+  HugeAllocator alloc_{vm_allocator_, metadata_allocator_,
+                       kHugePagesPerGigaPage};
+  HugeCache cache_{alloc_, metadata_allocator_, unback_, absl::Seconds(1),
+                   Clock{.now = FakeClock, .freq = GetFakeClockFrequency}};
+};
+
+TEST_F(HugeCacheGigaPageTest, ReleasesWholeGigaPages) {
+  constexpr HugeLength kGiga = kHugePagesPerGigaPage;
+  bool from;
+  HugeRange r1 = cache_.Get(NHugePages(1), &from);
+  ASSERT_TRUE(r1.valid());
+  EXPECT_TRUE(from);
+  EXPECT_EQ(r1.start().index() % kGiga.raw_num(), 0);
+  EXPECT_EQ(alloc_.system(), kGiga);
+
+  // The rest of the 1GiB page is cached, and serves later requests.
+  EXPECT_EQ(cache_.size(), kGiga - NHugePages(1));
+  HugeRange r2 = cache_.Get(NHugePages(1), &from);
+  ASSERT_TRUE(r2.valid());
+  EXPECT_FALSE(from);
+  EXPECT_EQ(alloc_.system(), kGiga);
+  EXPECT_EQ(cache_.empty_granules(), 0);
+
+  // Nothing can be released while part of the 1GiB page is in use.
+  EXPECT_EQ(cache_.ReleaseCachedPages(NHugePages(1)), NHugePages(0));
+  EXPECT_EQ(unback_.unbacked_, Length(0));
+
+  cache_.Release(r1);
+  EXPECT_EQ(cache_.empty_granules(), 0);
+  // Unbacked hugepages stay in the cache until their 1GiB page is released.
+  cache_.ReleaseUnbacked(r2);
+  EXPECT_EQ(cache_.size(), kGiga);
+  EXPECT_EQ(cache_.empty_granules(), 1);
+
+  // Releasing any amount releases the whole 1GiB page.
+  EXPECT_EQ(cache_.ReleaseCachedPages(NHugePages(1)), kGiga);
+  EXPECT_EQ(unback_.unbacked_, kGiga.in_pages());
+  EXPECT_EQ(cache_.size(), NHugePages(0));
+  EXPECT_EQ(alloc_.size(), kGiga);
+
+  // And it can be reused from the allocator.
+  HugeRange r3 = cache_.Get(NHugePages(3), &from);
+  ASSERT_TRUE(r3.valid());
+  EXPECT_TRUE(from);
+  EXPECT_EQ(alloc_.system(), kGiga);
+  EXPECT_EQ(cache_.size(), kGiga - NHugePages(3));
+}
+
 }  // namespace
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
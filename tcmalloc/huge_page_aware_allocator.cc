@@ -19,6 +19,7 @@
 
 #include "absl/base/attributes.h"
 #include "absl/base/nullability.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/string_view.h"
 #include "tcmalloc/arena.h"
 #include "tcmalloc/error_reporting.h"
@@ -110,6 +111,32 @@ HugeRegionUsageOption huge_region_option() {
              : HugeRegionUsageOption::kDefault;
 }
 
+bool use_gigapages() {
+  const char* e = thread_safe_getenv("TCMALLOC_GIGAPAGES");
+  if (e) {
+    switch (e[0]) {
+      case '0':
+        return false;
+      case '1':
+        return true;
+      default:
+        TC_BUG("bad env var '%s'", e);
+    }
+  }
+
+  return false;
+}
+
+size_t vma_budget() {
+  const char* e = thread_safe_getenv("TCMALLOC_VMA_BUDGET");
+  if (e == nullptr) return 0;
+  size_t budget;
+  if (!absl::SimpleAtoi(e, &budget)) {
+    TC_BUG("bad env var '%s'", e);
+  }
+  return budget;
+}
+
 Arena& StaticForwarder::arena() { return tc_globals.arena(); }
 
 void* StaticForwarder::GetHugepage(HugePage p) {
@@ -126,6 +153,10 @@ void StaticForwarder::SetSpan(PageId page, Span* absl_nonnull span) {
   tc_globals.pagemap().Set(page, span);
 }
 
+void StaticForwarder::SetCompactLargeSpan(Range r, bool donated) {
+  tc_globals.pagemap().SetCompactLargeSpan(r.p, {r.n, donated});
+}
+
 void StaticForwarder::SetHugepage(HugePage p, void* pt) {
   tc_globals.pagemap().SetHugepage(p.first_page(), pt);
 }
@@ -168,6 +199,22 @@ void StaticForwarder::SetAnonVmaName(Range r,
                                                name);
 }
 
+bool StaticForwarder::numa_aware() {
+  return tc_globals.numa_topology().numa_aware();
+}
+
+std::optional<bool> StaticForwarder::IsOnPartitionNodes(Range r,
+                                                        size_t partition) {
+  return tc_globals.system_allocator().IsOnPartitionNodes(r.start_addr(),
+                                                          partition);
+}
+
+MemoryModifyStatus StaticForwarder::MoveToPartition(Range r,
+                                                    size_t partition) {
+  return tc_globals.system_allocator().MoveToPartition(r.start_addr(),
+                                                       r.in_bytes(), partition);
+}
+
 }  // namespace huge_page_allocator_internal
 
 }  // namespace tcmalloc_internal
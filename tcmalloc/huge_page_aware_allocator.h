@@ -23,7 +23,6 @@
 #include <optional>
 
 #include "absl/base/attributes.h"
-#include "absl/base/internal/cycleclock.h"
 #include "absl/base/optimization.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
@@ -37,9 +36,11 @@
 #include "tcmalloc/huge_pages.h"
 #include "tcmalloc/huge_region.h"
 #include "tcmalloc/internal/allocation_guard.h"
+#include "tcmalloc/internal/clock.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/logging.h"
 #include "tcmalloc/internal/metadata_allocator.h"
+#include "tcmalloc/internal/page_heap_tracer.h"
 #include "tcmalloc/internal/pageflags.h"
 #include "tcmalloc/internal/parameter_accessors.h"
 #include "tcmalloc/internal/prefetch.h"
@@ -60,6 +61,8 @@ bool decide_subrelease();
 
 HugeRegionUsageOption huge_region_option();
 bool use_huge_region_more_often();
+bool use_gigapages();
+size_t vma_budget();
 
 class StaticForwarder {
  public:
@@ -79,6 +82,10 @@ class StaticForwarder {
     return Parameters::subrelease_unbacked_hugepages();
   }
 
+  static SeparateSpanLifetimes filler_separate_span_lifetimes() {
+    return Parameters::filler_separate_span_lifetimes();
+  }
+
   static bool hpaa_subrelease() { return Parameters::hpaa_subrelease(); }
 
   static EnableUnfilteredCollapse enable_unfiltered_collapse() {
@@ -89,6 +96,10 @@ class StaticForwarder {
     return Parameters::huge_region_adaptive_release();
   }
 
+  static HugeRegionPreferBacked huge_region_prefer_backed() {
+    return Parameters::huge_region_prefer_backed();
+  }
+
   static bool release_max_cold_pages() {
     return Parameters::release_max_cold_pages();
   }
@@ -101,6 +112,15 @@ class StaticForwarder {
     return Parameters::madvise_cold_regions_nohugepage();
   }
 
+  static MigrateRemoteHugepages numa_migrate_remote_hugepages() {
+    return Parameters::numa_migrate_remote_hugepages()
+               ? MigrateRemoteHugepages::kEnabled
+               : MigrateRemoteHugepages::kDisabled;
+  }
+
+  // NUMA state.
+  static bool numa_aware();
+
   // Arena state.
   static Arena& arena();
 
@@ -118,6 +138,7 @@ class StaticForwarder {
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
   static void ClearSpan(PageId page);
   static void SetSpan(PageId page, Span* absl_nonnull span);
+  static void SetCompactLargeSpan(Range r, bool donated);
   static void SetHugepage(HugePage p, void* pt);
 
   // SpanAllocator state.
@@ -150,11 +171,25 @@ class StaticForwarder {
   [[nodiscard]] static MemoryModifyStatus ReleasePages(Range r);
   [[nodiscard]] static MemoryModifyStatus CollapsePages(Range r);
   static void SetAnonVmaName(Range r, std::optional<absl::string_view> name);
+  static std::optional<bool> IsOnPartitionNodes(Range r, size_t partition);
+  [[nodiscard]] static MemoryModifyStatus MoveToPartition(Range r,
+                                                          size_t partition);
 };
 
 struct HugePageAwareAllocatorOptions {
   MemoryTag tag;
   HugeRegionUsageOption use_huge_region_more_often = huge_region_option();
+  // Obtain memory from the system in aligned 1GiB units, and only release
+  // whole 1GiB pages, from the HugeCache.  Subrelease from the filler and
+  // release from HugeRegions are disabled.  Pair this with a 1GiB hugetlb
+  // region factory (see memfs_malloc.h).
+  bool use_gigapages = huge_page_allocator_internal::use_gigapages();
+  // If nonzero, the number of mappings HugeAllocator aims to stay within by
+  // growing its requests to the system (see HugeAllocator).
+  size_t vma_budget = huge_page_allocator_internal::vma_budget();
+  // Time source for the filler's and the cache's demand history and for
+  // hugepage allocation times.  Overridable for offline simulation.
+  Clock clock;
 };
 
 // An implementation of the PageAllocator interface that is hugepage-efficient.
@@ -189,6 +224,15 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
                                  SpanAllocInfo span_alloc_info)
       ABSL_LOCKS_EXCLUDED(pageheap_lock) override;
 
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  // As NewAligned, but rather than creating a Span, records the allocation in
+  // the pagemap as a CompactLargeSpan.  Returns an empty AllocationState if
+  // out of memory.
+  AllocationState NewLarge(Length n, Length align,
+                           SpanAllocInfo span_alloc_info)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) override;
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+
   // Delete the span "[p, p+n-1]".
   // REQUIRES: span was returned by earlier call to New() and
   //           has not yet been deleted.
@@ -200,6 +244,22 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
   void Delete(AllocationState s, SpanAllocInfo span_alloc_info)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
 
+  // Extend "s" in place to "n" pages, if the pages following it are free.
+  bool TryGrow(AllocationState& s, Length n, SpanAllocInfo span_alloc_info)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) override;
+
+  bool ReserveMove(PageId p)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
+
+  void UnreserveMove(PageId p)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override {
+    alloc_.UnreserveMove();
+  }
+
+  void DeleteMoved(AllocationState s, Length unbacked,
+                   SpanAllocInfo span_alloc_info)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
+
   BackingStats stats() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
 
@@ -225,6 +285,12 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
   PageReleaseStats GetReleaseStats() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
 
+  NumaPlacementStats GetNumaPlacementStats() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
+
+  Length GetRecentDemand()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override;
+
   void TreatHugepageTrackers(EnableCollapse enable_collapse)
       ABSL_LOCKS_EXCLUDED(pageheap_lock) override;
 
@@ -254,6 +320,12 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
     return cache_.stats();
   }
 
+  // Fraction of the filler's used pages that are on intact hugepages.
+  double FillerHugePageFrac() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
+    return filler_.hugepage_frac();
+  }
+
   HugeLength DonatedHugePages() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
     return donated_huge_pages_;
@@ -288,6 +360,27 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
  private:
   static constexpr Length kSmallAllocPages = kPagesPerHugePage / 2;
 
+  // Reports a range returned to the OS to the page heap tracer, as a
+  // subrelease if it covers less than a hugepage.
+  void TraceRelease(Range r) const {
+    page_heap_tracer.Record(r.n < kPagesPerHugePage
+                                ? PageHeapEventType::kSubrelease
+                                : PageHeapEventType::kHugePageRelease,
+                            tag_, r.p.start_uintptr(), r.in_bytes());
+  }
+
+  // Whether r may be returned to the OS.  When working in 1GiB pages, only
+  // whole, aligned ones may be: part of a 1GiB page cannot be released on its
+  // own, and counting it as released would overstate what the OS got back.
+  bool CanRelease(Range r) const {
+    const size_t granule = alloc_.granularity().in_pages().raw_num();
+    return r.p.index() % granule == 0 && r.n.raw_num() % granule == 0;
+  }
+
+  // Whether memory is managed in units larger than a hugepage, such that only
+  // the HugeCache, which holds whole units, may release it.
+  bool uses_gigapages() const { return alloc_.granularity() > NHugePages(1); }
+
   class Unback final : public MemoryModifyFunction {
    public:
     explicit Unback(HugePageAwareAllocator& hpaa ABSL_ATTRIBUTE_LIFETIME_BOUND)
@@ -301,7 +394,10 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
 #ifndef NDEBUG
       pageheap_lock.AssertHeld();
 #endif  // NDEBUG
-      return hpaa_.forwarder_.ReleasePages(r);
+      if (!hpaa_.CanRelease(r)) return {false, 0};
+      MemoryModifyStatus ret = hpaa_.forwarder_.ReleasePages(r);
+      if (ret.success) hpaa_.TraceRelease(r);
+      return ret;
     }
 
    public:
@@ -322,8 +418,10 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
 #ifndef NDEBUG
       pageheap_lock.AssertHeld();
 #endif  // NDEBUG
+      if (!hpaa_.CanRelease(r)) return {false, 0};
       pageheap_lock.unlock();
       MemoryModifyStatus ret = hpaa_.forwarder_.ReleasePages(r);
+      if (ret.success) hpaa_.TraceRelease(r);
       pageheap_lock.lock();
       return ret;
     }
@@ -343,6 +441,10 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
 
     [[nodiscard]] MemoryModifyStatus operator()(Range r) override {
       MemoryModifyStatus ret = hpaa_.forwarder_.CollapsePages(r);
+      if (ret.success) {
+        page_heap_tracer.Record(PageHeapEventType::kCollapse, hpaa_.tag_,
+                                r.p.start_uintptr(), r.in_bytes());
+      }
       return ret;
     }
 
@@ -367,12 +469,38 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
     HugePageAwareAllocator& hpaa_;
   };
 
+  // Places memory on the NUMA nodes of the partition this allocator serves.
+  class NumaPlacement final : public NumaPlacementFunction {
+   public:
+    explicit NumaPlacement(
+        HugePageAwareAllocator& hpaa ABSL_ATTRIBUTE_LIFETIME_BOUND)
+        : hpaa_(hpaa) {}
+    ~NumaPlacement() override = default;
+
+    static void operator delete(void*) { __builtin_trap(); }
+
+    std::optional<bool> IsLocal(Range r) override {
+      return hpaa_.forwarder_.IsOnPartitionNodes(r, partition());
+    }
+
+    [[nodiscard]] MemoryModifyStatus MoveToLocal(Range r) override {
+      return hpaa_.forwarder_.MoveToPartition(r, partition());
+    }
+
+   private:
+    size_t partition() const { return NormalTagPartition(hpaa_.tag_); }
+
+    HugePageAwareAllocator& hpaa_;
+  };
+
   ABSL_ATTRIBUTE_NO_UNIQUE_ADDRESS Forwarder forwarder_;
+  const Clock clock_;
 
   Unback unback_ ABSL_GUARDED_BY(pageheap_lock);
   UnbackWithoutLock unback_without_lock_ ABSL_GUARDED_BY(pageheap_lock);
   Collapse collapse_;
   SetAnonVmaName set_anon_vma_name_;
+  NumaPlacement numa_placement_;
 
   typedef HugePageFiller<PageTracker> FillerType;
   FillerType filler_ ABSL_GUARDED_BY(pageheap_lock);
@@ -463,6 +591,11 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
   using FinalizeType = AllocationState;
 #endif  // !TCMALLOC_INTERNAL_LEGACY_LOCKING
 
+  // Allocates n pages aligned to <align> pages and backs them if needed.
+  FinalizeType AllocAligned(Length n, Length align,
+                            SpanAllocInfo span_alloc_info)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
   FinalizeType LockAndAlloc(Length n, SpanAllocInfo span_alloc_info,
                             bool* from_released);
 
@@ -482,6 +615,17 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
 
   bool AddRegion() ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
+  // Helper for TryGrow().
+  bool LockedTryGrow(AllocationState& s, Length n,
+                     SpanAllocInfo span_alloc_info, bool* from_released)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
+  // Helper for Delete() and DeleteMoved(): the first <unbacked> hugepages of
+  // s are returned to the cache as released.
+  void LockedDelete(AllocationState s, HugeLength unbacked,
+                    SpanAllocInfo span_alloc_info)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
   void ReleaseHugepage(FillerType::Tracker* pt)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
   // Return an allocation from a single hugepage.
@@ -499,6 +643,7 @@ class HugePageAwareAllocator final : public PageAllocatorInterface {
 
   // Whether this HPAA should use subrelease. This delegates to the appropriate
   // parameter depending whether this is for the cold heap or another heap.
+  // Subrelease is always off when working in 1GiB pages.
   bool hpaa_subrelease() const;
 };
 
@@ -506,20 +651,26 @@ template <class Forwarder>
 inline HugePageAwareAllocator<Forwarder>::HugePageAwareAllocator(
     const HugePageAwareAllocatorOptions& options)
     : PageAllocatorInterface("HugePageAware", options.tag),
+      clock_(options.clock),
       unback_(*this),
       unback_without_lock_(*this),
       collapse_(*this),
       set_anon_vma_name_(*this),
-      filler_(tag_, unback_, unback_without_lock_, collapse_,
-              set_anon_vma_name_, forwarder_.subrelease_unbacked_hugepages()),
-      regions_(options.use_huge_region_more_often),
+      numa_placement_(*this),
+      filler_(clock_, tag_, unback_, unback_without_lock_, collapse_,
+              set_anon_vma_name_, forwarder_.subrelease_unbacked_hugepages(),
+              forwarder_.filler_separate_span_lifetimes()),
+      regions_(options.use_huge_region_more_often,
+               forwarder_.huge_region_prefer_backed()),
       tracker_allocator_(forwarder_.arena()),
       region_allocator_(forwarder_.arena()),
       vm_allocator_(*this),
       metadata_allocator_(*this),
-      alloc_(vm_allocator_, metadata_allocator_),
+      alloc_(vm_allocator_, metadata_allocator_,
+             options.use_gigapages ? kHugePagesPerGigaPage : NHugePages(1),
+             options.vma_budget),
       cache_(HugeCache{alloc_, metadata_allocator_, unback_without_lock_,
-                       absl::Seconds(1)}) {}
+                       absl::Seconds(1), clock_, tag_}) {}
 
 template <class Forwarder>
 inline typename HugePageAwareAllocator<Forwarder>::FillerType::Tracker*
@@ -540,8 +691,7 @@ template <class Forwarder>
 inline PageId HugePageAwareAllocator<Forwarder>::AllocAndContribute(
     HugePage p, Length n, SpanAllocInfo span_alloc_info, bool donated) {
   TC_CHECK_NE(p.start_addr(), nullptr);
-  FillerType::Tracker* pt = tracker_allocator_.New(
-      p, donated, absl::base_internal::CycleClock::Now());
+  FillerType::Tracker* pt = tracker_allocator_.New(p, donated, clock_.now());
   TC_ASSERT_GE(pt->longest_free_range(), n);
   TC_ASSERT_EQ(pt->was_donated(), donated);
   // if the page was donated, we track its size so that we can potentially
@@ -728,9 +878,26 @@ HugePageAwareAllocator<Forwarder>::AllocRawHugepages(
 template <class Forwarder>
 inline Span* HugePageAwareAllocator<Forwarder>::New(
     Length n, SpanAllocInfo span_alloc_info) {
+  Span* s = Spanify(AllocAligned(n, Length(1), span_alloc_info));
+  TC_ASSERT(!s || GetMemoryTag(s->start_address()) == tag_);
+  return s;
+}
+
+template <class Forwarder>
+inline typename HugePageAwareAllocator<Forwarder>::FinalizeType
+HugePageAwareAllocator<Forwarder>::AllocAligned(Length n, Length align,
+                                                SpanAllocInfo span_alloc_info) {
   TC_CHECK_GT(n, Length(0));
   bool from_released;
-  FinalizeType f = LockAndAlloc(n, span_alloc_info, &from_released);
+  FinalizeType f;
+  if (align <= Length(1)) {
+    f = LockAndAlloc(n, span_alloc_info, &from_released);
+  } else {
+    // we can do better than this, but...
+    TC_CHECK_LE(align, kPagesPerHugePage);
+    PageHeapSpinLockHolder l;
+    f = AllocRawHugepages(n, span_alloc_info, &from_released);
+  }
   if (f) {
     Range r = Unspanify(f);
     // Prefetch for writing, as we anticipate using the memory soon.
@@ -739,9 +906,7 @@ inline Span* HugePageAwareAllocator<Forwarder>::New(
       forwarder_.Back(r);
     }
   }
-  Span* s = Spanify(f);
-  TC_ASSERT(!s || GetMemoryTag(s->start_address()) == tag_);
-  return s;
+  return f;
 }
 
 template <class Forwarder>
@@ -771,31 +936,25 @@ HugePageAwareAllocator<Forwarder>::LockAndAlloc(Length n,
 template <class Forwarder>
 inline Span* HugePageAwareAllocator<Forwarder>::NewAligned(
     Length n, Length align, SpanAllocInfo span_alloc_info) {
-  if (align <= Length(1)) {
-    return New(n, span_alloc_info);
-  }
+  Span* s = Spanify(AllocAligned(n, align, span_alloc_info));
+  TC_ASSERT(!s || GetMemoryTag(s->start_address()) == tag_);
+  return s;
+}
 
-  // we can do better than this, but...
-  TC_CHECK_LE(align, kPagesPerHugePage);
-  bool from_released;
-  FinalizeType f;
-  {
-    PageHeapSpinLockHolder l;
-    f = AllocRawHugepages(n, span_alloc_info, &from_released);
-  }
-  if (f && from_released) {
-    Range r = Unspanify(f);
-    // Prefetch for writing, as we anticipate using the memory soon.
-    PrefetchW(r.p.start_addr());
-    if (ShouldBack(r)) {
-      forwarder_.Back(r);
-    }
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+// public
+template <class Forwarder>
+inline PageAllocatorInterface::AllocationState
+HugePageAwareAllocator<Forwarder>::NewLarge(Length n, Length align,
+                                            SpanAllocInfo span_alloc_info) {
+  AllocationState s = AllocAligned(n, align, span_alloc_info);
+  if (s) {
+    TC_ASSERT(GetMemoryTag(s.r.p.start_addr()) == tag_);
+    forwarder_.SetCompactLargeSpan(s.r, s.donated);
   }
-
-  Span* s = Spanify(f);
-  TC_ASSERT(!s || GetMemoryTag(s->start_address()) == tag_);
   return s;
 }
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
 
 template <class Forwarder>
 inline Span* HugePageAwareAllocator<Forwarder>::Spanify(FinalizeType f) {
@@ -864,7 +1023,8 @@ inline bool HugePageAwareAllocator<Forwarder>::AddRegion() {
     } while (madvise_failed && errno == EAGAIN);
   }
 
-  HugeRegion* region = region_allocator_.New(r, unback_, set_anon_vma_name_);
+  HugeRegion* region =
+      region_allocator_.New(r, unback_, set_anon_vma_name_, clock_);
   regions_.Contribute(region);
   return true;
 }
@@ -887,6 +1047,32 @@ inline void HugePageAwareAllocator<Forwarder>::Delete(
 template <class Forwarder>
 inline void HugePageAwareAllocator<Forwarder>::Delete(
     AllocationState s, SpanAllocInfo span_alloc_info) {
+  LockedDelete(s, NHugePages(0), span_alloc_info);
+}
+
+// public
+template <class Forwarder>
+inline bool HugePageAwareAllocator<Forwarder>::ReserveMove(PageId p) {
+  // Only allocations straight from the HugeCache own their hugepages outright
+  // (see Delete).  Filler hugepages are shared, and regions name their
+  // mapping apart from the rest of the heap.
+  if (GetTracker(HugePageContaining(p)) != nullptr || regions_.Contains(p)) {
+    return false;
+  }
+  return alloc_.ReserveMove();
+}
+
+// public
+template <class Forwarder>
+inline void HugePageAwareAllocator<Forwarder>::DeleteMoved(
+    AllocationState s, Length unbacked, SpanAllocInfo span_alloc_info) {
+  TC_ASSERT_EQ(unbacked % kPagesPerHugePage, Length(0));
+  LockedDelete(s, HLFromPages(unbacked), span_alloc_info);
+}
+
+template <class Forwarder>
+inline void HugePageAwareAllocator<Forwarder>::LockedDelete(
+    AllocationState s, HugeLength unbacked, SpanAllocInfo span_alloc_info) {
   const PageId p = s.r.p;
   const HugePage hp = HugePageContaining(p);
   const Length n = s.r.n;
@@ -905,13 +1091,17 @@ inline void HugePageAwareAllocator<Forwarder>::Delete(
   //    allocation to that hugepage in the filler.
   if (ABSL_PREDICT_TRUE(pt != nullptr)) {
     TC_ASSERT_EQ(hp, HugePageContaining(p + n - Length(1)));
+    TC_ASSERT_EQ(unbacked, NHugePages(0));
     DeleteFromHugepage(pt, Range(p, n), might_abandon, span_alloc_info);
     return;
   }
 
   // b) We got put into a region, possibly crossing hugepages -
   //    return our allocation to the region.
-  if (regions_.MaybePut(Range(p, n))) return;
+  if (regions_.MaybePut(Range(p, n))) {
+    TC_ASSERT_EQ(unbacked, NHugePages(0));
+    return;
+  }
 
   // c) we came straight from the HugeCache - return straight there.  (We
   //    might have had slack put into the filler - if so, return that virtual
@@ -962,7 +1152,79 @@ inline void HugePageAwareAllocator<Forwarder>::Delete(
       }
     }
   }
-  cache_.Release({hp, hl});
+  // Moved hugepages are whole ones of ours, so they never include the slack
+  // hugepage handled above.
+  TC_ASSERT_LE(unbacked, hl);
+  if (unbacked > NHugePages(0)) {
+    cache_.ReleaseUnbacked({hp, unbacked});
+  }
+  if (hl > unbacked) {
+    cache_.Release({hp + unbacked, hl - unbacked});
+  }
+}
+
+// public
+template <class Forwarder>
+inline bool HugePageAwareAllocator<Forwarder>::TryGrow(
+    AllocationState& s, Length n, SpanAllocInfo span_alloc_info) {
+  TC_ASSERT_GT(n, s.r.n);
+  const Range added(s.r.p + s.r.n, n - s.r.n);
+  bool from_released = false;
+  {
+    PageHeapSpinLockHolder l;
+    if (!LockedTryGrow(s, n, span_alloc_info, &from_released)) return false;
+  }
+  if (from_released && ShouldBack(added)) {
+    forwarder_.Back(added);
+  }
+  return true;
+}
+
+template <class Forwarder>
+inline bool HugePageAwareAllocator<Forwarder>::LockedTryGrow(
+    AllocationState& s, Length n, SpanAllocInfo span_alloc_info,
+    bool* from_released) {
+  const HugePage hp = HugePageContaining(s.r.p);
+  // Where did s come from?  (See Delete.)
+  //
+  // a) The filler packed it onto a single hugepage.  Anything grown past
+  //    kPagesPerHugePage would not fit, and smaller allocations are not worth
+  //    the bookkeeping.
+  if (GetTracker(hp) != nullptr) return false;
+
+  // b) A region: take the free pages that follow it, if any.
+  if (regions_.Contains(s.r.p)) {
+    if (!regions_.MaybeGrow(s.r, n - s.r.n, from_released)) return false;
+  } else {
+    // c) Straight from the HugeCache: take the hugepages that follow it.  We
+    //    don't try to move slack donated to the filler, which other
+    //    allocations may be using.
+    if (s.donated) return false;
+    const HugeLength hl = HLFromPages(s.r.n);
+    TC_ASSERT_EQ(hl.in_pages(), s.r.n);
+    const HugeLength new_hl = HLFromPages(n);
+    if (!cache_.MaybeGetAt(HugeRange::Make(hp + hl, new_hl - hl),
+                           from_released)) {
+      return false;
+    }
+
+    // As in AllocRawHugepages, donate any slack on the new last hugepage to
+    // the filler.
+    const Length slack = new_hl.in_pages() - n;
+    if (slack > Length(0)) {
+      ++donated_huge_pages_;
+      AllocAndContribute(hp + new_hl - NHugePages(1), kPagesPerHugePage - slack,
+                         span_alloc_info, /*donated=*/true);
+      s.donated = true;
+    }
+  }
+
+  const Length added = n - s.r.n;
+  info_.RecordFree(s.r);
+  s.r.n = n;
+  info_.RecordAlloc(s.r);
+  forwarder_.ShrinkToUsageLimit(added);
+  return true;
 }
 
 template <class Forwarder>
@@ -1046,16 +1308,17 @@ inline Length HugePageAwareAllocator<Forwarder>::ReleaseAtLeastNPages(
   Length released =
       cache_.ReleaseCachedPages(HLFromPages(num_pages)).in_pages();
 
-  // Release all backed-but-free hugepages from HugeRegion.
-  // TODO(b/199203282): We release all the free hugepages from HugeRegions when
-  // the experiment is enabled. We can also explore releasing only a desired
-  // number of pages.
-  if (regions_.UseHugeRegionMoreOften()) {
+  // Release backed-but-free hugepages from HugeRegion.
+  // TODO(b/199203282): Without adaptive release, we release a fraction of the
+  // free hugepages from HugeRegions when the experiment is enabled. We can also
+  // explore releasing only a desired number of pages.
+  if (regions_.UseHugeRegionMoreOften() && !uses_gigapages()) {
     Length from_huge_region =
         num_pages > released ? num_pages - released : Length(0);
-    released += regions_.ReleasePages(from_huge_region,
-                                      forwarder_.huge_region_adaptive_release(),
-                                      /*hit_limit=*/false);
+    released += regions_.ReleasePages(
+        from_huge_region, forwarder_.huge_region_adaptive_release(),
+        /*hit_limit=*/false,
+        forwarder_.filler_skip_subrelease_short_interval());
   }
 
   // This is our long term plan but in current state will lead to insufficient
@@ -1088,10 +1351,20 @@ inline void HugePageAwareAllocator<Forwarder>::TreatHugepageTrackers(
   const EnableUnfilteredCollapse enable_unfiltered_collapse =
       forwarder_.enable_unfiltered_collapse();
   const ReleaseStalePages release_stale_pages =
-      forwarder_.release_stale_pages();
+      uses_gigapages() ? ReleaseStalePages::kDisabled
+                       : forwarder_.release_stale_pages();
+  // Only the normal allocators are bound to the nodes of a NUMA partition.
+  NumaPlacementFunction* numa_placement = nullptr;
+  if (IsNormalTag(tag_) && forwarder_.numa_aware()) {
+    numa_placement = &numa_placement_;
+  }
+  const MigrateRemoteHugepages migrate_remote_hugepages =
+      forwarder_.numa_migrate_remote_hugepages();
   PageHeapSpinLockHolder l;
   filler_.TreatHugepageTrackers(enable_collapse, enable_unfiltered_collapse,
-                                release_stale_pages);
+                                release_stale_pages, /*pageflags=*/nullptr,
+                                /*residency=*/nullptr, numa_placement,
+                                migrate_remote_hugepages);
   FillerType::Tracker* pt;
   while ((pt = filler_.FetchFullyFreedTracker()) != nullptr) {
     ReleaseHugepage(pt);
@@ -1260,6 +1533,12 @@ HugePageAwareAllocator<Forwarder>::ReleaseAtLeastNPagesBreakingHugepages(
 
   released += cache_.ReleaseCachedPages(HLFromPages(n)).in_pages();
 
+  // Only the cache holds whole 1GiB pages.
+  if (uses_gigapages()) {
+    info_.RecordRelease(n, released, reason);
+    return released;
+  }
+
   // We try to release as many free hugepages from HugeRegion as possible.
   Length from_huge_region = n > released ? n - released : Length(0);
   released += regions_.ReleasePages(from_huge_region,
@@ -1285,6 +1564,26 @@ inline PageReleaseStats HugePageAwareAllocator<Forwarder>::GetReleaseStats()
   return info_.GetRecordedReleases();
 }
 
+template <class Forwarder>
+inline NumaPlacementStats
+HugePageAwareAllocator<Forwarder>::GetNumaPlacementStats() const {
+  return filler_.GetHugePageTreatmentStats().numa_placement;
+}
+
+template <class Forwarder>
+inline Length HugePageAwareAllocator<Forwarder>::GetRecentDemand() {
+  // Only the filler keeps a demand history.  Everything else is predicted to
+  // stay at its current usage.
+  const BackingStats s = stats();
+  const Length used =
+      BytesToLengthFloor(s.system_bytes - s.free_bytes - s.unmapped_bytes);
+  const Length filler_used = std::min(filler_.used_pages(), used);
+  const Length filler_demand = filler_.GetRecentDemand(SkipSubreleaseIntervals{
+      .short_interval = forwarder_.filler_skip_subrelease_short_interval(),
+      .long_interval = forwarder_.filler_skip_subrelease_long_interval()});
+  return used - filler_used + std::max(filler_demand, filler_used);
+}
+
 template <class Forwarder>
 bool HugePageAwareAllocator<Forwarder>::IsValidSizeClass(size_t size,
                                                          Length pages) {
@@ -1299,7 +1598,9 @@ bool HugePageAwareAllocator<Forwarder>::IsValidSizeClass(size_t size,
 
 template <class Forwarder>
 inline bool HugePageAwareAllocator<Forwarder>::hpaa_subrelease() const {
-  if (tag_ == MemoryTag::kCold) {
+  if (uses_gigapages()) {
+    return false;
+  } else if (tag_ == MemoryTag::kCold) {
     return true;
   } else {
     return forwarder_.hpaa_subrelease();
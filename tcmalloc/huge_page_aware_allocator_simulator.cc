@@ -0,0 +1,375 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/huge_page_aware_allocator_simulator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/base/internal/cycleclock.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "tcmalloc/common.h"
+#include "tcmalloc/huge_page_aware_allocator.h"
+#include "tcmalloc/huge_page_options.h"
+#include "tcmalloc/internal/clock.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/memory_tag.h"
+#include "tcmalloc/mock_huge_page_static_forwarder.h"
+#include "tcmalloc/page_allocator_interface.h"
+#include "tcmalloc/pages.h"
+#include "tcmalloc/span.h"
+#include "tcmalloc/stats.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+using huge_page_allocator_internal::FakeStaticForwarder;
+using huge_page_allocator_internal::HugePageAwareAllocator;
+using huge_page_allocator_internal::HugePageAwareAllocatorOptions;
+
+using SimulatedAllocator = HugePageAwareAllocator<FakeStaticForwarder>;
+
+// The simulated clock ticks in nanoseconds.
+ABSL_CONST_INIT int64_t simulated_time_ns = 0;
+
+int64_t SimulatedNow() { return simulated_time_ns; }
+double SimulatedFrequency() { return 1e9; }
+
+absl::Status ParseError(int line_number, absl::string_view line,
+                        absl::string_view what) {
+  return absl::InvalidArgumentError(
+      absl::StrFormat("line %d: %s: \"%s\"", line_number, what, line));
+}
+
+// Storage for a SimulatedAllocator, which is too large for the stack and
+// cannot be deleted.
+struct AllocatorStorage {
+  alignas(SimulatedAllocator) unsigned char buf[sizeof(SimulatedAllocator)];
+};
+
+class Simulation {
+ public:
+  explicit Simulation(const SimulatorOptions& options)
+      : options_(options), storage_(std::make_unique<AllocatorStorage>()) {
+    simulated_time_ns = 0;
+    allocator_ = new (storage_->buf) SimulatedAllocator(
+        HugePageAwareAllocatorOptions{
+            .tag = MemoryTag::kNormal,
+            .use_huge_region_more_often = options.use_huge_region_more_often,
+            .use_gigapages = false,
+            .clock = Clock{.now = SimulatedNow, .freq = SimulatedFrequency}});
+
+    FakeStaticForwarder& forwarder = allocator_->forwarder();
+    forwarder.set_filler_skip_subrelease_short_interval(
+        options.skip_subrelease_short_interval);
+    forwarder.set_filler_skip_subrelease_long_interval(
+        options.skip_subrelease_long_interval);
+    forwarder.set_release_partial_alloc_pages(
+        options.release_partial_alloc_pages);
+    forwarder.set_hpaa_subrelease(true);
+  }
+
+  ~Simulation() { allocator_->~SimulatedAllocator(); }
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  absl::Status Run(absl::Span<const TraceEvent> events) {
+    for (const TraceEvent& e : events) {
+      AdvanceTo(e.time);
+      absl::Status status =
+          e.type == TraceEvent::Type::kNew ? New(e) : Delete(e);
+      if (!status.ok()) return status;
+    }
+    if (!events.empty() &&
+        (samples_.empty() || samples_.back().time < events.back().time)) {
+      Sample();
+    }
+    return absl::OkStatus();
+  }
+
+  SimulatorResult Finish() {
+    SimulatorResult result;
+    result.samples = std::move(samples_);
+    PageHeapSpinLockHolder l;
+    result.release_stats = allocator_->GetReleaseStats();
+    return result;
+  }
+
+ private:
+  struct LiveSpan {
+    Span* span;
+    SpanAllocInfo span_alloc_info;
+  };
+
+  // Runs the background actions and takes the samples due before t, then sets
+  // the clock to t.
+  void AdvanceTo(absl::Duration t) {
+    while (next_release_ <= t || next_sample_ <= t) {
+      if (next_release_ <= next_sample_) {
+        SetTime(next_release_);
+        BackgroundActions();
+        next_release_ += options_.release_interval;
+      } else {
+        SetTime(next_sample_);
+        Sample();
+        next_sample_ += options_.sample_interval;
+      }
+    }
+    SetTime(t);
+  }
+
+  void SetTime(absl::Duration t) {
+    now_ = t;
+    simulated_time_ns = absl::ToInt64Nanoseconds(t);
+  }
+
+  absl::Status New(const TraceEvent& e) {
+    if (live_.contains(e.id)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("span ", e.id, " allocated twice"));
+    }
+    SpanAllocInfo info = e.span_alloc_info;
+    if (!options_.use_density_heuristic) {
+      info.density = AccessDensityPrediction::kSparse;
+    }
+
+    const int64_t start = absl::base_internal::CycleClock::Now();
+    Span* span = allocator_->New(e.pages, info);
+    lock_held_cycles_ += absl::base_internal::CycleClock::Now() - start;
+    if (span == nullptr) {
+      return absl::ResourceExhaustedError(
+          absl::StrCat("out of memory allocating span ", e.id));
+    }
+
+    live_.emplace(e.id, LiveSpan{span, info});
+    used_ += span->num_pages();
+    return absl::OkStatus();
+  }
+
+  absl::Status Delete(const TraceEvent& e) {
+    auto it = live_.find(e.id);
+    if (it == live_.end()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("span ", e.id, " deleted before it was allocated"));
+    }
+    Span* span = it->second.span;
+    const SpanAllocInfo info = it->second.span_alloc_info;
+    live_.erase(it);
+    used_ -= span->num_pages();
+
+    const int64_t start = absl::base_internal::CycleClock::Now();
+#ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
+    {
+      PageHeapSpinLockHolder l;
+      allocator_->Delete(span, info);
+    }
+#else
+    PageAllocatorInterface::AllocationState a{
+        Range(span->first_page(), span->num_pages()),
+        span->donated(),
+    };
+    allocator_->forwarder().DeleteSpan(span);
+    {
+      PageHeapSpinLockHolder l;
+      allocator_->Delete(a, info);
+    }
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+    lock_held_cycles_ += absl::base_internal::CycleClock::Now() - start;
+    return absl::OkStatus();
+  }
+
+  // Mirrors the background thread: treat the hugepage trackers, then release
+  // memory at the configured rate.
+  void BackgroundActions() {
+    const int64_t start = absl::base_internal::CycleClock::Now();
+    allocator_->TreatHugepageTrackers(EnableCollapse::kDisabled);
+    if (options_.release_rate > 0) {
+      const Length desired = BytesToLengthCeil(static_cast<size_t>(
+          options_.release_rate *
+          absl::ToDoubleSeconds(options_.release_interval)));
+      PageHeapSpinLockHolder l;
+      allocator_->ReleaseAtLeastNPages(
+          desired, PageReleaseReason::kProcessBackgroundActions);
+    }
+    lock_held_cycles_ += absl::base_internal::CycleClock::Now() - start;
+  }
+
+  void Sample() {
+    SimulatorSample s;
+    s.time = now_;
+    s.used_bytes = used_.in_bytes();
+    {
+      PageHeapSpinLockHolder l;
+      s.backing = allocator_->stats();
+      s.hugepage_coverage = allocator_->FillerHugePageFrac();
+      s.released_bytes = allocator_->GetReleaseStats().total.in_bytes();
+    }
+    const uint64_t backed = s.backing.system_bytes - s.backing.unmapped_bytes;
+    s.fragmentation =
+        backed > 0 ? static_cast<double>(s.backing.free_bytes) / backed : 0;
+    s.lock_held = absl::Seconds(lock_held_cycles_ /
+                                absl::base_internal::CycleClock::Frequency());
+    samples_.push_back(s);
+  }
+
+  const SimulatorOptions options_;
+  std::unique_ptr<AllocatorStorage> storage_;
+  SimulatedAllocator* allocator_;
+
+  absl::flat_hash_map<uint64_t, LiveSpan> live_;
+  Length used_;
+  int64_t lock_held_cycles_ = 0;
+
+  absl::Duration now_ = absl::ZeroDuration();
+  absl::Duration next_release_ = options_.release_interval;
+  absl::Duration next_sample_ = absl::ZeroDuration();
+  std::vector<SimulatorSample> samples_;
+};
+
+}  // namespace
+
+absl::StatusOr<std::vector<TraceEvent>> ParsePageHeapTrace(
+    absl::string_view trace) {
+  std::vector<TraceEvent> events;
+  int line_number = 0;
+  for (absl::string_view line : absl::StrSplit(trace, '\n')) {
+    ++line_number;
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || line[0] == '#') continue;
+
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    if (fields.size() < 3) {
+      return ParseError(line_number, line, "too few fields");
+    }
+
+    TraceEvent e{};
+    int64_t time_us;
+    if (!absl::SimpleAtoi(fields[0], &time_us) || time_us < 0) {
+      return ParseError(line_number, line, "bad timestamp");
+    }
+    e.time = absl::Microseconds(time_us);
+    if (!events.empty() && e.time < events.back().time) {
+      return ParseError(line_number, line, "timestamp goes backwards");
+    }
+    if (!absl::SimpleAtoi(fields[2], &e.id)) {
+      return ParseError(line_number, line, "bad span id");
+    }
+
+    if (fields[1] == "new") {
+      size_t pages, objects_per_span;
+      if (fields.size() != 6) {
+        return ParseError(line_number, line, "new takes 5 fields");
+      }
+      if (!absl::SimpleAtoi(fields[3], &pages) || pages == 0) {
+        return ParseError(line_number, line, "bad page count");
+      }
+      if (!absl::SimpleAtoi(fields[4], &objects_per_span) ||
+          objects_per_span == 0) {
+        return ParseError(line_number, line, "bad objects per span");
+      }
+      AccessDensityPrediction density;
+      if (fields[5] == "dense") {
+        // HugePageAwareAllocator only allocates single-page spans as dense.
+        if (pages != 1) {
+          return ParseError(line_number, line, "dense spans must be 1 page");
+        }
+        density = AccessDensityPrediction::kDense;
+      } else if (fields[5] == "sparse") {
+        density = AccessDensityPrediction::kSparse;
+      } else {
+        return ParseError(line_number, line, "density is not dense or sparse");
+      }
+      e.type = TraceEvent::Type::kNew;
+      e.pages = Length(pages);
+      e.span_alloc_info = {.objects_per_span = objects_per_span,
+                           .density = density};
+    } else if (fields[1] == "delete") {
+      if (fields.size() != 3) {
+        return ParseError(line_number, line, "delete takes 2 fields");
+      }
+      e.type = TraceEvent::Type::kDelete;
+    } else {
+      return ParseError(line_number, line, "unknown operation");
+    }
+    events.push_back(e);
+  }
+  return events;
+}
+
+absl::StatusOr<SimulatorResult> SimulateHugePageAwareAllocator(
+    const SimulatorOptions& options, absl::Span<const TraceEvent> events) {
+  if (options.release_interval <= absl::ZeroDuration() ||
+      options.sample_interval <= absl::ZeroDuration()) {
+    return absl::InvalidArgumentError(
+        "release and sample intervals must be positive");
+  }
+
+  Simulation simulation(options);
+  absl::Status status = simulation.Run(events);
+  if (!status.ok()) return status;
+  return simulation.Finish();
+}
+
+std::string FormatSimulatorOptions(const SimulatorOptions& options) {
+  return absl::StrFormat(
+      "skip_subrelease_short_interval=%s skip_subrelease_long_interval=%s "
+      "release_partial_alloc_pages=%d use_huge_region_more_often=%d "
+      "use_density_heuristic=%d release_rate=%u release_interval=%s",
+      absl::FormatDuration(options.skip_subrelease_short_interval),
+      absl::FormatDuration(options.skip_subrelease_long_interval),
+      options.release_partial_alloc_pages,
+      options.use_huge_region_more_often ==
+          HugeRegionUsageOption::kUseForAllLargeAllocs,
+      options.use_density_heuristic, options.release_rate,
+      absl::FormatDuration(options.release_interval));
+}
+
+std::string FormatSimulatorSamples(absl::Span<const SimulatorSample> samples) {
+  std::string out =
+      "time_s,used_bytes,system_bytes,free_bytes,unmapped_bytes,"
+      "hugepage_coverage,fragmentation,released_bytes,lock_held_us\n";
+  for (const SimulatorSample& s : samples) {
+    absl::StrAppendFormat(
+        &out, "%.3f,%u,%u,%u,%u,%.4f,%.4f,%u,%.1f\n",
+        absl::ToDoubleSeconds(s.time), s.used_bytes, s.backing.system_bytes,
+        s.backing.free_bytes, s.backing.unmapped_bytes, s.hugepage_coverage,
+        s.fragmentation, s.released_bytes,
+        absl::ToDoubleMicroseconds(s.lock_held));
+  }
+  return out;
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
@@ -0,0 +1,124 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_HUGE_PAGE_AWARE_ALLOCATOR_SIMULATOR_H_
+#define TCMALLOC_HUGE_PAGE_AWARE_ALLOCATOR_SIMULATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "tcmalloc/huge_region.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/pages.h"
+#include "tcmalloc/span.h"
+#include "tcmalloc/stats.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+// One page heap operation of a recorded trace.
+struct TraceEvent {
+  enum class Type { kNew, kDelete };
+
+  // Time since the start of the trace.  Events are ordered by time.
+  absl::Duration time;
+  Type type;
+  // Identifies the span.  A kDelete refers to the kNew with the same id.
+  uint64_t id;
+  // Only meaningful for kNew.
+  Length pages;
+  SpanAllocInfo span_alloc_info;
+};
+
+// Parses a page heap trace, one event per line:
+//
+//   <time_us> new <id> <pages> <objects_per_span> <dense|sparse>
+//   <time_us> delete <id>
+//
+// Blank lines and lines starting with '#' are ignored.  Timestamps are in
+// microseconds from the start of the trace and must not decrease.  Only
+// single-page spans may be dense.
+absl::StatusOr<std::vector<TraceEvent>> ParsePageHeapTrace(
+    absl::string_view trace);
+
+// The knobs a simulation varies.  The defaults match TCMalloc's defaults.
+struct SimulatorOptions {
+  absl::Duration skip_subrelease_short_interval = absl::Seconds(60);
+  absl::Duration skip_subrelease_long_interval = absl::Seconds(300);
+  bool release_partial_alloc_pages = false;
+  HugeRegionUsageOption use_huge_region_more_often =
+      HugeRegionUsageOption::kDefault;
+  // If false, every span is allocated as kSparse, as if the dense/sparse
+  // heuristic were disabled.
+  bool use_density_heuristic = true;
+
+  // Bytes released per second by the simulated background thread, which runs
+  // once every release_interval.  Zero disables background release.
+  size_t release_rate = 10 << 20;
+  absl::Duration release_interval = absl::Seconds(1);
+
+  // How often to take a SimulatorSample.
+  absl::Duration sample_interval = absl::Seconds(10);
+};
+
+// The page heap's state at a point of the simulation.
+struct SimulatorSample {
+  absl::Duration time;
+
+  // Bytes of live spans.
+  size_t used_bytes;
+  // Bytes obtained from the system, free but backed, and released.
+  BackingStats backing;
+  // Fraction of the filler's used pages on intact hugepages.
+  double hugepage_coverage;
+  // Fraction of the backed bytes that are free.
+  double fragmentation;
+  // Total bytes released to the system so far.
+  size_t released_bytes;
+  // Wall time spent so far in allocator calls that hold pageheap_lock, an
+  // upper bound on the time the lock was held.
+  absl::Duration lock_held;
+};
+
+struct SimulatorResult {
+  std::vector<SimulatorSample> samples;
+  PageReleaseStats release_stats;
+};
+
+// Replays events through a HugePageAwareAllocator backed by fake memory, with
+// its clock driven by the event timestamps.  Fails if an event refers to an
+// unknown span or reuses a live span's id.
+//
+// Not thread-safe: the simulated clock is shared by all simulations.
+absl::StatusOr<SimulatorResult> SimulateHugePageAwareAllocator(
+    const SimulatorOptions& options, absl::Span<const TraceEvent> events);
+
+// Formats the options as a single line of key=value pairs.
+std::string FormatSimulatorOptions(const SimulatorOptions& options);
+
+// Formats samples as CSV, with a header line.
+std::string FormatSimulatorSamples(absl::Span<const SimulatorSample> samples);
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_HUGE_PAGE_AWARE_ALLOCATOR_SIMULATOR_H_
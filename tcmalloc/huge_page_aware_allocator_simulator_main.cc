@@ -0,0 +1,172 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a page heap trace (see ParsePageHeapTrace) through the
+// HugePageAwareAllocator once for every combination of the list-valued flags,
+// and reports hugepage coverage, released memory, fragmentation and time spent
+// under pageheap_lock for each.  For example:
+//
+//   huge_page_aware_allocator_simulator --trace=heap.trace
+//       --short_intervals=0s,60s --density_heuristic=true,false
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/time/time.h"
+#include "tcmalloc/huge_page_aware_allocator_simulator.h"
+#include "tcmalloc/huge_region.h"
+
+ABSL_FLAG(std::string, trace, "", "Page heap trace to replay.");
+ABSL_FLAG(std::vector<std::string>, short_intervals, {"60s"},
+          "Skip-subrelease short intervals to simulate.");
+ABSL_FLAG(std::vector<std::string>, long_intervals, {"300s"},
+          "Skip-subrelease long intervals to simulate.");
+ABSL_FLAG(std::vector<std::string>, huge_region_more_often, {"false"},
+          "Values of use_huge_region_more_often to simulate.");
+ABSL_FLAG(std::vector<std::string>, density_heuristic, {"true"},
+          "Whether to keep the dense/sparse span heuristic, or to treat every "
+          "span as sparse.");
+ABSL_FLAG(size_t, release_rate, 10 << 20,
+          "Background release rate in bytes per second.");
+ABSL_FLAG(absl::Duration, release_interval, absl::Seconds(1),
+          "How often the simulated background thread runs.");
+ABSL_FLAG(absl::Duration, sample_interval, absl::Seconds(10),
+          "How often to sample the page heap.");
+ABSL_FLAG(bool, print_samples, false,
+          "Print every sample as CSV, not just a summary per configuration.");
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+bool ParseDurations(const std::vector<std::string>& in,
+                    std::vector<absl::Duration>* out) {
+  for (const std::string& s : in) {
+    absl::Duration d;
+    if (!absl::ParseDuration(s, &d)) return false;
+    out->push_back(d);
+  }
+  return !out->empty();
+}
+
+bool ParseBools(const std::vector<std::string>& in, std::vector<bool>* out) {
+  for (const std::string& s : in) {
+    bool b;
+    if (!absl::SimpleAtob(s, &b)) return false;
+    out->push_back(b);
+  }
+  return !out->empty();
+}
+
+void PrintSummary(const SimulatorResult& result) {
+  size_t peak_system = 0, peak_used = 0;
+  double coverage = 0, fragmentation = 0;
+  for (const SimulatorSample& s : result.samples) {
+    peak_system = std::max<size_t>(
+        peak_system, s.backing.system_bytes - s.backing.unmapped_bytes);
+    peak_used = std::max(peak_used, s.used_bytes);
+    coverage += s.hugepage_coverage;
+    fragmentation += s.fragmentation;
+  }
+  const size_t n = std::max<size_t>(result.samples.size(), 1);
+  const absl::Duration lock_held = result.samples.empty()
+                                       ? absl::ZeroDuration()
+                                       : result.samples.back().lock_held;
+  printf(
+      "  peak used %zu bytes, peak backed %zu bytes, released %zu bytes\n"
+      "  mean hugepage coverage %.4f, mean fragmentation %.4f\n"
+      "  time under pageheap_lock %s\n",
+      peak_used, peak_system, result.release_stats.total.in_bytes(),
+      coverage / n, fragmentation / n,
+      absl::FormatDuration(lock_held).c_str());
+}
+
+int Main() {
+  const std::string path = absl::GetFlag(FLAGS_trace);
+  std::ifstream file(path);
+  if (path.empty() || !file) {
+    fprintf(stderr, "Cannot read --trace=%s\n", path.c_str());
+    return 1;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  absl::StatusOr<std::vector<TraceEvent>> events =
+      ParsePageHeapTrace(contents.str());
+  if (!events.ok()) {
+    fprintf(stderr, "%s: %s\n", path.c_str(),
+            events.status().ToString().c_str());
+    return 1;
+  }
+
+  std::vector<absl::Duration> short_intervals, long_intervals;
+  std::vector<bool> huge_region_more_often, density_heuristic;
+  if (!ParseDurations(absl::GetFlag(FLAGS_short_intervals), &short_intervals) ||
+      !ParseDurations(absl::GetFlag(FLAGS_long_intervals), &long_intervals) ||
+      !ParseBools(absl::GetFlag(FLAGS_huge_region_more_often),
+                  &huge_region_more_often) ||
+      !ParseBools(absl::GetFlag(FLAGS_density_heuristic), &density_heuristic)) {
+    fprintf(stderr, "Bad knob list\n");
+    return 1;
+  }
+
+  SimulatorOptions options;
+  options.release_rate = absl::GetFlag(FLAGS_release_rate);
+  options.release_interval = absl::GetFlag(FLAGS_release_interval);
+  options.sample_interval = absl::GetFlag(FLAGS_sample_interval);
+  for (absl::Duration short_interval : short_intervals) {
+    for (absl::Duration long_interval : long_intervals) {
+      for (bool more_often : huge_region_more_often) {
+        for (bool density : density_heuristic) {
+          options.skip_subrelease_short_interval = short_interval;
+          options.skip_subrelease_long_interval = long_interval;
+          options.use_huge_region_more_often =
+              more_often ? HugeRegionUsageOption::kUseForAllLargeAllocs
+                         : HugeRegionUsageOption::kDefault;
+          options.use_density_heuristic = density;
+
+          absl::StatusOr<SimulatorResult> result =
+              SimulateHugePageAwareAllocator(options, *events);
+          printf("%s\n", FormatSimulatorOptions(options).c_str());
+          if (!result.ok()) {
+            fprintf(stderr, "%s\n", result.status().ToString().c_str());
+            return 1;
+          }
+          if (absl::GetFlag(FLAGS_print_samples)) {
+            printf("%s", FormatSimulatorSamples(result->samples).c_str());
+          }
+          PrintSummary(*result);
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  return tcmalloc::tcmalloc_internal::Main();
+}
@@ -0,0 +1,185 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/huge_page_aware_allocator_simulator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "tcmalloc/pages.h"
+#include "tcmalloc/span.h"
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+using testing::HasSubstr;
+
+// Demand that rises to `peak` spans of one to four pages and falls back to
+// zero, `cycles` times, one event per millisecond.
+std::string OscillatingTrace(int cycles, int peak) {
+  std::string trace;
+  int64_t time_us = 0;
+  uint64_t next_id = 0;
+  for (int c = 0; c < cycles; ++c) {
+    const uint64_t first = next_id;
+    for (int i = 0; i < peak; ++i, time_us += 1000) {
+      const bool dense = i % 3 == 0;
+      absl::StrAppend(&trace, time_us, " new ", next_id++, " ",
+                      dense ? 1 : 1 + i % 4, " ", dense ? 128 : 1,
+                      dense ? " dense\n" : " sparse\n");
+    }
+    // Free every other span first, so the filler is left fragmented.
+    for (int parity = 0; parity < 2; ++parity) {
+      for (uint64_t id = first + parity; id < next_id;
+           id += 2, time_us += 1000) {
+        absl::StrAppend(&trace, time_us, " delete ", id, "\n");
+      }
+    }
+  }
+  return trace;
+}
+
+TEST(HugePageAwareAllocatorSimulatorTest, ParsesTrace) {
+  absl::StatusOr<std::vector<TraceEvent>> events = ParsePageHeapTrace(
+      "# A comment.\n"
+      "0 new 1 2 1 sparse\n"
+      "\n"
+      "  1500 new 2 1 64 dense  \n"
+      "2000 delete 1\n");
+  ASSERT_TRUE(events.ok()) << events.status();
+  ASSERT_EQ(events->size(), 3);
+
+  EXPECT_EQ((*events)[0].type, TraceEvent::Type::kNew);
+  EXPECT_EQ((*events)[0].time, absl::ZeroDuration());
+  EXPECT_EQ((*events)[0].id, 1);
+  EXPECT_EQ((*events)[0].pages, Length(2));
+  EXPECT_EQ((*events)[0].span_alloc_info.objects_per_span, 1);
+  EXPECT_EQ((*events)[0].span_alloc_info.density,
+            AccessDensityPrediction::kSparse);
+
+  EXPECT_EQ((*events)[1].time, absl::Microseconds(1500));
+  EXPECT_EQ((*events)[1].span_alloc_info.objects_per_span, 64);
+  EXPECT_EQ((*events)[1].span_alloc_info.density,
+            AccessDensityPrediction::kDense);
+
+  EXPECT_EQ((*events)[2].type, TraceEvent::Type::kDelete);
+  EXPECT_EQ((*events)[2].time, absl::Milliseconds(2));
+  EXPECT_EQ((*events)[2].id, 1);
+}
+
+TEST(HugePageAwareAllocatorSimulatorTest, RejectsMalformedTraces) {
+  for (const char* trace : {
+           "0 new 1 2 1\n",
+           "0 new 1 0 1 sparse\n",
+           "0 new 1 2 1 medium\n",
+           "0 new 1 2 64 dense\n",
+           "x new 1 2 1 sparse\n",
+           "0 free 1\n",
+           "0 delete 1 2\n",
+           "5 delete 1\n3 delete 2\n",
+       }) {
+    SCOPED_TRACE(trace);
+    absl::StatusOr<std::vector<TraceEvent>> events = ParsePageHeapTrace(trace);
+    EXPECT_EQ(events.status().code(), absl::StatusCode::kInvalidArgument);
+    EXPECT_THAT(events.status().message(), HasSubstr("line "));
+  }
+}
+
+TEST(HugePageAwareAllocatorSimulatorTest, RejectsUnknownSpans) {
+  absl::StatusOr<std::vector<TraceEvent>> events =
+      ParsePageHeapTrace("0 new 1 1 1 sparse\n1 new 1 1 1 sparse\n");
+  ASSERT_TRUE(events.ok()) << events.status();
+  EXPECT_EQ(SimulateHugePageAwareAllocator({}, *events).status().code(),
+            absl::StatusCode::kInvalidArgument);
+
+  events = ParsePageHeapTrace("0 delete 1\n");
+  ASSERT_TRUE(events.ok()) << events.status();
+  EXPECT_EQ(SimulateHugePageAwareAllocator({}, *events).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(HugePageAwareAllocatorSimulatorTest, Simulates) {
+  absl::StatusOr<std::vector<TraceEvent>> events =
+      ParsePageHeapTrace(OscillatingTrace(/*cycles=*/3, /*peak=*/5000));
+  ASSERT_TRUE(events.ok()) << events.status();
+
+  SimulatorOptions options;
+  options.sample_interval = absl::Seconds(1);
+  absl::StatusOr<SimulatorResult> result =
+      SimulateHugePageAwareAllocator(options, *events);
+  ASSERT_TRUE(result.ok()) << result.status();
+
+  ASSERT_FALSE(result->samples.empty());
+  absl::Duration last = -absl::InfiniteDuration();
+  size_t peak_used = 0;
+  for (const SimulatorSample& s : result->samples) {
+    EXPECT_GT(s.time, last);
+    last = s.time;
+    peak_used = std::max(peak_used, s.used_bytes);
+    EXPECT_GE(s.backing.system_bytes,
+              s.used_bytes + s.backing.free_bytes + s.backing.unmapped_bytes);
+    EXPECT_GE(s.hugepage_coverage, 0);
+    EXPECT_LE(s.hugepage_coverage, 1);
+    EXPECT_GE(s.fragmentation, 0);
+    EXPECT_LE(s.fragmentation, 1);
+  }
+  EXPECT_EQ(last, events->back().time);
+  EXPECT_GT(peak_used, 0);
+  EXPECT_EQ(result->samples.back().used_bytes, 0);
+  EXPECT_GT(result->samples.back().released_bytes, 0);
+  EXPECT_EQ(result->samples.back().released_bytes,
+            result->release_stats.total.in_bytes());
+  EXPECT_EQ(result->release_stats.total,
+            result->release_stats.process_background_actions);
+
+  const std::string csv = FormatSimulatorSamples(result->samples);
+  EXPECT_THAT(csv, HasSubstr("time_s,used_bytes,"));
+  EXPECT_THAT(FormatSimulatorOptions(options),
+              HasSubstr("use_density_heuristic=1"));
+}
+
+TEST(HugePageAwareAllocatorSimulatorTest, SkipSubreleaseReducesReleases) {
+  absl::StatusOr<std::vector<TraceEvent>> events =
+      ParsePageHeapTrace(OscillatingTrace(/*cycles=*/4, /*peak=*/5000));
+  ASSERT_TRUE(events.ok()) << events.status();
+
+  SimulatorOptions options;
+  options.skip_subrelease_short_interval = absl::ZeroDuration();
+  options.skip_subrelease_long_interval = absl::ZeroDuration();
+  absl::StatusOr<SimulatorResult> eager =
+      SimulateHugePageAwareAllocator(options, *events);
+  ASSERT_TRUE(eager.ok()) << eager.status();
+
+  options.skip_subrelease_short_interval = absl::Seconds(60);
+  options.skip_subrelease_long_interval = absl::Seconds(300);
+  absl::StatusOr<SimulatorResult> skipping =
+      SimulateHugePageAwareAllocator(options, *events);
+  ASSERT_TRUE(skipping.ok()) << skipping.status();
+
+  EXPECT_LT(skipping->release_stats.total, eager->release_stats.total);
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
@@ -249,6 +249,77 @@ class HugePageAwareAllocatorTest
     }
   }
 
+  // Extends span in place to n pages with TryGrow.  Returns false, leaving
+  // span unchanged, if the allocator could not grow it.
+  bool Grow(Span* span, Length n) {
+    absl::base_internal::SpinLockHolder h(lock_);
+    PageAllocatorInterface::AllocationState s{
+        Range(span->first_page(), span->num_pages()), span->donated()};
+    const bool grown = allocator_->TryGrow(
+        s, n, {.objects_per_span = 1,
+               .density = AccessDensityPrediction::kSparse});
+    if (grown) {
+      EXPECT_EQ(s.r.p, span->first_page());
+      EXPECT_EQ(s.r.n, n);
+      total_ += n - span->num_pages();
+      span->set_num_pages(n);
+      span->set_donated(s.donated);
+    } else {
+      EXPECT_EQ(s.r.p, span->first_page());
+      EXPECT_EQ(s.r.n, span->num_pages());
+    }
+    CheckStats();
+    return grown;
+  }
+
+  // As Delete, but the first <unbacked> pages of span have been remapped away
+  // (see DeleteMoved).
+  void DeleteMoved(Span* span, Length unbacked) {
+    constexpr SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+    absl::base_internal::SpinLockHolder h(lock_);
+    TC_CHECK(ids_.erase(span) == 1);
+    const Length n = span->num_pages();
+    PageAllocatorInterface::AllocationState a{Range(span->first_page(), n),
+                                              span->donated()};
+#ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
+    {
+      PageHeapSpinLockHolder l;
+      allocator_->forwarder().DeleteSpan(span);
+      allocator_->DeleteMoved(a, unbacked, kSpanInfo);
+    }
+#else
+    allocator_->forwarder().RecordDeallocation(
+        reinterpret_cast<uintptr_t>(span->start_address()));
+    allocator_->forwarder().DeleteSpan(span);
+    {
+      PageHeapSpinLockHolder l;
+      allocator_->DeleteMoved(a, unbacked, kSpanInfo);
+    }
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+    total_ -= n;
+    CheckStats();
+  }
+
+  bool ReserveMove(Span* span) {
+    PageHeapSpinLockHolder l;
+    return allocator_->ReserveMove(span->first_page());
+  }
+
+  uint64_t GetUnmappedBytes() {
+    PageHeapSpinLockHolder l;
+    return allocator_->stats().unmapped_bytes;
+  }
+
+  bool InRegion(Span* span) {
+    PageHeapSpinLockHolder l;
+    return allocator_->region().Contains(span->first_page());
+  }
+
+  HugeLength DonatedHugePages() {
+    PageHeapSpinLockHolder l;
+    return allocator_->DonatedHugePages();
+  }
+
   // Mostly small things, some large ones.
   std::pair<Length, SpanAllocInfo> RandomAllocSize(absl::BitGenRef rng) {
     Length n;
@@ -1316,8 +1387,177 @@ TEST_P(HugePageAwareAllocatorTest, DonationAccounting) {
   EXPECT_EQ(donated, NHugePages(0));
 }
 
+TEST_P(HugePageAwareAllocatorTest, GrowRawHugepagesInPlace) {
+  const SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+  Span* span = New(NHugePages(2).in_pages(), kSpanInfo);
+  ASSERT_FALSE(InRegion(span));
+  const PageId start = span->first_page();
+
+  // The hugepages that follow a fresh allocation are unused address space.
+  ASSERT_TRUE(Grow(span, NHugePages(3).in_pages()));
+  EXPECT_EQ(span->first_page(), start);
+  EXPECT_FALSE(span->donated());
+  EXPECT_EQ(DonatedHugePages(), NHugePages(0));
+
+  // Growing onto part of a hugepage donates the rest of it to the filler, as
+  // a fresh allocation would.
+  ASSERT_TRUE(Grow(span, NHugePages(4).in_pages() - Length(2)));
+  EXPECT_EQ(span->first_page(), start);
+  EXPECT_TRUE(span->donated());
+  EXPECT_EQ(DonatedHugePages(), NHugePages(1));
+
+  // Donated slack may be in use by other allocations, so it is not grown
+  // into.
+  EXPECT_FALSE(Grow(span, NHugePages(4).in_pages()));
+
+  Delete(span, kSpanInfo.objects_per_span);
+  EXPECT_EQ(DonatedHugePages(), NHugePages(0));
+}
+
+// Hugepages whose contents were remapped away are freed as released, not as
+// backed free memory.
+TEST_P(HugePageAwareAllocatorTest, DeleteMovedReleasesMovedHugepages) {
+  const SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+  Span* span = New(NHugePages(3).in_pages(), kSpanInfo);
+  ASSERT_FALSE(InRegion(span));
+  ASSERT_TRUE(ReserveMove(span));
+
+  const uint64_t unmapped = GetUnmappedBytes();
+  const uint64_t free = GetFreeBytes();
+  DeleteMoved(span, NHugePages(2).in_pages());
+  // The HugeCache may release the last hugepage too, but never caches the
+  // moved ones as backed.
+  EXPECT_GE(GetUnmappedBytes(), unmapped + NHugePages(2).in_bytes());
+  EXPECT_LE(GetFreeBytes(), free + NHugePages(1).in_bytes());
+}
+
+TEST_P(HugePageAwareAllocatorTest, ReserveMoveOnlyForRawHugepages) {
+  const SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+  Span* small = New(Length(1), kSpanInfo);
+  EXPECT_FALSE(ReserveMove(small));
+  Delete(small, kSpanInfo.objects_per_span);
+
+  // As in GrowInRegion, allocations with almost a hugepage of slack soon land
+  // in a region.
+  const Length kSize = kPagesPerHugePage + Length(1);
+  std::vector<Span*> raw;
+  Span* span = nullptr;
+  for (int i = 0; i < 1000; ++i) {
+    span = New(kSize, kSpanInfo);
+    if (InRegion(span)) break;
+    EXPECT_TRUE(ReserveMove(span));
+    raw.push_back(span);
+    span = nullptr;
+  }
+  ASSERT_NE(span, nullptr);
+  EXPECT_FALSE(ReserveMove(span));
+
+  Delete(span, kSpanInfo.objects_per_span);
+  for (Span* s : raw) {
+    Delete(s, kSpanInfo.objects_per_span);
+  }
+}
+
+TEST_P(HugePageAwareAllocatorTest, GrowFailsWhenFollowingPagesInUse) {
+  const SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+  Span* first = New(NHugePages(2).in_pages(), kSpanInfo);
+  Span* second = New(NHugePages(1).in_pages(), kSpanInfo);
+  ASSERT_EQ(second->first_page(), first->first_page() + first->num_pages());
+
+  EXPECT_FALSE(Grow(first, NHugePages(3).in_pages()));
+  EXPECT_EQ(first->num_pages(), NHugePages(2).in_pages());
+
+  // Once the following hugepage is freed (to the HugeCache), it can be taken.
+  Delete(second, kSpanInfo.objects_per_span);
+  EXPECT_TRUE(Grow(first, NHugePages(3).in_pages()));
+
+  Delete(first, kSpanInfo.objects_per_span);
+}
+
+TEST_P(HugePageAwareAllocatorTest, GrowFailsForFillerAllocations) {
+  const SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+  Span* span = New(Length(1), kSpanInfo);
+  EXPECT_FALSE(Grow(span, Length(2)));
+  Delete(span, kSpanInfo.objects_per_span);
+}
+
+TEST_P(HugePageAwareAllocatorTest, GrowInRegion) {
+  const SpanAllocInfo kSpanInfo = {1, AccessDensityPrediction::kSparse};
+  // Each raw allocation leaves almost a hugepage of slack, so that we soon
+  // have enough slack for AllocLarge to fall back to regions.
+  const Length kSize = kPagesPerHugePage + Length(1);
+  std::vector<Span*> raw;
+  Span* span = nullptr;
+  for (int i = 0; i < 1000; ++i) {
+    span = New(kSize, kSpanInfo);
+    if (InRegion(span)) break;
+    raw.push_back(span);
+    span = nullptr;
+  }
+  ASSERT_NE(span, nullptr);
+
+  // The rest of the region is free.
+  ASSERT_TRUE(Grow(span, 2 * kSize));
+  EXPECT_TRUE(InRegion(span));
+
+  // Growth cannot extend past the end of the region, into other memory.
+  EXPECT_FALSE(Grow(span, HugeRegion::size().in_pages() + Length(1)));
+
+  // Nor over another allocation in the region.
+  Span* next = New(kSize, kSpanInfo);
+  ASSERT_TRUE(InRegion(next));
+  ASSERT_EQ(next->first_page(), span->first_page() + span->num_pages());
+  EXPECT_FALSE(Grow(span, span->num_pages() + Length(1)));
+
+  Delete(next, kSpanInfo.objects_per_span);
+  Delete(span, kSpanInfo.objects_per_span);
+  for (Span* s : raw) {
+    Delete(s, kSpanInfo.objects_per_span);
+  }
+}
+
 // We'd like to test OOM behavior but this, err, OOMs. :)
 // (Usable manually in controlled environments.
+TEST_P(HugePageAwareAllocatorTest, GigaPagesReleaseOnlyWholeGigaPages) {
+  HugePageAwareAllocatorOptions options;
+  options.tag = MemoryTag::kNormal;
+  options.use_huge_region_more_often = std::get<0>(GetParam());
+  options.use_gigapages = true;
+  allocator_.emplace(options);
+  allocator_->forwarder().SetBackAllocations(std::get<1>(GetParam()));
+  allocator_->forwarder().SetBackSizeThresholdBytes(kHugePageSize);
+  allocator_->forwarder().set_hpaa_subrelease(/*value=*/true);
+
+  // Leave a partially used hugepage in the filler, and a free hugepage in the
+  // cache, both in the same 1GiB page.
+  constexpr SpanAllocInfo kInfo = {.objects_per_span = 1,
+                                   .density = AccessDensityPrediction::kSparse};
+  Span* small = New(Length(1), kInfo);
+  Span* large = New(kPagesPerHugePage, kInfo);
+  Delete(large, kInfo.objects_per_span);
+
+  // Neither subrelease nor breaking hugepages may release part of it.
+  EXPECT_EQ(ReleasePages(kPagesPerHugePage * 2,
+                         PageReleaseReason::kReleaseMemoryToSystem),
+            Length(0));
+  EXPECT_EQ(ReleaseAtLeastNPagesBreakingHugepages(
+                kPagesPerHugePage * 2, PageReleaseReason::kSoftLimitExceeded),
+            Length(0));
+  {
+    PageHeapSpinLockHolder l;
+    EXPECT_EQ(allocator_->stats().unmapped_bytes, 0);
+  }
+
+  // Once the 1GiB page is entirely free, it is released whole.
+  Delete(small, kInfo.objects_per_span);
+  EXPECT_EQ(ReleasePages(Length(1), PageReleaseReason::kReleaseMemoryToSystem),
+            kHugePagesPerGigaPage.in_pages());
+  {
+    PageHeapSpinLockHolder l;
+    EXPECT_EQ(allocator_->stats().unmapped_bytes, kGigaPageSize);
+  }
+}
+
 TEST_P(HugePageAwareAllocatorTest, DISABLED_OOM) {
   std::vector<Span*> objs;
   auto n = Length(1);
@@ -706,7 +706,9 @@ class HugePageFiller {
       MemoryModifyFunction& unback_without_lock ABSL_ATTRIBUTE_LIFETIME_BOUND,
       MemoryModifyFunction& collapse ABSL_ATTRIBUTE_LIFETIME_BOUND,
       MemoryTagFunction& set_anon_vma_name ABSL_ATTRIBUTE_LIFETIME_BOUND,
-      SubreleaseUnbackedMode subrelease_unbacked_mode);
+      SubreleaseUnbackedMode subrelease_unbacked_mode,
+      SeparateSpanLifetimes separate_span_lifetimes =
+          SeparateSpanLifetimes::kDisabled);
 
   HugePageFiller(
       Clock clock, MemoryTag tag,
@@ -714,7 +716,9 @@ class HugePageFiller {
       MemoryModifyFunction& unback_without_lock ABSL_ATTRIBUTE_LIFETIME_BOUND,
       MemoryModifyFunction& collapse ABSL_ATTRIBUTE_LIFETIME_BOUND,
       MemoryTagFunction& set_anon_vma_name ABSL_ATTRIBUTE_LIFETIME_BOUND,
-      SubreleaseUnbackedMode subrelease_unbacked_mode);
+      SubreleaseUnbackedMode subrelease_unbacked_mode,
+      SeparateSpanLifetimes separate_span_lifetimes =
+          SeparateSpanLifetimes::kDisabled);
 
   typedef TrackerType Tracker;
 
@@ -812,6 +816,13 @@ class HugePageFiller {
   // *is* hugepage-backed!)
   double hugepage_frac() const;
 
+  // Returns the number of used pages that the recent demand history predicts
+  // the filler will need, as used by skip subrelease: the recent peak if
+  // intervals.peak_interval is set, and otherwise the sum of the short-term
+  // fluctuation and long-term trend.  Returns zero if intervals are all zero.
+  Length GetRecentDemand(SkipSubreleaseIntervals intervals)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
   // Returns the amount of memory to release if all remaining options of
   // releasing memory involve subreleasing pages. Provided intervals are used
   // for making skip subrelease decisions.
@@ -880,11 +891,19 @@ class HugePageFiller {
   // revisited only after five minutes.
   // 3. Attempt to release free/unreleased pages from trackers with a swapped
   // page.
+  // 4. If <numa_placement> is set, check which NUMA node backs up to 64 highly
+  // utilized hugepages, and move those on remote nodes if
+  // <migrate_remote_hugepages> is enabled.
+  // 5. Nominate the most sparsely used hugepages as relocation donors (see
+  // MallocExtension::ShouldRelocate).
   void TreatHugepageTrackers(
       EnableCollapse enable_collapse,
       EnableUnfilteredCollapse enable_unfiltered_collapse,
       ReleaseStalePages release_stale_pages, PageFlagsBase* pageflags = nullptr,
-      Residency* residency = nullptr)
+      Residency* residency = nullptr,
+      NumaPlacementFunction* numa_placement = nullptr,
+      MigrateRemoteHugepages migrate_remote_hugepages =
+          MigrateRemoteHugepages::kDisabled)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
   // Utility function to release free pages from a given `page_tracker`
@@ -911,6 +930,44 @@ class HugePageFiller {
     }
   };
 
+  // This class wraps a PageTrackerLists per SpanLifetimePrediction, so that
+  // hugepages holding spans predicted to be short-lived, which are likely to
+  // become empty together, are not filled with long-lived spans.
+  template <size_t N>
+  class LifetimeTrackerLists {
+   public:
+    PageTrackerLists<N>& operator[](SpanLifetimePrediction lifetime) {
+      TC_ASSERT_LT(lifetime, SpanLifetimePrediction::kLifetimePredictionCounts);
+      return lists_[lifetime];
+    }
+    const PageTrackerLists<N>& operator[](
+        SpanLifetimePrediction lifetime) const {
+      TC_ASSERT_LT(lifetime, SpanLifetimePrediction::kLifetimePredictionCounts);
+      return lists_[lifetime];
+    }
+
+    HugeLength size() const {
+      HugeLength size;
+      for (const auto& lists : lists_) {
+        size += lists.size();
+      }
+      return size;
+    }
+
+    // Runs a functor on all trackers in the lists, starting at list index
+    // start of each lifetime.
+    template <typename Functor>
+    void Iter(const Functor& func, size_t start) const {
+      for (const auto& lists : lists_) {
+        lists.Iter(func, start);
+      }
+    }
+
+   private:
+    PageTrackerLists<N>
+        lists_[SpanLifetimePrediction::kLifetimePredictionCounts];
+  };
+
   SubreleaseStats subrelease_stats_;
 
   // We group hugepages first by longest-free (as a measure of fragmentation),
@@ -932,7 +989,7 @@ class HugePageFiller {
   static constexpr size_t kNumLists = kPagesPerHugePage.raw_num() * kChunks;
 
   // List of hugepages from which no pages have been released to the OS.
-  PageTrackerLists<kNumLists>
+  LifetimeTrackerLists<kNumLists>
       regular_alloc_[AccessDensityPrediction::kPredictionCounts];
   PageTrackerLists<kPagesPerHugePage.raw_num()> donated_alloc_;
   // Partially released ones that we are trying to release.
@@ -943,9 +1000,13 @@ class HugePageFiller {
   // regular_alloc_released_:  This list contains huge pages whose pages are
   // either allocated or returned to the OS.  There are no pages that are free,
   // but not returned to the OS.
-  PageTrackerLists<kNumLists> regular_alloc_partial_released_
+  //
+  // All of these are further separated by the predicted lifetime of the spans
+  // on their hugepages, if separate_span_lifetimes_ is enabled.  Otherwise,
+  // only the long-lived lists are used.
+  LifetimeTrackerLists<kNumLists> regular_alloc_partial_released_
       [AccessDensityPrediction::kPredictionCounts];
-  PageTrackerLists<kNumLists>
+  LifetimeTrackerLists<kNumLists>
       regular_alloc_released_[AccessDensityPrediction::kPredictionCounts];
 
   // Records a list of fully freed trackers. We might end up with trackers that
@@ -956,6 +1017,8 @@ class HugePageFiller {
   TList<TrackerType> fully_freed_trackers_;
 
   HugePageTreatmentStats treatment_stats_ ABSL_GUARDED_BY(pageheap_lock);
+  // Number of eligible hugepages the next NUMA placement pass skips.
+  size_t numa_placement_start_ ABSL_GUARDED_BY(pageheap_lock) = 0;
 
   // n_used_released_ contains the number of pages in huge pages that are not
   // free (i.e., allocated).  Only the hugepages in regular_alloc_released_ are
@@ -1062,6 +1125,16 @@ class HugePageFiller {
   int current_backoff_delay_ ABSL_GUARDED_BY(pageheap_lock) = 0;
   uintptr_t rng_ = 0;
   SubreleaseUnbackedMode subrelease_unbacked_mode_;
+  SeparateSpanLifetimes separate_span_lifetimes_;
+
+  // Returns the lifetime class whose hugepages an allocation described by
+  // span_alloc_info is placed on.  Unless lifetimes are separated, all
+  // hugepages are in the long-lived class.
+  SpanLifetimePrediction LifetimeClass(SpanAllocInfo span_alloc_info) const {
+    return separate_span_lifetimes_ == SeparateSpanLifetimes::kEnabled
+               ? span_alloc_info.lifetime
+               : SpanLifetimePrediction::kLongLived;
+  }
 };
 
 template <class TrackerType>
@@ -1069,11 +1142,13 @@ inline HugePageFiller<TrackerType>::HugePageFiller(
     MemoryTag tag, MemoryModifyFunction& unback,
     MemoryModifyFunction& unback_without_lock, MemoryModifyFunction& collapse,
     MemoryTagFunction& set_anon_vma_name,
-    SubreleaseUnbackedMode subrelease_unbacked_mode)
+    SubreleaseUnbackedMode subrelease_unbacked_mode,
+    SeparateSpanLifetimes separate_span_lifetimes)
     : HugePageFiller(Clock{.now = absl::base_internal::CycleClock::Now,
                            .freq = absl::base_internal::CycleClock::Frequency},
                      tag, unback, unback_without_lock, collapse,
-                     set_anon_vma_name, subrelease_unbacked_mode) {}
+                     set_anon_vma_name, subrelease_unbacked_mode,
+                     separate_span_lifetimes) {}
 
 // For testing with mock clock
 template <class TrackerType>
@@ -1081,7 +1156,8 @@ inline HugePageFiller<TrackerType>::HugePageFiller(
     Clock clock, MemoryTag tag, MemoryModifyFunction& unback,
     MemoryModifyFunction& unback_without_lock, MemoryModifyFunction& collapse,
     MemoryTagFunction& set_anon_vma_name,
-    SubreleaseUnbackedMode subrelease_unbacked_mode)
+    SubreleaseUnbackedMode subrelease_unbacked_mode,
+    SeparateSpanLifetimes separate_span_lifetimes)
     : size_(NHugePages(0)),
       fillerstats_tracker_(clock, absl::Minutes(60), absl::Minutes(5),
                            absl::Minutes(10)),
@@ -1091,7 +1167,8 @@ inline HugePageFiller<TrackerType>::HugePageFiller(
       unback_without_lock_(unback_without_lock),
       collapse_(collapse),
       set_anon_vma_name_(set_anon_vma_name),
-      subrelease_unbacked_mode_(subrelease_unbacked_mode) {
+      subrelease_unbacked_mode_(subrelease_unbacked_mode),
+      separate_span_lifetimes_(separate_span_lifetimes) {
   lifetime_bucket_bounds_[0] = 0;
   lifetime_bucket_bounds_[1] = 1;
   for (int i = 2; i <= kLifetimeBuckets; ++i) {
@@ -1170,6 +1247,13 @@ HugePageFiller<TrackerType>::TryGet(Length n, SpanAllocInfo span_alloc_info) {
   // So all we have to do is find the first nonempty freelist in the regular
   // PageTrackerList that *could* support our allocation, and it will be our
   // best choice. If there is none we repeat with the donated PageTrackerList.
+  //
+  // If separate_span_lifetimes_ is enabled, regular hugepages are further split
+  // by the predicted lifetime of the spans placed on them, and we only search
+  // those of the requested lifetime.
+  // Short-lived spans thus share hugepages that tend to become empty together,
+  // rather than leaving long-lived spans stranded on partially free (and
+  // eventually partially released) hugepages.
   ASSUME(n < kPagesPerHugePage);
   TrackerType* pt;
 
@@ -1178,7 +1262,8 @@ HugePageFiller<TrackerType>::TryGet(Length n, SpanAllocInfo span_alloc_info) {
   do {
     const size_t listindex =
         ListFor(n, 0, type, kPagesPerHugePage.raw_num() - 1);
-    pt = regular_alloc_[type].GetLeast(listindex);
+    const SpanLifetimePrediction lifetime = LifetimeClass(span_alloc_info);
+    pt = regular_alloc_[type][lifetime].GetLeast(listindex);
     if (pt) {
       TC_ASSERT(!pt->donated());
       break;
@@ -1189,7 +1274,7 @@ HugePageFiller<TrackerType>::TryGet(Length n, SpanAllocInfo span_alloc_info) {
         break;
       }
     }
-    pt = regular_alloc_partial_released_[type].GetLeast(listindex);
+    pt = regular_alloc_partial_released_[type][lifetime].GetLeast(listindex);
     if (pt) {
       TC_ASSERT(!pt->donated());
       was_released = true;
@@ -1197,7 +1282,7 @@ HugePageFiller<TrackerType>::TryGet(Length n, SpanAllocInfo span_alloc_info) {
       n_used_partial_released_[type] -= pt->used_pages();
       break;
     }
-    pt = regular_alloc_released_[type].GetLeast(listindex);
+    pt = regular_alloc_released_[type][lifetime].GetLeast(listindex);
     if (pt) {
       TC_ASSERT(!pt->donated());
       was_released = true;
@@ -1369,6 +1454,7 @@ inline void HugePageFiller<TrackerType>::Contribute(
 
   pages_allocated_[type] += pt->used_pages();
   TC_ASSERT(!(type == AccessDensityPrediction::kDense && donated));
+  pt->set_lifetime(LifetimeClass(span_alloc_info));
   if (donated) {
     TC_ASSERT(pt->was_donated());
     DonateToFillerList(pt);
@@ -1509,6 +1595,22 @@ inline Length HugePageFiller<TrackerType>::FreePagesInPartialAllocs() const {
          used_pages_in_any_subreleased() - unmapped_pages();
 }
 
+template <class TrackerType>
+inline Length HugePageFiller<TrackerType>::GetRecentDemand(
+    SkipSubreleaseIntervals intervals) {
+  if (!intervals.SkipSubreleaseEnabled()) {
+    return Length(0);
+  }
+  UpdateFillerStatsTracker();
+  // There are two ways to calculate the demand requirement. We give priority
+  // to using the peak if peak_interval is set.
+  if (intervals.IsPeakIntervalSet()) {
+    return fillerstats_tracker_.GetRecentPeak(intervals.peak_interval);
+  }
+  return fillerstats_tracker_.GetRecentDemand(intervals.short_interval,
+                                              intervals.long_interval);
+}
+
 template <class TrackerType>
 inline Length HugePageFiller<TrackerType>::GetDesiredSubreleasePages(
     Length desired, Length total_released, SkipSubreleaseIntervals intervals) {
@@ -1522,17 +1624,7 @@ inline Length HugePageFiller<TrackerType>::GetDesiredSubreleasePages(
   if (!intervals.SkipSubreleaseEnabled()) {
     return desired;
   }
-  UpdateFillerStatsTracker();
-  Length required_pages;
-  // As mentioned above, there are two ways to calculate the demand
-  // requirement. We give priority to using the peak if peak_interval is set.
-  if (intervals.IsPeakIntervalSet()) {
-    required_pages =
-        fillerstats_tracker_.GetRecentPeak(intervals.peak_interval);
-  } else {
-    required_pages = fillerstats_tracker_.GetRecentDemand(
-        intervals.short_interval, intervals.long_interval);
-  }
+  Length required_pages = GetRecentDemand(intervals);
 
   Length current_pages = used_pages() + free_pages();
 
@@ -1637,14 +1729,17 @@ inline Length HugePageFiller<TrackerType>::ReleasePages(
     //
     // We do not examine the regular_alloc_released_ lists, as only contain
     // completely released pages.
-    int n_candidates = SelectCandidates(
-        absl::MakeSpan(candidates), 0,
-        regular_alloc_partial_released_[AccessDensityPrediction::kSparse],
-        kChunks);
-    n_candidates = SelectCandidates(
-        absl::MakeSpan(candidates), n_candidates,
-        regular_alloc_partial_released_[AccessDensityPrediction::kDense],
-        kChunks);
+    int n_candidates = 0;
+    for (const AccessDensityPrediction type :
+         {AccessDensityPrediction::kSparse, AccessDensityPrediction::kDense}) {
+      for (const SpanLifetimePrediction lifetime :
+           {SpanLifetimePrediction::kLongLived,
+            SpanLifetimePrediction::kShortLived}) {
+        n_candidates = SelectCandidates(
+            absl::MakeSpan(candidates), n_candidates,
+            regular_alloc_partial_released_[type][lifetime], kChunks);
+      }
+    }
 
     Length released =
         ReleaseCandidates(absl::MakeSpan(candidates.data(), n_candidates),
@@ -1666,12 +1761,20 @@ inline Length HugePageFiller<TrackerType>::ReleasePages(
     // We select candidate hugepages from few_objects_alloc_ first as we expect
     // hugepages in this alloc to become free earlier than those in other
     // allocs.
-    int n_candidates = SelectCandidates(
-        absl::MakeSpan(candidates), /*current_candidates=*/0,
-        regular_alloc_[AccessDensityPrediction::kSparse], kChunks);
-    n_candidates = SelectCandidates(
-        absl::MakeSpan(candidates), n_candidates,
-        regular_alloc_[AccessDensityPrediction::kDense], kChunks);
+    //
+    // Within each, we select hugepages of long-lived spans first, as the free
+    // pages of short-lived ones are likely to be freed whole shortly.
+    int n_candidates = 0;
+    for (const AccessDensityPrediction type :
+         {AccessDensityPrediction::kSparse, AccessDensityPrediction::kDense}) {
+      for (const SpanLifetimePrediction lifetime :
+           {SpanLifetimePrediction::kLongLived,
+            SpanLifetimePrediction::kShortLived}) {
+        n_candidates =
+            SelectCandidates(absl::MakeSpan(candidates), n_candidates,
+                             regular_alloc_[type][lifetime], kChunks);
+      }
+    }
     // TODO(b/138864853): Perhaps remove donated_alloc_ from here, it's not a
     // great candidate for partial release.
     n_candidates = SelectCandidates(absl::MakeSpan(candidates), n_candidates,
@@ -1721,14 +1824,21 @@ inline HugePageFillerStats HugePageFiller<TrackerType>::GetStats() const {
     size_t sparselist =
         ListFor(/*longest=*/Length(0), chunk, AccessDensityPrediction::kSparse,
                 /*nallocs=*/0);
-    stats.n_full[AccessDensityPrediction::kSparse] += NHugePages(
-        regular_alloc_[AccessDensityPrediction::kSparse][sparselist].length());
-
     size_t denselist = ListFor(
         /*longest=*/Length(0), chunk, AccessDensityPrediction::kDense,
         kPagesPerHugePage.raw_num());
-    stats.n_full[AccessDensityPrediction::kDense] += NHugePages(
-        regular_alloc_[AccessDensityPrediction::kDense][denselist].length());
+    for (const SpanLifetimePrediction lifetime :
+         {SpanLifetimePrediction::kLongLived,
+          SpanLifetimePrediction::kShortLived}) {
+      const auto& sparse =
+          regular_alloc_[AccessDensityPrediction::kSparse][lifetime];
+      const auto& dense =
+          regular_alloc_[AccessDensityPrediction::kDense][lifetime];
+      stats.n_full[AccessDensityPrediction::kSparse] +=
+          NHugePages(sparse[sparselist].length());
+      stats.n_full[AccessDensityPrediction::kDense] +=
+          NHugePages(dense[denselist].length());
+    }
   }
   stats.n_full[AccessDensityPrediction::kPredictionCounts] =
       stats.n_full[AccessDensityPrediction::kSparse] +
@@ -1798,7 +1908,8 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
     EnableCollapse enable_collapse,
     EnableUnfilteredCollapse enable_unfiltered_collapse,
     ReleaseStalePages release_stale_pages, PageFlagsBase* pageflags,
-    Residency* residency) {
+    Residency* residency, NumaPlacementFunction* numa_placement,
+    MigrateRemoteHugepages migrate_remote_hugepages) {
   if (enable_collapse == EnableCollapse::kEnabled &&
       ShouldBackoffFromCollapse()) {
     enable_collapse = EnableCollapse::kDisabled;
@@ -1813,12 +1924,16 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
       clock_, pageflags, residency, collapse_, *this, enable_collapse,
       subrelease_unbacked_mode_, enable_unfiltered_collapse,
       release_stale_pages);
+  NumaPlacementTreatment numa_placement_treatment(
+      numa_placement, migrate_remote_hugepages, numa_placement_start_);
+  RelocationDonorTreatment relocation_donor_treatment(free_pages());
 
   // Collect up to kTotalTrackersToScan trackers from our lists.
   regular_alloc_partial_released_[AccessDensityPrediction::kSparse].Iter(
       [&](TrackerType& pt) GOOGLE_MALLOC_SECTION {
         sampled_tracker_treatment.SelectEligibleTrackers(pt);
         unbacked_tracker_treatment.SelectEligibleTrackers(pt);
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
@@ -1826,12 +1941,14 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
       [&](TrackerType& pt) GOOGLE_MALLOC_SECTION {
         sampled_tracker_treatment.SelectEligibleTrackers(pt);
         unbacked_tracker_treatment.SelectEligibleTrackers(pt);
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
   donated_alloc_.Iter(
       [&](TrackerType& pt) GOOGLE_MALLOC_SECTION {
         unbacked_tracker_treatment.SelectEligibleTrackers(pt);
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
@@ -1839,6 +1956,8 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
       [&](TrackerType& pt) GOOGLE_MALLOC_SECTION {
         sampled_tracker_treatment.SelectEligibleTrackers(pt);
         unbacked_tracker_treatment.SelectEligibleTrackers(pt);
+        numa_placement_treatment.SelectEligibleTrackers(pt);
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
@@ -1846,6 +1965,8 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
       [&](TrackerType& pt) GOOGLE_MALLOC_SECTION {
         sampled_tracker_treatment.SelectEligibleTrackers(pt);
         unbacked_tracker_treatment.SelectEligibleTrackers(pt);
+        numa_placement_treatment.SelectEligibleTrackers(pt);
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
@@ -1855,6 +1976,7 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
         if (enable_subrelease_unbacked) {
           unbacked_tracker_treatment.SelectEligibleTrackers(pt);
         }
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
@@ -1864,12 +1986,17 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
         if (enable_subrelease_unbacked) {
           unbacked_tracker_treatment.SelectEligibleTrackers(pt);
         }
+        relocation_donor_treatment.SelectEligibleTrackers(pt);
       },
       /*start=*/0);
 
+  relocation_donor_treatment.Nominate();
+  relocation_donor_treatment.UpdateHugePageTreatmentStats(treatment_stats_);
+
   pageheap_lock.unlock();
   sampled_tracker_treatment.Treat();
   unbacked_tracker_treatment.Treat();
+  numa_placement_treatment.Treat();
 
   HugePageTreatmentStats stats = unbacked_tracker_treatment.GetStats();
 
@@ -1882,8 +2009,11 @@ inline void HugePageFiller<TrackerType>::TreatHugepageTrackers(
   }
   sampled_tracker_treatment.Restore();
   unbacked_tracker_treatment.Restore();
+  numa_placement_treatment.Restore();
 
   unbacked_tracker_treatment.UpdateHugePageTreatmentStats(treatment_stats_);
+  numa_placement_treatment.UpdateHugePageTreatmentStats(treatment_stats_);
+  numa_placement_start_ = numa_placement_treatment.next_start();
   // It should be rare that we find anything in the fully freed list, because
   // we only sample 1% of the trackers for naming, and an interleaving Put
   // operation would have to free all the pages while the memory is being named.
@@ -2047,6 +2177,21 @@ inline void HugePageFiller<TrackerType>::Print(Printer& out, bool everything,
       treatment_stats_.treated_pages_unbacked_subreleased,
       treatment_stats_.total_treated_pages_unbacked_subreleased);
 
+  out.printf(
+      "HugePageFiller: Of sampled highly utilized hugepages, %zu were on a "
+      "local NUMA node, %zu on a remote node; %zu migrated, %zu failed to "
+      "migrate.\n",
+      treatment_stats_.numa_placement.hits,
+      treatment_stats_.numa_placement.misses,
+      treatment_stats_.numa_placement.migrated,
+      treatment_stats_.numa_placement.migration_failures);
+
+  out.printf(
+      "HugePageFiller: %zu hugepages nominated as relocation donors; "
+      "%.1f MiB reclaimable via relocation.\n",
+      treatment_stats_.relocation_donors,
+      Length(treatment_stats_.relocation_reclaimable_pages).in_mib());
+
   out.printf("\n");
   out.printf("HugePageFiller: fullness histograms\n");
 
@@ -2356,6 +2501,20 @@ inline void HugePageFiller<TrackerType>::PrintInPbtxt(
     huge_page_treatment_region.PrintI64(
         "treated_pages_stale_subreleased",
         treatment_stats_.treated_pages_stale_subreleased);
+    huge_page_treatment_region.PrintI64("numa_hits",
+                                        treatment_stats_.numa_placement.hits);
+    huge_page_treatment_region.PrintI64(
+        "numa_misses", treatment_stats_.numa_placement.misses);
+    huge_page_treatment_region.PrintI64(
+        "numa_migrated", treatment_stats_.numa_placement.migrated);
+    huge_page_treatment_region.PrintI64(
+        "numa_migration_failures",
+        treatment_stats_.numa_placement.migration_failures);
+    huge_page_treatment_region.PrintI64("relocation_donors",
+                                        treatment_stats_.relocation_donors);
+    huge_page_treatment_region.PrintI64(
+        "relocation_reclaimable_bytes",
+        Length(treatment_stats_.relocation_reclaimable_pages).in_bytes());
   }
   PrintLifetimeHistoInPbtxt(hpaa,
                             lifetime_histo_[AccessDensityPrediction::kDense],
@@ -2457,13 +2616,13 @@ inline void HugePageFiller<TrackerType>::RemoveFromFillerList(TrackerType* pt) {
   if (!pt->released() &&
       (pt->unbroken() ||
        subrelease_unbacked_mode_ == SubreleaseUnbackedMode::kDisabled)) {
-    regular_alloc_[type].Remove(pt, i);
+    regular_alloc_[type][pt->lifetime()].Remove(pt, i);
   } else if (pt->free_pages() <= pt->released_pages()) {
-    regular_alloc_released_[type].Remove(pt, i);
+    regular_alloc_released_[type][pt->lifetime()].Remove(pt, i);
     TC_ASSERT_GE(n_used_released_[type], pt->used_pages());
     n_used_released_[type] -= pt->used_pages();
   } else {
-    regular_alloc_partial_released_[type].Remove(pt, i);
+    regular_alloc_partial_released_[type][pt->lifetime()].Remove(pt, i);
     TC_ASSERT_GE(n_used_partial_released_[type], pt->used_pages());
     n_used_partial_released_[type] -= pt->used_pages();
   }
@@ -2507,12 +2666,12 @@ inline void HugePageFiller<TrackerType>::AddToFillerList(TrackerType* pt) {
   if (!pt->released() &&
       (pt->unbroken() ||
        subrelease_unbacked_mode_ == SubreleaseUnbackedMode::kDisabled)) {
-    regular_alloc_[type].Add(pt, i);
+    regular_alloc_[type][pt->lifetime()].Add(pt, i);
   } else if (pt->free_pages() <= pt->released_pages()) {
-    regular_alloc_released_[type].Add(pt, i);
+    regular_alloc_released_[type][pt->lifetime()].Add(pt, i);
     n_used_released_[type] += pt->used_pages();
   } else {
-    regular_alloc_partial_released_[type].Add(pt, i);
+    regular_alloc_partial_released_[type][pt->lifetime()].Add(pt, i);
     n_used_partial_released_[type] += pt->used_pages();
   }
 }
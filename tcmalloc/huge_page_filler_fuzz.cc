@@ -138,14 +138,16 @@ struct Allocate {
   uint16_t length;
   uint32_t num_objects;
   bool density_dense;
+  bool short_lived;
 
   void Perform(State& state) const;
 
   template <typename Sink>
   friend void AbslStringify(Sink& sink, const Allocate& a) {
     absl::Format(&sink,
-                 "Allocate{.length=%d, .num_objects=%d, .density_dense=%v}",
-                 a.length, a.num_objects, a.density_dense);
+                 "Allocate{.length=%d, .num_objects=%d, .density_dense=%v, "
+                 ".short_lived=%v}",
+                 a.length, a.num_objects, a.density_dense, a.short_lived);
   }
 };
 
@@ -365,13 +367,14 @@ void AbslStringify(Sink& sink, const Instruction& i) {
 
 struct State {
   explicit State(SubreleaseUnbackedMode subrelease_unbacked_mode,
+                 SeparateSpanLifetimes separate_span_lifetimes,
                  size_t num_instructions)
       : subrelease_unbacked_mode(subrelease_unbacked_mode),
         unback(*this),
         collapse(*this),
         filler(Clock{.now = mock_clock, .freq = freq}, MemoryTag::kNormal,
                unback, unback, collapse, set_anon_vma_name,
-               subrelease_unbacked_mode) {
+               subrelease_unbacked_mode, separate_span_lifetimes) {
     fake_clock = 0;
     output.resize(1 << 20);
     // To avoid reentrancy during unback, reserve space in released_set.  We
@@ -511,8 +514,11 @@ void Allocate::Perform(State& state) const {
   if (density == AccessDensityPrediction::kDense) {
     n = Length(1);
   }
-  SpanAllocInfo alloc_info = {.objects_per_span = num_objects,
-                              .density = density};
+  SpanAllocInfo alloc_info = {
+      .objects_per_span = num_objects,
+      .density = density,
+      .lifetime = short_lived ? SpanLifetimePrediction::kShortLived
+                              : SpanLifetimePrediction::kLongLived};
 
   if (state.depth == 0) {
     TC_CHECK_EQ(state.filler.size().raw_num(), state.trackers.size());
@@ -808,8 +814,11 @@ void ReentrantSubprogram::Perform(State& state) const {
 }
 
 void FuzzFiller(const std::vector<Instruction>& instructions,
-                SubreleaseUnbackedMode subrelease_unbacked_mode) {
-  State state(subrelease_unbacked_mode, instructions.size());
+                SubreleaseUnbackedMode subrelease_unbacked_mode,
+                SeparateSpanLifetimes separate_span_lifetimes =
+                    SeparateSpanLifetimes::kDisabled) {
+  State state(subrelease_unbacked_mode, separate_span_lifetimes,
+              instructions.size());
   state.RunInstructions(instructions);
 }
 
@@ -880,7 +889,9 @@ fuzztest::Domain<Instruction> GetInstructionDomain(int depth) {
 FUZZ_TEST(HugePageFillerTest, FuzzFiller)
     .WithDomains(fuzztest::VectorOf(GetInstructionDomain(5)).WithMaxSize(20000),
                  fuzztest::ElementOf({SubreleaseUnbackedMode::kDisabled,
-                                      SubreleaseUnbackedMode::kEnabled}));
+                                      SubreleaseUnbackedMode::kEnabled}),
+                 fuzztest::ElementOf({SeparateSpanLifetimes::kDisabled,
+                                      SeparateSpanLifetimes::kEnabled}));
 
 TEST(HugePageFillerTest, b510326948) {
   FuzzFiller(
@@ -1227,9 +1238,21 @@ TEST(HugePageFillerTest, InstructionStringify) {
     Instruction inst =
         Allocate{.length = 1, .num_objects = 2, .density_dense = true};
     std::string s = absl::StrFormat("%v", inst);
-    EXPECT_EQ(s, "Allocate{.length=1, .num_objects=2, .density_dense=true}");
+    EXPECT_EQ(s,
+              "Allocate{.length=1, .num_objects=2, .density_dense=true, "
+              ".short_lived=false}");
     EXPECT_THAT(s, Not(HasSubstr("<MAPPING_FUNCTION>")));
   }
+  {
+    Instruction inst = Allocate{.length = 3,
+                                .num_objects = 1,
+                                .density_dense = false,
+                                .short_lived = true};
+    std::string s = absl::StrFormat("%v", inst);
+    EXPECT_EQ(s,
+              "Allocate{.length=3, .num_objects=1, .density_dense=false, "
+              ".short_lived=true}");
+  }
   {
     Instruction inst = Deallocate{.tracker_index = 3, .alloc_index = 4};
     std::string s = absl::StrFormat("%v", inst);
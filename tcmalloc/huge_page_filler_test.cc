@@ -314,6 +314,37 @@ class MockSetAnonVmaName final : public MemoryTagFunction {
   bool ignore_name_ = false;
 };
 
+class MockNumaPlacement final : public NumaPlacementFunction {
+ public:
+  MockNumaPlacement() = default;
+  std::optional<bool> IsLocal(Range r) override {
+    EXPECT_EQ(r.n, kPagesPerHugePage);
+    ++queried_[r.start_addr()];
+    return !remote_.contains(r.start_addr());
+  }
+  [[nodiscard]] MemoryModifyStatus MoveToLocal(Range r) override {
+    EXPECT_EQ(r.n, kPagesPerHugePage);
+    EXPECT_TRUE(remote_.contains(r.start_addr()));
+    if (!move_succeeds_) {
+      return {.success = false, .error_number = ENOMEM};
+    }
+    remote_.erase(r.start_addr());
+    return {.success = true, .error_number = 0};
+  }
+
+  void SetRemote(void* addr) { remote_.insert(addr); }
+  void SetMoveSucceeds(bool succeeds) { move_succeeds_ = succeeds; }
+  int TimesQueried(void* addr) const {
+    auto it = queried_.find(addr);
+    return it == queried_.end() ? 0 : it->second;
+  }
+
+ private:
+  absl::flat_hash_set<void*> remote_;
+  absl::flat_hash_map<void*, int> queried_;
+  bool move_succeeds_ = true;
+};
+
 class BlockingUnback final : public MemoryModifyFunction {
  public:
   constexpr BlockingUnback() = default;
@@ -390,11 +421,13 @@ class FillerTest : public testing::Test {
   MockSetAnonVmaName set_anon_vma_name_;
 
   explicit FillerTest(
-      SubreleaseUnbackedMode mode = SubreleaseUnbackedMode::kDisabled)
+      SubreleaseUnbackedMode mode = SubreleaseUnbackedMode::kDisabled,
+      SeparateSpanLifetimes separate_span_lifetimes =
+          SeparateSpanLifetimes::kDisabled)
       : mode_(mode),
         filler_(Clock{.now = FakeClock::now, .freq = FakeClock::freq},
                 MemoryTag::kNormal, blocking_unback_, blocking_unback_,
-                collapse_, set_anon_vma_name_, mode) {
+                collapse_, set_anon_vma_name_, mode, separate_span_lifetimes) {
     // Reset success state
     blocking_unback_.success_ = true;
   }
@@ -564,14 +597,17 @@ class FillerTest : public testing::Test {
       EnableCollapse enable_collapse,
       EnableUnfilteredCollapse enable_unfiltered_collapse,
       ReleaseStalePages release_stale_pages, PageFlagsBase* pageflags,
-      Residency* residency) {
+      Residency* residency, NumaPlacementFunction* numa_placement = nullptr,
+      MigrateRemoteHugepages migrate_remote_hugepages =
+          MigrateRemoteHugepages::kDisabled) {
     // Note that scoped pageheap lock isn't used here. This is because the
     // pageheap lock is manually unlocked before the collapse operation, and the
     // scoped lock doesn't recognize the manual unlock. In tests, collapse
     // allocates, so we use manual lock and unlock here.
     pageheap_lock.lock();
     filler_.TreatHugepageTrackers(enable_collapse, enable_unfiltered_collapse,
-                                  release_stale_pages, pageflags, residency);
+                                  release_stale_pages, pageflags, residency,
+                                  numa_placement, migrate_remote_hugepages);
     pageheap_lock.unlock();
   }
 
@@ -655,6 +691,13 @@ class FillerTestWithSubreleaseUnbacked : public FillerTest {
       : FillerTest(SubreleaseUnbackedMode::kEnabled) {}
 };
 
+class FillerTestWithSeparateSpanLifetimes : public FillerTest {
+ public:
+  FillerTestWithSeparateSpanLifetimes()
+      : FillerTest(SubreleaseUnbackedMode::kDisabled,
+                   SeparateSpanLifetimes::kEnabled) {}
+};
+
 TEST_F(FillerTest, Density) {
   absl::BitGen rng;
   // Start with a really annoying setup: some hugepages half empty (randomly)
@@ -699,6 +742,273 @@ TEST_F(FillerTest, Density) {
   }
 }
 
+TEST_F(FillerTest, NumaPlacement) {
+  randomize_density_ = false;
+
+  // Three full hugepages, and one that is barely used and not worth migrating.
+  std::vector<PAlloc> full;
+  for (int i = 0; i < 3; ++i) {
+    full.push_back(Allocate(kPagesPerHugePage));
+  }
+  PAlloc sparse = Allocate(Length(1));
+  ASSERT_NE(sparse.pt, full[0].pt);
+
+  FakePageFlags pageflags;
+  FakeResidency residency;
+  for (const PAlloc& a : full) {
+    pageflags.MarkHugePageBacked(a.pt->location().start_addr(), true);
+  }
+  pageflags.MarkHugePageBacked(sparse.pt->location().start_addr(), true);
+  MockNumaPlacement numa_placement;
+  void* remote = full[1].pt->location().start_addr();
+  numa_placement.SetRemote(remote);
+  numa_placement.SetMoveSucceeds(false);
+
+  // Without a placement function, nothing is queried.
+  TreatHugepageTrackers(EnableCollapse::kDisabled,
+                        EnableUnfilteredCollapse::kDisabled,
+                        ReleaseStalePages::kDisabled, &pageflags, &residency);
+  EXPECT_EQ(numa_placement.TimesQueried(remote), 0);
+
+  // Remote hugepages are only counted unless migration is enabled.
+  TreatHugepageTrackers(
+      EnableCollapse::kDisabled, EnableUnfilteredCollapse::kDisabled,
+      ReleaseStalePages::kDisabled, &pageflags, &residency, &numa_placement,
+      MigrateRemoteHugepages::kDisabled);
+  NumaPlacementStats stats = GetHugePageTreatmentStats().numa_placement;
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.migrated, 0);
+  EXPECT_EQ(stats.migration_failures, 0);
+  EXPECT_EQ(numa_placement.TimesQueried(remote), 1);
+  EXPECT_EQ(
+      numa_placement.TimesQueried(sparse.pt->location().start_addr()), 0);
+
+  TreatHugepageTrackers(
+      EnableCollapse::kDisabled, EnableUnfilteredCollapse::kDisabled,
+      ReleaseStalePages::kDisabled, &pageflags, &residency, &numa_placement,
+      MigrateRemoteHugepages::kEnabled);
+  stats = GetHugePageTreatmentStats().numa_placement;
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.migration_failures, 1);
+
+  numa_placement.SetMoveSucceeds(true);
+  TreatHugepageTrackers(
+      EnableCollapse::kDisabled, EnableUnfilteredCollapse::kDisabled,
+      ReleaseStalePages::kDisabled, &pageflags, &residency, &numa_placement,
+      MigrateRemoteHugepages::kEnabled);
+  TreatHugepageTrackers(
+      EnableCollapse::kDisabled, EnableUnfilteredCollapse::kDisabled,
+      ReleaseStalePages::kDisabled, &pageflags, &residency, &numa_placement,
+      MigrateRemoteHugepages::kEnabled);
+  // Once migrated, the hugepage is found on a local node.
+  stats = GetHugePageTreatmentStats().numa_placement;
+  EXPECT_EQ(stats.hits, 9);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.migrated, 1);
+  EXPECT_EQ(stats.migration_failures, 1);
+
+  std::string buffer = PrintToString(1024 * 1024, [&](Printer& printer) {
+    PageHeapSpinLockHolder l;
+    filler_.Print(printer, true, pageflags);
+  });
+  EXPECT_THAT(buffer,
+              testing::HasSubstr("HugePageFiller: Of sampled highly utilized "
+                                 "hugepages, 9 were on a local NUMA node, 3 on "
+                                 "a remote node; 1 migrated, 1 failed to "
+                                 "migrate."));
+
+  for (const PAlloc& a : full) {
+    Delete(a);
+  }
+  Delete(sparse);
+}
+
+TEST_F(FillerTest, NumaPlacementVisitsHugepagesInTurn) {
+  randomize_density_ = false;
+
+  // More full hugepages than a single pass visits.
+  constexpr int kHugePages = 100;
+  std::vector<PAlloc> full;
+  for (int i = 0; i < kHugePages; ++i) {
+    full.push_back(Allocate(kPagesPerHugePage));
+  }
+
+  FakePageFlags pageflags;
+  FakeResidency residency;
+  for (const PAlloc& a : full) {
+    pageflags.MarkHugePageBacked(a.pt->location().start_addr(), true);
+  }
+  MockNumaPlacement numa_placement;
+  auto treat = [&]() {
+    TreatHugepageTrackers(
+        EnableCollapse::kDisabled, EnableUnfilteredCollapse::kDisabled,
+        ReleaseStalePages::kDisabled, &pageflags, &residency, &numa_placement,
+        MigrateRemoteHugepages::kDisabled);
+  };
+
+  treat();
+  EXPECT_EQ(GetHugePageTreatmentStats().numa_placement.hits, 64);
+  // The second pass covers the remaining hugepages, and the third starts over.
+  treat();
+  EXPECT_EQ(GetHugePageTreatmentStats().numa_placement.hits, kHugePages);
+  for (const PAlloc& a : full) {
+    EXPECT_EQ(numa_placement.TimesQueried(a.pt->location().start_addr()), 1);
+  }
+  treat();
+  EXPECT_EQ(GetHugePageTreatmentStats().numa_placement.hits, kHugePages + 64);
+
+  for (const PAlloc& a : full) {
+    Delete(a);
+  }
+}
+
+TEST_F(FillerTest, RelocationDonors) {
+  randomize_density_ = false;
+
+  // Three full hugepages, then free all but one page of the last two.
+  std::vector<PAlloc> small, rest;
+  for (int i = 0; i < 3; ++i) {
+    small.push_back(Allocate(Length(1)));
+    rest.push_back(Allocate(kPagesPerHugePage - Length(1)));
+    ASSERT_EQ(small[i].pt, rest[i].pt);
+  }
+  Delete(rest[1]);
+  Delete(rest[2]);
+
+  FakePageFlags pageflags;
+  FakeResidency residency;
+  auto treat = [&]() {
+    TreatHugepageTrackers(EnableCollapse::kDisabled,
+                          EnableUnfilteredCollapse::kDisabled,
+                          ReleaseStalePages::kDisabled, &pageflags, &residency);
+  };
+
+  // The free pages only have room for one of the sparse hugepages to be
+  // relocated into the other.
+  treat();
+  HugePageTreatmentStats stats = GetHugePageTreatmentStats();
+  EXPECT_EQ(stats.relocation_donors, 1);
+  EXPECT_EQ(stats.relocation_reclaimable_pages, kPagesPerHugePage.raw_num());
+  EXPECT_FALSE(small[0].pt->relocation_donor());
+  EXPECT_NE(small[1].pt->relocation_donor(), small[2].pt->relocation_donor());
+
+  // Once the first hugepage is sparse too, any two can be relocated into the
+  // third.
+  Delete(rest[0]);
+  treat();
+  stats = GetHugePageTreatmentStats();
+  EXPECT_EQ(stats.relocation_donors, 2);
+  EXPECT_EQ(small[0].pt->relocation_donor() + small[1].pt->relocation_donor() +
+                small[2].pt->relocation_donor(),
+            2);
+
+  std::string buffer = PrintToString(1024 * 1024, [&](Printer& printer) {
+    PageHeapSpinLockHolder l;
+    filler_.Print(printer, true, pageflags);
+  });
+  EXPECT_THAT(buffer, testing::HasSubstr("HugePageFiller: 2 hugepages "
+                                         "nominated as relocation donors;"));
+
+  // Densely used hugepages are not worth evacuating.
+  PAlloc dense = Allocate(kPagesPerHugePage / 2);
+  treat();
+  EXPECT_FALSE(dense.pt->relocation_donor());
+
+  Delete(dense);
+  for (const PAlloc& a : small) {
+    Delete(a);
+  }
+}
+
+// Simulates rounds of allocations, half of which are short-lived and freed at
+// the end of the round, while the other half outlive several rounds.  Free
+// pages are released after each round.  Placing the short-lived spans on their
+// own hugepages lets those drain completely, rather than leaving the
+// long-lived spans on partially released hugepages.
+TEST_F(FillerTest, SpanLifetimesShareHugepagesByDefault) {
+  const SpanAllocInfo long_lived_info = {
+      .objects_per_span = 1,
+      .density = AccessDensityPrediction::kSparse,
+      .lifetime = SpanLifetimePrediction::kLongLived};
+  const SpanAllocInfo short_lived_info = {
+      .objects_per_span = 1,
+      .density = AccessDensityPrediction::kSparse,
+      .lifetime = SpanLifetimePrediction::kShortLived};
+  PAlloc a = AllocateWithSpanAllocInfo(Length(1), long_lived_info);
+  PAlloc b = AllocateWithSpanAllocInfo(Length(1), short_lived_info);
+  EXPECT_EQ(a.pt, b.pt);
+  Delete(a);
+  Delete(b);
+}
+
+TEST_F(FillerTestWithSeparateSpanLifetimes, SpanLifetimesUseOwnHugepages) {
+  const SpanAllocInfo long_lived_info = {
+      .objects_per_span = 1,
+      .density = AccessDensityPrediction::kSparse,
+      .lifetime = SpanLifetimePrediction::kLongLived};
+  const SpanAllocInfo short_lived_info = {
+      .objects_per_span = 1,
+      .density = AccessDensityPrediction::kSparse,
+      .lifetime = SpanLifetimePrediction::kShortLived};
+  PAlloc a = AllocateWithSpanAllocInfo(Length(1), long_lived_info);
+  PAlloc b = AllocateWithSpanAllocInfo(Length(1), short_lived_info);
+  PAlloc c = AllocateWithSpanAllocInfo(Length(1), short_lived_info);
+  EXPECT_NE(a.pt, b.pt);
+  EXPECT_EQ(b.pt, c.pt);
+  Delete(a);
+  Delete(b);
+  Delete(c);
+}
+
+TEST_F(FillerTestWithSeparateSpanLifetimes, SpanLifetimeSeparation) {
+  struct Result {
+    Length subreleased;
+    size_t released_hugepages = 0;
+  };
+  auto simulate = [&](SpanLifetimePrediction short_lived_prediction) {
+    const SpanAllocInfo long_lived_info = {
+        .objects_per_span = 1,
+        .density = AccessDensityPrediction::kSparse,
+        .lifetime = SpanLifetimePrediction::kLongLived};
+    const SpanAllocInfo short_lived_info = {
+        .objects_per_span = 1,
+        .density = AccessDensityPrediction::kSparse,
+        .lifetime = short_lived_prediction};
+    constexpr int kRounds = 20;
+    const int kSpans = 2 * kPagesPerHugePage.raw_num();
+    std::vector<PAlloc> long_lived;
+    size_t oldest = 0;
+    Result result;
+    for (int round = 0; round < kRounds; ++round) {
+      std::vector<PAlloc> short_lived;
+      for (int i = 0; i < kSpans; ++i) {
+        const Length n(1 + i % 4);
+        long_lived.push_back(AllocateWithSpanAllocInfo(n, long_lived_info));
+        short_lived.push_back(AllocateWithSpanAllocInfo(n, short_lived_info));
+      }
+      DeleteVector(short_lived);
+      for (int i = 0; i < kSpans / 4; ++i) {
+        Delete(long_lived[oldest++]);
+      }
+      result.subreleased += ReleasePages(kMaxValidPages);
+      result.released_hugepages +=
+          filler_.GetStats()
+              .n_released[AccessDensityPrediction::kPredictionCounts]
+              .raw_num();
+    }
+    DeleteRange(long_lived.begin() + oldest, long_lived.end());
+    return result;
+  };
+
+  const Result mixed = simulate(SpanLifetimePrediction::kLongLived);
+  const Result separated = simulate(SpanLifetimePrediction::kShortLived);
+  // With 8KiB pages, this leaves 3.4 rather than 37.0 partially released
+  // hugepages after each round, and subreleases 77% fewer pages.
+  EXPECT_LT(separated.released_hugepages * 4, mixed.released_hugepages);
+  EXPECT_LT(separated.subreleased * 2, mixed.subreleased);
+}
+
 TEST_F(FillerTest, ReleaseStaleFree) {
   // Disable randomization for predictable layout
   randomize_density_ = false;
@@ -5224,6 +5534,8 @@ HugePageFiller: Backoff delay for collapse currently is 1 interval(s), number of
 HugePageFiller: In the previous treatment interval, subreleased 0 pages.
 HugePageFiller: In the previous treatment interval, subreleased 0 stale pages.
 HugePageFiller: In the previous treatment interval, marked 0 unbacked pages as subreleased. Since startup, 0.
+HugePageFiller: Of sampled highly utilized hugepages, 0 were on a local NUMA node, 0 on a remote node; 0 migrated, 0 failed to migrate.
+HugePageFiller: 0 hugepages nominated as relocation donors; 0.0 MiB reclaimable via relocation.
 
 HugePageFiller: fullness histograms
 
@@ -25,6 +25,7 @@ namespace tcmalloc::tcmalloc_internal {
 enum class HugePageTreatmentType : uint8_t {
   kSampled = 1 << 0,
   kCollapse = 1 << 1,
+  kNumaPlacement = 1 << 2,
 };
 
 enum class EnableCollapse : uint8_t {
@@ -54,6 +55,21 @@ enum class ReleaseStalePages : bool {
   kEnabled = true,
 };
 
+enum class MigrateRemoteHugepages : bool {
+  kDisabled = false,
+  kEnabled = true,
+};
+
+enum class SeparateSpanLifetimes : bool {
+  kDisabled = false,
+  kEnabled = true,
+};
+
+enum class HugeRegionPreferBacked : bool {
+  kDisabled = false,
+  kEnabled = true,
+};
+
 enum class MadviseRegionsNoHugepage : bool {
   kDisabled = false,
   kEnabled = true,
@@ -228,6 +228,9 @@ class PageTracker : public TList<PageTracker>::Elem {
                     LargeSpanStats* absl_nullable large) const;
   bool HasDenseSpans() const { return has_dense_spans_; }
   void SetHasDenseSpans() { has_dense_spans_ = true; }
+  // Predicted lifetime of the spans that the filler places on this hugepage.
+  SpanLifetimePrediction lifetime() const { return lifetime_; }
+  void set_lifetime(SpanLifetimePrediction lifetime) { lifetime_ = lifetime; }
 
   struct HugePageResidencyState {
     // Records whether the page is hugepage backed.
@@ -307,6 +310,16 @@ class PageTracker : public TList<PageTracker>::Elem {
   }
   bool DontFreeTracker() const { return dont_free_tracker_mask_ != 0; }
 
+  // Tracks whether the filler nominated this hugepage as a relocation donor:
+  // were the allocations on it moved elsewhere, it could be freed whole.  Read
+  // without pageheap_lock by MallocExtension::ShouldRelocate.
+  bool relocation_donor() const {
+    return relocation_donor_.load(std::memory_order_relaxed);
+  }
+  void set_relocation_donor(bool status) {
+    relocation_donor_.store(status, std::memory_order_relaxed);
+  }
+
   struct TagState {
     bool sampled_for_tagging = false;
     double record_time = 0;
@@ -377,6 +390,7 @@ class PageTracker : public TList<PageTracker>::Elem {
                 "nallocs must be able to support kPagesPerHugePage!");
 
   bool has_dense_spans_ = false;
+  SpanLifetimePrediction lifetime_ = SpanLifetimePrediction::kLongLived;
 
   HugePageResidencyState hugepage_residency_state_;
 
@@ -387,6 +401,8 @@ class PageTracker : public TList<PageTracker>::Elem {
   // is checked to ensure that the tracker is not freed right away.
   uint8_t dont_free_tracker_mask_ = 0;
 
+  std::atomic<bool> relocation_donor_ = false;
+
   [[nodiscard]] bool ReleasePages(Range r, MemoryModifyFunction& unback) {
     bool success = unback(r).success;
     if (ABSL_PREDICT_TRUE(success)) {
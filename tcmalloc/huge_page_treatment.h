@@ -98,6 +98,11 @@ struct HugePageTreatmentStats {
   double collapse_time_total_cycles = 0;
   double collapse_time_max_cycles = 0;
   size_t collapse_intervals_skipped = 0;
+  NumaPlacementStats numa_placement;
+  // Hugepages nominated as relocation donors in the previous treatment
+  // interval, and the backed pages on them that relocation would free.
+  size_t relocation_donors = 0;
+  size_t relocation_reclaimable_pages = 0;
   static absl::string_view ErrorTypeToString(CollapseErrorType type) {
     switch (type) {
       case CollapseErrorType::kENoMem:
@@ -152,6 +157,9 @@ struct HugePageTreatmentStats {
       collapse_errors[i] += rhs.collapse_errors[i];
     }
     collapse_time_total_cycles += rhs.collapse_time_total_cycles;
+    numa_placement += rhs.numa_placement;
+    relocation_donors += rhs.relocation_donors;
+    relocation_reclaimable_pages += rhs.relocation_reclaimable_pages;
     // TODO(b/425749361): Add treated_pages_subreleased to the stats when we
     // start collecting cumulative stats.
     return *this;
@@ -296,6 +304,175 @@ class SampledTrackerTreatment final : public HugePageTreatment {
   int num_valid_trackers_ = 0;
 };
 
+// Checks which NUMA node backs highly utilized hugepages of a NUMA partition,
+// and optionally moves those found on another partition's nodes.  Memory can
+// end up remote if binding it failed or was disabled, or if released pages
+// were faulted back in by a thread running on another node.
+//
+// Each pass visits up to kTotalTrackersToScan hugepages, picking up where the
+// previous pass stopped, so that every candidate is sampled in turn.
+class NumaPlacementTreatment final : public HugePageTreatment {
+ public:
+  // Selects nothing if <numa_placement> is nullptr.  <start> is the number of
+  // eligible trackers to skip, as returned by the previous pass's next_start.
+  NumaPlacementTreatment(NumaPlacementFunction* absl_nullable numa_placement,
+                         MigrateRemoteHugepages migrate, size_t start)
+      : numa_placement_(numa_placement), migrate_(migrate), start_(start) {}
+  ~NumaPlacementTreatment() override = default;
+
+  static void operator delete(void*) { __builtin_trap(); }
+
+  void SelectEligibleTrackers(PageTracker& pt) override {
+    if (numa_placement_ == nullptr ||
+        num_valid_trackers_ >= kTotalTrackersToScan) {
+      return;
+    }
+    // Only the first page of a hugepage is queried, so skip released
+    // hugepages, which may have lost it.
+    if (pt.released() || pt.used_pages() < kMinUsedPages) return;
+    if (skipped_ < start_) {
+      ++skipped_;
+      return;
+    }
+    selected_trackers_[num_valid_trackers_] = &pt;
+    ++num_valid_trackers_;
+    pt.SetDontFreeTracker(HugePageTreatmentType::kNumaPlacement);
+  }
+
+  int num_valid_trackers() const override { return num_valid_trackers_; }
+
+  void Treat() ABSL_LOCKS_EXCLUDED(pageheap_lock) override {
+    TC_ASSERT_LE(num_valid_trackers_, kTotalTrackersToScan);
+    for (int i = 0; i < num_valid_trackers_; ++i) {
+      const Range r(selected_trackers_[i]->location().first_page(),
+                    kPagesPerHugePage);
+      const std::optional<bool> local = numa_placement_->IsLocal(r);
+      if (!local.has_value()) continue;
+      if (*local) {
+        ++stats_.hits;
+        continue;
+      }
+      ++stats_.misses;
+      if (migrate_ == MigrateRemoteHugepages::kDisabled) continue;
+      if (numa_placement_->MoveToLocal(r).success) {
+        ++stats_.migrated;
+      } else {
+        ++stats_.migration_failures;
+      }
+    }
+  }
+
+  void Restore() ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) override {
+    TC_ASSERT_LE(num_valid_trackers_, kTotalTrackersToScan);
+    for (int i = 0; i < num_valid_trackers_; ++i) {
+      selected_trackers_[i]->ClearDontFreeTracker(
+          HugePageTreatmentType::kNumaPlacement);
+    }
+  }
+
+  // Returns the <start> for the next pass: just past the trackers selected by
+  // this one, or back to the beginning once a pass runs out of candidates.
+  size_t next_start() const {
+    if (num_valid_trackers_ < kTotalTrackersToScan) return 0;
+    return start_ + num_valid_trackers_;
+  }
+
+  void UpdateHugePageTreatmentStats(HugePageTreatmentStats& stats) const {
+    stats.numa_placement += stats_;
+  }
+
+ private:
+  static constexpr size_t kTotalTrackersToScan = 64;
+  // Hugepages with at least this many pages in use are worth migrating.
+  static constexpr Length kMinUsedPages =
+      Length(kPagesPerHugePage.raw_num() * 3 / 4);
+
+  NumaPlacementFunction* absl_nullable numa_placement_;
+  MigrateRemoteHugepages migrate_;
+  size_t start_;
+  size_t skipped_ = 0;
+
+  std::array<PageTracker*, kTotalTrackersToScan> selected_trackers_;
+  int num_valid_trackers_ = 0;
+  NumaPlacementStats stats_;
+};
+
+// Nominates sparsely used hugepages as relocation donors, reported to
+// containers that can move their objects by MallocExtension::ShouldRelocate.
+// Were the few allocations pinning a donor moved elsewhere, it could be freed
+// whole rather than subreleased piecemeal.
+//
+// Donors are the hugepages with the fewest pages in use, taken for as long as
+// their backed pages fit in the free, backed pages of the filler: the
+// relocated allocations have to fit in what the other hugepages have free.
+// Nominations last until the next pass.
+//
+// Unlike the other treatments, nothing is done outside of pageheap_lock, so
+// this does not hold on to the selected trackers across an unlock.
+class RelocationDonorTreatment {
+ public:
+  // <free_pages> is the number of free, backed pages in the filler.
+  explicit RelocationDonorTreatment(Length free_pages)
+      : free_pages_(free_pages) {}
+
+  // Called on every tracker of the filler.  Keeps the kMaxDonors least used.
+  void SelectEligibleTrackers(PageTracker& pt)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
+    pt.set_relocation_donor(false);
+    // Donated hugepages hold the tail of a large allocation, which would have
+    // to move as a whole.
+    if (pt.donated() || pt.used_pages() > kMaxUsedPages) return;
+    PageTracker** const begin = candidates_.data();
+    if (num_candidates_ < kMaxDonors) {
+      begin[num_candidates_++] = &pt;
+      std::push_heap(begin, begin + num_candidates_, CompareUsedPages);
+    } else if (pt.used_pages() < begin[0]->used_pages()) {
+      // Replace the most used candidate.
+      std::pop_heap(begin, begin + num_candidates_, CompareUsedPages);
+      begin[num_candidates_ - 1] = &pt;
+      std::push_heap(begin, begin + num_candidates_, CompareUsedPages);
+    }
+  }
+
+  // Nominates donors from the selected trackers, least used first.
+  //
+  // REQUIRES: pageheap_lock has been held since SelectEligibleTrackers.
+  void Nominate() ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
+    PageTracker** const begin = candidates_.data();
+    std::sort_heap(begin, begin + num_candidates_, CompareUsedPages);
+    Length budget = free_pages_;
+    for (size_t i = 0; i < num_candidates_; ++i) {
+      PageTracker* pt = begin[i];
+      const Length backed = kPagesPerHugePage - pt->released_pages();
+      if (backed > budget) break;
+      budget -= backed;
+      pt->set_relocation_donor(true);
+      ++donors_;
+      reclaimable_ += backed;
+    }
+  }
+
+  void UpdateHugePageTreatmentStats(HugePageTreatmentStats& stats) const {
+    stats.relocation_donors = donors_;
+    stats.relocation_reclaimable_pages = reclaimable_.raw_num();
+  }
+
+ private:
+  static constexpr size_t kMaxDonors = 64;
+  // Hugepages with more pages than this in use are not worth evacuating.
+  static constexpr Length kMaxUsedPages = kPagesPerHugePage / 8;
+
+  static bool CompareUsedPages(const PageTracker* a, const PageTracker* b) {
+    return a->used_pages() < b->used_pages();
+  }
+
+  Length free_pages_;
+  std::array<PageTracker*, kMaxDonors> candidates_;
+  size_t num_candidates_ = 0;
+  size_t donors_ = 0;
+  Length reclaimable_;
+};
+
 template <class TrackerType>
 class HugePageUnbackedTrackerTreatment final : public HugePageTreatment {
  public:
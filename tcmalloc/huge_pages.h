@@ -135,6 +135,11 @@ inline constexpr HugeLength HLFromBytes(size_t bytes) {
   return NHugePages(bytes / kHugePageSize);
 }
 
+// 1GiB pages, the largest page size x86 and arm64 offer.  HugeAllocator and
+// HugeCache can optionally manage memory in aligned units of this size.
+inline constexpr size_t kGigaPageSize = size_t{1} << 30;
+inline constexpr HugeLength kHugePagesPerGigaPage = HLFromBytes(kGigaPageSize);
+
 // Rounds *up* to the nearest hugepage.
 TCMALLOC_ATTRIBUTE_CONST
 inline constexpr HugeLength HLFromPages(Length pages) {
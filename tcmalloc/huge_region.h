@@ -18,6 +18,7 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <limits>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -25,8 +26,11 @@
 #include "absl/base/nullability.h"
 #include "absl/base/optimization.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/time.h"
 #include "tcmalloc/huge_cache.h"
+#include "tcmalloc/huge_page_options.h"
 #include "tcmalloc/huge_pages.h"
+#include "tcmalloc/internal/clock.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/linked_list.h"
 #include "tcmalloc/internal/logging.h"
@@ -71,10 +75,14 @@ class HugeRegion : public TList<HugeRegion>::Elem {
   static constexpr size_t kNumHugePages = kRegionSize.raw_num();
   static constexpr HugeLength size() { return kRegionSize; }
 
+  // How far back the region remembers its demand (see FreeBackedOverDemand).
+  static constexpr absl::Duration kDemandHistory = absl::Minutes(5);
+
   // REQUIRES: r.len() == size(); r unbacked.
   HugeRegion(
       HugeRange r, MemoryModifyFunction& unback ABSL_ATTRIBUTE_LIFETIME_BOUND,
-      MemoryTagFunction& set_anon_vma_name ABSL_ATTRIBUTE_LIFETIME_BOUND);
+      MemoryTagFunction& set_anon_vma_name ABSL_ATTRIBUTE_LIFETIME_BOUND,
+      Clock clock = Clock{});
   HugeRegion() = delete;
 
   // If available, return a range of n free pages, setting *from_released =
@@ -83,6 +91,16 @@ class HugeRegion : public TList<HugeRegion>::Elem {
   bool MaybeGet(Length n, PageId* absl_nonnull p,
                 bool* absl_nonnull from_released);
 
+  // As MaybeGet, but only returns a range that lies entirely on hugepages that
+  // are already backed, choosing the smallest free gap of that kind that fits.
+  bool MaybeGetBacked(Length n, PageId* absl_nonnull p);
+
+  // If the n pages following r are free, extend r over them, setting
+  // *from_released = true iff any of them are currently unbacked.
+  // Returns false if they are not available.
+  // REQUIRES: r was the result of a previous MaybeGet (or MaybeGrow).
+  bool MaybeGrow(Range r, Length n, bool* absl_nonnull from_released);
+
   // Return r for new allocations.
   // If release=true, release any hugepages made empty as a result.
   // REQUIRES: Range{p, n} was the result of a previous MaybeGet.
@@ -94,6 +112,13 @@ class HugeRegion : public TList<HugeRegion>::Elem {
   // order, so we hope to release pages that won't be soon allocated.
   HugeLength Release(Length desired, bool adaptive_release);
 
+  // Returns how many of the free but backed hugepages are more than the region
+  // needed to meet its peak demand (hugepages with allocations on them) over
+  // the last <interval>, capped at kDemandHistory.
+  // REQUIRES: interval > 0.  Callers without an interval to honor should use a
+  // low water mark of free backed hugepages instead.
+  HugeLength FreeBackedOverDemand(absl::Duration interval) const;
+
   // Is p located in this region?
   [[nodiscard]] bool contains(PageId p) const { return location_.contains(p); }
 
@@ -132,6 +157,15 @@ class HugeRegion : public TList<HugeRegion>::Elem {
   void Print(Printer& out) const;
   void PrintInPbtxt(PbtxtRegion& detail) const;
 
+  // Number of buckets AddUsageHistogram fills: one for free backed hugepages,
+  // then kUsageBuckets - 1 equal slices of kPagesPerHugePage.
+  static constexpr size_t kUsageBuckets = 17;
+  // Adds the region's backed hugepages, bucketed by how many pages are used on
+  // each, to histo.
+  void AddUsageHistogram(size_t histo[kUsageBuckets]) const;
+  static void PrintUsageHistogram(PbtxtRegion& out,
+                                  const size_t histo[kUsageBuckets]);
+
   BackingStats stats() const;
 
   // We don't define this as operator< because it's a rather specialized order.
@@ -163,6 +197,10 @@ class HugeRegion : public TList<HugeRegion>::Elem {
   HugeLength total_unbacked_{NHugePages(0)};
   HugeLength free_backed_count_;
 
+  // Hugepages with allocations on them, over time.
+  HugeLength demand() const { return nbacked_ - free_backed_count_; }
+  MinMaxTracker<> demand_tracker_;
+
   MemoryModifyFunction& unback_;
 };
 
@@ -171,31 +209,49 @@ class HugeRegion : public TList<HugeRegion>::Elem {
 template <typename Region>
 class HugeRegionSet {
  public:
-  explicit HugeRegionSet(HugeRegionUsageOption use_huge_region_more_often)
+  explicit HugeRegionSet(
+      HugeRegionUsageOption use_huge_region_more_often,
+      HugeRegionPreferBacked prefer_backed = HugeRegionPreferBacked::kDisabled)
       : n_(0),
         use_huge_region_more_often_(use_huge_region_more_often),
+        prefer_backed_(prefer_backed),
         free_backed_count_(NHugePages(0)),
         lowater_free_backed_(NHugePages(0)) {}
 
   // If available, return a range of n free pages, setting *from_released =
   // true iff the returned range is currently unbacked.
   // Returns false if no range available.
+  //
+  // With prefer_backed enabled, regions holding a fully free backed hugepage
+  // are first searched for a range that needs no new hugepages backed.
   bool MaybeGet(Length n, PageId* absl_nonnull page,
                 bool* absl_nonnull from_released);
 
+  // If r belongs to a region and the n pages following it are free there,
+  // extend r over them, setting *from_released = true iff any of them are
+  // currently unbacked.  Returns false otherwise.
+  bool MaybeGrow(Range r, Length n, bool* absl_nonnull from_released);
+
   // Return an allocation to a region (if one matches!)
   bool MaybePut(Range r);
 
+  // Is p located in one of the regions?
+  [[nodiscard]] bool Contains(PageId p) const;
+
   // Add region to the set.
   void Contribute(Region* region);
 
   // Releases unused but backed hugepages from the set.
   // - If hit_limit is true, we release up to desired pages.
-  // - If hit_limit is false and use_adaptive is true, we release up to the
-  //   low water mark of free backed pages (capped by desired).
+  // - If hit_limit is false and use_adaptive is true, each region releases the
+  //   free backed hugepages it did not need to meet its peak demand over the
+  //   last demand_interval (see HugeRegion::FreeBackedOverDemand).  A zero
+  //   demand_interval instead releases the set's low water mark of free
+  //   backed hugepages since the last release.
   // - If hit_limit is false and use_adaptive is false, we release a fraction
   //   of the free backed pages.
-  Length ReleasePages(Length desired, bool use_adaptive, bool hit_limit);
+  Length ReleasePages(Length desired, bool use_adaptive, bool hit_limit,
+                      absl::Duration demand_interval = absl::ZeroDuration());
 
   void Print(Printer& out) const;
   void PrintInPbtxt(PbtxtRegion& hpaa) const;
@@ -275,6 +331,7 @@ class HugeRegionSet {
 
   size_t n_;
   HugeRegionUsageOption use_huge_region_more_often_;
+  HugeRegionPreferBacked prefer_backed_;
   // Sorted by longest_free increasing.
   TList<Region> list_;
   HugeLength free_backed_count_;
@@ -283,12 +340,13 @@ class HugeRegionSet {
 
 // REQUIRES: r.len() == size(); r unbacked.
 inline HugeRegion::HugeRegion(HugeRange r, MemoryModifyFunction& unback,
-                              MemoryTagFunction& set_anon_vma_name)
+                              MemoryTagFunction& set_anon_vma_name, Clock clock)
     : tracker_{},
       location_(r),
       pages_used_{},
       backed_{},
       nbacked_(NHugePages(0)),
+      demand_tracker_(clock, kDemandHistory),
       unback_(unback) {
   for (int i = 0; i < kNumHugePages; ++i) {
     // These are already 0 but for clarity...
@@ -317,6 +375,60 @@ inline bool HugeRegion::MaybeGet(Length n, PageId* p, bool* from_released) {
   return true;
 }
 
+inline bool HugeRegion::MaybeGetBacked(Length n, PageId* p) {
+  // free_pages() only counts pages on backed hugepages.
+  if (n > free_pages()) return false;
+  TC_ASSERT_GT(n, Length(0));
+
+  constexpr size_t kNoFit = std::numeric_limits<size_t>::max();
+  size_t best_index = 0, best_len = kNoFit;
+  auto consider = [&](size_t index, size_t len) {
+    if (len >= n.raw_num() && len < best_len) {
+      best_index = index;
+      best_len = len;
+    }
+  };
+
+  // Split each free range at the unbacked hugepages it crosses.  Regions have
+  // few free ranges in practice, so a linear walk is cheap enough.
+  size_t index = 0, len;
+  while (best_len != n.raw_num() &&
+         tracker_.NextFreeRange(index, &index, &len)) {
+    const size_t end = index + len;
+    size_t run_start = index;
+    for (size_t i = index; i < end;) {
+      const size_t hp = i / kPagesPerHugePage.raw_num();
+      const size_t hp_end =
+          std::min(end, (hp + 1) * kPagesPerHugePage.raw_num());
+      if (!backed_[hp]) {
+        consider(run_start, i - run_start);
+        run_start = hp_end;
+      }
+      i = hp_end;
+    }
+    consider(run_start, end - run_start);
+    index = end;
+  }
+  if (best_len == kNoFit) return false;
+
+  tracker_.Mark(best_index, n.raw_num());
+  *p = location_.start().first_page() + Length(best_index);
+  bool from_released;
+  Inc(Range{*p, n}, &from_released);
+  TC_ASSERT(!from_released);
+  return true;
+}
+
+inline bool HugeRegion::MaybeGrow(Range r, Length n, bool* from_released) {
+  TC_ASSERT(contains(r.p));
+  TC_ASSERT_GT(n, Length(0));
+  const Length end = r.p + r.n - location_.start().first_page();
+  if (!tracker_.MaybeExtend(end.raw_num(), n.raw_num())) return false;
+
+  Inc(Range{r.p + r.n, n}, from_released);
+  return true;
+}
+
 // If release=true, release any hugepages made empty as a result.
 inline void HugeRegion::Put(Range r, bool release) {
   Length index = r.p - location_.start().first_page();
@@ -326,10 +438,9 @@ inline void HugeRegion::Put(Range r, bool release) {
 }
 
 // Release hugepages that are unused but backed.
-// TODO(b/199203282): We release <desired> pages, rounded up to a hugepage, from
-// free but backed hugepages from the region. We can explore a more
-// sophisticated mechanism similar to Filler/Cache, that accounts for a recent
-// peak while releasing pages.
+// We release <desired> pages, rounded up to a hugepage, from free but backed
+// hugepages from the region.  Callers that want to keep enough backed memory
+// for a recent peak bound <desired> by FreeBackedOverDemand.
 inline HugeLength HugeRegion::Release(Length desired, bool adaptive_release) {
   if (desired == Length(0)) return NHugePages(0);
 
@@ -354,6 +465,18 @@ inline HugeLength HugeRegion::Release(Length desired, bool adaptive_release) {
   return UnbackHugepages(should_unback);
 }
 
+inline HugeLength HugeRegion::FreeBackedOverDemand(
+    absl::Duration interval) const {
+  TC_ASSERT_GT(interval, absl::ZeroDuration());
+
+  const HugeLength now = demand();
+  const HugeLength peak = std::max(
+      now, demand_tracker_.MaxOverTime(std::min(interval, kDemandHistory)));
+  const HugeLength reserve = peak - now;
+  return free_backed_count_ > reserve ? free_backed_count_ - reserve
+                                      : NHugePages(0);
+}
+
 inline void HugeRegion::AddSpanStats(SmallSpanStats* small,
                                      LargeSpanStats* large) const {
   size_t index = 0, n;
@@ -445,6 +568,35 @@ inline void HugeRegion::PrintInPbtxt(PbtxtRegion& detail) const {
   detail.PrintI64("unbacked_bytes", unbacked.in_bytes());
   detail.PrintI64("total_unbacked_bytes", total_unbacked_.in_bytes());
   detail.PrintI64("backed_fully_free_bytes", free_backed().in_bytes());
+
+  size_t histo[kUsageBuckets] = {};
+  AddUsageHistogram(histo);
+  PrintUsageHistogram(detail, histo);
+}
+
+inline void HugeRegion::AddUsageHistogram(size_t histo[kUsageBuckets]) const {
+  constexpr size_t kSlice = kPagesPerHugePage.raw_num() / (kUsageBuckets - 1);
+  static_assert(kSlice > 0);
+  for (size_t i = 0; i < kNumHugePages; ++i) {
+    if (!backed_[i]) continue;
+    const size_t used = pages_used_[i].raw_num();
+    histo[used == 0 ? 0
+                    : std::min(1 + (used - 1) / kSlice, kUsageBuckets - 1)]++;
+  }
+}
+
+inline void HugeRegion::PrintUsageHistogram(
+    PbtxtRegion& out, const size_t histo[kUsageBuckets]) {
+  constexpr size_t kSlice = kPagesPerHugePage.raw_num() / (kUsageBuckets - 1);
+  for (size_t i = 0; i < kUsageBuckets; ++i) {
+    auto hist = out.CreateSubRegion("used_pages_histogram");
+    hist.PrintI64("lower_bound", i == 0 ? 0 : (i - 1) * kSlice + 1);
+    hist.PrintI64("upper_bound", i == 0 ? 0
+                                 : i == kUsageBuckets - 1
+                                     ? kPagesPerHugePage.raw_num()
+                                     : i * kSlice);
+    hist.PrintI64("value", histo[i]);
+  }
 }
 
 inline BackingStats HugeRegion::stats() const {
@@ -477,6 +629,7 @@ inline void HugeRegion::Inc(Range r, bool* from_released) {
     r.p += here;
     r.n -= here;
   }
+  demand_tracker_.Report(demand());
   *from_released = should_back;
 }
 
@@ -498,6 +651,7 @@ inline void HugeRegion::Dec(Range r, bool release) {
     r.p += here;
     r.n -= here;
   }
+  demand_tracker_.Report(demand());
   if (release) {
     UnbackHugepages(should_unback);
   }
@@ -574,6 +728,31 @@ inline HugeLength HugeRegion::UnbackHugepages(
 template <typename Region>
 inline bool HugeRegionSet<Region>::MaybeGet(Length n, PageId* page,
                                             bool* from_released) {
+  // Prefer space that is already backed, so we neither fault in new hugepages
+  // nor drain the free backed ones another region is keeping for its demand.
+  // Only regions with a fully free backed hugepage are searched, and we stop
+  // once all of the set's free backed hugepages have been visited.
+  if (prefer_backed_ == HugeRegionPreferBacked::kEnabled) {
+    HugeLength unvisited = free_backed_count_;
+    for (Region* region : list_) {
+      if (unvisited == NHugePages(0)) break;
+      const HugeLength before = region->free_backed();
+      if (before == NHugePages(0)) continue;
+      if (region->MaybeGetBacked(n, page)) {
+        HugeLength after = region->free_backed();
+        TC_ASSERT_LE(after, before);
+        HugeLength diff = before - after;
+        TC_ASSERT_GE(free_backed_count_, diff);
+        free_backed_count_ -= diff;
+        lowater_free_backed_ =
+            std::min(lowater_free_backed_, free_backed_count_);
+        Fix(region);
+        *from_released = false;
+        return true;
+      }
+      unvisited -= std::min(unvisited, before);
+    }
+  }
   for (Region* region : list_) {
     HugeLength before = region->free_backed();
     if (region->MaybeGet(n, page, from_released)) {
@@ -590,6 +769,26 @@ inline bool HugeRegionSet<Region>::MaybeGet(Length n, PageId* page,
   return false;
 }
 
+template <typename Region>
+inline bool HugeRegionSet<Region>::MaybeGrow(Range r, Length n,
+                                             bool* from_released) {
+  for (Region* region : list_) {
+    if (!region->contains(r.p)) continue;
+
+    HugeLength before = region->free_backed();
+    if (!region->MaybeGrow(r, n, from_released)) return false;
+    HugeLength after = region->free_backed();
+    TC_ASSERT_LE(after, before);
+    HugeLength diff = before - after;
+    TC_ASSERT_GE(free_backed_count_, diff);
+    free_backed_count_ -= diff;
+    lowater_free_backed_ = std::min(lowater_free_backed_, free_backed_count_);
+    Fix(region);
+    return true;
+  }
+  return false;
+}
+
 // Return an allocation to a region (if one matches!)
 template <typename Region>
 inline bool HugeRegionSet<Region>::MaybePut(Range r) {
@@ -612,6 +811,14 @@ inline bool HugeRegionSet<Region>::MaybePut(Range r) {
   return false;
 }
 
+template <typename Region>
+inline bool HugeRegionSet<Region>::Contains(PageId p) const {
+  for (const Region* region : list_) {
+    if (region->contains(p)) return true;
+  }
+  return false;
+}
+
 // Add region to the set.
 template <typename Region>
 inline void HugeRegionSet<Region>::Contribute(Region* region) {
@@ -621,13 +828,20 @@ inline void HugeRegionSet<Region>::Contribute(Region* region) {
 }
 
 template <typename Region>
-inline Length HugeRegionSet<Region>::ReleasePages(Length desired,
-                                                  bool use_adaptive,
-                                                  bool hit_limit) {
+inline Length HugeRegionSet<Region>::ReleasePages(
+    Length desired, bool use_adaptive, bool hit_limit,
+    absl::Duration demand_interval) {
+  const bool per_region_demand =
+      use_adaptive && !hit_limit && demand_interval > absl::ZeroDuration();
   Length to_release;
   if (hit_limit) {
     to_release = desired;
+  } else if (per_region_demand) {
+    // Bounded per region below.
+    to_release = Length::max();
   } else if (use_adaptive) {
+    // With no demand history to honor, keep the free backed hugepages the set
+    // dipped into since the last release.
     to_release = lowater_free_backed_.in_pages();
   } else {
     to_release =
@@ -638,6 +852,12 @@ inline Length HugeRegionSet<Region>::ReleasePages(Length desired,
   Length released;
   auto release_from_region = [&](Region& region) {
     Length region_target = to_release - released;
+    if (per_region_demand) {
+      region_target =
+          std::min(region_target,
+                   region.FreeBackedOverDemand(demand_interval).in_pages());
+      if (region_target == Length(0)) return;
+    }
 
     Length region_released =
         region.Release(region_target, use_adaptive).in_pages();
@@ -700,10 +920,30 @@ inline void HugeRegionSet<Region>::PrintInPbtxt(PbtxtRegion& hpaa) const {
   hpaa.PrintI64("huge_region_size", Region::size().in_bytes());
   hpaa.PrintI64("huge_region_low_water_mark_bytes",
                 lowater_free_backed_.in_bytes());
+
+  // Regions by the fraction of their hugepages that are backed, in tenths, and
+  // backed hugepages across all regions by how many pages are used on them.
+  constexpr size_t kResidencyBuckets = 10;
+  size_t residency[kResidencyBuckets + 1] = {};
+  size_t usage[Region::kUsageBuckets] = {};
   for (Region* region : list_) {
     auto detail = hpaa.CreateSubRegion("huge_region_details");
     region->PrintInPbtxt(detail);
+
+    residency[region->backed().raw_num() * kResidencyBuckets /
+              Region::size().raw_num()]++;
+    region->AddUsageHistogram(usage);
+  }
+  for (size_t i = 0; i <= kResidencyBuckets; ++i) {
+    auto hist = hpaa.CreateSubRegion("huge_region_residency_histogram");
+    hist.PrintI64("lower_bound", i * 100 / kResidencyBuckets);
+    hist.PrintI64("upper_bound", i == kResidencyBuckets
+                                     ? 100
+                                     : (i + 1) * 100 / kResidencyBuckets - 1);
+    hist.PrintI64("value", residency[i]);
   }
+  auto usage_region = hpaa.CreateSubRegion("huge_region_usage");
+  Region::PrintUsageHistogram(usage_region, usage);
 }
 
 template <typename Region>
@@ -216,6 +216,72 @@ TEST_F(HugeRegionTest, ReqsBacking) {
   }
 }
 
+TEST_F(HugeRegionTest, MaybeGrow) {
+  const Length n = kPagesPerHugePage;
+  bool from_released;
+  Alloc a = Allocate(n - Length(1));
+  Alloc b = Allocate(Length(1));
+  ASSERT_EQ(a.p + a.n, b.p);
+
+  // b is in the way.
+  EXPECT_FALSE(region_.MaybeGrow(Range(a.p, a.n), Length(1), &from_released));
+  Delete(b);
+
+  // Growing within the first (backed) hugepage...
+  ASSERT_TRUE(region_.MaybeGrow(Range(a.p, a.n), Length(1), &from_released));
+  EXPECT_FALSE(from_released);
+  a.n += Length(1);
+  Mark(a);
+  EXPECT_EQ(region_.used_pages(), a.n);
+
+  // ...and onto the next one, which needs backing.
+  ASSERT_TRUE(region_.MaybeGrow(Range(a.p, a.n), n, &from_released));
+  EXPECT_TRUE(from_released);
+  a.n += n;
+  Mark(a);
+  EXPECT_EQ(region_.used_pages(), a.n);
+
+  // Nothing past the end of the region.
+  EXPECT_FALSE(region_.MaybeGrow(Range(a.p, a.n), region_.size().in_pages(),
+                                 &from_released));
+
+  Delete(a);
+  EXPECT_EQ(region_.used_pages(), Length(0));
+}
+
+TEST_F(HugeRegionTest, MaybeGetBacked) {
+  const Length n = kPagesPerHugePage;
+  Alloc a = Allocate(2 * n);
+  Alloc b = Allocate(3 * n);
+  Alloc c = Allocate(Length(1));
+  Delete(b);
+  // Hugepages 2-4 are free and backed; the rest of hugepage 5 is free and
+  // backed, but adjoins the unbacked remainder of the region.
+  EXPECT_EQ(region_.free_backed(), NHugePages(3));
+
+  PageId p;
+  // Plain best-fit would take the start of the three-hugepage gap.
+  ASSERT_TRUE(region_.MaybeGetBacked(n / 2, &p));
+  EXPECT_EQ(p, c.p + Length(1));
+  region_.Put(Range(p, n / 2), false);
+
+  // Nothing backed is big enough...
+  EXPECT_FALSE(region_.MaybeGetBacked(4 * n, &p));
+  EXPECT_FALSE(region_.MaybeGetBacked(region_.size().in_pages(), &p));
+
+  // ...but an exact fit is.
+  ASSERT_TRUE(region_.MaybeGetBacked(3 * n, &p));
+  EXPECT_EQ(p, b.p);
+  EXPECT_EQ(region_.free_backed(), NHugePages(0));
+  region_.Put(Range(p, 3 * n), false);
+
+  // The gap was just in use, so the recent peak keeps all of it backed.
+  EXPECT_EQ(region_.FreeBackedOverDemand(absl::Minutes(1)), NHugePages(0));
+
+  Delete(a);
+  Delete(c);
+}
+
 TEST_F(HugeRegionTest, ReleaseFrac) {
   const Length n = kPagesPerHugePage;
   bool from_released;
@@ -795,31 +861,77 @@ class HugeRegionSetTest
  protected:
   typedef HugeRegion Region;
 
-  HugeRegionSetTest() : set_(/*use_huge_region_more_often=*/GetParam()) {
+  HugeRegionSetTest()
+      : set_(/*use_huge_region_more_often=*/GetParam()),
+        prefer_backed_set_(/*use_huge_region_more_often=*/GetParam(),
+                           HugeRegionPreferBacked::kEnabled) {
     next_ = HugePageContaining(nullptr);
   }
 
   std::unique_ptr<Region> GetRegion() {
     // These regions are backed by "real" memory, but we don't touch it.
     std::unique_ptr<Region> r = std::make_unique<Region>(
-        HugeRange{next_, Region::size()}, nil_unback_, nil_set_anon_vma_name_);
+        HugeRange{next_, Region::size()}, nil_unback_, nil_set_anon_vma_name_,
+        Clock{.now = FakeClock, .freq = GetFakeClockFrequency});
     next_ += Region::size();
     return r;
   }
 
   bool UseHugeRegionMoreOften() const { return set_.UseHugeRegionMoreOften(); }
 
+  struct Alloc {
+    PageId p;
+    Length n;
+  };
+
+  struct BackedPreference {
+    std::unique_ptr<Region> r1, r2;
+    Alloc a, b, c;
+  };
+
+  // Leaves r1 with a free hugepage (a) in front of an allocation (b), and
+  // contributes r2, whose allocation c makes it first in best-fit order.
+  BackedPreference SetUpBackedPreference(HugeRegionSet<Region>& set) {
+    constexpr Length kSize = kPagesPerHugePage;
+    bool from_released;
+    BackedPreference s;
+    s.r1 = GetRegion();
+    set.Contribute(s.r1.get());
+    s.a.n = s.b.n = kSize;
+    TC_CHECK(set.MaybeGet(kSize, &s.a.p, &from_released));
+    TC_CHECK(set.MaybeGet(kSize, &s.b.p, &from_released));
+    TC_CHECK(set.MaybePut(Range(s.a.p, s.a.n)));
+
+    s.r2 = GetRegion();
+    s.c.n = 4 * kSize;
+    TC_CHECK(s.r2->MaybeGet(s.c.n, &s.c.p, &from_released));
+    set.Contribute(s.r2.get());
+    return s;
+  }
+
+  static void Advance(absl::Duration d) {
+    clock_ += absl::ToDoubleSeconds(d) * GetFakeClockFrequency();
+  }
+  static int64_t FakeClock() { return clock_; }
+  static double GetFakeClockFrequency() {
+    return absl::ToDoubleNanoseconds(absl::Seconds(2));
+  }
+
+  // How far back adaptive release looks for peak demand.
+  static constexpr absl::Duration kDemandInterval = absl::Minutes(1);
+
   NilUnback nil_unback_;
   NilMemoryTagFunction nil_set_anon_vma_name_;
   HugeRegionSet<Region> set_;
+  HugeRegionSet<Region> prefer_backed_set_;
   HugePage next_;
 
-  struct Alloc {
-    PageId p;
-    Length n;
-  };
+ private:
+  static int64_t clock_;
 };
 
+int64_t HugeRegionSetTest::clock_{0};
+
 TEST_P(HugeRegionSetTest, Release) {
   absl::BitGen rng;
   PageId p;
@@ -880,14 +992,16 @@ TEST_P(HugeRegionSetTest, ReleaseAdaptive) {
     ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
   }
 
-  // Adaptive release limit is 0, so ReleasePages should release nothing.
-  Length released = set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
-                                      /*hit_limit=*/false);
+  // The region needed all of its hugepages within the interval, so
+  // ReleasePages should release nothing.
+  Length released =
+      set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
+                        /*hit_limit=*/false, kDemandInterval);
   EXPECT_EQ(released.in_pages(), Length(0));
 
-  // Adaptive release limit is now reset to free_backed_count (which is
-  // the total size of region since we put all back).
+  // Once that peak ages out, only the new demand is kept.
   // Let's allocate some.
+  Advance(2 * kDemandInterval);
   size_t to_alloc = allocs.size() / 2;
 
   std::vector<Alloc> active_allocs;
@@ -901,11 +1015,11 @@ TEST_P(HugeRegionSetTest, ReleaseAdaptive) {
     ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
   }
 
-  // Now free_backed is back to full, but adaptive release limit is full -
-  // to_alloc. Verify we release up to the adaptive release limit (low water
-  // mark) when use_adaptive is enabled.
+  // Now free_backed is back to full, but the recent peak demand was to_alloc.
+  // Verify we release everything above that peak when use_adaptive is
+  // enabled.
   released = set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
-                               /*hit_limit=*/false);
+                               /*hit_limit=*/false, kDemandInterval);
   const Length expected_released =
       NHugePages(allocs.size() - to_alloc).in_pages();
 
@@ -937,14 +1051,15 @@ TEST_P(HugeRegionSetTest, ReleaseAdaptiveWithLimit) {
     ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
   }
 
-  // Low water mark is 0, so ReleasePages should release nothing.
-  Length released = set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
-                                      /*hit_limit=*/false);
+  // Peak demand covers the whole region, so ReleasePages should release
+  // nothing.
+  Length released =
+      set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
+                        /*hit_limit=*/false, kDemandInterval);
   EXPECT_EQ(released.in_pages(), Length(0));
 
-  // Adaptive release limit is now reset to free_backed_count (which is
-  // the total size of region since we put all back).
-  // Let's allocate some.
+  // Let the peak age out and allocate some.
+  Advance(2 * kDemandInterval);
   size_t to_alloc = allocs.size() / 2;
   std::vector<Alloc> active_allocs;
   for (size_t i = 0; i < to_alloc; ++i) {
@@ -957,19 +1072,18 @@ TEST_P(HugeRegionSetTest, ReleaseAdaptiveWithLimit) {
     ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
   }
 
-  // Now free_backed is back to full, but adaptive release limit is full -
-  // to_alloc.
+  // Now free_backed is back to full, but the recent peak demand was to_alloc.
   const Length expected_released =
       NHugePages(allocs.size() - to_alloc).in_pages();
 
   // We pass a limit which is less than expected_released.
   // Since use_adaptive is true and hit_limit is false, this limit (desired)
-  // should be ignored, and we should release up to the low water mark.
+  // should be ignored, and we should release everything above the peak.
   Length limit = kPagesPerHugePage;
   ASSERT_LT(limit, expected_released);
 
   released = set_.ReleasePages(limit, /*use_adaptive=*/true,
-                               /*hit_limit=*/false);
+                               /*hit_limit=*/false, kDemandInterval);
 
   EXPECT_EQ(released, expected_released);
 }
@@ -997,8 +1111,8 @@ TEST_P(HugeRegionSetTest, ReleaseAdaptiveWithHitLimit) {
     ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
   }
 
-  // Low water mark is 0. If we call ReleasePages with hit_limit = false,
-  // it would release nothing.
+  // Peak demand covers the whole region. If we call ReleasePages with
+  // hit_limit = false, it would release nothing.
   // But with hit_limit = true, it should release everything.
   Length released = set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
                                       /*hit_limit=*/true);
@@ -1065,6 +1179,87 @@ TEST_P(HugeRegionSetTest, ReleaseAdaptiveOrder) {
   ASSERT_TRUE(set_.MaybePut(Range(r1_allocs[0].p, r1_allocs[0].n)));
 }
 
+TEST_P(HugeRegionSetTest, ReleaseAdaptiveWithoutInterval) {
+  if (!UseHugeRegionMoreOften()) {
+    return;
+  }
+
+  PageId p;
+  constexpr Length kSize = kPagesPerHugePage;
+  bool from_released;
+  auto r1 = GetRegion();
+  set_.Contribute(r1.get());
+
+  std::vector<Alloc> allocs;
+  while (set_.MaybeGet(kSize, &p, &from_released)) {
+    allocs.push_back({p, kSize});
+  }
+  for (auto a : allocs) {
+    ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
+  }
+
+  // The set had no free backed hugepages at its low water mark, so a zero
+  // interval must not release them all.
+  Length released = set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
+                                      /*hit_limit=*/false,
+                                      absl::ZeroDuration());
+  EXPECT_EQ(released, Length(0));
+  EXPECT_EQ(r1->free_backed(), Region::size());
+
+  // Reuse half of them; the other half sat idle since the last release.
+  const size_t to_alloc = allocs.size() / 2;
+  std::vector<Alloc> active_allocs;
+  for (size_t i = 0; i < to_alloc; ++i) {
+    ASSERT_TRUE(set_.MaybeGet(kSize, &p, &from_released));
+    active_allocs.push_back({p, kSize});
+  }
+  for (auto a : active_allocs) {
+    ASSERT_TRUE(set_.MaybePut(Range(a.p, a.n)));
+  }
+
+  released = set_.ReleasePages(Length::max(), /*use_adaptive=*/true,
+                               /*hit_limit=*/false, absl::ZeroDuration());
+  EXPECT_EQ(released, NHugePages(allocs.size() - to_alloc).in_pages());
+}
+
+TEST_P(HugeRegionSetTest, PrefersBackedPages) {
+  constexpr Length kSize = kPagesPerHugePage;
+  BackedPreference s = SetUpBackedPreference(prefer_backed_set_);
+
+  PageId p;
+  bool from_released;
+  ASSERT_TRUE(prefer_backed_set_.MaybeGet(kSize / 2, &p, &from_released));
+  if (UseHugeRegionMoreOften()) {
+    // r1's hugepage stayed backed, and is preferred to backing a new one.
+    EXPECT_EQ(p, s.a.p);
+    EXPECT_FALSE(from_released);
+  } else {
+    // The hugepage was released on Put, so there is nothing backed to prefer.
+    EXPECT_TRUE(s.r2->contains(p));
+    EXPECT_TRUE(from_released);
+  }
+  ASSERT_TRUE(prefer_backed_set_.MaybePut(Range(p, kSize / 2)));
+
+  ASSERT_TRUE(prefer_backed_set_.MaybePut(Range(s.b.p, s.b.n)));
+  ASSERT_TRUE(prefer_backed_set_.MaybePut(Range(s.c.p, s.c.n)));
+}
+
+TEST_P(HugeRegionSetTest, BackedPreferenceIsOffByDefault) {
+  constexpr Length kSize = kPagesPerHugePage;
+  BackedPreference s = SetUpBackedPreference(set_);
+
+  // Plain best-fit picks r2, even when r1 has a free backed hugepage.
+  PageId p;
+  bool from_released;
+  ASSERT_TRUE(set_.MaybeGet(kSize / 2, &p, &from_released));
+  EXPECT_TRUE(s.r2->contains(p));
+  EXPECT_TRUE(from_released);
+  ASSERT_TRUE(set_.MaybePut(Range(p, kSize / 2)));
+
+  ASSERT_TRUE(set_.MaybePut(Range(s.b.p, s.b.n)));
+  ASSERT_TRUE(set_.MaybePut(Range(s.c.p, s.c.n)));
+}
+
 TEST_P(HugeRegionSetTest, Set) {
   absl::BitGen rng;
   PageId p;
@@ -1168,6 +1363,10 @@ TEST_P(HugeRegionSetTest, Set) {
   set_.PrintInPbtxt(region);
   EXPECT_THAT(absl::string_view(&pbtxt_buf[0]),
               testing::HasSubstr("huge_region_low_water_mark_bytes: 0"));
+  EXPECT_THAT(absl::string_view(&pbtxt_buf[0]),
+              testing::HasSubstr("huge_region_residency_histogram"));
+  EXPECT_THAT(absl::string_view(&pbtxt_buf[0]),
+              testing::HasSubstr("used_pages_histogram"));
 }
 
 TEST_P(HugeRegionSetTest, GetPageAllocationStatus) {
@@ -0,0 +1,134 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/internal/cgroup.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <optional>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/util.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+// Reads dir/name into buf, returning the contents, or std::nullopt if the
+// file could not be read.  Contents longer than size are truncated, which
+// is fine for the small files parsed here.
+std::optional<absl::string_view> ReadFile(const char* dir, const char* name,
+                                          char* buf, size_t size) {
+  char path[PATH_MAX];
+  const int n = snprintf(path, sizeof(path), "%s/%s", dir, name);
+  if (n < 0 || n >= sizeof(path)) {
+    return std::nullopt;
+  }
+
+  const int fd = signal_safe_open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+  size_t bytes_read = 0;
+  const ssize_t ret = signal_safe_read(fd, buf, size, &bytes_read);
+  signal_safe_close(fd);
+  if (ret < 0) {
+    return std::nullopt;
+  }
+  return absl::string_view(buf, bytes_read);
+}
+
+}  // namespace
+
+std::optional<size_t> ParseCgroupMemoryLimit(absl::string_view contents) {
+  contents = absl::StripAsciiWhitespace(contents);
+  if (contents == "max") {
+    return CgroupMemoryState::kUnlimited;
+  }
+  size_t limit;
+  if (!absl::SimpleAtoi(contents, &limit)) {
+    return std::nullopt;
+  }
+  return limit;
+}
+
+std::optional<double> ParseCgroupPressureAvg10(absl::string_view contents,
+                                               absl::string_view kind) {
+  // Lines look like:
+  //   some avg10=0.12 avg60=0.05 avg300=0.01 total=123456
+  while (!contents.empty()) {
+    absl::string_view line = contents;
+    const size_t eol = contents.find('\n');
+    if (eol != absl::string_view::npos) {
+      line = contents.substr(0, eol);
+      contents.remove_prefix(eol + 1);
+    } else {
+      contents = absl::string_view();
+    }
+
+    if (!absl::ConsumePrefix(&line, kind) ||
+        !absl::ConsumePrefix(&line, " avg10=")) {
+      continue;
+    }
+    line = line.substr(0, line.find(' '));
+    double avg10;
+    if (!absl::SimpleAtod(line, &avg10)) {
+      return std::nullopt;
+    }
+    return avg10;
+  }
+  return std::nullopt;
+}
+
+bool ReadCgroupMemoryState(const char* dir, CgroupMemoryState& state) {
+  state = CgroupMemoryState{};
+  bool found = false;
+  char buf[256];
+
+  if (auto contents = ReadFile(dir, "memory.max", buf, sizeof(buf))) {
+    if (auto limit = ParseCgroupMemoryLimit(*contents)) {
+      state.max = *limit;
+      found = true;
+    }
+  }
+  if (auto contents = ReadFile(dir, "memory.high", buf, sizeof(buf))) {
+    if (auto limit = ParseCgroupMemoryLimit(*contents)) {
+      state.high = *limit;
+      found = true;
+    }
+  }
+  if (auto contents = ReadFile(dir, "memory.pressure", buf, sizeof(buf))) {
+    if (auto some = ParseCgroupPressureAvg10(*contents, "some")) {
+      state.pressure_some_avg10 = *some;
+      found = true;
+    }
+    if (auto full = ParseCgroupPressureAvg10(*contents, "full")) {
+      state.pressure_full_avg10 = *full;
+      found = true;
+    }
+  }
+  return found;
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
@@ -0,0 +1,65 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_INTERNAL_CGROUP_H_
+#define TCMALLOC_INTERNAL_CGROUP_H_
+
+#include <stddef.h>
+
+#include <limits>
+#include <optional>
+
+#include "absl/strings/string_view.h"
+#include "tcmalloc/internal/config.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+// Snapshot of the cgroup v2 memory controller files TCMalloc consults.
+struct CgroupMemoryState {
+  static constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
+
+  // memory.max and memory.high, in bytes.  kUnlimited if the file reads "max"
+  // or is missing (e.g. in the root cgroup).
+  size_t max = kUnlimited;
+  size_t high = kUnlimited;
+  // The "some" and "full" avg10 values of memory.pressure: the percentage of
+  // the last 10 seconds in which some (resp. all) tasks were stalled on
+  // memory.  0 if pressure stall information is unavailable.
+  double pressure_some_avg10 = 0;
+  double pressure_full_avg10 = 0;
+
+  // Returns the tighter of max and high.
+  size_t limit() const { return high < max ? high : max; }
+};
+
+// Parses the contents of memory.max or memory.high.
+std::optional<size_t> ParseCgroupMemoryLimit(absl::string_view contents);
+
+// Parses the avg10 field of the line of memory.pressure named kind ("some" or
+// "full").
+std::optional<double> ParseCgroupPressureAvg10(absl::string_view contents,
+                                               absl::string_view kind);
+
+// Reads memory.max, memory.high, and memory.pressure from the cgroup v2
+// directory dir into state.  Returns false if none of them could be read.
+// This does not allocate.
+bool ReadCgroupMemoryState(const char* dir, CgroupMemoryState& state);
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_INTERNAL_CGROUP_H_
@@ -0,0 +1,124 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/internal/cgroup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <optional>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+using ::testing::Optional;
+
+constexpr size_t kUnlimited = CgroupMemoryState::kUnlimited;
+
+TEST(CgroupTest, ParseMemoryLimit) {
+  EXPECT_THAT(ParseCgroupMemoryLimit("max\n"), Optional(kUnlimited));
+  EXPECT_THAT(ParseCgroupMemoryLimit("1073741824\n"), Optional(1073741824));
+  EXPECT_THAT(ParseCgroupMemoryLimit("0"), Optional(0));
+  EXPECT_EQ(ParseCgroupMemoryLimit(""), std::nullopt);
+  EXPECT_EQ(ParseCgroupMemoryLimit("-1"), std::nullopt);
+  EXPECT_EQ(ParseCgroupMemoryLimit("12 KiB"), std::nullopt);
+}
+
+TEST(CgroupTest, ParsePressure) {
+  constexpr absl::string_view kPressure =
+      "some avg10=12.50 avg60=3.00 avg300=1.00 total=123456\n"
+      "full avg10=2.25 avg60=0.50 avg300=0.10 total=23456\n";
+  EXPECT_THAT(ParseCgroupPressureAvg10(kPressure, "some"), Optional(12.5));
+  EXPECT_THAT(ParseCgroupPressureAvg10(kPressure, "full"), Optional(2.25));
+  EXPECT_EQ(ParseCgroupPressureAvg10(kPressure, "none"), std::nullopt);
+
+  // Older kernels only report "some".
+  EXPECT_THAT(ParseCgroupPressureAvg10(
+                  "some avg10=0.00 avg60=0.00 avg300=0.00 total=0", "some"),
+              Optional(0.0));
+  EXPECT_EQ(ParseCgroupPressureAvg10(
+                "some avg10=0.00 avg60=0.00 avg300=0.00 total=0", "full"),
+            std::nullopt);
+  EXPECT_EQ(ParseCgroupPressureAvg10("some avg10=bad", "some"), std::nullopt);
+}
+
+class FakeCgroup {
+ public:
+  FakeCgroup() {
+    std::string tmpl =
+        absl::StrCat(::testing::TempDir(), "/cgroup_test_XXXXXX");
+    dir_ = mkdtemp(tmpl.data());
+    EXPECT_FALSE(dir_.empty());
+  }
+
+  ~FakeCgroup() {
+    for (const char* name : {"memory.max", "memory.high", "memory.pressure"}) {
+      unlink(absl::StrCat(dir_, "/", name).c_str());
+    }
+    rmdir(dir_.c_str());
+  }
+
+  void Write(absl::string_view name, absl::string_view contents) {
+    FILE* f = fopen(absl::StrCat(dir_, "/", name).c_str(), "w");
+    ASSERT_NE(f, nullptr);
+    fwrite(contents.data(), 1, contents.size(), f);
+    fclose(f);
+  }
+
+  const char* dir() const { return dir_.c_str(); }
+
+ private:
+  std::string dir_;
+};
+
+TEST(CgroupTest, ReadMissing) {
+  FakeCgroup cgroup;
+  CgroupMemoryState state;
+  EXPECT_FALSE(ReadCgroupMemoryState(cgroup.dir(), state));
+  EXPECT_EQ(state.limit(), kUnlimited);
+}
+
+TEST(CgroupTest, Read) {
+  FakeCgroup cgroup;
+  cgroup.Write("memory.max", "4294967296\n");
+  cgroup.Write("memory.high", "max\n");
+  cgroup.Write("memory.pressure",
+               "some avg10=7.00 avg60=3.00 avg300=1.00 total=123456\n"
+               "full avg10=1.00 avg60=0.50 avg300=0.10 total=23456\n");
+
+  CgroupMemoryState state;
+  ASSERT_TRUE(ReadCgroupMemoryState(cgroup.dir(), state));
+  EXPECT_EQ(state.max, 4294967296);
+  EXPECT_EQ(state.high, kUnlimited);
+  EXPECT_EQ(state.limit(), 4294967296);
+  EXPECT_EQ(state.pressure_some_avg10, 7);
+  EXPECT_EQ(state.pressure_full_avg10, 1);
+
+  cgroup.Write("memory.high", "1073741824\n");
+  ASSERT_TRUE(ReadCgroupMemoryState(cgroup.dir(), state));
+  EXPECT_EQ(state.high, 1073741824);
+  EXPECT_EQ(state.limit(), 1073741824);
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
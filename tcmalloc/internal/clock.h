@@ -61,9 +61,18 @@ class Cycles32 {
 
   // Updates the timestamp using clock.now() >> kShift.
   void Update(Clock clock = Clock{}) {
-    uint32_t now_32 = static_cast<uint32_t>(clock.now() >> kShift);
-    if (now_32 == 0) now_32 = 1;  // Reserve 0 as the uninitialized sentinel.
-    val_.store(now_32, std::memory_order_relaxed);
+    val_.store(Ticks(clock.now()), std::memory_order_relaxed);
+  }
+
+  // Updates the timestamp to now if it is uninitialized or at least interval
+  // old, and returns true.  Of callers racing on the same timestamp, only one
+  // succeeds per interval.
+  bool UpdateIfElapsed(absl::Duration interval, Clock clock = Clock{}) {
+    const Clock::Snapshot snap = clock.GetSnapshot();
+    uint32_t last = val_.load(std::memory_order_relaxed);
+    if (last != 0 && Elapsed(last, snap) < interval) return false;
+    return val_.compare_exchange_strong(last, Ticks(snap.now),
+                                        std::memory_order_relaxed);
   }
 
   // Resets the timestamp to 0 (uninitialized sentinel).
@@ -79,12 +88,7 @@ class Cycles32 {
   absl::Duration AsDuration(Clock::Snapshot snap) const {
     const uint32_t last = val_.load(std::memory_order_relaxed);
     if (last == 0) return absl::InfiniteDuration();
-    const uint32_t now_32 = static_cast<uint32_t>(snap.now >> kShift);
-    // Unsigned 32-bit modular subtraction across wraparound is safe.
-    const uint32_t elapsed_ticks = now_32 - last;
-    const double elapsed_cycles =
-        static_cast<double>(elapsed_ticks) * (1 << kShift);
-    return absl::Seconds(elapsed_cycles / snap.freq);
+    return Elapsed(last, snap);
   }
 
   // Convenience overload: takes a fresh clock snapshot.
@@ -101,6 +105,21 @@ class Cycles32 {
   uint32_t raw() const { return val_.load(std::memory_order_relaxed); }
 
  private:
+  static uint32_t Ticks(int64_t now) {
+    uint32_t now_32 = static_cast<uint32_t>(now >> kShift);
+    if (now_32 == 0) now_32 = 1;  // Reserve 0 as the uninitialized sentinel.
+    return now_32;
+  }
+
+  static absl::Duration Elapsed(uint32_t last, Clock::Snapshot snap) {
+    const uint32_t now_32 = static_cast<uint32_t>(snap.now >> kShift);
+    // Unsigned 32-bit modular subtraction across wraparound is safe.
+    const uint32_t elapsed_ticks = now_32 - last;
+    const double elapsed_cycles =
+        static_cast<double>(elapsed_ticks) * (1 << kShift);
+    return absl::Seconds(elapsed_cycles / snap.freq);
+  }
+
   static bool TimeAfterOrEqual(uint32_t a, uint32_t b) {
     return static_cast<int32_t>(a - b) >= 0;
   }
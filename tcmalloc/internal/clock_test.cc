@@ -59,6 +59,25 @@ TEST_F(Cycles32Test, UpdateAndAsDuration) {
             absl::Nanoseconds(150LL << Cycles32::kShift));
 }
 
+TEST_F(Cycles32Test, UpdateIfElapsed) {
+  const absl::Duration interval = absl::Nanoseconds(10LL << Cycles32::kShift);
+  g_ticks_ = (100LL << Cycles32::kShift);
+
+  Cycles32 c;
+  EXPECT_TRUE(c.UpdateIfElapsed(interval, mock_clock_));
+  EXPECT_EQ(c.raw(), 100);
+  EXPECT_FALSE(c.UpdateIfElapsed(interval, mock_clock_));
+
+  g_ticks_ = (109LL << Cycles32::kShift);
+  EXPECT_FALSE(c.UpdateIfElapsed(interval, mock_clock_));
+  EXPECT_EQ(c.raw(), 100);
+
+  g_ticks_ = (110LL << Cycles32::kShift);
+  EXPECT_TRUE(c.UpdateIfElapsed(interval, mock_clock_));
+  EXPECT_EQ(c.raw(), 110);
+  EXPECT_FALSE(c.UpdateIfElapsed(interval, mock_clock_));
+}
+
 TEST_F(Cycles32Test, WraparoundModularSubtraction) {
   Cycles32 c(0xFFFFFFF0u);
 
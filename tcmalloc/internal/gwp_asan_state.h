@@ -40,6 +40,7 @@ class GwpAsanState {
     kDoubleFree,
     kInvalidFree,
     kMismatchedFree,
+    kUseAfterFree,
   };
 
   Type type() const { return type_; }
@@ -237,6 +238,25 @@ class GwpAsanState {
     deallocation_stack_depth_ = deallocation_stack_depth;
   }
 
+  void RecordUseAfterFree(const void* ptr,
+                          absl::Span<void* const> allocation_stack,
+                          absl::Span<void* const> deallocation_stack) {
+    ptr_ = ptr;
+    type_ = Type::kUseAfterFree;
+
+    const size_t allocation_stack_depth =
+        std::min<size_t>(kMaxStackDepth, allocation_stack.size());
+    memcpy(allocation_stack_, allocation_stack.data(),
+           sizeof(void*) * allocation_stack_depth);
+    allocation_stack_depth_ = allocation_stack_depth;
+
+    const size_t deallocation_stack_depth =
+        std::min<size_t>(kMaxStackDepth, deallocation_stack.size());
+    memcpy(deallocation_stack_, deallocation_stack.data(),
+           sizeof(void*) * deallocation_stack_depth);
+    deallocation_stack_depth_ = deallocation_stack_depth;
+  }
+
  private:
   Type type_ = Type::kNone;
   const void* ptr_ = nullptr;
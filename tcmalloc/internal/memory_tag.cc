@@ -14,6 +14,8 @@
 
 #include "tcmalloc/internal/memory_tag.h"
 
+#include <iterator>
+
 #include "absl/strings/string_view.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/optimization.h"
@@ -22,6 +24,15 @@ GOOGLE_MALLOC_SECTION_BEGIN
 namespace tcmalloc::tcmalloc_internal {
 
 absl::string_view MemoryTagToLabel(MemoryTag tag) {
+  if (IsNormalTag(tag)) {
+    static constexpr absl::string_view kNormalLabels[] = {
+        "NORMAL",    "NORMAL_P1", "NORMAL_P2", "NORMAL_P3",
+        "NORMAL_P4", "NORMAL_P5", "NORMAL_P6", "NORMAL_P7",
+    };
+    static_assert(std::size(kNormalLabels) >= kMaxNormalPartitions);
+    return kNormalLabels[NormalTagPartition(tag)];
+  }
+
   switch (tag) {
     case MemoryTag::kNormal:
       return "NORMAL";
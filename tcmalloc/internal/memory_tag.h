@@ -15,6 +15,8 @@
 #ifndef TCMALLOC_INTERNAL_MEMORY_TAG_H_
 #define TCMALLOC_INTERNAL_MEMORY_TAG_H_
 
+#include <stddef.h>
+
 #include <algorithm>
 #include <cstdint>
 
@@ -25,14 +27,22 @@
 GOOGLE_MALLOC_SECTION_BEGIN
 namespace tcmalloc::tcmalloc_internal {
 
+// Normal memory carries one tag per NUMA or security partition: kNormalP0 plus
+// the partition number.  All of those tags, and no others, have the kNormalP0
+// bit set, so checking for normal memory stays a single mask test however many
+// partitions there are.  The encoding does not depend on how many partitions a
+// build uses.
+inline constexpr size_t kMaxNormalPartitions = kSanitizerAddressSpace ? 1 : 8;
+
 enum class MemoryTag : uint8_t {
   // Sampled, infrequently allocated
   kSampled = 0x0,
   kSampledP1 = kSanitizerAddressSpace ? 0xf8 : 0x1,
   // Normal memory, NUMA or security partition 0
-  kNormalP0 = kSanitizerAddressSpace ? 0x1 : 0x4,
-  // Normal memory, NUMA or security partition 1
-  kNormalP1 = kSanitizerAddressSpace ? 0xff : 0x6,
+  kNormalP0 = kSanitizerAddressSpace ? 0x1 : 0x8,
+  // Normal memory, NUMA or security partition 1.  Partitions up to
+  // kMaxNormalPartitions - 1 follow it.
+  kNormalP1 = kSanitizerAddressSpace ? 0xff : 0x9,
   // Normal memory
   kNormal = kNormalP0,
   // Cold
@@ -41,27 +51,51 @@ enum class MemoryTag : uint8_t {
   kMetadata = 0x3,
 };
 
-inline constexpr uintptr_t kTagShift = std::min(kAddressBits - 4, 42);
-inline constexpr uintptr_t kTagMask =
-    uintptr_t{kSanitizerAddressSpace ? 0x3 : 0x7} << kTagShift;
+// The bits of a normal tag holding its partition.
+inline constexpr uint8_t kNormalPartitionMask = kMaxNormalPartitions - 1;
+static_assert((static_cast<uint8_t>(MemoryTag::kNormalP0) &
+               kNormalPartitionMask) == 0);
+
+inline constexpr int kTagBits = kSanitizerAddressSpace ? 2 : 4;
+inline constexpr uintptr_t kTagShift =
+    std::min(kAddressBits - 1 - kTagBits, 42);
+inline constexpr uintptr_t kTagMask = ((uintptr_t{1} << kTagBits) - 1)
+                                      << kTagShift;
 
 inline MemoryTag GetMemoryTag(const void* ptr) {
   return static_cast<MemoryTag>((reinterpret_cast<uintptr_t>(ptr) & kTagMask) >>
                                 kTagShift);
 }
 
+// Returns true if tag is kNormalP0 or the tag of another normal partition.
+inline constexpr bool IsNormalTag(MemoryTag tag) {
+  return (static_cast<uint8_t>(tag) & ~kNormalPartitionMask) ==
+         static_cast<uint8_t>(MemoryTag::kNormalP0);
+}
+
+// Returns the tag of normal memory of the given partition.
+inline constexpr MemoryTag NormalTag(size_t partition) {
+  TC_ASSERT_LT(partition, kMaxNormalPartitions);
+  return static_cast<MemoryTag>(static_cast<uint8_t>(MemoryTag::kNormalP0) |
+                                partition);
+}
+
+// Returns the partition of a normal memory tag.
+inline constexpr size_t NormalTagPartition(MemoryTag tag) {
+  TC_ASSERT(IsNormalTag(tag), "tag=%d", static_cast<int>(tag));
+  return static_cast<uint8_t>(tag) & kNormalPartitionMask;
+}
+
 inline bool IsNormalMemory(const void* ptr) {
-  // This is slightly faster than checking kNormalP0/P1 separetly.
+  // This is slightly faster than checking each partition's tag separately.
   static_assert((static_cast<uint8_t>(MemoryTag::kNormalP0) &
                  (static_cast<uint8_t>(MemoryTag::kSampled) |
                   static_cast<uint8_t>(MemoryTag::kSampledP1) |
                   static_cast<uint8_t>(MemoryTag::kCold))) == 0);
   bool res = (static_cast<uintptr_t>(GetMemoryTag(ptr)) &
               static_cast<uintptr_t>(MemoryTag::kNormal)) != 0;
-  TC_ASSERT(res == (GetMemoryTag(ptr) == MemoryTag::kNormalP0 ||
-                    GetMemoryTag(ptr) == MemoryTag::kNormalP1),
-            "ptr=%p res=%d tag=%d", ptr, res,
-            static_cast<int>(GetMemoryTag(ptr)));
+  TC_ASSERT(res == IsNormalTag(GetMemoryTag(ptr)), "ptr=%p res=%d tag=%d", ptr,
+            res, static_cast<int>(GetMemoryTag(ptr)));
   return res;
 }
 
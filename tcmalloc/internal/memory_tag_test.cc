@@ -0,0 +1,79 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/internal/memory_tag.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+
+namespace tcmalloc::tcmalloc_internal {
+namespace {
+
+TEST(MemoryTagTest, NormalTagsRoundTrip) {
+  for (size_t partition = 0; partition < kMaxNormalPartitions; ++partition) {
+    SCOPED_TRACE(absl::StrCat("partition=", partition));
+    const MemoryTag tag = NormalTag(partition);
+    EXPECT_TRUE(IsNormalTag(tag));
+    EXPECT_EQ(NormalTagPartition(tag), partition);
+    EXPECT_NE(tag, MemoryTag::kSampled);
+    EXPECT_NE(tag, MemoryTag::kSampledP1);
+    EXPECT_NE(tag, MemoryTag::kCold);
+    EXPECT_NE(tag, MemoryTag::kMetadata);
+  }
+  EXPECT_EQ(NormalTag(0), MemoryTag::kNormalP0);
+  if (kMaxNormalPartitions > 1) {
+    EXPECT_EQ(NormalTag(1), MemoryTag::kNormalP1);
+  }
+}
+
+TEST(MemoryTagTest, OtherTagsAreNotNormal) {
+  EXPECT_FALSE(IsNormalTag(MemoryTag::kSampled));
+  EXPECT_FALSE(IsNormalTag(MemoryTag::kSampledP1));
+  EXPECT_FALSE(IsNormalTag(MemoryTag::kCold));
+  EXPECT_FALSE(IsNormalTag(MemoryTag::kMetadata));
+}
+
+TEST(MemoryTagTest, IsNormalMemory) {
+  for (size_t partition = 0; partition < kMaxNormalPartitions; ++partition) {
+    SCOPED_TRACE(absl::StrCat("partition=", partition));
+    const uintptr_t tagged =
+        static_cast<uintptr_t>(NormalTag(partition)) << kTagShift;
+    const void* ptr = reinterpret_cast<const void*>(tagged | 0x1000);
+    EXPECT_EQ(GetMemoryTag(ptr), NormalTag(partition));
+    EXPECT_TRUE(IsNormalMemory(ptr));
+    EXPECT_FALSE(IsSampledMemory(ptr));
+  }
+
+  for (MemoryTag tag : {MemoryTag::kSampled, MemoryTag::kSampledP1,
+                        MemoryTag::kCold, MemoryTag::kMetadata}) {
+    SCOPED_TRACE(absl::StrCat("tag=", static_cast<int>(tag)));
+    const uintptr_t tagged = static_cast<uintptr_t>(tag) << kTagShift;
+    const void* ptr = reinterpret_cast<const void*>(tagged | 0x1000);
+    EXPECT_FALSE(IsNormalMemory(ptr));
+  }
+}
+
+TEST(MemoryTagTest, Labels) {
+  EXPECT_EQ(MemoryTagToLabel(NormalTag(0)), "NORMAL");
+  for (size_t partition = 1; partition < kMaxNormalPartitions; ++partition) {
+    EXPECT_EQ(MemoryTagToLabel(NormalTag(partition)),
+              absl::StrCat("NORMAL_P", partition));
+  }
+}
+
+}  // namespace
+}  // namespace tcmalloc::tcmalloc_internal
@@ -64,7 +64,7 @@ bool InitNumaTopology(size_t cpu_to_scaled_partition[kMaxCpus],
   const char* e =
       tcmalloc::tcmalloc_internal::thread_safe_getenv("TCMALLOC_NUMA_AWARE");
 
-  partition_to_nodes[NodeToPartition(0, num_partitions)] |= 1 << 0;
+  partition_to_nodes[NodeToPartition(0, num_partitions)] |= uint64_t{1} << 0;
   *num_nodes = 1;
 
   // We rely on rseq to quickly obtain a CPU ID & lookup the appropriate
@@ -126,7 +126,7 @@ bool InitNumaTopology(size_t cpu_to_scaled_partition[kMaxCpus],
 
     // Record this node in partition_to_nodes.
     const size_t partition = NodeToPartition(node, num_partitions);
-    partition_to_nodes[partition] |= 1 << node;
+    partition_to_nodes[partition] |= uint64_t{1} << node;
 
     // cpu_to_scaled_partition_ entries are default initialized to zero, so
     // skip redundantly parsing CPU lists for nodes that map to partition 0.
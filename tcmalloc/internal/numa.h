@@ -105,9 +105,10 @@ class NumaTopology {
   // Returns the number of NUMA partitions deemed 'active' - i.e. the number of
   // partitions that other parts of TCMalloc need to concern themselves with.
   // Checking this rather than using kNumaPartitions allows users to avoid work
-  // on non-zero partitions when NUMA awareness is disabled.
+  // on non-zero partitions when NUMA awareness is disabled, or on partitions
+  // that no node maps to when the system has fewer nodes than partitions.
   size_t active_partitions() const {
-    return numa_aware() ? kNumInternalPartitions : 1;
+    return numa_aware() ? std::min(kNumInternalPartitions, num_nodes_) : 1;
   }
 
   // Returns the number of NUMA nodes detected in the system.
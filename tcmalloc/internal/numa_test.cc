@@ -18,6 +18,7 @@
 #include <linux/memfd.h>
 #include <sched.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall.h>
@@ -177,6 +178,49 @@ TEST_F(NumaTopologyTest, TwoNode) {
   }
 }
 
+// Ensure that partitions no node maps to are not activated, as on a 2 node
+// system running a build supporting 8 partitions.
+TEST_F(NumaTopologyTest, FewerNodesThanPartitions) {
+  std::vector<SyntheticCpuList> nodes;
+  nodes.emplace_back("0-5");
+  nodes.emplace_back("6-11");
+
+  const auto nt = CreateNumaTopology<8>(nodes);
+
+  EXPECT_EQ(nt.numa_aware(), true);
+  EXPECT_EQ(nt.active_partitions(), 2);
+  EXPECT_EQ(nt.GetPartitionNodes(0), uint64_t{0b01});
+  EXPECT_EQ(nt.GetPartitionNodes(1), uint64_t{0b10});
+
+  for (int cpu = 0; cpu <= 5; cpu++) {
+    EXPECT_EQ(nt.GetCpuPartition(cpu), 0);
+  }
+  for (int cpu = 6; cpu <= 11; cpu++) {
+    EXPECT_EQ(nt.GetCpuPartition(cpu), 1);
+  }
+}
+
+// Basic sanity test modelling a 4 socket system with a partition per node.
+TEST_F(NumaTopologyTest, FourNode) {
+  std::vector<SyntheticCpuList> nodes;
+  nodes.emplace_back("0-5");
+  nodes.emplace_back("6-11");
+  nodes.emplace_back("12-17");
+  nodes.emplace_back("18-23");
+
+  const auto nt = CreateNumaTopology<4>(nodes);
+
+  EXPECT_EQ(nt.numa_aware(), true);
+  EXPECT_EQ(nt.active_partitions(), 4);
+
+  for (int node = 0; node < 4; node++) {
+    EXPECT_EQ(nt.GetPartitionNodes(node), uint64_t{1} << node);
+    for (int cpu = node * 6; cpu < (node + 1) * 6; cpu++) {
+      EXPECT_EQ(nt.GetCpuPartition(cpu), node);
+    }
+  }
+}
+
 // Confirm that an empty node parses correctly (b/212827142).
 TEST_F(NumaTopologyTest, EmptyNode) {
   std::vector<SyntheticCpuList> nodes;
@@ -0,0 +1,144 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/internal/page_heap_tracer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <new>
+
+#include "absl/base/attributes.h"
+#include "absl/base/internal/spinlock.h"
+#include "absl/numeric/bits.h"
+#include "absl/types/span.h"
+#include "tcmalloc/internal/allocation_guard.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/memory_tag.h"
+#include "tcmalloc/internal/percpu.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+ABSL_CONST_INIT PageHeapTracer page_heap_tracer;
+
+size_t PageHeapTracer::RingSize(size_t events_per_cpu) {
+  const size_t bytes = sizeof(Ring) + events_per_cpu * sizeof(Slot);
+  return (bytes + ABSL_CACHELINE_SIZE - 1) & ~size_t{ABSL_CACHELINE_SIZE - 1};
+}
+
+size_t PageHeapTracer::BufferSize(int num_cpus, size_t events_per_cpu) {
+  TC_CHECK_GT(num_cpus, 0);
+  TC_CHECK(absl::has_single_bit(events_per_cpu), "%zu", events_per_cpu);
+  return num_cpus * RingSize(events_per_cpu);
+}
+
+void PageHeapTracer::Init(void* buffer, int num_cpus, size_t events_per_cpu) {
+  TC_CHECK(!initialized());
+  TC_CHECK_EQ(reinterpret_cast<uintptr_t>(buffer) % ABSL_CACHELINE_SIZE, 0);
+  TC_CHECK_GT(num_cpus, 0);
+  TC_CHECK(absl::has_single_bit(events_per_cpu), "%zu", events_per_cpu);
+
+  rings_ = static_cast<char*>(buffer);
+  ring_size_ = RingSize(events_per_cpu);
+  num_cpus_ = num_cpus;
+  mask_ = events_per_cpu - 1;
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    Ring* r = new (rings_ + cpu * ring_size_) Ring;
+    r->head.store(0, std::memory_order_relaxed);
+    r->tail = 0;
+    Slot* slots = reinterpret_cast<Slot*>(r + 1);
+    for (size_t i = 0; i < events_per_cpu; ++i) {
+      Slot* s = new (&slots[i]) Slot;
+      s->seq.store(0, std::memory_order_relaxed);
+    }
+  }
+  initialized_.store(true, std::memory_order_release);
+}
+
+void PageHeapTracer::RecordSlow(PageHeapEventType type, MemoryTag tag,
+                                uintptr_t start_addr, size_t bytes) {
+  if (ABSL_PREDICT_FALSE(!initialized())) return;
+
+  int cpu = subtle::percpu::GetRealCpuUnsafe();
+  if (ABSL_PREDICT_FALSE(cpu < 0 || cpu >= num_cpus_)) {
+    cpu = 0;
+  }
+  Ring& r = ring(cpu);
+  const uint64_t pos = r.head.fetch_add(1, std::memory_order_relaxed);
+  Slot& s = slot(r, pos);
+
+  // A seqlock write: readers that see an odd or unexpected sequence number,
+  // or one that changed while they copied the fields, discard the slot.
+  s.seq.store(2 * pos + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.ticks.store(clock_.now(), std::memory_order_relaxed);
+  s.start_addr.store(start_addr, std::memory_order_relaxed);
+  s.packed.store(uint64_t{bytes} << 16 | static_cast<uint64_t>(type) << 8 |
+                     static_cast<uint64_t>(tag),
+                 std::memory_order_relaxed);
+  s.seq.store(2 * pos + 2, std::memory_order_release);
+}
+
+PageHeapTracer::DrainResult PageHeapTracer::Drain(
+    absl::Span<PageHeapTraceEvent> out) {
+  DrainResult result = {0, 0};
+  if (!initialized()) return result;
+
+  AllocationGuardSpinLockHolder l(drain_lock_);
+  for (int cpu = 0; cpu < num_cpus_; ++cpu) {
+    Ring& r = ring(cpu);
+    const uint64_t head = r.head.load(std::memory_order_acquire);
+    uint64_t pos = r.tail;
+    if (head - pos > events_per_cpu()) {
+      result.dropped += head - events_per_cpu() - pos;
+      pos = head - events_per_cpu();
+    }
+    for (; pos < head && result.events < out.size(); ++pos) {
+      Slot& s = slot(r, pos);
+      const uint64_t seq = s.seq.load(std::memory_order_acquire);
+      if (seq < 2 * pos + 2) {
+        // The writer that claimed pos has not finished; pick it up next time.
+        break;
+      }
+      if (seq > 2 * pos + 2) {
+        // A later lap overwrote this slot.
+        ++result.dropped;
+        continue;
+      }
+      PageHeapTraceEvent& e = out[result.events];
+      e.ticks = s.ticks.load(std::memory_order_relaxed);
+      e.start_addr = s.start_addr.load(std::memory_order_relaxed);
+      const uint64_t packed = s.packed.load(std::memory_order_relaxed);
+      e.bytes = packed >> 16;
+      e.type = static_cast<PageHeapEventType>((packed >> 8) & 0xff);
+      e.tag = static_cast<MemoryTag>(packed & 0xff);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (s.seq.load(std::memory_order_relaxed) != seq) {
+        ++result.dropped;
+        continue;
+      }
+      ++result.events;
+    }
+    r.tail = pos;
+  }
+  return result;
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
@@ -0,0 +1,160 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_INTERNAL_PAGE_HEAP_TRACER_H_
+#define TCMALLOC_INTERNAL_PAGE_HEAP_TRACER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "absl/base/attributes.h"
+#include "absl/base/internal/spinlock.h"
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/types/span.h"
+#include "tcmalloc/internal/clock.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/memory_tag.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+enum class PageHeapEventType : uint8_t {
+  // A span was handed out or returned by the page allocator.
+  kNew,
+  kDelete,
+  // Part of a hugepage was returned to the OS.
+  kSubrelease,
+  // One or more whole hugepages were returned to the OS.
+  kHugePageRelease,
+  // A range was collapsed into hugepages.
+  kCollapse,
+  // The HugeCache limit moved; bytes is the size of the change.
+  kCacheGrow,
+  kCacheShrink,
+};
+
+struct PageHeapTraceEvent {
+  int64_t ticks;
+  uintptr_t start_addr;
+  size_t bytes;
+  PageHeapEventType type;
+  MemoryTag tag;
+};
+
+// Records page heap events into fixed-size per-CPU rings.  Recording is a
+// relaxed load while tracing is stopped; while it runs, it claims a slot with
+// one fetch_add on the current CPU's ring and publishes it with a sequence
+// number, so it takes no locks and may be called with or without
+// pageheap_lock.  When a ring wraps before it is drained, the oldest events
+// are overwritten and counted as dropped.
+class PageHeapTracer {
+ public:
+  struct DrainResult {
+    size_t events;
+    size_t dropped;
+  };
+
+  constexpr PageHeapTracer() = default;
+  constexpr explicit PageHeapTracer(Clock clock) : clock_(clock) {}
+
+  PageHeapTracer(const PageHeapTracer&) = delete;
+  PageHeapTracer& operator=(const PageHeapTracer&) = delete;
+
+  // Returns the number of bytes Init needs for num_cpus rings of
+  // events_per_cpu events each.  events_per_cpu must be a power of two.
+  static size_t BufferSize(int num_cpus, size_t events_per_cpu);
+
+  // Carves the rings out of buffer, which must be BufferSize(num_cpus,
+  // events_per_cpu) bytes, aligned to ABSL_CACHELINE_SIZE and outlive the
+  // tracer.  May be called only once.
+  void Init(void* buffer, int num_cpus, size_t events_per_cpu);
+
+  bool initialized() const {
+    return initialized_.load(std::memory_order_acquire);
+  }
+  size_t events_per_cpu() const { return mask_ + 1; }
+  // The most events a single Drain can return.
+  size_t capacity() const { return num_cpus_ * events_per_cpu(); }
+
+  // REQUIRES: initialized().
+  void Start() { enabled_.store(true, std::memory_order_release); }
+  void Stop() { enabled_.store(false, std::memory_order_release); }
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void Record(PageHeapEventType type, MemoryTag tag, uintptr_t start_addr,
+              size_t bytes) {
+    if (ABSL_PREDICT_TRUE(!enabled())) return;
+    RecordSlow(type, tag, start_addr, bytes);
+  }
+
+  // Copies the events recorded since the previous Drain into out, oldest
+  // first within each CPU.  Events that do not fit stay queued for the next
+  // call.  Safe to call concurrently with Record and with other Drains.
+  DrainResult Drain(absl::Span<PageHeapTraceEvent> out);
+
+  const Clock& clock() const { return clock_; }
+
+ private:
+  struct Slot {
+    // 2 * pos + 1 while the event at ring position pos is being written,
+    // 2 * pos + 2 once it is complete.
+    std::atomic<uint64_t> seq;
+    std::atomic<int64_t> ticks;
+    std::atomic<uintptr_t> start_addr;
+    // bytes << 16 | type << 8 | tag.
+    std::atomic<uint64_t> packed;
+  };
+
+  struct ABSL_CACHELINE_ALIGNED Ring {
+    std::atomic<uint64_t> head;
+    // Next position to drain.  Guarded by drain_lock_.
+    uint64_t tail;
+  };
+
+  static size_t RingSize(size_t events_per_cpu);
+  Ring& ring(int cpu) const {
+    return *reinterpret_cast<Ring*>(rings_ + cpu * ring_size_);
+  }
+  // The slots follow each Ring header.
+  Slot& slot(Ring& r, uint64_t pos) const {
+    return reinterpret_cast<Slot*>(&r + 1)[pos & mask_];
+  }
+
+  ABSL_ATTRIBUTE_NOINLINE void RecordSlow(PageHeapEventType type,
+                                          MemoryTag tag, uintptr_t start_addr,
+                                          size_t bytes);
+
+  Clock clock_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<bool> initialized_{false};
+  char* rings_ = nullptr;
+  size_t ring_size_ = 0;
+  int num_cpus_ = 0;
+  size_t mask_ = 0;
+
+  absl::base_internal::SpinLock drain_lock_{
+      absl::base_internal::SCHEDULE_KERNEL_ONLY};
+};
+
+ABSL_CONST_INIT extern PageHeapTracer page_heap_tracer;
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_INTERNAL_PAGE_HEAP_TRACER_H_
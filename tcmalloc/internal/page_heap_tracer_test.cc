@@ -0,0 +1,181 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/internal/page_heap_tracer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <new>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/types/span.h"
+#include "tcmalloc/internal/clock.h"
+#include "tcmalloc/internal/memory_tag.h"
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+int64_t FakeNow() {
+  static std::atomic<int64_t> now{0};
+  return now.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+double FakeFreq() { return 1e9; }
+
+class PageHeapTracerTest : public testing::Test {
+ protected:
+  void Init(int num_cpus, size_t events_per_cpu) {
+    const size_t size = PageHeapTracer::BufferSize(num_cpus, events_per_cpu);
+    buffer_ = ::operator new(size, std::align_val_t{ABSL_CACHELINE_SIZE});
+    tracer_.Init(buffer_, num_cpus, events_per_cpu);
+  }
+
+  ~PageHeapTracerTest() override {
+    ::operator delete(buffer_, std::align_val_t{ABSL_CACHELINE_SIZE});
+  }
+
+  std::vector<PageHeapTraceEvent> Drain(size_t* dropped = nullptr) {
+    std::vector<PageHeapTraceEvent> events(tracer_.capacity());
+    PageHeapTracer::DrainResult result =
+        tracer_.Drain(absl::MakeSpan(events));
+    events.resize(result.events);
+    if (dropped != nullptr) *dropped = result.dropped;
+    return events;
+  }
+
+  PageHeapTracer tracer_{Clock{.now = FakeNow, .freq = FakeFreq}};
+  void* buffer_ = nullptr;
+};
+
+TEST_F(PageHeapTracerTest, IgnoredUntilStarted) {
+  tracer_.Record(PageHeapEventType::kNew, MemoryTag::kNormal, 0x1000, 8192);
+  EXPECT_TRUE(Drain().empty());
+
+  Init(1, 8);
+  tracer_.Record(PageHeapEventType::kNew, MemoryTag::kNormal, 0x1000, 8192);
+  EXPECT_TRUE(Drain().empty());
+
+  tracer_.Start();
+  tracer_.Record(PageHeapEventType::kNew, MemoryTag::kNormal, 0x1000, 8192);
+  tracer_.Stop();
+  tracer_.Record(PageHeapEventType::kDelete, MemoryTag::kNormal, 0x1000, 8192);
+  EXPECT_EQ(Drain().size(), 1);
+}
+
+TEST_F(PageHeapTracerTest, RecordsAndDrains) {
+  Init(1, 8);
+  tracer_.Start();
+  tracer_.Record(PageHeapEventType::kNew, MemoryTag::kSampled, 0x2000, 1 << 20);
+  tracer_.Record(PageHeapEventType::kSubrelease, MemoryTag::kCold, 0x4000,
+                 8192);
+  tracer_.Record(PageHeapEventType::kCacheGrow, MemoryTag::kNormal, 0,
+                 size_t{1} << 40);
+
+  size_t dropped;
+  std::vector<PageHeapTraceEvent> events = Drain(&dropped);
+  EXPECT_EQ(dropped, 0);
+  ASSERT_EQ(events.size(), 3);
+  EXPECT_EQ(events[0].type, PageHeapEventType::kNew);
+  EXPECT_EQ(events[0].tag, MemoryTag::kSampled);
+  EXPECT_EQ(events[0].start_addr, 0x2000);
+  EXPECT_EQ(events[0].bytes, 1 << 20);
+  EXPECT_EQ(events[1].type, PageHeapEventType::kSubrelease);
+  EXPECT_EQ(events[1].tag, MemoryTag::kCold);
+  EXPECT_EQ(events[2].type, PageHeapEventType::kCacheGrow);
+  EXPECT_EQ(events[2].bytes, size_t{1} << 40);
+  EXPECT_LT(events[0].ticks, events[1].ticks);
+  EXPECT_LT(events[1].ticks, events[2].ticks);
+
+  // Events are only returned once.
+  EXPECT_TRUE(Drain().empty());
+}
+
+TEST_F(PageHeapTracerTest, PartialDrain) {
+  Init(1, 8);
+  tracer_.Start();
+  for (int i = 0; i < 5; ++i) {
+    tracer_.Record(PageHeapEventType::kNew, MemoryTag::kNormal, i, 1);
+  }
+
+  PageHeapTraceEvent events[2];
+  PageHeapTracer::DrainResult result = tracer_.Drain(absl::MakeSpan(events));
+  EXPECT_EQ(result.events, 2);
+  EXPECT_EQ(events[1].start_addr, 1);
+
+  std::vector<PageHeapTraceEvent> rest = Drain();
+  ASSERT_EQ(rest.size(), 3);
+  EXPECT_EQ(rest[0].start_addr, 2);
+}
+
+TEST_F(PageHeapTracerTest, OverflowDropsOldest) {
+  Init(1, 8);
+  tracer_.Start();
+  for (int i = 0; i < 20; ++i) {
+    tracer_.Record(PageHeapEventType::kDelete, MemoryTag::kNormal, i, 1);
+  }
+
+  size_t dropped;
+  std::vector<PageHeapTraceEvent> events = Drain(&dropped);
+  EXPECT_EQ(dropped, 12);
+  ASSERT_EQ(events.size(), 8);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(events[i].start_addr, 12 + i);
+  }
+}
+
+TEST_F(PageHeapTracerTest, ConcurrentRecords) {
+  constexpr int kThreads = 4;
+  constexpr int kEventsPerThread = 1000;
+  Init(1, 1 << 14);
+  tracer_.Start();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([this, t]() {
+      for (int i = 0; i < kEventsPerThread; ++i) {
+        tracer_.Record(PageHeapEventType::kNew, MemoryTag::kNormal, t, i);
+      }
+    });
+  }
+
+  // Drain while the writers are running; nothing may be lost or duplicated.
+  std::vector<int> seen(kThreads, 0);
+  size_t total_dropped = 0;
+  auto drain = [&]() {
+    size_t dropped;
+    for (const PageHeapTraceEvent& e : Drain(&dropped)) {
+      ASSERT_LT(e.start_addr, kThreads);
+      EXPECT_EQ(e.bytes, seen[e.start_addr]);
+      ++seen[e.start_addr];
+    }
+    total_dropped += dropped;
+  };
+  for (int i = 0; i < 100; ++i) drain();
+  for (std::thread& t : threads) t.join();
+  drain();
+
+  EXPECT_EQ(total_dropped, 0);
+  for (int t = 0; t < kThreads; ++t) {
+    EXPECT_EQ(seen[t], kEventsPerThread);
+  }
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
@@ -42,6 +42,10 @@ extern "C" {
 
 ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetBackgroundReleaseRate(
     size_t value);
+ABSL_ATTRIBUTE_WEAK bool TCMalloc_Internal_GetBackgroundReleaseAdaptive();
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetBackgroundReleaseAdaptive(bool v);
+ABSL_ATTRIBUTE_WEAK double TCMalloc_Internal_GetMemoryPressure();
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetMemoryPressure(double v);
 ABSL_ATTRIBUTE_WEAK uint64_t TCMalloc_Internal_GetHeapSizeHardLimit();
 ABSL_ATTRIBUTE_WEAK bool TCMalloc_Internal_GetHPAASubrelease();
 ABSL_ATTRIBUTE_WEAK void
@@ -65,6 +69,7 @@ ABSL_ATTRIBUTE_WEAK size_t TCMalloc_Internal_GetStats(char* buffer,
 ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetGuardedSamplingInterval(
     int64_t v);
 ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetHeapSizeHardLimit(uint64_t v);
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetSampledQuarantineBytes(int64_t v);
 ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetHPAASubrelease(bool v);
 ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetReleasePartialAllocPagesEnabled(
     bool v);
@@ -128,6 +133,15 @@ ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_GetSizeClasses(
 ABSL_ATTRIBUTE_WEAK size_t TCMalloc_Internal_GetPageSize();
 ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetReleaseDrainedSlabMetadata(
     bool v);
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetPerCpuCachesOnDemandSteal(
+    bool v);
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetPerCpuCachesFollowCpuset(bool v);
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetNumaMigrateRemoteHugepages(
+    bool v);
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetPartitionPerCpuCachePercent(
+    size_t partition, int32_t v);
+ABSL_ATTRIBUTE_WEAK void TCMalloc_Internal_SetPartitionReleaseEagerly(
+    size_t partition, bool v);
 ABSL_ATTRIBUTE_WEAK bool TCMalloc_Internal_GetPageAllocationStatus(
     const void* ptr,
     tcmalloc::tcmalloc_internal::PageAllocationStatus* absl_nonnull status);
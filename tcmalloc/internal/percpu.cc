@@ -26,16 +26,16 @@
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
+#include <cstring>
 #include <limits>
 #include <optional>
 
 #include "absl/base/attributes.h"
 #include "absl/base/call_once.h"  // IWYU pragma: keep
 #include "absl/base/optimization.h"
-#include "tcmalloc/experiment.h"
-#include "tcmalloc/experiment_config.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/cpu_utils.h"
+#include "tcmalloc/internal/environment.h"
 #include "tcmalloc/internal/linux_syscall_support.h"
 #include "tcmalloc/internal/logging.h"
 #include "tcmalloc/internal/optimization.h"
@@ -94,6 +94,35 @@ bool UsingRseqVirtualCpus() {
   return GetRseqVcpuMode() == RseqVcpuMode::kMM;
 }
 
+RseqVcpuMode SelectRseqVcpuMode(const char* setting,
+                                unsigned long rseq_feature_size,
+                                unsigned mm_cid, int num_cpus) {
+  if (setting != nullptr && setting[0] != '\0') {
+    if (strcmp(setting, "none") == 0) {
+      return RseqVcpuMode::kNone;
+    }
+    // "flat" is the older name for mm_cid ids.
+    if (strcmp(setting, "mm") != 0 && strcmp(setting, "flat") != 0) {
+      TC_BUG("bad PERCPU_VCPU_MODE env var '%s'", setting);
+    }
+  }
+  // mm_cid support was introduced in Linux 6.3
+  // (https://github.com/torvalds/linux/commit/f7b01bb0b57f994a44ea6368536b59062b796381).
+  // AT_RSEQ_FEATURE_SIZE is populated as of
+  // https://github.com/torvalds/linux/commit/317c8194e6aeb8b3b573ad139fc2a0635856498e
+  // in the same series.  Older kernels leave the field as zero padding.
+  if (rseq_feature_size <
+      offsetof(kernel_rseq, mm_cid) + sizeof(kernel_rseq::mm_cid)) {
+    return RseqVcpuMode::kNone;
+  }
+  // The kernel bounds mm_cid by the number of possible CPUs.  Anything else
+  // could not index our slabs.
+  if (mm_cid >= static_cast<unsigned>(num_cpus)) {
+    return RseqVcpuMode::kNone;
+  }
+  return RseqVcpuMode::kMM;
+}
+
 int VirtualCpu::Synchronize() {
 #if TCMALLOC_INTERNAL_PERCPU_USE_RSEQ
   int vcpu = kCpuIdUninitialized;
@@ -167,17 +196,11 @@ static void InitPerCpu() {
                      kMEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_RSEQ, 0, 0),
         std::memory_order_relaxed);
 
-    if (IsExperimentActive(Experiment::TEST_ONLY_MM_VCPU)) {
-      auto auxv = getauxval(AT_RSEQ_FEATURE_SIZE);
-      // mm_cid support was introduced in Linux 6.3
-      // (https://github.com/torvalds/linux/commit/f7b01bb0b57f994a44ea6368536b59062b796381).
-      // This auxv value is populated as of
-      // https://github.com/torvalds/linux/commit/317c8194e6aeb8b3b573ad139fc2a0635856498e
-      // in the same series.
-      if (auxv >= offsetof(kernel_rseq, mm_cid) + sizeof(__rseq_abi.mm_cid)) {
-        vcpu_mode = RseqVcpuMode::kMM;
-      }
-    }
+    // This thread was registered above, so the kernel has filled in its
+    // mm_cid, if it supports it.
+    vcpu_mode = SelectRseqVcpuMode(thread_safe_getenv("PERCPU_VCPU_MODE"),
+                                   getauxval(AT_RSEQ_FEATURE_SIZE),
+                                   __rseq_abi.mm_cid, *maybe_numcpus);
 #endif  // TCMALLOC_INTERNAL_PERCPU_USE_RSEQ
   }
 }
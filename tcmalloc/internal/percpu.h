@@ -16,17 +16,17 @@
 #define TCMALLOC_INTERNAL_PERCPU_H_
 
 // sizeof(Sampler)
-#define TCMALLOC_SAMPLER_SIZE 32
+#define TCMALLOC_SAMPLER_SIZE 48
 // alignof(Sampler)
 #define TCMALLOC_SAMPLER_ALIGN 8
 // Sampler::HotDataOffset()
-#define TCMALLOC_SAMPLER_HOT_OFFSET 24
+#define TCMALLOC_SAMPLER_HOT_OFFSET 40
 
 // Offset from __rseq_abi to the cached slabs address.
 #define TCMALLOC_RSEQ_SLABS_OFFSET -4
 
 // Offset from the cached slabs address to the sampler.
-#define TCMALLOC_SAMPLER_SLABS_OFFSET 36
+#define TCMALLOC_SAMPLER_SLABS_OFFSET 52
 
 // The bit denotes that tcmalloc_rseq.slabs contains valid slabs offset.
 #define TCMALLOC_CACHED_SLABS_BIT 63
@@ -209,10 +209,25 @@ size_t TcmallocSlab_Internal_PopBatch(size_t size_class, void** batch,
 // increase the visibility of functions embedded into the root-namespace (by
 // virtue of C linkage) in the supported case.
 
+// How per-CPU slabs are indexed.  kNone uses the physical CPU id.  kMM uses
+// the kernel's per-mm concurrency id (rseq mm_cid, Linux 6.3+), which is
+// dense in [0, number of concurrently running threads), so a process running
+// few threads on a large machine only touches that many slabs.
 enum class RseqVcpuMode { kNone, kMM };
 
 extern RseqVcpuMode vcpu_mode;
 
+// Returns the vCPU mode to use.  <setting> is the value of PERCPU_VCPU_MODE,
+// or nullptr if it is unset: "none" selects kNone, and unset, empty, "mm" or
+// "flat" select kMM when the kernel supports it.  Any other value is a fatal
+// error.  <rseq_feature_size> is the kernel's
+// AT_RSEQ_FEATURE_SIZE (0 before Linux 6.3) and <mm_cid> the id it reported
+// for the calling thread, which must already be registered with rseq.  Falls
+// back to kNone if mm_cid is unsupported or out of range for <num_cpus>.
+RseqVcpuMode SelectRseqVcpuMode(const char* setting,
+                                unsigned long rseq_feature_size,
+                                unsigned mm_cid, int num_cpus);
+
 inline RseqVcpuMode GetRseqVcpuMode() {
   return vcpu_mode;
 }
@@ -302,10 +302,25 @@ class TcmallocSlab {
   // All CPUs' ResizeInfo must be locked before calling this function.
   // The function stops them itself.
   void ReleaseSlabMetadataForDrainedCpus(
+      absl::FunctionRef<bool(size_t)> populated,
+      absl::FunctionRef<void(size_t)> unpopulate,
+      absl::FunctionRef<void(void*, size_t)> madvise_away_slabs) {
+    ReleaseSlabMetadataForDrainedCpus([](size_t) { return true; }, populated,
+                                      unpopulate, madvise_away_slabs);
+  }
+
+  // As above, but only releases hugepages whose CPUs all satisfy <locked>, so
+  // only those CPUs' ResizeInfo must be locked.
+  void ReleaseSlabMetadataForDrainedCpus(
+      absl::FunctionRef<bool(size_t)> locked,
       absl::FunctionRef<bool(size_t)> populated,
       absl::FunctionRef<void(size_t)> unpopulate,
       absl::FunctionRef<void(void*, size_t)> madvise_away_slabs);
 
+  // Returns the range [first, last) of CPUs whose slab metadata shares a
+  // hugepage with <cpu>'s at the current shift.
+  std::pair<int, int> CpusSharingHugePage(int cpu) const;
+
   PerCPUMetadataState MetadataMemoryUsage() const;
 
   // Gets the current shift of the slabs. Intended for use by the thread that
@@ -1492,6 +1507,7 @@ void TcmallocSlab<NumClasses>::Drain(int cpu, DrainHandler drain_handler) {
 
 template <size_t NumClasses>
 void TcmallocSlab<NumClasses>::ReleaseSlabMetadataForDrainedCpus(
+    absl::FunctionRef<bool(size_t)> locked,
     absl::FunctionRef<bool(size_t)> populated,
     absl::FunctionRef<void(size_t)> unpopulate,
     absl::FunctionRef<void(void*, size_t)> madvise_away_slabs) {
@@ -1556,15 +1572,20 @@ void TcmallocSlab<NumClasses>::ReleaseSlabMetadataForDrainedCpus(
   // and not larger than a hugepage, and they are also powers of two,
   // it can never cross hugepages.)
   for (size_t cpu = 0; cpu < n_cpus; ++cpu) {
-    if (!populated(cpu)) {
-      continue;
-    }
-
     size_t slab_hugepage =
         address_to_hugepage_number(CpuMemoryStart(slabs, shift, cpu));
     TC_CHECK_GE(slab_hugepage, base_hugepage_nr);
     HugePageStatus& status = hugepage_status[slab_hugepage - base_hugepage_nr];
 
+    if (!locked(cpu)) {
+      // Its populated state may change under us.
+      status = kCannotFree;
+      continue;
+    }
+    if (!populated(cpu)) {
+      continue;
+    }
+
     if (status == kCannotFree) {
       // No need to check, don't do anything.
     } else if (CpuIsDrained(slabs, shift, cpu)) {
@@ -1606,6 +1627,22 @@ void TcmallocSlab<NumClasses>::ReleaseSlabMetadataForDrainedCpus(
   }
 }
 
+template <size_t NumClasses>
+std::pair<int, int> TcmallocSlab<NumClasses>::CpusSharingHugePage(
+    int cpu) const {
+  TC_ASSERT(cpu >= 0 && cpu < num_cpus(), "cpu=%d", cpu);
+  const auto [slabs, shift] = GetSlabsAndShift(std::memory_order_relaxed);
+  const uintptr_t start = reinterpret_cast<uintptr_t>(slabs);
+  const uintptr_t hugepage =
+      reinterpret_cast<uintptr_t>(CpuMemoryStart(slabs, shift, cpu)) &
+      ~(kHugePageSize - 1);
+  const uint8_t s = ToUint8(shift);
+  const int first = hugepage > start ? (hugepage - start) >> s : 0;
+  const int last = std::min<size_t>(
+      num_cpus(), ((hugepage + kHugePageSize - start) + (1 << s) - 1) >> s);
+  return {first, last};
+}
+
 template <size_t NumClasses>
 void TcmallocSlab<NumClasses>::StopCpu(int cpu) {
   TC_ASSERT(cpu >= 0 && cpu < num_cpus(), "cpu=%d", cpu);
@@ -551,6 +551,28 @@ TEST_F(TcmallocSlabTest, ShrinkEmptyCache) {
   slab_.StartCpu(kCpu);
 }
 
+TEST_F(TcmallocSlabTest, CpusSharingHugePage) {
+  if (!IsFast()) {
+    GTEST_SKIP() << "Need fast percpu. Skipping.";
+    return;
+  }
+
+  const int num_cpus = NumCPUs();
+  const int per_hugepage = std::max<int>(kHugePageSize >> kShift, 1);
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    const auto [first, last] = slab_.CpusSharingHugePage(cpu);
+    EXPECT_GE(first, 0);
+    EXPECT_LE(first, cpu);
+    EXPECT_GT(last, cpu);
+    EXPECT_LE(last, num_cpus);
+    EXPECT_LE(last - first, per_hugepage);
+    // Every CPU in the range reports the same range.
+    for (int other = first; other < last; ++other) {
+      EXPECT_EQ(slab_.CpusSharingHugePage(other), std::make_pair(first, last));
+    }
+  }
+}
+
 TEST_F(TcmallocSlabTest, SimulatedMadviseFailure) {
   if (!IsFast()) {
     GTEST_SKIP() << "Need fast percpu. Skipping.";
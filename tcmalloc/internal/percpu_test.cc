@@ -24,6 +24,7 @@
 #include "absl/log/absl_check.h"
 #include "absl/time/time.h"
 #include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/sysinfo.h"
 #include "tcmalloc/testing/testutil.h"
 
 namespace tcmalloc::tcmalloc_internal::subtle::percpu {
@@ -36,6 +37,58 @@ void sa_alrm(int sig) {
   TC_CHECK(IsFast());
 }
 
+// Kernels before Linux 6.3 do not report AT_RSEQ_FEATURE_SIZE, so getauxval
+// returns 0.  Linux 6.3 reports 28, covering mm_cid.
+constexpr unsigned long kNoFeatureSize = 0;
+constexpr unsigned long kOriginalFeatureSize = 20;
+constexpr unsigned long kMmCidFeatureSize = 28;
+
+TEST(PerCpu, SelectRseqVcpuModeWithoutMmCid) {
+  EXPECT_EQ(SelectRseqVcpuMode(nullptr, kNoFeatureSize, 0, 8),
+            RseqVcpuMode::kNone);
+  EXPECT_EQ(SelectRseqVcpuMode(nullptr, kOriginalFeatureSize, 0, 8),
+            RseqVcpuMode::kNone);
+  // Asking for mm_cid falls back to physical CPUs.
+  EXPECT_EQ(SelectRseqVcpuMode("mm", kOriginalFeatureSize, 0, 8),
+            RseqVcpuMode::kNone);
+}
+
+TEST(PerCpu, SelectRseqVcpuModeWithMmCid) {
+  EXPECT_EQ(SelectRseqVcpuMode(nullptr, kMmCidFeatureSize, 0, 8),
+            RseqVcpuMode::kMM);
+  EXPECT_EQ(SelectRseqVcpuMode("mm", kMmCidFeatureSize, 7, 8),
+            RseqVcpuMode::kMM);
+  // Later kernels report a larger feature size.
+  EXPECT_EQ(SelectRseqVcpuMode(nullptr, kMmCidFeatureSize + 4, 3, 8),
+            RseqVcpuMode::kMM);
+
+  EXPECT_EQ(SelectRseqVcpuMode("none", kMmCidFeatureSize, 0, 8),
+            RseqVcpuMode::kNone);
+  // Ids we cannot index slabs with.
+  EXPECT_EQ(SelectRseqVcpuMode(nullptr, kMmCidFeatureSize, 8, 8),
+            RseqVcpuMode::kNone);
+}
+
+TEST(PerCpu, SelectRseqVcpuModeSettings) {
+  EXPECT_EQ(SelectRseqVcpuMode("", kMmCidFeatureSize, 0, 8), RseqVcpuMode::kMM);
+  EXPECT_EQ(SelectRseqVcpuMode("flat", kMmCidFeatureSize, 0, 8),
+            RseqVcpuMode::kMM);
+  EXPECT_DEATH(SelectRseqVcpuMode("mmcid", kMmCidFeatureSize, 0, 8),
+               "bad PERCPU_VCPU_MODE env var 'mmcid'");
+  EXPECT_DEATH(SelectRseqVcpuMode("None", kNoFeatureSize, 0, 8),
+               "bad PERCPU_VCPU_MODE env var 'None'");
+}
+
+TEST(PerCpu, VirtualCpuInRange) {
+  if (!IsFast()) {
+    GTEST_SKIP() << "per-CPU unavailable";
+  }
+
+  const int vcpu = VirtualCpu::Synchronize();
+  EXPECT_GE(vcpu, 0);
+  EXPECT_LT(vcpu, NumCPUs());
+}
+
 TEST(PerCpu, SignalHandling) {
   if (!IsFast()) {
     GTEST_SKIP() << "per-CPU unavailable";
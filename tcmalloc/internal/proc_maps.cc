@@ -20,7 +20,9 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <optional>
 
 #include "absl/strings/str_format.h"
 #include "tcmalloc/internal/config.h"
@@ -147,6 +149,43 @@ bool ProcMapsIterator::NextExt(uint64_t* start, uint64_t* end, char** flags,
   return false;
 }
 
+std::optional<MappingCounts> CountMappings() {
+  ProcMapsIterator::Buffer buffer;
+  ProcMapsIterator it(&buffer);
+  if (!it.Valid()) return std::nullopt;
+
+  // Matches the names SystemAllocator::SetAnonVmaName and the page heap give
+  // to tcmalloc's mappings.
+  constexpr char kPrefix[] = "[anon:tcmalloc";
+  MappingCounts counts = {0, 0, 0};
+  char* filename;
+  while (it.NextExt(nullptr, nullptr, nullptr, nullptr, nullptr, &filename,
+                    nullptr)) {
+    ++counts.total;
+    if (strncmp(filename, kPrefix, sizeof(kPrefix) - 1) == 0) {
+      ++counts.tcmalloc;
+    }
+  }
+
+#if defined(__linux__)
+  int fd;
+  TCMALLOC_RETRY_ON_TEMP_FAILURE(
+      fd = open("/proc/sys/vm/max_map_count", O_RDONLY));
+  if (fd >= 0) {
+    char buf[32];
+    ssize_t n;
+    TCMALLOC_RETRY_ON_TEMP_FAILURE(n = read(fd, buf, sizeof(buf) - 1));
+    if (n > 0) {
+      buf[n] = 0;
+      counts.limit = strtoul(buf, nullptr, 10);
+    }
+    close(fd);
+  }
+#endif
+
+  return counts;
+}
+
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
 GOOGLE_MALLOC_SECTION_END
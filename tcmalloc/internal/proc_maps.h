@@ -19,6 +19,7 @@
 #include <sys/types.h>
 
 #include <cstddef>
+#include <optional>
 
 #include "tcmalloc/internal/config.h"
 
@@ -55,6 +56,21 @@ class ProcMapsIterator {
   char flags_[10];
 };
 
+struct MappingCounts {
+  // All of the process' mappings (VMAs).
+  size_t total;
+  // Those named by tcmalloc (see SystemAllocator::SetAnonVmaName).  Zero if
+  // the kernel does not support naming anonymous mappings.
+  size_t tcmalloc;
+  // vm.max_map_count, or zero if it could not be read.
+  size_t limit;
+};
+
+// Counts the mappings in this process by walking /proc/thread-self/maps, which
+// takes time proportional to their number.  Returns std::nullopt if it is not
+// available.
+std::optional<MappingCounts> CountMappings();
+
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
 GOOGLE_MALLOC_SECTION_END
@@ -90,6 +90,13 @@ class Bitmap {
   ssize_t FindSetBackwards(size_t index) const;
   ssize_t FindClearBackwards(size_t index) const;
 
+  // Calls visitor(index, length) for each maximal range of clear bits, in
+  // increasing order of index, until visitor returns false.  The ranges are
+  // found from masks of their first and last bits, a word at a time, rather
+  // than by searching for each boundary in turn.
+  template <typename Visitor>
+  void VisitClearRanges(Visitor visitor) const;
+
   void Clear();
 
   // Bitwise operators.
@@ -159,6 +166,11 @@ class RangeTracker {
   // REQUIRES: the range [index, index + n) is fully unmarked.
   void Mark(size_t index, size_t n);
 
+  // If [index, index + n) is fully unmarked, marks it as part of the
+  // allocation that ends at index (so allocs() is unchanged) and returns true.
+  // Otherwise returns false.
+  bool MaybeExtend(size_t index, size_t n);
+
   // REQUIRES: the range [index, index + n) is fully marked, and
   // was the returned value from a call to FindAndMark.
   // Unmarks it.
@@ -172,6 +184,15 @@ class RangeTracker {
   Bitmap<N> bits() const;
 
  private:
+  // Up to this size, FindAndMark and RecomputeLongestFree find free ranges
+  // with bit-parallel operations over the whole bitmap.  Beyond it, searching
+  // for each range boundary in turn is cheaper.
+  static constexpr size_t kMaxBitParallelSize = 512;
+
+  void SetRange(size_t index, size_t n);
+  // Sets longest_free_ by visiting every free range.
+  void RecomputeLongestFree();
+
   Bitmap<N> bits_;
 
   // Computes the smallest unsigned type that can hold the constant N.
@@ -233,6 +254,51 @@ template <size_t N>
 inline size_t RangeTracker<N>::FindAndMark(size_t n) {
   TC_ASSERT_GT(n, 0);
 
+  if constexpr (N <= kMaxBitParallelSize) {
+    TC_ASSERT_LE(n, longest_free_);
+    // We keep the two longest ranges in the bitmap since we might allocate
+    // from one.
+    size_t longest_len = 0;
+    size_t second_len = 0;
+
+    // the best (shortest) range we could use
+    // TODO(b/134691947): shortest? lowest-addressed?
+    size_t best_index = N;
+    size_t best_len = 2 * N;
+    if (nused_ == 0) {
+      // The whole bitmap is one free range.
+      best_index = 0;
+      best_len = longest_len = N;
+    } else {
+      bits_.VisitClearRanges([&](size_t index, size_t len) {
+        if (len > longest_len) {
+          second_len = longest_len;
+          longest_len = len;
+        } else if (len > second_len) {
+          second_len = len;
+        }
+        if (len < n || len >= best_len) return true;
+        best_index = index;
+        best_len = len;
+        // An exact fit cannot be beaten.  Unless it is also a longest range,
+        // longest_free_ does not change and we can stop looking.
+        return len != n || n == longest_free_;
+      });
+    }
+
+    TC_CHECK_LT(best_index, N);
+    bits_.SetRange(best_index, n);
+
+    if (best_len == longest_free_) {
+      // We allocated from a longest range, so visited every range.
+      longest_free_ = std::max(longest_len - n, second_len);
+    }
+
+    nused_ += n;
+    nallocs_++;
+    return best_index;
+  }
+
   // We keep the two longest ranges in the bitmap since we might allocate
   // from one.
   size_t longest_len = 0;
@@ -280,15 +346,50 @@ inline size_t RangeTracker<N>::FindAndMark(size_t n) {
 template <size_t N>
 inline void RangeTracker<N>::Mark(size_t index, size_t n) {
   TC_ASSERT_GE(bits_.FindSet(index), index + n);
+  SetRange(index, n);
+  nallocs_++;
+}
+
+template <size_t N>
+inline bool RangeTracker<N>::MaybeExtend(size_t index, size_t n) {
+  TC_ASSERT_GT(n, 0);
+  TC_ASSERT_GT(index, 0);
+  TC_ASSERT(bits_.GetBit(index - 1));
+  if (index + n > N || bits_.FindSet(index) < index + n) {
+    return false;
+  }
+  SetRange(index, n);
+  return true;
+}
+
+template <size_t N>
+inline void RangeTracker<N>::SetRange(size_t index, size_t n) {
+  // The free range that [index, index + n) is carved from.
+  const size_t range_start = bits_.FindSetBackwards(index) + 1;
+  const size_t range_end = bits_.FindSet(index);
   bits_.SetRange(index, n);
   nused_ += n;
-  nallocs_++;
 
+  // We just marked a range as used. This only changes the longest free range
+  // recorded in longest_free_ if we took from a range that long.
+  if (range_end - range_start < longest_free_) return;
+  RecomputeLongestFree();
+}
+
+template <size_t N>
+inline void RangeTracker<N>::RecomputeLongestFree() {
   size_t longest_len = 0;
+  if constexpr (N <= kMaxBitParallelSize) {
+    bits_.VisitClearRanges([&](size_t, size_t len) {
+      longest_len = std::max(longest_len, len);
+      return true;
+    });
+    longest_free_ = longest_len;
+    return;
+  }
+
   size_t scan_index = 0, scan_len;
 
-  // We just marked a range as used. This might change the longest free range
-  // recorded in longest_free_. Recompute.
   while (bits_.NextFreeRange(scan_index, &scan_index, &scan_len)) {
     if (scan_len > longest_len) {
       longest_len = scan_len;
@@ -515,6 +616,37 @@ inline ssize_t Bitmap<N>::FindClearBackwards(size_t index) const {
   return FindValueBackwards<false>(index);
 }
 
+template <size_t N>
+template <typename Visitor>
+inline void Bitmap<N>::VisitClearRanges(Visitor visitor) const {
+  // Start of a range that runs on past the previous word, or N if none.
+  size_t open = N;
+  for (size_t i = 0; i < kWords; ++i) {
+    size_t free = ~bits_[i];
+    if (kDeadBits > 0 && i == kWords - 1) {
+      free &= (~static_cast<size_t>(0)) >> kDeadBits;
+    }
+    // The first and last clear bits of each range within the word.
+    size_t starts = free & ~(free << 1);
+    if (open != N) starts &= ~static_cast<size_t>(1);
+    size_t ends = free & ~(free >> 1);
+    while (ends != 0) {
+      if (open == N) {
+        open = i * kWordSize + absl::countr_zero(starts);
+        starts &= starts - 1;
+      }
+      const size_t last = absl::countr_zero(ends);
+      ends &= ends - 1;
+      if (last == kWordSize - 1 && i + 1 < kWords && !(bits_[i + 1] & 1)) {
+        break;
+      }
+      const size_t len = i * kWordSize + last + 1 - open;
+      if (!visitor(open, len)) return;
+      open = N;
+    }
+  }
+}
+
 template <size_t N>
 inline void Bitmap<N>::Clear() {
   for (int i = 0; i < kWords; ++i) {
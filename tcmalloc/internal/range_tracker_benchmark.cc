@@ -111,6 +111,99 @@ BENCHMARK_TEMPLATE(BM_MarkUnmarkChunks, 64);
 BENCHMARK_TEMPLATE(BM_MarkUnmarkChunks, 256);
 BENCHMARK_TEMPLATE(BM_MarkUnmarkChunks, 256 * 32);
 
+// Marks runs of 1-8 bits across the tracker, each with probability
+// used_percent, so that free ranges are short and numerous.  The last run is
+// left free.
+template <size_t N>
+static void Fragment(RangeTracker<N>& range, int used_percent,
+                     absl::BitGen& rng) {
+  size_t index = 0;
+  while (index < N) {
+    size_t len = std::min<size_t>(absl::Uniform<int32_t>(rng, 1, 9), N - index);
+    if (index + len < N && absl::Uniform<int32_t>(rng, 0, 100) < used_percent) {
+      range.Mark(index, len);
+    }
+    index += len;
+  }
+}
+
+template <size_t N>
+static std::vector<size_t> RequestLengths(const RangeTracker<N>& range,
+                                          absl::BitGen& rng) {
+  std::vector<size_t> lens(1024);
+  for (size_t& len : lens) {
+    len = absl::LogUniform<int32_t>(rng, 1, range.longest_free());
+  }
+  return lens;
+}
+
+// FindAndMark and Unmark a range in a tracker with state.range(0) percent of
+// it marked.
+template <size_t N>
+static void BM_FindAndMarkFragmented(benchmark::State& state) {
+  RangeTracker<N> range;
+  absl::BitGen rng;
+  Fragment(range, state.range(0), rng);
+  const std::vector<size_t> lens = RequestLengths(range, rng);
+
+  size_t i = 0;
+  for (auto s : state) {
+    const size_t len = lens[i++ % lens.size()];
+    size_t index = range.FindAndMark(len);
+    benchmark::DoNotOptimize(index);
+    range.Unmark(index, len);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_FindAndMarkFragmented, 64)->Arg(0)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(BM_FindAndMarkFragmented, 256)
+    ->Arg(0)
+    ->Arg(25)
+    ->Arg(50)
+    ->Arg(75)
+    ->Arg(90);
+BENCHMARK_TEMPLATE(BM_FindAndMarkFragmented, 512)->Arg(0)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(BM_FindAndMarkFragmented, 256 * 32)
+    ->Arg(0)
+    ->Arg(50)
+    ->Arg(90);
+
+// Baseline for BM_FindAndMarkFragmented: finds the best fit by visiting every
+// free range, as FindAndMark does for large trackers, without marking it.
+template <size_t N>
+static void BM_BestFitScanFragmented(benchmark::State& state) {
+  RangeTracker<N> range;
+  absl::BitGen rng;
+  Fragment(range, state.range(0), rng);
+  const std::vector<size_t> lens = RequestLengths(range, rng);
+
+  size_t i = 0;
+  for (auto s : state) {
+    const size_t n = lens[i++ % lens.size()];
+    size_t best_index = N, best_len = 2 * N;
+    size_t index = 0, len;
+    while (range.NextFreeRange(index, &index, &len)) {
+      if (len >= n && len < best_len) {
+        best_index = index;
+        best_len = len;
+      }
+      index += len;
+    }
+    benchmark::DoNotOptimize(best_index);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_BestFitScanFragmented, 256)
+    ->Arg(0)
+    ->Arg(25)
+    ->Arg(50)
+    ->Arg(75)
+    ->Arg(90);
+
 template <size_t N>
 static void BM_FillOnes(benchmark::State& state) {
   RangeTracker<N> range;
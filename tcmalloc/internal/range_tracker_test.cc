@@ -17,6 +17,7 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <utility>
 #include <vector>
@@ -24,6 +25,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/container/fixed_array.h"
+#include "absl/random/distributions.h"
 #include "absl/random/random.h"
 
 namespace tcmalloc {
@@ -314,6 +316,38 @@ TEST_F(BitmapTest, PopBatch) {
   EXPECT_TRUE(map.IsZero());
 }
 
+TEST_F(BitmapTest, VisitClearRanges) {
+  Bitmap<253> map;
+  map.SetRange(10, 50);
+  map.SetBit(63);
+  map.SetBit(128);
+  map.SetBit(252);
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  map.VisitClearRanges([&](size_t index, size_t len) {
+    ranges.push_back({index, len});
+    return true;
+  });
+  EXPECT_THAT(ranges, ElementsAre(Pair(0, 10), Pair(60, 3), Pair(64, 64),
+                                  Pair(129, 123)));
+
+  // Stops when the visitor returns false.
+  ranges.clear();
+  map.VisitClearRanges([&](size_t index, size_t len) {
+    ranges.push_back({index, len});
+    return index < 60;
+  });
+  EXPECT_THAT(ranges, ElementsAre(Pair(0, 10), Pair(60, 3)));
+
+  map.Clear();
+  ranges.clear();
+  map.VisitClearRanges([&](size_t index, size_t len) {
+    ranges.push_back({index, len});
+    return true;
+  });
+  EXPECT_THAT(ranges, ElementsAre(Pair(0, 253)));
+}
+
 class RangeTrackerTest : public ::testing::Test {
  protected:
   std::vector<std::pair<size_t, size_t>> FreeRanges() {
@@ -364,6 +398,70 @@ TEST_F(RangeTrackerTest, Mark) {
   EXPECT_EQ(range_.longest_free(), kBits);
 }
 
+TEST_F(RangeTrackerTest, MaybeExtend) {
+  range_.Mark(100, 100);
+  range_.Mark(300, 100);
+  // Extending into the free range that follows succeeds...
+  EXPECT_TRUE(range_.MaybeExtend(200, 50));
+  EXPECT_EQ(range_.used(), 250);
+  EXPECT_EQ(range_.allocs(), 2);
+  EXPECT_THAT(FreeRanges(), ElementsAre(Pair(0, 100), Pair(250, 50),
+                                        Pair(400, kBits - 400)));
+  // ...but not into another allocation, or past the end.
+  EXPECT_FALSE(range_.MaybeExtend(250, 51));
+  EXPECT_FALSE(range_.MaybeExtend(400, kBits - 399));
+  EXPECT_EQ(range_.used(), 250);
+
+  EXPECT_TRUE(range_.MaybeExtend(400, kBits - 400));
+  EXPECT_EQ(range_.longest_free(), 100);
+  range_.Unmark(100, 150);
+  range_.Unmark(300, kBits - 300);
+  EXPECT_EQ(range_.used(), 0);
+  EXPECT_EQ(range_.allocs(), 0);
+  EXPECT_EQ(range_.longest_free(), kBits);
+}
+
+// Small trackers find free ranges with bit-parallel operations; check them
+// against a best fit computed from the free ranges.
+TEST(SmallRangeTrackerTest, BestFit) {
+  constexpr size_t kBits = 256;
+  RangeTracker<kBits> range;
+  absl::BitGen rng;
+  std::vector<std::pair<size_t, size_t>> allocs;
+  for (int i = 0; i < 100000; ++i) {
+    if (range.longest_free() == 0 ||
+        (!allocs.empty() && absl::Bernoulli(rng, 0.5))) {
+      const size_t j = absl::Uniform<size_t>(rng, 0, allocs.size());
+      range.Unmark(allocs[j].first, allocs[j].second);
+      allocs[j] = allocs.back();
+      allocs.pop_back();
+    } else {
+      const size_t n = absl::LogUniform<size_t>(rng, 1, range.longest_free());
+      size_t want_index = kBits, want_len = 2 * kBits;
+      size_t index = 0, len;
+      while (range.NextFreeRange(index, &index, &len)) {
+        if (len >= n && len < want_len) {
+          want_index = index;
+          want_len = len;
+        }
+        index += len;
+      }
+      ASSERT_EQ(range.FindAndMark(n), want_index);
+      allocs.push_back({want_index, n});
+    }
+
+    size_t longest = 0, used = kBits;
+    size_t index = 0, len;
+    while (range.NextFreeRange(index, &index, &len)) {
+      longest = std::max(longest, len);
+      used -= len;
+      index += len;
+    }
+    ASSERT_EQ(range.longest_free(), longest);
+    ASSERT_EQ(range.used(), used);
+  }
+}
+
 TEST(BitmapScaleTest, ScaleAssertionFailures) {
 #ifdef NDEBUG
   GTEST_SKIP() << "Requires debug mode";
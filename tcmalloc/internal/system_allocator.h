@@ -20,9 +20,13 @@
 
 #include <asm/unistd.h>
 
+#include <cerrno>
+#include <cstdint>
 #include <cstring>
+#include <limits>
 #include <optional>
 
+#include "absl/numeric/bits.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "tcmalloc/internal/is_aligned_to.h"
@@ -71,6 +75,10 @@
 #define MADV_DONTNEED_LOCKED 24
 #endif
 
+#ifndef MREMAP_DONTUNMAP
+#define MREMAP_DONTUNMAP 4
+#endif
+
 // The <sys/prctl.h> on some systems may not define these macros yet even though
 // the kernel may have support for the new PR_SET_VMA syscall, so we explicitly
 // define them here.
@@ -149,7 +157,8 @@ class SystemAllocator {
   // performance.  (Only pages fully covered by the memory region will
   // be released, partial pages will not.)
   //
-  // Returns true on success.
+  // Returns true on success.  Memory the region factory reports as not
+  // releasable is left untouched, and reported as not released.
   [[nodiscard]] MemoryModifyStatus Release(void* start, size_t length);
 
   // Attempt to MADV_COLLAPSE the specified range of memory, starting at the
@@ -157,6 +166,17 @@ class SystemAllocator {
   // Returns true on success.
   [[nodiscard]] MemoryModifyStatus Collapse(void* start, size_t length);
 
+  // Returns whether the page containing <start> is backed by a NUMA node of
+  // <partition>, or std::nullopt if NUMA awareness is disabled or the page is
+  // not backed.
+  std::optional<bool> IsOnPartitionNodes(void* start, size_t partition) const;
+
+  // Migrates the pages backing [start, start + length) to a NUMA node of
+  // <partition>.  Unlike BindMemory, this leaves the memory policy of the range
+  // alone, so it does not split VMAs.
+  [[nodiscard]] MemoryModifyStatus MoveToPartition(void* start, size_t length,
+                                                   size_t partition) const;
+
   // Sets the anonymous VMA <name> for the specified range of memory, starting
   // at the <start> address, ranging <length>.
   // If <name> is empty, it uses a default name based on the memory tag for the
@@ -173,6 +193,22 @@ class SystemAllocator {
     madvise(start, length, MADV_POPULATE_READ | MADV_POPULATE_WRITE);
   }
 
+  // Moves the pages backing [from, from + length) to [to, to + length)
+  // without copying them, replacing whatever backed the destination.  The
+  // source range stays mapped, but is left unbacked (it reads back as zero.)
+  //
+  // Returns false, changing nothing, if the kernel cannot move the pages (for
+  // example, if they do not come from a single private anonymous mapping);
+  // the caller should copy instead.
+  //
+  // The destination keeps the NUMA binding and VMA name of its own memory tag,
+  // not those of the source, so the destination must not lie in a mapping that
+  // was given a different name.
+  //
+  // REQUIRES: both ranges are aligned to 4KiB boundaries and do not overlap.
+  [[nodiscard]] bool MovePages(void* from, void* to, size_t length)
+      ABSL_LOCKS_EXCLUDED(spinlock_);
+
   // Returns the current address region factory.
   [[nodiscard]] AddressRegionFactory* GetRegionFactory() const;
 
@@ -479,11 +515,13 @@ SystemAllocator<Topology, NormalPartitions>::AllocateFromRegion(
 
   AddressRegion*& region =
       *[&]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(spinlock_) GOOGLE_MALLOC_SECTION {
+        if (IsNormalTag(tag)) {
+          return &normal_region_[NormalTagPartition(tag)];
+        }
         switch (tag) {
           case MemoryTag::kNormal:
-            return &normal_region_[0];
           case MemoryTag::kNormalP1:
-            return &normal_region_[1];
+            break;
           case MemoryTag::kSampled:
             return &sampled_region_[0];
           case MemoryTag::kSampledP1:
@@ -536,17 +574,19 @@ void* SystemAllocator<Topology, NormalPartitions>::MmapAlignedLocked(
   std::optional<int> numa_partition;
   uintptr_t& next_addr =
       *[&]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(spinlock_) GOOGLE_MALLOC_SECTION {
+        if (IsNormalTag(tag)) {
+          const size_t partition = NormalTagPartition(tag);
+          numa_partition = topology_.numa_aware() ? partition : 0;
+          return &next_normal_addr_[partition];
+        }
         switch (tag) {
           case MemoryTag::kSampled:
             return &next_sampled_addr_[0];
           case MemoryTag::kSampledP1:
             return &next_sampled_addr_[1];
           case MemoryTag::kNormalP0:
-            numa_partition = 0;
-            return &next_normal_addr_[0];
           case MemoryTag::kNormalP1:
-            numa_partition = topology_.numa_aware() ? 1 : 0;
-            return &next_normal_addr_[1];
+            break;
           case MemoryTag::kCold:
             return &next_cold_addr_;
           case MemoryTag::kMetadata:
@@ -657,6 +697,19 @@ MemoryModifyStatus SystemAllocator<Topology, NormalPartitions>::Release(
   void* new_ptr = reinterpret_cast<void*>(new_start);
   size_t new_length = new_end - new_start;
 
+  // Only custom factories can hand out memory that must stay backed.  This is
+  // not an error: the memory simply remains in use.
+  AddressRegionFactory* custom_factory;
+  {
+    AllocationGuardSpinLockHolder lock_holder(spinlock_);
+    custom_factory =
+        region_factory_ != &mmap_factory_ ? region_factory_ : nullptr;
+  }
+  if (custom_factory != nullptr &&
+      !custom_factory->IsReleasable(new_ptr, new_length)) {
+    return {false, 0};
+  }
+
   ReleaseStatus result = ReleasePages(new_ptr, new_length);
   if (result == ReleaseStatus::kSuccess) {
     return {true, errno};
@@ -679,6 +732,42 @@ MemoryModifyStatus SystemAllocator<Topology, NormalPartitions>::Release(
   return {false, errno};
 }
 
+template <typename Topology, size_t NormalPartitions>
+bool SystemAllocator<Topology, NormalPartitions>::MovePages(void* from,
+                                                            void* to,
+                                                            size_t length) {
+#ifdef __linux__
+  {
+    // A custom factory may hand out shared or file-backed memory, which
+    // MREMAP_DONTUNMAP would leave aliased rather than unbacked.
+    AllocationGuardSpinLockHolder lock_holder(spinlock_);
+    if (region_factory_ != &mmap_factory_) return false;
+  }
+
+  ErrnoRestorer errno_restorer;
+  // MREMAP_DONTUNMAP (Linux 5.7+) keeps the source mapping in place, so we
+  // never leave a hole in our address space for another mmap to claim.
+  void* result =
+      mremap(from, length, length,
+             MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, to);
+  if (result == MAP_FAILED) return false;
+
+  // The destination takes on the attributes of the source mapping, including
+  // its NUMA policy and name.  Restore the ones the destination's tag implies.
+  const MemoryTag tag = GetMemoryTag(to);
+  if (IsNormalTag(tag)) {
+    AllocationGuardSpinLockHolder lock_holder(spinlock_);
+    BindMemory(to, length, NormalTagPartition(tag));
+  } else if (topology_.numa_aware()) {
+    syscall(__NR_mbind, to, length, MPOL_DEFAULT, nullptr, 0, 0);
+  }
+  SetAnonVmaName(to, length, std::nullopt);
+  return true;
+#else
+  return false;
+#endif
+}
+
 template <typename Topology, size_t NormalPartitions>
 MemoryModifyStatus SystemAllocator<Topology, NormalPartitions>::Collapse(
     void* start, size_t length) {
@@ -694,6 +783,59 @@ MemoryModifyStatus SystemAllocator<Topology, NormalPartitions>::Collapse(
   return {ret == 0, errno};
 }
 
+template <typename Topology, size_t NormalPartitions>
+std::optional<bool>
+SystemAllocator<Topology, NormalPartitions>::IsOnPartitionNodes(
+    void* start, size_t partition) const {
+  if (!topology_.numa_aware()) return std::nullopt;
+
+  ErrnoRestorer errno_restorer;
+  void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(start) &
+                                       ~(GetPageSize() - 1));
+  int node = -1;
+  // With no target nodes, move_pages only reports where the pages are.
+  if (syscall(__NR_move_pages, /*pid=*/0, /*count=*/1, &page,
+              /*nodes=*/nullptr, &node, /*flags=*/0) != 0 ||
+      node < 0) {
+    return std::nullopt;
+  }
+  if (node >= std::numeric_limits<uint64_t>::digits) return false;
+  return (topology_.GetPartitionNodes(partition) >> node) & 1;
+}
+
+template <typename Topology, size_t NormalPartitions>
+MemoryModifyStatus SystemAllocator<Topology, NormalPartitions>::MoveToPartition(
+    void* start, size_t length, size_t partition) const {
+  const uint64_t nodemask = topology_.GetPartitionNodes(partition);
+  if (!topology_.numa_aware() || nodemask == 0) {
+    return {false, EINVAL};
+  }
+  const int node = absl::countr_zero(nodemask);
+
+  ErrnoRestorer errno_restorer;
+  constexpr size_t kBatch = 512;
+  void* pages[kBatch];
+  int nodes[kBatch];
+  int status[kBatch];
+  const size_t page_size = GetPageSize();
+  uintptr_t addr = reinterpret_cast<uintptr_t>(start);
+  const uintptr_t end = addr + length;
+  while (addr < end) {
+    size_t n = 0;
+    for (; n < kBatch && addr < end; ++n, addr += page_size) {
+      pages[n] = reinterpret_cast<void*>(addr);
+      nodes[n] = node;
+    }
+    // move_pages returns the number of pages it could not move, or -1.
+    const long ret = syscall(__NR_move_pages, /*pid=*/0, n, pages, nodes,
+                             status, MPOL_MF_MOVE);
+    if (ret != 0) {
+      return {false, ret < 0 ? errno : EBUSY};
+    }
+  }
+  return {true, 0};
+}
+
 template <typename Topology, size_t NormalPartitions>
 void SystemAllocator<Topology, NormalPartitions>::SetAnonVmaName(
     void* start, size_t length, std::optional<absl::string_view> name) {
@@ -754,17 +896,21 @@ template <typename Topology, size_t NormalPartitions>
 AddressRegionFactory::UsageHint
 SystemAllocator<Topology, NormalPartitions>::TagToHint(MemoryTag tag) const {
   using UsageHint = AddressRegionFactory::UsageHint;
+  if (IsNormalTag(tag)) {
+    if (topology_.numa_aware()) {
+      static_assert(static_cast<int>(UsageHint::kNormalNumaAwareS7) -
+                        static_cast<int>(UsageHint::kNormalNumaAwareS0) + 1 >=
+                    kMaxNormalPartitions);
+      return static_cast<UsageHint>(
+          static_cast<int>(UsageHint::kNormalNumaAwareS0) +
+          NormalTagPartition(tag));
+    }
+    return UsageHint::kNormal;
+  }
   switch (tag) {
     case MemoryTag::kNormal:
-      if (topology_.numa_aware()) {
-        return UsageHint::kNormalNumaAwareS0;
-      }
-      return UsageHint::kNormal;
     case MemoryTag::kNormalP1:
-      if (topology_.numa_aware()) {
-        return UsageHint::kNormalNumaAwareS1;
-      }
-      return UsageHint::kNormal;
+      break;
     case MemoryTag::kSampled:
     case MemoryTag::kSampledP1:
       return UsageHint::kInfrequentAllocation;
@@ -139,6 +139,26 @@ TEST(SystemAllocatorTest, ReleaseLockedMemory) {
   EXPECT_EQ(allocator.release_errors(), 0);
 }
 
+TEST(SystemAllocatorTest, CountMappings) {
+  NumaTopology<2> topology;
+  SystemAllocator<NumaTopology<2>, 1> allocator(topology, kMinMmapAlloc);
+  void* p = allocator.MmapAligned(kHugePageSize, kHugePageSize,
+                                  MemoryTag::kNormal);
+  ASSERT_NE(p, nullptr);
+
+  std::optional<MappingCounts> counts = CountMappings();
+  ASSERT_TRUE(counts.has_value());
+  EXPECT_GT(counts->total, 0);
+  EXPECT_LE(counts->tcmalloc, counts->total);
+  if (tcmalloc::NamedVMAsSupported()) {
+    EXPECT_GT(counts->tcmalloc, 0);
+  }
+  if (counts->limit != 0) {
+    EXPECT_LT(counts->total, counts->limit);
+  }
+  EXPECT_EQ(munmap(p, kHugePageSize), 0);
+}
+
 }  // namespace
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
@@ -79,6 +79,8 @@ MallocExtension_Internal_StartEventTracing();
 ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_ActivateGuardedSampling();
 ABSL_ATTRIBUTE_WEAK tcmalloc::MallocExtension::Ownership
 MallocExtension_Internal_GetOwnership(const void* ptr);
+ABSL_ATTRIBUTE_WEAK bool MallocExtension_Internal_ShouldRelocate(
+    const void* ptr);
 ABSL_ATTRIBUTE_WEAK size_t MallocExtension_Internal_GetMemoryLimit(
     tcmalloc::MallocExtension::LimitKind limit_kind);
 ABSL_ATTRIBUTE_WEAK bool MallocExtension_Internal_GetNumericProperty(
@@ -118,6 +120,15 @@ ABSL_ATTRIBUTE_WEAK size_t
 MallocExtension_Internal_ReleaseMemoryToSystem(size_t bytes);
 ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetMemoryLimit(
     size_t limit, tcmalloc::MallocExtension::LimitKind limit_kind);
+ABSL_ATTRIBUTE_WEAK tcmalloc::MallocExtension::HardLimitAction
+MallocExtension_Internal_GetHardLimitAction();
+ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetHardLimitAction(
+    tcmalloc::MallocExtension::HardLimitAction action);
+ABSL_ATTRIBUTE_WEAK bool MallocExtension_Internal_AddMemoryLimitCallback(
+    tcmalloc::MallocExtension::LimitKind limit_kind, double fraction,
+    tcmalloc::MallocExtension::MemoryLimitCallback callback);
+ABSL_ATTRIBUTE_WEAK bool MallocExtension_Internal_RemoveMemoryLimitCallback(
+    tcmalloc::MallocExtension::MemoryLimitCallback callback);
 
 ABSL_ATTRIBUTE_WEAK size_t
 MallocExtension_Internal_GetAllocatedSize(const void* ptr);
@@ -137,12 +148,31 @@ ABSL_ATTRIBUTE_WEAK tcmalloc::MallocExtension::BytesPerSecond
 MallocExtension_Internal_GetBackgroundReleaseRate();
 ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetBackgroundReleaseRate(
     tcmalloc::MallocExtension::BytesPerSecond);
+ABSL_ATTRIBUTE_WEAK bool
+MallocExtension_Internal_GetBackgroundReleaseAdaptive();
+ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetBackgroundReleaseAdaptive(
+    bool value);
+ABSL_ATTRIBUTE_WEAK double MallocExtension_Internal_GetMemoryPressure();
+ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetMemoryPressure(
+    double value);
 
 ABSL_ATTRIBUTE_WEAK int64_t
 MallocExtension_Internal_GetGuardedSamplingInterval();
 ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetGuardedSamplingInterval(
     int64_t);
 
+ABSL_ATTRIBUTE_WEAK int64_t
+MallocExtension_Internal_GetSampledQuarantineBytes();
+ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetSampledQuarantineBytes(
+    int64_t);
+
+ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_GetThreadAllocatedBytes(
+    tcmalloc::MallocExtension::ThreadAllocatedBytes* ret);
+ABSL_ATTRIBUTE_WEAK tcmalloc::MallocExtension::ThreadAccountingMode
+MallocExtension_Internal_GetThreadAccountingMode();
+ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetThreadAccountingMode(
+    tcmalloc::MallocExtension::ThreadAccountingMode mode);
+
 ABSL_ATTRIBUTE_WEAK int64_t
 MallocExtension_Internal_GetMaxTotalThreadCacheBytes();
 ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_SetMaxTotalThreadCacheBytes(
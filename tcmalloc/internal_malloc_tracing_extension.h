@@ -20,7 +20,10 @@
 #ifndef TCMALLOC_INTERNAL_MALLOC_TRACING_EXTENSION_H_
 #define TCMALLOC_INTERNAL_MALLOC_TRACING_EXTENSION_H_
 
+#include <cstddef>
+
 #include "absl/base/attributes.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "tcmalloc/malloc_tracing_extension.h"
 
@@ -30,6 +33,16 @@ ABSL_ATTRIBUTE_WEAK
 absl::StatusOr<tcmalloc::malloc_tracing_extension::AllocatedAddressRanges>
 MallocTracingExtension_Internal_GetAllocatedAddressRanges();
 
+ABSL_ATTRIBUTE_WEAK absl::Status
+MallocTracingExtension_Internal_StartPageHeapTracing(size_t events_per_cpu);
+
+ABSL_ATTRIBUTE_WEAK absl::Status
+MallocTracingExtension_Internal_StopPageHeapTracing();
+
+ABSL_ATTRIBUTE_WEAK
+absl::StatusOr<tcmalloc::malloc_tracing_extension::PageHeapEvents>
+MallocTracingExtension_Internal_DrainPageHeapEvents();
+
 #endif
 
 #endif  // TCMALLOC_INTERNAL_MALLOC_TRACING_EXTENSION_H_
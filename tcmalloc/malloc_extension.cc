@@ -181,6 +181,12 @@ size_t AddressRegionFactory::GetStats(absl::Span<char> buffer) {
   return 0;
 }
 
+bool AddressRegionFactory::IsReleasable(const void* start, size_t size) {
+  static_cast<void>(start);
+  static_cast<void>(size);
+  return true;
+}
+
 size_t AddressRegionFactory::GetStatsInPbtxt(absl::Span<char> buffer) {
   static_cast<void>(buffer);
   return 0;
@@ -362,6 +368,46 @@ void MallocExtension::SetMemoryLimit(const size_t limit, LimitKind limit_kind) {
 #endif
 }
 
+MallocExtension::HardLimitAction MallocExtension::GetHardLimitAction() {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_GetHardLimitAction != nullptr) {
+    return MallocExtension_Internal_GetHardLimitAction();
+  }
+#endif
+  return HardLimitAction::kAbort;
+}
+
+void MallocExtension::SetHardLimitAction(HardLimitAction action) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_SetHardLimitAction != nullptr) {
+    MallocExtension_Internal_SetHardLimitAction(action);
+  }
+#else
+  (void)action;
+#endif
+}
+
+bool MallocExtension::AddMemoryLimitCallback(LimitKind limit_kind,
+                                             double fraction,
+                                             MemoryLimitCallback callback) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_AddMemoryLimitCallback != nullptr) {
+    return MallocExtension_Internal_AddMemoryLimitCallback(limit_kind,
+                                                           fraction, callback);
+  }
+#endif
+  return false;
+}
+
+bool MallocExtension::RemoveMemoryLimitCallback(MemoryLimitCallback callback) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_RemoveMemoryLimitCallback != nullptr) {
+    return MallocExtension_Internal_RemoveMemoryLimitCallback(callback);
+  }
+#endif
+  return false;
+}
+
 int64_t MallocExtension::GetProfileSamplingInterval() {
 #if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
   if (&MallocExtension_Internal_GetProfileSamplingInterval != nullptr) {
@@ -404,6 +450,30 @@ void MallocExtension::SetGuardedSamplingInterval(int64_t interval) {
 #endif
 }
 
+int64_t MallocExtension::GetSampledQuarantineBytes() {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (MallocExtension_Internal_GetSampledQuarantineBytes == nullptr) {
+    return -1;
+  }
+
+  return MallocExtension_Internal_GetSampledQuarantineBytes();
+#else
+  return -1;
+#endif
+}
+
+void MallocExtension::SetSampledQuarantineBytes(int64_t bytes) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (MallocExtension_Internal_SetSampledQuarantineBytes == nullptr) {
+    return;
+  }
+
+  MallocExtension_Internal_SetSampledQuarantineBytes(bytes);
+#else
+  (void)bytes;
+#endif
+}
+
 void MallocExtension::ActivateGuardedSampling() {
 #if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
   if (&MallocExtension_Internal_ActivateGuardedSampling != nullptr) {
@@ -651,6 +721,15 @@ MallocExtension::Ownership MallocExtension::GetOwnership(const void* p) {
   return MallocExtension::Ownership::kUnknown;
 }
 
+bool MallocExtension::ShouldRelocate(const void* p) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (MallocExtension_Internal_ShouldRelocate != nullptr) {
+    return MallocExtension_Internal_ShouldRelocate(p);
+  }
+#endif
+  return false;
+}
+
 MallocExtension::PropertyMap MallocExtension::GetProperties() {
   MallocExtension::PropertyMap ret;
 #if TCMALLOC_UNDER_SANITIZERS
@@ -728,6 +807,72 @@ void MallocExtension::SetBackgroundReleaseRate(BytesPerSecond rate) {
 #endif
 }
 
+bool MallocExtension::GetBackgroundReleaseAdaptive() {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_GetBackgroundReleaseAdaptive != nullptr) {
+    return MallocExtension_Internal_GetBackgroundReleaseAdaptive();
+  }
+#endif
+  return false;
+}
+
+void MallocExtension::SetBackgroundReleaseAdaptive(bool value) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_SetBackgroundReleaseAdaptive != nullptr) {
+    MallocExtension_Internal_SetBackgroundReleaseAdaptive(value);
+  }
+#endif
+}
+
+double MallocExtension::GetMemoryPressure() {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_GetMemoryPressure != nullptr) {
+    return MallocExtension_Internal_GetMemoryPressure();
+  }
+#endif
+  return 0;
+}
+
+void MallocExtension::SetMemoryPressure(double percent) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_SetMemoryPressure != nullptr) {
+    MallocExtension_Internal_SetMemoryPressure(percent);
+  }
+#endif
+}
+
+std::optional<MallocExtension::ThreadAllocatedBytes>
+MallocExtension::GetThreadAllocatedBytes() {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_GetThreadAllocatedBytes != nullptr) {
+    ThreadAllocatedBytes ret;
+    MallocExtension_Internal_GetThreadAllocatedBytes(&ret);
+    return ret;
+  }
+#endif
+  return std::nullopt;
+}
+
+MallocExtension::ThreadAccountingMode
+MallocExtension::GetThreadAccountingMode() {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_GetThreadAccountingMode != nullptr) {
+    return MallocExtension_Internal_GetThreadAccountingMode();
+  }
+#endif
+  return ThreadAccountingMode::kSampled;
+}
+
+void MallocExtension::SetThreadAccountingMode(ThreadAccountingMode mode) {
+#if ABSL_INTERNAL_HAVE_WEAK_MALLOCEXTENSION_STUBS
+  if (&MallocExtension_Internal_SetThreadAccountingMode != nullptr) {
+    MallocExtension_Internal_SetThreadAccountingMode(mode);
+  }
+#else
+  (void)mode;
+#endif
+}
+
 }  // namespace tcmalloc
 
 // Default implementation just returns size. The expectation is that
@@ -365,6 +365,14 @@ class AddressRegionFactory {
     // mbind is not sufficient (e.g. when dealing with pre-faulted memory).
     kNormalNumaAwareS0,  // Normal usage intended for NUMA S0 under numa_aware.
     kNormalNumaAwareS1,  // Normal usage intended for NUMA S1 under numa_aware.
+    // Normal usage intended for further NUMA partitions, in builds supporting
+    // more than two.
+    kNormalNumaAwareS2,
+    kNormalNumaAwareS3,
+    kNormalNumaAwareS4,
+    kNormalNumaAwareS5,
+    kNormalNumaAwareS6,
+    kNormalNumaAwareS7,
   };
 
   constexpr AddressRegionFactory() = default;
@@ -382,6 +390,12 @@ class AddressRegionFactory {
   virtual AddressRegion* absl_nonnull Create(void* absl_nonnull start_addr,
                                              size_t size, UsageHint hint) = 0;
 
+  // Returns whether TCMalloc may release [start, start + size), memory handed
+  // out by one of this factory's regions, back to the OS.  Memory that is not
+  // releasable stays backed; use this for memory that could not reliably be
+  // faulted in again once released.  The default allows all releases.
+  virtual bool IsReleasable(const void* absl_nonnull start, size_t size);
+
   // Gets a human-readable description of the current state of the allocator.
   //
   // The state is stored in the provided buffer.  The number of bytes used (or
@@ -527,11 +541,58 @@ class MallocExtension final {
   // malloc call would require passing this limit, release as much memory to
   // the OS as needed to stay under it if possible.
   //
-  // If limit_kind == kHard, crash if returning memory is unable to get below
-  // the limit.
+  // If limit_kind == kHard and returning memory is unable to get below the
+  // limit, take the action given by GetHardLimitAction().
   static size_t GetMemoryLimit(LimitKind limit_kind);
   static void SetMemoryLimit(size_t limit, LimitKind limit_kind);
 
+  enum class HardLimitAction {
+    // Crash the process.  This is the default.
+    kAbort,
+    // Fail page heap allocations that would grow backed memory while usage
+    // exceeds the limit.  Allocations served from memory that is already
+    // backed still succeed.  The failure is reported like any other
+    // out-of-memory condition: malloc returns nullptr, and operator new
+    // reports the OOM.  Memory that TCMalloc allocates for its own metadata
+    // cannot fail, and may still exceed the limit.
+    kFailAllocation,
+  };
+
+  // Gets and sets what happens when usage cannot be kept below the kHard
+  // limit.
+  static HardLimitAction GetHardLimitAction();
+  static void SetHardLimitAction(HardLimitAction action);
+
+  // Passed to a MemoryLimitCallback.
+  struct MemoryLimitNotification {
+    LimitKind limit_kind;
+    // The fraction the callback was registered with.
+    double fraction;
+    // The limit, and the usage that reached fraction * limit, in bytes.
+    size_t limit;
+    size_t usage;
+  };
+
+  typedef void (*MemoryLimitCallback)(const MemoryLimitNotification&);
+
+  // Registers callback to be invoked when memory usage reaches fraction (in
+  // (0, 1]) of the limit_kind limit, e.g. to shed application caches at 80%,
+  // 90% and 95% of the limit before TCMalloc has to break up hugepages to stay
+  // below it.
+  //
+  // Usage is checked from ProcessBackgroundActions, so callbacks run on the
+  // background thread, at most once per GetBackgroundProcessSleepInterval().
+  // A callback fires once each time usage rises to its threshold, and again
+  // only after usage has dropped below the threshold.  Callbacks may allocate.
+  //
+  // Returns false if the implementation does not support callbacks, the
+  // arguments are invalid, or too many callbacks are registered.
+  [[nodiscard]] static bool AddMemoryLimitCallback(
+      LimitKind limit_kind, double fraction, MemoryLimitCallback callback);
+  // Removes every registration of callback.  Returns false if there was none.
+  [[nodiscard]] static bool RemoveMemoryLimitCallback(
+      MemoryLimitCallback callback);
+
   // Gets the sampling interval.  Returns a value < 0 if unknown.
   static int64_t GetProfileSamplingInterval();
   // Sets the sampling interval for heap profiles.  TCMalloc samples
@@ -553,6 +614,17 @@ class MallocExtension final {
   // use-after-free according to the guarded sample parameter value.
   static void ActivateGuardedSampling();
 
+  // Gets the sampled quarantine budget in bytes.  Returns a value < 0 if
+  // unknown.
+  static int64_t GetSampledQuarantineBytes();
+  // Sets how many bytes of freed sampled allocations TCMalloc may hold in
+  // quarantine.  Quarantined allocations are filled with a pattern that is
+  // verified when they are released, so writes after free are reported with
+  // the allocation and deallocation stacks.  Lowering the budget releases the
+  // oldest allocations until the rest fit; 0 (the default) disables the
+  // quarantine and releases anything it holds.
+  static void SetSampledQuarantineBytes(int64_t bytes);
+
   // Gets whether TCMalloc is using per-CPU caches.
   static bool PerCpuCachesActive();
 
@@ -626,6 +698,21 @@ class MallocExtension final {
   enum class Ownership { kUnknown = 0, kOwned, kNotOwned };
   static Ownership GetOwnership(const void* absl_nullable p);
 
+  // Returns true if p is on a sparsely used hugepage that TCMalloc has
+  // nominated for relocation: were the few allocations on it moved elsewhere,
+  // TCMalloc could return the whole hugepage to the OS instead of breaking it
+  // up.  Containers that are able to move their objects may, when convenient,
+  // allocate a new copy of such an object, move the contents over and free the
+  // original; TCMalloc prefers fuller hugepages for the new copy.
+  //
+  // Hugepages are nominated by background actions (see
+  // ProcessBackgroundActions()), and only for as many pages as the other
+  // hugepages have free, so this is a hint that may be out of date.  It does
+  // not take locks.  Returns false if p is null or TCMalloc is not in use.
+  //
+  // REQUIRES: p is null or was allocated by TCMalloc and not yet freed.
+  [[nodiscard]] static bool ShouldRelocate(const void* absl_nullable p);
+
   // Type used by GetProperties.  See comment on GetProperties.
   struct Property {
     size_t value;
@@ -719,6 +806,64 @@ class MallocExtension final {
   // Specifies the release rate from the page heap.  ProcessBackgroundActions
   // must be called for this to be operative.
   static void SetBackgroundReleaseRate(BytesPerSecond rate);
+
+  // Gets whether ProcessBackgroundActions adapts its release rate to recent
+  // demand and memory pressure.
+  static bool GetBackgroundReleaseAdaptive();
+  // When enabled, ProcessBackgroundActions releases free memory that recent
+  // demand does not predict will be reused, speeding up while demand is flat
+  // or falling and under memory pressure (see SetMemoryPressure), so an idle
+  // heap converges to its predicted demand.  GetBackgroundReleaseRate() acts
+  // as a floor.  Disabled by default.
+  static void SetBackgroundReleaseAdaptive(bool value);
+
+  // Gets the memory pressure last reported with SetMemoryPressure.
+  static double GetMemoryPressure();
+  // Reports memory pressure from outside the allocator, as the percentage of
+  // recent time that tasks were stalled on memory (e.g. the "some avg10" field
+  // of a PSI file), clamped to [0, 100].  Higher pressure makes background
+  // release more aggressive.
+  static void SetMemoryPressure(double percent);
+
+  // Bytes allocated and freed by a single thread over its lifetime.
+  struct ThreadAllocatedBytes {
+    uint64_t allocated = 0;
+    uint64_t freed = 0;
+  };
+
+  // Returns the bytes allocated and freed by the calling thread, or nullopt if
+  // the implementation does not support per-thread accounting.  Both counters
+  // are monotonic; their difference approximates the thread's net allocation.
+  //
+  // "allocated" is the sum of requested sizes plus one byte per allocation,
+  // and is always exact.  It is maintained by the heap profiling sampler, so it
+  // adds no cost to the allocation fast path.  Growing or shrinking an
+  // allocation in place via realloc is not counted.
+  //
+  // "freed" depends on the accounting mode:
+  // * kSampled (the default) credits each freed heap profiling sample with
+  //   the bytes it represents.  This adds no cost to the deallocation fast
+  //   path.  The estimate is unbiased, and its standard deviation is roughly
+  //   sqrt(freed * GetProfileSamplingInterval()) bytes, i.e. within 1% with
+  //   high probability once about 10^5 sampling intervals have been freed.
+  //   Deallocations are not counted while sampling is disabled.
+  // * kExact counts every deallocation by its size (or allocated size, if
+  //   the caller did not supply one) plus one byte.  This installs a delete
+  //   hook, which moves every thread's deallocations off the fast path.  A
+  //   thread that is already running when the mode is switched may still
+  //   miss a few deallocations until it next takes a slow path.
+  //
+  // Deallocations are attributed to the thread that frees the memory, which
+  // may differ from the thread that allocated it.
+  [[nodiscard]] static std::optional<ThreadAllocatedBytes>
+  GetThreadAllocatedBytes();
+
+  enum class ThreadAccountingMode { kSampled, kExact };
+
+  // Gets and sets the process-wide mode used to count freed bytes.  Changing
+  // the mode does not reset existing counters.
+  static ThreadAccountingMode GetThreadAccountingMode();
+  static void SetThreadAccountingMode(ThreadAccountingMode mode);
 };
 
 }  // namespace tcmalloc
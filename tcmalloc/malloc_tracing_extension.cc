@@ -19,6 +19,8 @@
 
 #include "tcmalloc/malloc_tracing_extension.h"
 
+#include <cstddef>
+
 #include "absl/base/attributes.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -37,5 +39,36 @@ absl::StatusOr<AllocatedAddressRanges> GetAllocatedAddressRanges() {
       "malloc_tracing_extension routines not exported by the current malloc.");
 }
 
+absl::Status StartPageHeapTracing(size_t events_per_cpu) {
+#if ABSL_HAVE_ATTRIBUTE_WEAK && !defined(__APPLE__) && !defined(__EMSCRIPTEN__)
+  if (&MallocTracingExtension_Internal_StartPageHeapTracing != nullptr) {
+    return MallocTracingExtension_Internal_StartPageHeapTracing(
+        events_per_cpu);
+  }
+#endif
+  return absl::UnimplementedError(
+      "malloc_tracing_extension routines not exported by the current malloc.");
+}
+
+absl::Status StopPageHeapTracing() {
+#if ABSL_HAVE_ATTRIBUTE_WEAK && !defined(__APPLE__) && !defined(__EMSCRIPTEN__)
+  if (&MallocTracingExtension_Internal_StopPageHeapTracing != nullptr) {
+    return MallocTracingExtension_Internal_StopPageHeapTracing();
+  }
+#endif
+  return absl::UnimplementedError(
+      "malloc_tracing_extension routines not exported by the current malloc.");
+}
+
+absl::StatusOr<PageHeapEvents> DrainPageHeapEvents() {
+#if ABSL_HAVE_ATTRIBUTE_WEAK && !defined(__APPLE__) && !defined(__EMSCRIPTEN__)
+  if (&MallocTracingExtension_Internal_DrainPageHeapEvents != nullptr) {
+    return MallocTracingExtension_Internal_DrainPageHeapEvents();
+  }
+#endif
+  return absl::UnimplementedError(
+      "malloc_tracing_extension routines not exported by the current malloc.");
+}
+
 }  // namespace malloc_tracing_extension
 }  // namespace tcmalloc
@@ -24,7 +24,10 @@
 #include <cstdint>
 #include <vector>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 
 namespace tcmalloc {
 namespace malloc_tracing_extension {
@@ -48,6 +51,56 @@ struct AllocatedAddressRanges {
 // Returns the address ranges currently allocated by TCMalloc.
 absl::StatusOr<AllocatedAddressRanges> GetAllocatedAddressRanges();
 
+// An event in TCMalloc's page heap, as recorded while page heap tracing is
+// running.
+struct PageHeapEvent {
+  enum class Type {
+    // A span of size bytes at start_addr was allocated from or returned to
+    // the page heap.
+    kNew,
+    kDelete,
+    // size bytes at start_addr, less than a hugepage, were returned to the OS.
+    kSubrelease,
+    // size bytes of whole hugepages at start_addr were returned to the OS.
+    kHugePageRelease,
+    // size bytes at start_addr were collapsed into hugepages.
+    kCollapse,
+    // The limit of the cache of free hugepages grew or shrank by size bytes.
+    // start_addr is zero.
+    kCacheGrow,
+    kCacheShrink,
+  };
+
+  Type type;
+  absl::Time time;
+  // The page heap the event happened in, e.g. "NORMAL_P0", "SAMPLED" or
+  // "COLD".  Points to static storage.
+  absl::string_view heap;
+  uintptr_t start_addr;
+  size_t size;
+};
+
+struct PageHeapEvents {
+  // Ordered by time.
+  std::vector<PageHeapEvent> events;
+  // Events lost because a per-CPU buffer wrapped before it was drained.
+  size_t dropped;
+};
+
+// Starts recording page heap events into per-CPU buffers that hold
+// events_per_cpu events each (rounded up to a power of two).  The buffers are
+// allocated on the first call and kept for the lifetime of the process, so
+// later calls must ask for the same or a smaller size.  Recording costs a
+// relaxed load per event while tracing is stopped.
+absl::Status StartPageHeapTracing(size_t events_per_cpu = 4096);
+
+// Stops recording.  Events recorded so far can still be drained.
+absl::Status StopPageHeapTracing();
+
+// Returns and forgets the events recorded since the last drain.  Drain at
+// least once per buffer's worth of events to avoid drops.
+absl::StatusOr<PageHeapEvents> DrainPageHeapEvents();
+
 }  // namespace malloc_tracing_extension
 }  // namespace tcmalloc
 
@@ -0,0 +1,327 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/memfs_malloc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "absl/flags/flag.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/strerror.h"
+#include "tcmalloc/internal/util.h"
+#include "tcmalloc/malloc_extension.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+#ifndef MFD_HUGE_SHIFT
+#define MFD_HUGE_SHIFT 26
+#endif
+
+#ifndef HUGETLBFS_MAGIC
+#define HUGETLBFS_MAGIC 0x958458f6
+#endif
+
+ABSL_FLAG(std::string, memfs_malloc_path, "",
+          "Where to get hugetlb pages for the heap from: a directory on a "
+          "hugetlbfs mount, or \"memfd\".  Empty disables memfs_malloc.");
+ABSL_FLAG(size_t, memfs_malloc_page_size, size_t{2} << 20,
+          "Hugetlb page size to request with --memfs_malloc_path=memfd.");
+
+namespace tcmalloc {
+
+using tcmalloc_internal::ErrnoRestorer;
+using tcmalloc_internal::Printer;
+using tcmalloc_internal::StrError;
+
+// Hands out hugetlb-backed memory from the end of [start, start + size), as
+// MmapRegion does, until a hugetlb allocation fails.  The rest of the range is
+// then handed to a region from the fallback factory.
+//
+// Hugetlb memory is handed out downwards from the end of the region, so it
+// always forms the single range [hugetlb_start_, hugetlb_end_).
+class HugetlbRegionFactory::Region final : public AddressRegion {
+ public:
+  Region(HugetlbRegionFactory& factory, uintptr_t start, size_t size,
+         Region* next)
+      : factory_(factory), start_(start), free_size_(size), next_(next) {}
+  ~Region() override = default;
+
+  static void operator delete(void*) { __builtin_trap(); }
+
+  std::pair<void*, size_t> Alloc(size_t request_size,
+                                 size_t alignment) override;
+
+  // Returns true if [start, end) overlaps this region's hugetlb pages.
+  bool OverlapsHugetlb(uintptr_t start, uintptr_t end) const {
+    return start < hugetlb_end_.load(std::memory_order_relaxed) &&
+           hugetlb_start_.load(std::memory_order_relaxed) < end;
+  }
+
+  Region* next() const { return next_; }
+
+ private:
+  HugetlbRegionFactory& factory_;
+  const uintptr_t start_;
+  size_t free_size_;
+  AddressRegion* fallback_ = nullptr;
+  Region* const next_;
+
+  // Memory handed out by TCMalloc is published to other threads under its
+  // own locks, so these only need to be atomic, not ordered.
+  std::atomic<uintptr_t> hugetlb_start_{0};
+  std::atomic<uintptr_t> hugetlb_end_{0};
+};
+
+std::pair<void*, size_t> HugetlbRegionFactory::Region::Alloc(
+    size_t request_size, size_t alignment) {
+  if (fallback_ == nullptr) {
+    const size_t page_size = factory_.page_size_;
+    const size_t size = (request_size + page_size - 1) & ~(page_size - 1);
+    if (size < request_size) return {nullptr, 0};
+    const size_t hugetlb_alignment = std::max(alignment, page_size);
+
+    // Hugetlb mappings must cover whole pages, so the end of the region may be
+    // unusable if it is not page aligned.
+    const uintptr_t end = (start_ + free_size_) & ~(page_size - 1);
+    uintptr_t result = (end - size) & ~(hugetlb_alignment - 1);
+    if (end >= start_ + size && result >= start_) {
+      void* ptr = reinterpret_cast<void*>(result);
+      const size_t actual_size = end - result;
+      switch (factory_.Map(ptr, actual_size)) {
+        case MapResult::kSuccess:
+          free_size_ = result - start_;
+          if (hugetlb_end_.load(std::memory_order_relaxed) == 0) {
+            hugetlb_end_.store(end, std::memory_order_relaxed);
+          }
+          hugetlb_start_.store(result, std::memory_order_relaxed);
+          factory_.hugetlb_bytes_.fetch_add(actual_size,
+                                            std::memory_order_relaxed);
+          return {ptr, actual_size};
+        case MapResult::kPoolExhausted:
+          factory_.pool_exhausted_.fetch_add(1, std::memory_order_relaxed);
+          break;
+        case MapResult::kFailure:
+          factory_.failures_.fetch_add(1, std::memory_order_relaxed);
+          break;
+      }
+    }
+
+    // Either hugetlb pages are unavailable, or they do not fit in what is
+    // left of the region.  Both are unlikely to change for this region.
+    if (free_size_ == 0) return {nullptr, 0};
+    fallback_ = factory_.fallback_->Create(reinterpret_cast<void*>(start_),
+                                           free_size_, UsageHint::kNormal);
+  }
+
+  std::pair<void*, size_t> ret = fallback_->Alloc(request_size, alignment);
+  if (ret.first != nullptr) {
+    factory_.fallback_bytes_.fetch_add(ret.second, std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+HugetlbRegionFactory* HugetlbRegionFactory::New(
+    absl::string_view path, size_t page_size,
+    AddressRegionFactory* absl_nonnull fallback) {
+  int fd;
+  if (path == "memfd") {
+    if (!absl::has_single_bit(page_size)) {
+      TC_LOG("memfs_malloc: bad hugetlb page size %v", page_size);
+      return nullptr;
+    }
+    const unsigned int flags =
+        MFD_CLOEXEC | MFD_HUGETLB |
+        (static_cast<unsigned int>(absl::countr_zero(page_size))
+         << MFD_HUGE_SHIFT);
+    fd = syscall(SYS_memfd_create, "tcmalloc_memfs", flags);
+    if (fd < 0) {
+      TC_LOG("memfs_malloc: memfd_create(MFD_HUGETLB, %v) failed (%v)",
+             page_size, StrError(errno));
+      return nullptr;
+    }
+  } else {
+    std::string name = absl::StrCat(path, "/tcmalloc.XXXXXX");
+    fd = mkostemp(name.data(), O_CLOEXEC);
+    if (fd < 0) {
+      TC_LOG("memfs_malloc: mkostemp(%v) failed (%v)", name.c_str(),
+             StrError(errno));
+      return nullptr;
+    }
+    unlink(name.c_str());
+
+    struct statfs sfs;
+    if (fstatfs(fd, &sfs) != 0 || sfs.f_type != HUGETLBFS_MAGIC) {
+      TC_LOG("memfs_malloc: %v is not on hugetlbfs", path);
+      close(fd);
+      return nullptr;
+    }
+    page_size = sfs.f_bsize;
+  }
+
+  void* space = MallocInternal(sizeof(HugetlbRegionFactory));
+  return new (space) HugetlbRegionFactory(fd, page_size, fallback);
+}
+
+AddressRegion* HugetlbRegionFactory::Create(void* start, size_t size,
+                                            UsageHint hint) {
+  if (hint != UsageHint::kNormal) {
+    return fallback_->Create(start, size, hint);
+  }
+  void* space = MallocInternal(sizeof(Region));
+  Region* head = regions_.load(std::memory_order_relaxed);
+  Region* region;
+  do {
+    region = new (space)
+        Region(*this, reinterpret_cast<uintptr_t>(start), size, head);
+  } while (!regions_.compare_exchange_weak(head, region,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+  return region;
+}
+
+bool HugetlbRegionFactory::IsReleasable(const void* start, size_t size) {
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(start);
+  for (const Region* region = regions_.load(std::memory_order_acquire);
+       region != nullptr; region = region->next()) {
+    if (region->OverlapsHugetlb(begin, begin + size)) return false;
+  }
+  return true;
+}
+
+HugetlbRegionFactory::MapResult HugetlbRegionFactory::Map(void* addr,
+                                                         size_t size) {
+  ErrnoRestorer errno_restorer;
+  // File offsets are never reused, so there is no need to synchronize with
+  // other regions beyond claiming a range.
+  const off_t offset = next_offset_.fetch_add(size, std::memory_order_relaxed);
+
+  // Allocate the pages before mapping them.  Mapping first would reserve them,
+  // but a MAP_FIXED mmap that fails to reserve may have already unmapped our
+  // PROT_NONE reservation.  Once allocated, the pages stay in the file, so
+  // faults on them can never fail for lack of hugetlb pages.
+  if (fallocate(fd_, 0, offset, size) != 0) {
+    const int err = errno;
+    // Give back whatever part of the range we did get.
+    fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size);
+    if (err == ENOMEM || err == ENOSPC) {
+      return MapResult::kPoolExhausted;
+    }
+    TC_LOG("memfs_malloc: fallocate(%v) failed (%v)", size, StrError(err));
+    return MapResult::kFailure;
+  }
+
+  if (mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd_,
+           offset) == MAP_FAILED) {
+    TC_LOG("memfs_malloc: mmap(%p, %v) failed (%v)", addr, size,
+           StrError(errno));
+    fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size);
+    // Restore the reservation for the fallback region.
+    if (mmap(addr, size, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1,
+             0) == MAP_FAILED) {
+      TC_BUG("memfs_malloc: cannot restore reservation at %p (%v)", addr,
+             StrError(errno));
+    }
+    return MapResult::kFailure;
+  }
+  return MapResult::kSuccess;
+}
+
+HugetlbRegionFactory::Stats HugetlbRegionFactory::stats() const {
+  return {
+      .page_size = page_size_,
+      .hugetlb_bytes = hugetlb_bytes_.load(std::memory_order_relaxed),
+      .fallback_bytes = fallback_bytes_.load(std::memory_order_relaxed),
+      .pool_exhausted = pool_exhausted_.load(std::memory_order_relaxed),
+      .failures = failures_.load(std::memory_order_relaxed),
+  };
+}
+
+size_t HugetlbRegionFactory::GetStats(absl::Span<char> buffer) {
+  Printer printer(buffer.data(), buffer.size());
+  const Stats s = stats();
+  constexpr double MiB = 1048576.0;
+  printer.printf(
+      "HugetlbSysAllocator: %zu bytes (%.1f MiB) in %zu KiB hugetlb pages\n",
+      s.hugetlb_bytes, s.hugetlb_bytes / MiB, s.page_size >> 10);
+  printer.printf(
+      "HugetlbSysAllocator: %zu bytes (%.1f MiB) fell back to the next "
+      "allocator\n",
+      s.fallback_bytes, s.fallback_bytes / MiB);
+  printer.printf(
+      "HugetlbSysAllocator: %zu failures with the hugetlb pool exhausted, "
+      "%zu other failures\n",
+      s.pool_exhausted, s.failures);
+
+  size_t n = printer.SpaceRequired();
+  if (n < buffer.size()) {
+    n += fallback_->GetStats(buffer.subspan(n));
+  }
+  return n;
+}
+
+size_t HugetlbRegionFactory::GetStatsInPbtxt(absl::Span<char> buffer) {
+  Printer printer(buffer.data(), buffer.size());
+  const Stats s = stats();
+  printer.printf(" hugetlb_sys_allocator_page_size: %zu\n", s.page_size);
+  printer.printf(" hugetlb_sys_allocator: %zu\n", s.hugetlb_bytes);
+  printer.printf(" hugetlb_sys_allocator_fallback: %zu\n", s.fallback_bytes);
+  printer.printf(" hugetlb_sys_allocator_pool_exhausted: %zu\n",
+                 s.pool_exhausted);
+  printer.printf(" hugetlb_sys_allocator_failures: %zu\n", s.failures);
+
+  size_t n = printer.SpaceRequired();
+  if (n < buffer.size()) {
+    n += fallback_->GetStatsInPbtxt(buffer.subspan(n));
+  }
+  return n;
+}
+
+bool InitMemfsMalloc() {
+  const std::string path = absl::GetFlag(FLAGS_memfs_malloc_path);
+  if (path.empty()) return false;
+
+  HugetlbRegionFactory* factory = HugetlbRegionFactory::New(
+      path, absl::GetFlag(FLAGS_memfs_malloc_page_size),
+      MallocExtension::GetRegionFactory());
+  if (factory == nullptr) return false;
+  MallocExtension::SetRegionFactory(factory);
+  return true;
+}
+
+}  // namespace tcmalloc
@@ -15,10 +15,112 @@
 #ifndef TCMALLOC_MEMFS_MALLOC_H_
 #define TCMALLOC_MEMFS_MALLOC_H_
 
+#include <stddef.h>
+
+#include <atomic>
 #include <string>
 
+#include "absl/base/nullability.h"
 #include "absl/flags/declare.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "tcmalloc/malloc_extension.h"
 
+// Where to get hugetlb pages from: a directory on a hugetlbfs mount, or
+// "memfd" for an anonymous memfd_create(MFD_HUGETLB) file.  Empty disables
+// memfs_malloc.
 ABSL_DECLARE_FLAG(std::string, memfs_malloc_path);
+// Hugetlb page size to request with "memfd": 2MiB or 1GiB.  hugetlbfs mounts
+// use their own page size.
+ABSL_DECLARE_FLAG(size_t, memfs_malloc_page_size);
+
+namespace tcmalloc {
+
+// An AddressRegionFactory that backs UsageHint::kNormal regions with hugetlb
+// pages from a hugetlbfs or memfd file, so the heap is guaranteed to be
+// hugepage-backed without relying on THP.  Pages are allocated from the
+// hugetlb pool as soon as TCMalloc takes memory from a region, and are never
+// released: giving them back to the pool would let a later fault on them
+// raise SIGBUS once the pool is exhausted.  Size the pool for the peak heap.
+//
+// Other regions, and normal regions whose hugetlb allocation fails (most
+// commonly because the pool is exhausted), are served by a fallback factory,
+// usually TCMalloc's default anonymous mmap factory.  Once a region falls back
+// it stays anonymous; later regions try hugetlb pages again.
+class HugetlbRegionFactory final : public AddressRegionFactory {
+ public:
+  struct Stats {
+    size_t page_size;
+    // Bytes backed by hugetlb pages.
+    size_t hugetlb_bytes;
+    // Bytes of normal regions served by the fallback factory instead.
+    size_t fallback_bytes;
+    // Hugetlb allocations that failed because the pool was exhausted.
+    size_t pool_exhausted;
+    // Hugetlb allocations that failed for any other reason.
+    size_t failures;
+  };
+
+  // Returns a factory taking hugetlb pages from a file in path, or from a
+  // memfd of page_size pages if path is "memfd".  The factory is never
+  // destroyed.  Returns nullptr, logging why, if the file cannot be created.
+  static HugetlbRegionFactory* absl_nullable New(
+      absl::string_view path, size_t page_size,
+      AddressRegionFactory* absl_nonnull fallback);
+
+  static void operator delete(void*) { __builtin_trap(); }
+
+  AddressRegion* absl_nonnull Create(void* absl_nonnull start, size_t size,
+                                     UsageHint hint) override;
+  // Returns false if any of [start, start + size) is backed by hugetlb pages.
+  bool IsReleasable(const void* absl_nonnull start, size_t size) override;
+  size_t GetStats(absl::Span<char> buffer) override;
+  size_t GetStatsInPbtxt(absl::Span<char> buffer) override;
+
+  Stats stats() const;
+
+ private:
+  class Region;
+
+  // Result of trying to back [addr, addr + size) with hugetlb pages.
+  enum class MapResult {
+    kSuccess,
+    kPoolExhausted,
+    kFailure,
+  };
+
+  HugetlbRegionFactory(int fd, size_t page_size,
+                       AddressRegionFactory* absl_nonnull fallback)
+      : fd_(fd), page_size_(page_size), fallback_(fallback) {}
+  ~HugetlbRegionFactory() override = default;
+
+  MapResult Map(void* absl_nonnull addr, size_t size);
+
+  const int fd_;
+  const size_t page_size_;
+  AddressRegionFactory* absl_nonnull const fallback_;
+
+  // All normal regions created so far, most recent first.
+  std::atomic<Region*> regions_{nullptr};
+
+  // Offset in fd_ of the next page to allocate.
+  std::atomic<size_t> next_offset_{0};
+
+  std::atomic<size_t> hugetlb_bytes_{0};
+  std::atomic<size_t> fallback_bytes_{0};
+  std::atomic<size_t> pool_exhausted_{0};
+  std::atomic<size_t> failures_{0};
+};
+
+// Installs a HugetlbRegionFactory configured by --memfs_malloc_path and
+// --memfs_malloc_page_size, falling back to the current region factory.
+// Returns false if memfs_malloc is disabled or the factory could not be
+// created.
+//
+// Call this after flags are parsed and as early as possible: memory TCMalloc
+// has already obtained from the system keeps its current backing.
+bool InitMemfsMalloc();
+
+}  // namespace tcmalloc
 
 #endif  // TCMALLOC_MEMFS_MALLOC_H_
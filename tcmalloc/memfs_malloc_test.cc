@@ -0,0 +1,208 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/memfs_malloc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "tcmalloc/internal/memory_tag.h"
+#include "tcmalloc/internal/numa.h"
+#include "tcmalloc/internal/system_allocator.h"
+#include "tcmalloc/malloc_extension.h"
+
+namespace tcmalloc {
+namespace {
+
+using UsageHint = AddressRegionFactory::UsageHint;
+
+constexpr size_t kHugePage = size_t{2} << 20;
+
+// Hands out anonymous memory, as TCMalloc's default factory does.
+class AnonRegion final : public AddressRegion {
+ public:
+  AnonRegion(uintptr_t start, size_t size) : start_(start), free_size_(size) {}
+
+  std::pair<void*, size_t> Alloc(size_t size, size_t alignment) override {
+    uintptr_t result = (start_ + free_size_ - size) & ~(alignment - 1);
+    if (result < start_ || result >= start_ + free_size_) return {nullptr, 0};
+    size_t actual_size = start_ + free_size_ - result;
+    free_size_ -= actual_size;
+    void* ptr = reinterpret_cast<void*>(result);
+    if (mprotect(ptr, actual_size, PROT_READ | PROT_WRITE) != 0) {
+      return {nullptr, 0};
+    }
+    return {ptr, actual_size};
+  }
+
+ private:
+  uintptr_t start_;
+  size_t free_size_;
+};
+
+class AnonRegionFactory final : public AddressRegionFactory {
+ public:
+  AddressRegion* Create(void* start, size_t size, UsageHint hint) override {
+    ++regions_;
+    last_hint_ = hint;
+    void* space = MallocInternal(sizeof(AnonRegion));
+    return new (space) AnonRegion(reinterpret_cast<uintptr_t>(start), size);
+  }
+
+  size_t GetStats(absl::Span<char> buffer) override {
+    constexpr absl::string_view kStats = "AnonRegionFactory\n";
+    memcpy(buffer.data(), kStats.data(),
+           std::min(buffer.size(), kStats.size()));
+    return kStats.size();
+  }
+
+  int regions_ = 0;
+  UsageHint last_hint_ = UsageHint::kNormal;
+};
+
+class MemfsMallocTest : public testing::Test {
+ protected:
+  MemfsMallocTest() {
+    reservation_ = mmap(nullptr, kReservation + kHugePage, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    EXPECT_NE(reservation_, MAP_FAILED);
+    start_ = reinterpret_cast<void*>(
+        (reinterpret_cast<uintptr_t>(reservation_) + kHugePage - 1) &
+        ~(kHugePage - 1));
+  }
+
+  ~MemfsMallocTest() override {
+    munmap(reservation_, kReservation + kHugePage);
+  }
+
+  HugetlbRegionFactory* NewFactory() {
+    HugetlbRegionFactory* factory =
+        HugetlbRegionFactory::New("memfd", kHugePage, &fallback_);
+    return factory;
+  }
+
+  static constexpr size_t kReservation = 64 << 20;
+
+  AnonRegionFactory fallback_;
+  void* reservation_;
+  void* start_;
+};
+
+TEST_F(MemfsMallocTest, OtherHintsUseFallback) {
+  HugetlbRegionFactory* factory = NewFactory();
+  if (factory == nullptr) {
+    GTEST_SKIP() << "hugetlb memfds not supported";
+  }
+
+  factory->Create(start_, kReservation, UsageHint::kMetadata);
+  EXPECT_EQ(fallback_.regions_, 1);
+  EXPECT_EQ(fallback_.last_hint_, UsageHint::kMetadata);
+
+  // Normal regions only need the fallback if hugetlb allocation fails.
+  factory->Create(start_, kReservation, UsageHint::kNormal);
+  EXPECT_EQ(fallback_.regions_, 1);
+}
+
+TEST_F(MemfsMallocTest, AllocatesHugetlbOrFallsBack) {
+  HugetlbRegionFactory* factory = NewFactory();
+  if (factory == nullptr) {
+    GTEST_SKIP() << "hugetlb memfds not supported";
+  }
+
+  AddressRegion* region =
+      factory->Create(start_, kReservation, UsageHint::kNormal);
+  size_t total = 0;
+  for (int i = 0; i < 4; ++i) {
+    auto [ptr, size] = region->Alloc(kHugePage + 1, kHugePage);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_GE(size, kHugePage + 1);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % kHugePage, 0);
+    memset(ptr, 0xab, size);
+    total += size;
+  }
+
+  const HugetlbRegionFactory::Stats stats = factory->stats();
+  EXPECT_EQ(stats.page_size, kHugePage);
+  EXPECT_EQ(stats.hugetlb_bytes + stats.fallback_bytes, total);
+  if (stats.fallback_bytes == 0) {
+    EXPECT_EQ(stats.pool_exhausted + stats.failures, 0);
+    EXPECT_EQ(fallback_.regions_, 0);
+  } else {
+    // Once a region falls back, it stays that way.
+    EXPECT_EQ(stats.pool_exhausted + stats.failures, 1);
+    EXPECT_EQ(fallback_.regions_, 1);
+  }
+
+  std::string buffer(4096, '\0');
+  size_t n = factory->GetStats(absl::MakeSpan(buffer));
+  ASSERT_LT(n, buffer.size());
+  buffer.resize(n);
+  EXPECT_THAT(buffer, testing::HasSubstr("HugetlbSysAllocator"));
+  EXPECT_THAT(buffer, testing::HasSubstr("AnonRegionFactory"));
+}
+
+TEST_F(MemfsMallocTest, HugetlbPagesAreNotReleased) {
+  HugetlbRegionFactory* factory = NewFactory();
+  if (factory == nullptr) {
+    GTEST_SKIP() << "hugetlb memfds not supported";
+  }
+
+  tcmalloc_internal::NumaTopology<1> topology;
+  tcmalloc_internal::SystemAllocator<tcmalloc_internal::NumaTopology<1>, 1>
+      allocator(topology, kReservation);
+  allocator.SetRegionFactory(factory);
+  tcmalloc_internal::AddressRange range = allocator.Allocate(
+      2 * kHugePage, kHugePage, tcmalloc_internal::MemoryTag::kNormal);
+  ASSERT_NE(range.ptr, nullptr);
+  if (factory->stats().hugetlb_bytes == 0) {
+    GTEST_SKIP() << "hugetlb pool exhausted";
+  }
+  EXPECT_FALSE(factory->IsReleasable(range.ptr, range.bytes));
+  EXPECT_FALSE(factory->IsReleasable(range.ptr, kHugePage));
+
+  // Releasing the range must leave its pages in place, so that touching them
+  // again can never fault for lack of hugetlb pages.
+  memset(range.ptr, 0xab, range.bytes);
+  EXPECT_FALSE(allocator.Release(range.ptr, range.bytes).success);
+  EXPECT_EQ(allocator.release_errors(), 0);
+  const auto* bytes = static_cast<const unsigned char*>(range.ptr);
+  EXPECT_EQ(bytes[0], 0xab);
+  EXPECT_EQ(bytes[range.bytes - 1], 0xab);
+  memset(range.ptr, 0xcd, range.bytes);
+
+  // Memory outside the hugetlb pages is still released as usual.
+  EXPECT_TRUE(factory->IsReleasable(start_, kHugePage));
+}
+
+TEST_F(MemfsMallocTest, RejectsOtherFilesystems) {
+  EXPECT_EQ(HugetlbRegionFactory::New(testing::TempDir(), kHugePage,
+                                      &fallback_),
+            nullptr);
+  EXPECT_EQ(HugetlbRegionFactory::New("memfd", kHugePage + 1, &fallback_),
+            nullptr);
+}
+
+}  // namespace
+}  // namespace tcmalloc
@@ -0,0 +1,104 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/memory_limit_notifier.h"
+
+#include <stddef.h>
+
+#include <limits>
+
+#include "absl/base/internal/spinlock.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/malloc_extension.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+bool MemoryLimitNotifier::Add(LimitKind limit_kind, double fraction,
+                              Callback callback) {
+  if (callback == nullptr || !(fraction > 0 && fraction <= 1)) {
+    return false;
+  }
+
+  absl::base_internal::SpinLockHolder h(lock_);
+  Entry* empty = nullptr;
+  for (Entry& e : entries_) {
+    if (e.callback == nullptr) {
+      if (empty == nullptr) empty = &e;
+    } else if (e.callback == callback && e.limit_kind == limit_kind &&
+               e.fraction == fraction) {
+      return false;
+    }
+  }
+  if (empty == nullptr) {
+    return false;
+  }
+  *empty = Entry{callback, limit_kind, fraction, /*fired=*/false};
+  return true;
+}
+
+bool MemoryLimitNotifier::Remove(Callback callback) {
+  absl::base_internal::SpinLockHolder h(lock_);
+  bool removed = false;
+  for (Entry& e : entries_) {
+    if (e.callback == callback) {
+      e = Entry{};
+      removed = true;
+    }
+  }
+  return removed;
+}
+
+void MemoryLimitNotifier::Notify(size_t usage, size_t soft_limit,
+                                 size_t hard_limit) {
+  struct Pending {
+    Callback callback;
+    MallocExtension::MemoryLimitNotification notification;
+  };
+  Pending pending[kMaxCallbacks];
+  int num_pending = 0;
+
+  {
+    absl::base_internal::SpinLockHolder h(lock_);
+    for (Entry& e : entries_) {
+      if (e.callback == nullptr) continue;
+
+      const size_t limit =
+          e.limit_kind == LimitKind::kHard ? hard_limit : soft_limit;
+      if (limit == std::numeric_limits<size_t>::max() ||
+          static_cast<double>(usage) < e.fraction * limit) {
+        e.fired = false;
+        continue;
+      }
+      if (e.fired) continue;
+
+      e.fired = true;
+      pending[num_pending++] = {
+          e.callback,
+          {.limit_kind = e.limit_kind,
+           .fraction = e.fraction,
+           .limit = limit,
+           .usage = usage}};
+    }
+  }
+
+  for (int i = 0; i < num_pending; ++i) {
+    pending[i].callback(pending[i].notification);
+  }
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
@@ -0,0 +1,79 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_MEMORY_LIMIT_NOTIFIER_H_
+#define TCMALLOC_MEMORY_LIMIT_NOTIFIER_H_
+
+#include <stddef.h>
+
+#include "absl/base/internal/spinlock.h"
+#include "absl/base/thread_annotations.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/malloc_extension.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+// Tracks the callbacks registered with MallocExtension::AddMemoryLimitCallback.
+//
+// A callback fires once when usage rises to its fraction of the limit, and is
+// re-armed once usage falls back below that threshold.  Unset limits
+// (std::numeric_limits<size_t>::max()) never fire.
+class MemoryLimitNotifier {
+ public:
+  using LimitKind = MallocExtension::LimitKind;
+  using Callback = MallocExtension::MemoryLimitCallback;
+
+  static constexpr int kMaxCallbacks = 16;
+
+  MemoryLimitNotifier() = default;
+  MemoryLimitNotifier(const MemoryLimitNotifier&) = delete;
+  MemoryLimitNotifier& operator=(const MemoryLimitNotifier&) = delete;
+
+  // Registers callback at fraction (in (0, 1]) of the limit_kind limit.
+  // Returns false if the arguments are invalid, this exact registration
+  // already exists, or all kMaxCallbacks slots are in use.
+  [[nodiscard]] bool Add(LimitKind limit_kind, double fraction,
+                         Callback callback) ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Removes every registration of callback.  Returns false if there was none.
+  [[nodiscard]] bool Remove(Callback callback) ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Compares usage against the limits, and invokes the callbacks whose
+  // thresholds were crossed since the previous call.  Callbacks run on the
+  // calling thread without any internal locks held, so they may allocate.
+  void Notify(size_t usage, size_t soft_limit, size_t hard_limit)
+      ABSL_LOCKS_EXCLUDED(lock_);
+
+ private:
+  struct Entry {
+    Callback callback = nullptr;
+    LimitKind limit_kind = LimitKind::kSoft;
+    double fraction = 0;
+    // Whether usage has been at or above the threshold since the callback last
+    // fired.
+    bool fired = false;
+  };
+
+  absl::base_internal::SpinLock lock_{
+      absl::base_internal::SCHEDULE_KERNEL_ONLY};
+  Entry entries_[kMaxCallbacks] ABSL_GUARDED_BY(lock_);
+};
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_MEMORY_LIMIT_NOTIFIER_H_
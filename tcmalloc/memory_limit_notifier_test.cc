@@ -0,0 +1,153 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/memory_limit_notifier.h"
+
+#include <stddef.h>
+
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/malloc_extension.h"
+
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+using LimitKind = MallocExtension::LimitKind;
+using Notification = MallocExtension::MemoryLimitNotification;
+
+constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
+
+std::vector<Notification>& FirstNotifications() {
+  static auto* v = new std::vector<Notification>();
+  return *v;
+}
+
+std::vector<Notification>& SecondNotifications() {
+  static auto* v = new std::vector<Notification>();
+  return *v;
+}
+
+void First(const Notification& n) { FirstNotifications().push_back(n); }
+void Second(const Notification& n) { SecondNotifications().push_back(n); }
+
+class MemoryLimitNotifierTest : public testing::Test {
+ protected:
+  MemoryLimitNotifierTest() {
+    FirstNotifications().clear();
+    SecondNotifications().clear();
+  }
+
+  MemoryLimitNotifier notifier_;
+};
+
+TEST_F(MemoryLimitNotifierTest, RejectsInvalidRegistrations) {
+  EXPECT_FALSE(notifier_.Add(LimitKind::kSoft, 0.5, nullptr));
+  EXPECT_FALSE(notifier_.Add(LimitKind::kSoft, 0, First));
+  EXPECT_FALSE(notifier_.Add(LimitKind::kSoft, -0.5, First));
+  EXPECT_FALSE(notifier_.Add(LimitKind::kSoft, 1.5, First));
+
+  EXPECT_TRUE(notifier_.Add(LimitKind::kSoft, 1, First));
+  EXPECT_FALSE(notifier_.Add(LimitKind::kSoft, 1, First));
+  // The same callback may watch several thresholds.
+  EXPECT_TRUE(notifier_.Add(LimitKind::kSoft, 0.5, First));
+  EXPECT_TRUE(notifier_.Add(LimitKind::kHard, 1, First));
+}
+
+TEST_F(MemoryLimitNotifierTest, FiresOncePerCrossing) {
+  ASSERT_TRUE(notifier_.Add(LimitKind::kSoft, 0.75, First));
+
+  notifier_.Notify(/*usage=*/700, /*soft_limit=*/1000, kUnlimited);
+  EXPECT_TRUE(FirstNotifications().empty());
+
+  notifier_.Notify(750, 1000, kUnlimited);
+  ASSERT_EQ(FirstNotifications().size(), 1);
+  EXPECT_EQ(FirstNotifications()[0].limit_kind, LimitKind::kSoft);
+  EXPECT_EQ(FirstNotifications()[0].fraction, 0.75);
+  EXPECT_EQ(FirstNotifications()[0].limit, 1000);
+  EXPECT_EQ(FirstNotifications()[0].usage, 750);
+
+  // Staying above the threshold does not fire again.
+  notifier_.Notify(900, 1000, kUnlimited);
+  notifier_.Notify(1200, 1000, kUnlimited);
+  EXPECT_EQ(FirstNotifications().size(), 1);
+
+  // Dropping below the threshold re-arms the callback.
+  notifier_.Notify(500, 1000, kUnlimited);
+  EXPECT_EQ(FirstNotifications().size(), 1);
+  notifier_.Notify(800, 1000, kUnlimited);
+  ASSERT_EQ(FirstNotifications().size(), 2);
+  EXPECT_EQ(FirstNotifications()[1].usage, 800);
+}
+
+TEST_F(MemoryLimitNotifierTest, GradedThresholds) {
+  ASSERT_TRUE(notifier_.Add(LimitKind::kHard, 0.5, First));
+  ASSERT_TRUE(notifier_.Add(LimitKind::kHard, 0.9, Second));
+
+  notifier_.Notify(600, kUnlimited, 1000);
+  EXPECT_EQ(FirstNotifications().size(), 1);
+  EXPECT_TRUE(SecondNotifications().empty());
+
+  notifier_.Notify(950, kUnlimited, 1000);
+  EXPECT_EQ(FirstNotifications().size(), 1);
+  ASSERT_EQ(SecondNotifications().size(), 1);
+  EXPECT_EQ(SecondNotifications()[0].limit_kind, LimitKind::kHard);
+  EXPECT_EQ(SecondNotifications()[0].limit, 1000);
+}
+
+TEST_F(MemoryLimitNotifierTest, UnsetLimitNeverFires) {
+  ASSERT_TRUE(notifier_.Add(LimitKind::kSoft, 1, First));
+  ASSERT_TRUE(notifier_.Add(LimitKind::kHard, 1, Second));
+
+  notifier_.Notify(kUnlimited, kUnlimited, kUnlimited);
+  EXPECT_TRUE(FirstNotifications().empty());
+  EXPECT_TRUE(SecondNotifications().empty());
+
+  // Each kind only looks at its own limit.
+  notifier_.Notify(2000, 1000, kUnlimited);
+  EXPECT_EQ(FirstNotifications().size(), 1);
+  EXPECT_TRUE(SecondNotifications().empty());
+}
+
+TEST_F(MemoryLimitNotifierTest, Remove) {
+  EXPECT_FALSE(notifier_.Remove(First));
+
+  ASSERT_TRUE(notifier_.Add(LimitKind::kSoft, 0.5, First));
+  ASSERT_TRUE(notifier_.Add(LimitKind::kSoft, 0.9, First));
+  ASSERT_TRUE(notifier_.Add(LimitKind::kSoft, 0.5, Second));
+  EXPECT_TRUE(notifier_.Remove(First));
+  EXPECT_FALSE(notifier_.Remove(First));
+
+  notifier_.Notify(1000, 1000, kUnlimited);
+  EXPECT_TRUE(FirstNotifications().empty());
+  EXPECT_EQ(SecondNotifications().size(), 1);
+}
+
+TEST_F(MemoryLimitNotifierTest, Capacity) {
+  for (int i = 0; i < MemoryLimitNotifier::kMaxCallbacks; ++i) {
+    ASSERT_TRUE(notifier_.Add(LimitKind::kSoft, 1.0 / (i + 1), First)) << i;
+  }
+  EXPECT_FALSE(notifier_.Add(LimitKind::kSoft, 0.01, Second));
+
+  // Removing a registration frees its slot.
+  ASSERT_TRUE(notifier_.Remove(First));
+  EXPECT_TRUE(notifier_.Add(LimitKind::kSoft, 0.01, Second));
+}
+
+}  // namespace
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
@@ -19,6 +19,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <optional>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -61,6 +62,9 @@ class FakeStaticForwarder {
   SubreleaseUnbackedMode subrelease_unbacked_hugepages() const {
     return subrelease_unbacked_hugepages_;
   }
+  SeparateSpanLifetimes filler_separate_span_lifetimes() const {
+    return filler_separate_span_lifetimes_;
+  }
 
   void set_filler_skip_subrelease_short_interval(absl::Duration value) {
     short_interval_ = value;
@@ -86,6 +90,9 @@ class FakeStaticForwarder {
   void set_huge_region_adaptive_release(bool value) {
     huge_region_adaptive_release_ = value;
   }
+  HugeRegionPreferBacked huge_region_prefer_backed() const {
+    return huge_region_prefer_backed_;
+  }
   bool release_max_cold_pages() const { return release_max_cold_pages_; }
   void set_release_max_cold_pages(bool value) {
     release_max_cold_pages_ = value;
@@ -103,6 +110,13 @@ class FakeStaticForwarder {
     madvise_cold_regions_nohugepage_ = value;
   }
 
+  MigrateRemoteHugepages numa_migrate_remote_hugepages() const {
+    return MigrateRemoteHugepages::kDisabled;
+  }
+
+  // NUMA state.
+  bool numa_aware() const { return false; }
+
   bool BackAllocations() const { return back_allocations_; }
   void SetBackAllocations(bool value) { back_allocations_ = value; }
   int32_t BackSizeThresholdBytes() const { return back_size_threshold_bytes_; }
@@ -146,6 +160,7 @@ class FakeStaticForwarder {
   }
   void ClearSpan(PageId page) {}
   void SetSpan(PageId page, Span* span) {}
+  void SetCompactLargeSpan(Range r, bool donated) {}
   void SetHugepage(HugePage p, void* pt) { trackers_[p] = pt; }
 
   // SpanAllocator state.
@@ -215,6 +230,12 @@ class FakeStaticForwarder {
   }
   void SetAnonVmaName(
       Range, std::optional<absl::string_view> name) { /* unimplemented */ }
+  std::optional<bool> IsOnPartitionNodes(Range r, size_t partition) {
+    return std::nullopt;
+  }
+  [[nodiscard]] MemoryModifyStatus MoveToPartition(Range r, size_t partition) {
+    return {.success = false, .error_number = 0};
+  }
 
  private:
   static absl::base_internal::LowLevelAlloc::Arena* ll_arena() {
@@ -232,10 +253,14 @@ class FakeStaticForwarder {
   bool hpaa_subrelease_ = true;
   SubreleaseUnbackedMode subrelease_unbacked_hugepages_ =
       SubreleaseUnbackedMode::kEnabled;
+  SeparateSpanLifetimes filler_separate_span_lifetimes_ =
+      SeparateSpanLifetimes::kDisabled;
   bool release_succeeds_ = true;
   bool collapse_succeeds_ = true;
   int error_number_ = 0;
   bool huge_region_adaptive_release_ = false;
+  HugeRegionPreferBacked huge_region_prefer_backed_ =
+      HugeRegionPreferBacked::kDisabled;
   bool release_max_cold_pages_ = false;
 
   bool back_allocations_ = false;
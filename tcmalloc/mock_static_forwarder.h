@@ -106,7 +106,8 @@ class FakeStaticForwarder {
   }
 
   [[nodiscard]] Span* AllocateSpan(int, size_t objects_per_span,
-                                   Length pages_per_span) {
+                                   Length pages_per_span,
+                                   SpanLifetimePrediction lifetime) {
     void* backing = ::operator new(pages_per_span.raw_num() * page_size_,
                                    std::align_val_t(page_size_));
     PageId page = PageIdContaining(backing);
@@ -118,7 +119,8 @@ class FakeStaticForwarder {
     info.span = span;
     SpanAllocInfo span_alloc_info = {
         .objects_per_span = objects_per_span,
-        .density = AccessDensityPrediction::kSparse};
+        .density = AccessDensityPrediction::kSparse,
+        .lifetime = lifetime};
     info.span_alloc_info = span_alloc_info;
     map_.emplace(page, info);
     return span;
@@ -190,9 +192,10 @@ class RawMockStaticForwarder : public FakeStaticForwarder {
         });
     ON_CALL(*this, AllocateSpan)
         .WillByDefault([this](int size_class, size_t objects_per_span,
-                              Length pages_per_span) {
+                              Length pages_per_span,
+                              SpanLifetimePrediction lifetime) {
           return FakeStaticForwarder::AllocateSpan(size_class, objects_per_span,
-                                                   pages_per_span);
+                                                   pages_per_span, lifetime);
         });
     ON_CALL(*this, DeallocateSpans)
         .WillByDefault([this](size_t objects_per_span,
@@ -210,7 +213,8 @@ class RawMockStaticForwarder : public FakeStaticForwarder {
   MOCK_METHOD(void, MapObjectsToSpans,
               (absl::Span<void*> batch, Span** spans, int expected_size_class));
   MOCK_METHOD(Span*, AllocateSpan,
-              (int size_class, size_t objects_per_span, Length pages_per_span));
+              (int size_class, size_t objects_per_span, Length pages_per_span,
+               SpanLifetimePrediction lifetime));
   MOCK_METHOD(void, DeallocateSpans,
               (size_t object_per_span, absl::Span<Span*> free_spans));
 };
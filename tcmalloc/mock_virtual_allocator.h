@@ -15,7 +15,10 @@
 #ifndef TCMALLOC_MOCK_VIRTUAL_ALLOCATOR_H_
 #define TCMALLOC_MOCK_VIRTUAL_ALLOCATOR_H_
 
+#include <algorithm>
 #include <cstddef>
+#include <optional>
+#include <utility>
 #include <vector>
 
 #include "absl/base/attributes.h"
@@ -37,6 +40,9 @@ class FakeVirtualAllocator final : public VirtualAllocator {
   std::vector<size_t> backing_;
 
   bool should_overallocate_ = false;
+  // If set, the hugepage index at which to place the next request, which
+  // should lie in a hole in backing_.
+  std::optional<size_t> next_index_;
   HugeLength huge_pages_requested_;
   HugeLength huge_pages_received_;
 };
@@ -55,11 +61,14 @@ inline AddressRange FakeVirtualAllocator::operator()(size_t bytes,
   bytes = req / NHugePages(1);
   align /= kHugePageSize;
   size_t index = backing_.size();
+  if (next_index_.has_value()) {
+    index = *std::exchange(next_index_, std::nullopt);
+  }
   if (index % align != 0) {
-    index += (align - (index & align));
+    index += align - index % align;
   }
   if (index + bytes > kMaxBacking) return {nullptr, 0};
-  backing_.resize(index + bytes);
+  backing_.resize(std::max(backing_.size(), index + bytes));
   void* ptr = reinterpret_cast<void*>(index * kHugePageSize);
   return {ptr, req.in_bytes()};
 }
@@ -14,10 +14,12 @@
 
 #include "tcmalloc/page_allocator.h"
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <limits>
+#include <optional>
 
 #include "absl/base/attributes.h"
 #include "absl/base/macros.h"
@@ -49,11 +51,12 @@ PageAllocator::PageAllocator() {
 
   normal_impl_[0] = new (&choices_[part++].hpaa)
       HugePageAwareAllocator(HugePageAwareAllocatorOptions{MemoryTag::kNormal});
-  if (tc_globals.active_partitions() > 1) {
-    normal_impl_[1] =
+  for (size_t partition = 1; partition < tc_globals.active_partitions();
+       ++partition) {
+    normal_impl_[partition] =
         new (tc_globals.arena().Alloc(sizeof(HugePageAwareAllocator)))
             HugePageAwareAllocator(
-                HugePageAwareAllocatorOptions{MemoryTag::kNormalP1});
+                HugePageAwareAllocatorOptions{MultiNormalTag(partition)});
   }
   sampled_impl_[0] = new (&choices_[part++].hpaa) HugePageAwareAllocator(
       HugePageAwareAllocatorOptions{MemoryTag::kSampled});
@@ -75,10 +78,22 @@ PageAllocator::PageAllocator() {
   TC_CHECK_LE(part, std::size(choices_));
 }
 
-void PageAllocator::ShrinkToUsageLimit(Length n) {
+size_t PageAllocator::page_heap_backed_bytes() const {
   BackingStats s = stats();
-  const size_t backed =
-      s.system_bytes - s.unmapped_bytes + tc_globals.metadata_bytes();
+  return s.system_bytes - s.unmapped_bytes;
+}
+
+size_t PageAllocator::backed_bytes() const {
+  return page_heap_backed_bytes() + tc_globals.metadata_bytes();
+}
+
+size_t PageAllocator::LockedPageHeapBackedBytes() const {
+  PageHeapSpinLockHolder l;
+  return page_heap_backed_bytes();
+}
+
+void PageAllocator::ShrinkToUsageLimit(Length n) {
+  const size_t backed = backed_bytes();
   // New high water marks should be rare.
   if (ABSL_PREDICT_FALSE(backed > peak_backed_bytes_)) {
     peak_backed_bytes_ = backed;
@@ -97,6 +112,12 @@ void PageAllocator::ShrinkToUsageLimit(Length n) {
   // occur if we allocate space for many objects preemptively and only later
   // sample them (incrementing sampled_objects_size_).
 
+  if (ABSL_PREDICT_FALSE(
+          hard_limit_exceeded_.load(std::memory_order_relaxed)) &&
+      backed <= limits_[kHard]) {
+    hard_limit_exceeded_.store(false, std::memory_order_relaxed);
+  }
+
   if (limits_[kSoft] == std::numeric_limits<size_t>::max()) {
     // Limits are not set.
     return;
@@ -119,9 +140,7 @@ void PageAllocator::ShrinkToUsageLimit(Length n) {
   // We're still not below limit.
   if (limits_[kHard] < std::numeric_limits<size_t>::max()) {
     // Recompute how many pages we still need to release.
-    BackingStats s = stats();
-    const size_t backed =
-        s.system_bytes - s.unmapped_bytes + tc_globals.metadata_bytes();
+    const size_t backed = backed_bytes();
     if (backed <= limits_[kHard]) {
       // We're already fine in terms of hard limit.
       return;
@@ -134,6 +153,11 @@ void PageAllocator::ShrinkToUsageLimit(Length n) {
                    limit_hits_[kHard]);
       return;
     }
+    if (hard_limit_action_ == kFailAllocation) {
+      // Let New() fail the allocation that got us here, rather than crashing.
+      hard_limit_exceeded_.store(true, std::memory_order_relaxed);
+      return;
+    }
     const size_t hard_limit = limits_[kHard];
     limits_[kHard] = std::numeric_limits<size_t>::max();
     TC_BUG(
@@ -209,16 +233,80 @@ bool PageAllocator::ShrinkHardBy(Length pages, LimitKind limit_kind) {
   return (pages <= ret);
 }
 
+bool PageAllocator::ShouldFailOverHardLimit(
+    std::optional<size_t> backed_before) {
+  if (backed_bytes() <= limits_[kHard]) {
+    hard_limit_exceeded_.store(false, std::memory_order_relaxed);
+    return false;
+  }
+  // Concurrent allocations may also have grown backed memory in the meantime,
+  // in which case we fail conservatively.
+  if (backed_before.has_value() &&
+      page_heap_backed_bytes() <= *backed_before) {
+    return false;
+  }
+  ++hard_limit_failed_allocations_;
+  return true;
+}
+
+Span* PageAllocator::FailIfOverHardLimit(Span* span, MemoryTag tag,
+                                         SpanAllocInfo span_alloc_info,
+                                         std::optional<size_t> backed_before) {
+  {
+    PageHeapSpinLockHolder l;
+    if (!ShouldFailOverHardLimit(backed_before)) {
+      return span;
+    }
+#ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
+    impl(tag)->Delete(span, span_alloc_info);
+    return nullptr;
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+  }
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  PageAllocatorInterface::AllocationState a{
+      Range(span->first_page(), span->num_pages()),
+      span->donated(),
+  };
+  Span::Delete(span);
+  PageHeapSpinLockHolder l;
+  impl(tag)->Delete(a, span_alloc_info);
+  return nullptr;
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+}
+
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+PageAllocatorInterface::AllocationState PageAllocator::FailIfOverHardLimit(
+    PageAllocatorInterface::AllocationState s, MemoryTag tag,
+    SpanAllocInfo span_alloc_info, std::optional<size_t> backed_before) {
+  PageHeapSpinLockHolder l;
+  if (!ShouldFailOverHardLimit(backed_before)) {
+    return s;
+  }
+  impl(tag)->Delete(s, span_alloc_info);
+  return {};
+}
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+
+void PageAllocator::NotifyLimitCallbacks() {
+  size_t usage, soft_limit, hard_limit;
+  {
+    PageHeapSpinLockHolder l;
+    usage = backed_bytes();
+    soft_limit = limits_[kSoft];
+    hard_limit = limits_[kHard];
+  }
+  limit_notifier_.Notify(usage, soft_limit, hard_limit);
+}
+
 size_t PageAllocator::active_partitions() const {
   return tc_globals.active_partitions();
 }
 
 ABSL_ATTRIBUTE_NOINLINE void PageAllocator::InvokeNewHookSlow(
-    Span* span, Length n, Length align, SpanAllocInfo span_alloc_info,
+    PageId start_page, Length n, Length align, SpanAllocInfo span_alloc_info,
     MemoryTag tag) {
-  size_t start_page_index = span ? span->first_page().index() : 0;
   page_allocator_new_hooks.Invoke(
-      start_page_index, n.raw_num(), align.raw_num(),
+      start_page.index(), n.raw_num(), align.raw_num(),
       span_alloc_info.objects_per_span,
       static_cast<uint8_t>(span_alloc_info.density), tag);
 }
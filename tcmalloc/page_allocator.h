@@ -18,8 +18,10 @@
 #include <stddef.h>
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <limits>
+#include <optional>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -36,6 +38,7 @@
 #include "tcmalloc/internal/optimization.h"
 #include "tcmalloc/internal/page_allocator_hooks.h"
 #include "tcmalloc/internal/pageflags.h"
+#include "tcmalloc/memory_limit_notifier.h"
 #include "tcmalloc/page_allocator_interface.h"
 #include "tcmalloc/pages.h"
 #include "tcmalloc/parameters.h"
@@ -65,6 +68,15 @@ class PageAllocator {
                                  SpanAllocInfo span_alloc_info, MemoryTag tag)
       ABSL_LOCKS_EXCLUDED(pageheap_lock);
 
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  // As NewAligned, but the allocation has no Span: the pagemap records it as a
+  // CompactLargeSpan instead.  Used for large allocations that are not sampled.
+  // Returns an empty AllocationState if out of memory.
+  PageAllocatorInterface::AllocationState NewLarge(
+      Length n, Length align, SpanAllocInfo span_alloc_info, MemoryTag tag)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+
   // Delete the span "[p, p+n-1]".
   // REQUIRES: span was returned by earlier call to New() with the same value of
   //           "tag" and has not yet been deleted.
@@ -78,6 +90,28 @@ class PageAllocator {
               SpanAllocInfo span_alloc_info)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
+  // As Delete, but the first <unbacked> pages of s were remapped away by
+  // SystemAllocator::MovePages.  See PageAllocatorInterface::DeleteMoved.
+  void DeleteMoved(PageAllocatorInterface::AllocationState s, MemoryTag tag,
+                   Length unbacked, SpanAllocInfo span_alloc_info)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
+  // Try to extend the allocation "s" in place to "n" pages.  On success,
+  // updates "s" and returns true; the caller must update the allocation's
+  // Span to match.
+  // REQUIRES: s describes a span returned by earlier call to New() with the
+  //           same value of "tag" and not yet deleted; n > s.r.n.
+  bool TryGrow(PageAllocatorInterface::AllocationState& s, Length n,
+               SpanAllocInfo span_alloc_info, MemoryTag tag)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
+  // Returns true if whole hugepages of the large allocation at page p,
+  // allocated with the given tag, may be remapped with
+  // SystemAllocator::MovePages.  See PageAllocatorInterface::ReserveMove.
+  bool ReserveMove(PageId p, MemoryTag tag) ABSL_LOCKS_EXCLUDED(pageheap_lock);
+  void UnreserveMove(PageId p, MemoryTag tag)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
   BackingStats stats() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
   void GetSmallSpanStats(SmallSpanStats* result)
@@ -100,9 +134,21 @@ class PageAllocator {
   PageReleaseStats GetReleaseStats() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
+  // Returns where the NUMA placement pass found hugepages of the NUMA
+  // partitions, combined across partitions.
+  NumaPlacementStats GetNumaPlacementStats() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
+  // Returns the number of pages that recent demand history predicts will be in
+  // use, combined across all child PageAllocatorInterface implementations.
+  Length GetRecentDemand() ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
   [[nodiscard]] bool GetPageAllocationStatus(HugePage hp, PageBitmap& pages,
                                              MemoryTag tag)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
+    if (IsNormalTag(tag)) {
+      return impl(tag)->GetPageAllocationStatus(hp, pages);
+    }
     switch (tag) {
       case MemoryTag::kNormal:
       case MemoryTag::kNormalP1:
@@ -138,6 +184,32 @@ class PageAllocator {
   int64_t successful_shrinks_after_limit_hit(LimitKind limit_kind) const
       ABSL_LOCKS_EXCLUDED(pageheap_lock);
 
+  // What to do when usage cannot be brought below limits_[kHard].
+  enum HardLimitAction { kAbort, kFailAllocation };
+  void set_hard_limit_action(HardLimitAction action)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) {
+    PageHeapSpinLockHolder l;
+    hard_limit_action_ = action;
+  }
+  HardLimitAction hard_limit_action() const
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) {
+    PageHeapSpinLockHolder l;
+    return hard_limit_action_;
+  }
+
+  // Number of allocations failed under HardLimitAction::kFailAllocation.
+  int64_t hard_limit_failed_allocations() const
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) {
+    PageHeapSpinLockHolder l;
+    return hard_limit_failed_allocations_;
+  }
+
+  MemoryLimitNotifier& limit_notifier() { return limit_notifier_; }
+
+  // Invokes the memory limit callbacks whose thresholds were crossed since the
+  // last call.  Called periodically from ProcessBackgroundActions.
+  void NotifyLimitCallbacks() ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
   // If we have a usage limit set, ensure we're not violating it from our latest
   // allocation.
   void ShrinkToUsageLimit(Length n)
@@ -154,7 +226,8 @@ class PageAllocator {
     if (ABSL_PREDICT_TRUE(page_allocator_new_hooks.empty())) {
       return;
     }
-    InvokeNewHookSlow(span, n, align, span_alloc_info, tag);
+    InvokeNewHookSlow(span ? span->first_page() : PageId{0}, n, align,
+                      span_alloc_info, tag);
   }
 
   static void InvokeDeleteHook(PageId start_page, Length n,
@@ -188,7 +261,7 @@ class PageAllocator {
   }
 
  private:
-  static void InvokeNewHookSlow(Span* span, Length n, Length align,
+  static void InvokeNewHookSlow(PageId start_page, Length n, Length align,
                                 SpanAllocInfo span_alloc_info, MemoryTag tag);
   static void InvokeDeleteHookSlow(PageId start_page, Length n,
                                    SpanAllocInfo span_alloc_info,
@@ -198,6 +271,45 @@ class PageAllocator {
   bool ShrinkHardBy(Length page, LimitKind limit_kind)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
 
+  // Bytes backed by the page heap and metadata, as compared against limits_.
+  size_t backed_bytes() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+  // Bytes backed by the page heap alone.
+  size_t page_heap_backed_bytes() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
+  // Returns page_heap_backed_bytes() if hard_limit_exceeded_ is already set
+  // before an allocation, for FailIfOverHardLimit to compare against.
+  std::optional<size_t> BackedBytesIfOverHardLimit() const
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) {
+    if (ABSL_PREDICT_TRUE(
+            !hard_limit_exceeded_.load(std::memory_order_relaxed))) {
+      return std::nullopt;
+    }
+    return LockedPageHeapBackedBytes();
+  }
+  size_t LockedPageHeapBackedBytes() const ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
+  // Returns span, or frees it and returns nullptr if we are still above the
+  // hard limit and the allocation grew backed memory.  An allocation grew it
+  // if hard_limit_exceeded_ was set during the allocation (backed_before is
+  // empty), or if page heap backed bytes rose above backed_before.
+  // Allocations served from memory that was already backed do not raise usage
+  // and are allowed.  Only called while hard_limit_exceeded_ is set.
+  Span* absl_nullable FailIfOverHardLimit(Span* absl_nonnull span,
+                                          MemoryTag tag,
+                                          SpanAllocInfo span_alloc_info,
+                                          std::optional<size_t> backed_before)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  PageAllocatorInterface::AllocationState FailIfOverHardLimit(
+      PageAllocatorInterface::AllocationState s, MemoryTag tag,
+      SpanAllocInfo span_alloc_info, std::optional<size_t> backed_before)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+  // Returns true if an allocation made while over the hard limit should fail.
+  bool ShouldFailOverHardLimit(std::optional<size_t> backed_before)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
   using Interface = HugePageAwareAllocator;
 
   ABSL_ATTRIBUTE_RETURNS_NONNULL Interface* impl(MemoryTag tag) const;
@@ -231,6 +343,15 @@ class PageAllocator {
   // or at the limit.
   int64_t successful_shrinks_after_limit_hit_[kNumLimits]{0};
 
+  HardLimitAction hard_limit_action_ = kAbort;
+  // Set under kFailAllocation when ShrinkToUsageLimit could not get below
+  // limits_[kHard], so that New() rechecks usage before returning a span.
+  // Written with pageheap_lock held, but read without it on allocation.
+  std::atomic<bool> hard_limit_exceeded_{false};
+  int64_t hard_limit_failed_allocations_{0};
+
+  MemoryLimitNotifier limit_notifier_;
+
   // peak_backed_bytes_ tracks the maximum number of pages backed (with physical
   // memory) in the page heap and metadata.
   //
@@ -244,11 +365,10 @@ class PageAllocator {
 };
 
 inline PageAllocator::Interface* PageAllocator::impl(MemoryTag tag) const {
+  if (IsNormalTag(tag)) {
+    return normal_impl_[NormalTagPartition(tag)];
+  }
   switch (tag) {
-    case MemoryTag::kNormalP0:
-      return normal_impl_[0];
-    case MemoryTag::kNormalP1:
-      return normal_impl_[1];
     case MemoryTag::kSampled:
       return sampled_impl_[0];
     case MemoryTag::kSampledP1:
@@ -263,7 +383,12 @@ inline PageAllocator::Interface* PageAllocator::impl(MemoryTag tag) const {
 
 inline Span* PageAllocator::New(Length n, SpanAllocInfo span_alloc_info,
                                 MemoryTag tag) {
+  const std::optional<size_t> backed_before = BackedBytesIfOverHardLimit();
   Span* span = impl(tag)->New(n, span_alloc_info);
+  if (span != nullptr && ABSL_PREDICT_FALSE(hard_limit_exceeded_.load(
+                             std::memory_order_relaxed))) {
+    span = FailIfOverHardLimit(span, tag, span_alloc_info, backed_before);
+  }
   // Unaligned page heap allocations are aligned to a 1-page boundary.
   InvokeNewHook(span, n, Length(1), span_alloc_info, tag);
   return span;
@@ -272,11 +397,33 @@ inline Span* PageAllocator::New(Length n, SpanAllocInfo span_alloc_info,
 inline Span* PageAllocator::NewAligned(Length n, Length align,
                                        SpanAllocInfo span_alloc_info,
                                        MemoryTag tag) {
+  const std::optional<size_t> backed_before = BackedBytesIfOverHardLimit();
   Span* span = impl(tag)->NewAligned(n, align, span_alloc_info);
+  if (span != nullptr && ABSL_PREDICT_FALSE(hard_limit_exceeded_.load(
+                             std::memory_order_relaxed))) {
+    span = FailIfOverHardLimit(span, tag, span_alloc_info, backed_before);
+  }
   InvokeNewHook(span, n, align, span_alloc_info, tag);
   return span;
 }
 
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+inline PageAllocatorInterface::AllocationState PageAllocator::NewLarge(
+    Length n, Length align, SpanAllocInfo span_alloc_info, MemoryTag tag) {
+  const std::optional<size_t> backed_before = BackedBytesIfOverHardLimit();
+  PageAllocatorInterface::AllocationState s =
+      impl(tag)->NewLarge(n, align, span_alloc_info);
+  if (s && ABSL_PREDICT_FALSE(
+               hard_limit_exceeded_.load(std::memory_order_relaxed))) {
+    s = FailIfOverHardLimit(s, tag, span_alloc_info, backed_before);
+  }
+  if (ABSL_PREDICT_FALSE(!page_allocator_new_hooks.empty())) {
+    InvokeNewHookSlow(s ? s.r.p : PageId{0}, n, align, span_alloc_info, tag);
+  }
+  return s;
+}
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+
 #ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
 inline void PageAllocator::Delete(Span* span, MemoryTag tag,
                                   SpanAllocInfo span_alloc_info) {
@@ -297,6 +444,42 @@ inline void PageAllocator::Delete(PageAllocatorInterface::AllocationState s,
   impl(tag)->Delete(s, span_alloc_info);
 }
 
+inline void PageAllocator::DeleteMoved(
+    PageAllocatorInterface::AllocationState s, MemoryTag tag, Length unbacked,
+    SpanAllocInfo span_alloc_info) {
+  InvokeDeleteHook(s.r.p, s.r.n, span_alloc_info, tag);
+  impl(tag)->DeleteMoved(s, unbacked, span_alloc_info);
+}
+
+inline bool PageAllocator::TryGrow(PageAllocatorInterface::AllocationState& s,
+                                   Length n, SpanAllocInfo span_alloc_info,
+                                   MemoryTag tag) {
+  // Leave enforcing the hard limit to the allocation path.
+  if (ABSL_PREDICT_FALSE(
+          hard_limit_exceeded_.load(std::memory_order_relaxed))) {
+    return false;
+  }
+  const Range old = s.r;
+  if (!impl(tag)->TryGrow(s, n, span_alloc_info)) return false;
+
+  // To hooks, growth looks like the old span being replaced by the new one.
+  InvokeDeleteHook(old.p, old.n, span_alloc_info, tag);
+  if (ABSL_PREDICT_FALSE(!page_allocator_new_hooks.empty())) {
+    InvokeNewHookSlow(s.r.p, s.r.n, Length(1), span_alloc_info, tag);
+  }
+  return true;
+}
+
+inline bool PageAllocator::ReserveMove(PageId p, MemoryTag tag) {
+  PageHeapSpinLockHolder l;
+  return impl(tag)->ReserveMove(p);
+}
+
+inline void PageAllocator::UnreserveMove(PageId p, MemoryTag tag) {
+  PageHeapSpinLockHolder l;
+  impl(tag)->UnreserveMove(p);
+}
+
 inline BackingStats PageAllocator::stats() const {
   BackingStats ret = normal_impl_[0]->stats();
   for (int partition = 1; partition < active_partitions(); partition++) {
@@ -367,19 +550,39 @@ inline void PageAllocator::TreatHugepageTrackers(
 inline Length PageAllocator::ReleaseAtLeastNPages(Length num_pages,
                                                   PageReleaseReason reason) {
   Length released;
+  // Partitions that release eagerly give up all of their free pages, whether
+  // or not the others have any, so that the others can stay warm.  Sampled
+  // allocations only belong to a partition with full heap partitioning.
+  bool release_eagerly[kNormalPartitions] = {};
+  for (int partition = 0; partition < active_partitions(); partition++) {
+    release_eagerly[partition] =
+        Parameters::partition_release_eagerly(partition);
+    if (!release_eagerly[partition]) continue;
+    released +=
+        normal_impl_[partition]->ReleaseAtLeastNPages(Length::max(), reason);
+    if (sampled_partition_active_ && partition < kSecurityPartitions) {
+      released +=
+          sampled_impl_[partition]->ReleaseAtLeastNPages(Length::max(), reason);
+    }
+  }
+
   // TODO(ckennelly): Refine this policy.  Cold data should be the most
   // resilient to not being on huge pages.
   if (has_cold_impl_) {
-    released = cold_impl_->ReleaseAtLeastNPages(num_pages, reason);
+    released += cold_impl_->ReleaseAtLeastNPages(
+        num_pages > released ? num_pages - released : Length(0), reason);
   }
   for (int partition = 0; partition < active_partitions(); partition++) {
+    if (release_eagerly[partition]) continue;
     released += normal_impl_[partition]->ReleaseAtLeastNPages(
         num_pages > released ? num_pages - released : Length(0), reason);
   }
 
-  released += sampled_impl_[0]->ReleaseAtLeastNPages(
-      num_pages > released ? num_pages - released : Length(0), reason);
-  if (sampled_partition_active_) {
+  if (!sampled_partition_active_ || !release_eagerly[0]) {
+    released += sampled_impl_[0]->ReleaseAtLeastNPages(
+        num_pages > released ? num_pages - released : Length(0), reason);
+  }
+  if (sampled_partition_active_ && !release_eagerly[1]) {
     released += sampled_impl_[1]->ReleaseAtLeastNPages(
         num_pages > released ? num_pages - released : Length(0), reason);
   }
@@ -406,6 +609,28 @@ inline PageReleaseStats PageAllocator::GetReleaseStats() const {
   return stats;
 }
 
+inline NumaPlacementStats PageAllocator::GetNumaPlacementStats() const {
+  NumaPlacementStats stats;
+  for (int partition = 0; partition < active_partitions(); partition++) {
+    stats += normal_impl_[partition]->GetNumaPlacementStats();
+  }
+  return stats;
+}
+
+inline Length PageAllocator::GetRecentDemand() {
+  Length demand = sampled_impl_[0]->GetRecentDemand();
+  for (int partition = 0; partition < active_partitions(); partition++) {
+    demand += normal_impl_[partition]->GetRecentDemand();
+  }
+  if (sampled_partition_active_) {
+    demand += sampled_impl_[1]->GetRecentDemand();
+  }
+  if (has_cold_impl_) {
+    demand += cold_impl_->GetRecentDemand();
+  }
+  return demand;
+}
+
 inline void PageAllocator::Print(Printer& out, MemoryTag tag,
                                  PageFlagsBase& pageflags) {
   if (tag == MemoryTag::kCold && !has_cold_impl_) {
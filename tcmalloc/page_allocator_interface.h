@@ -72,6 +72,44 @@ class PageAllocatorInterface {
   virtual void Delete(AllocationState s, SpanAllocInfo span_alloc_info)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
 
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  // As NewAligned, but for an allocation with no Span: its length and
+  // donation state are kept in the pagemap (see PageMap::SetCompactLargeSpan)
+  // and it must be deleted via its AllocationState.  Returns an empty
+  // AllocationState if out of memory.
+  virtual AllocationState NewLarge(Length n, Length align,
+                                   SpanAllocInfo span_alloc_info)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) = 0;
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+
+  // Try to extend the allocation "s" in place to "n" pages, using the free
+  // pages that immediately follow it.  On success, updates "s" and returns
+  // true.  Returns false, leaving "s" unchanged, if those pages are not
+  // available.
+  // REQUIRES: s was returned by earlier call to New() and has not yet been
+  //           deleted; n > s.r.n.
+  virtual bool TryGrow(AllocationState& s, Length n,
+                       SpanAllocInfo span_alloc_info)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock) = 0;
+
+  // Returns true if whole hugepages of the large allocation starting at page
+  // p may be remapped to or from another allocation with
+  // SystemAllocator::MovePages, counting the mappings the move may cost.
+  virtual bool ReserveMove(PageId p)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
+
+  // Uncounts a move reserved by ReserveMove(p) that did not happen.
+  virtual void UnreserveMove(PageId p)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
+
+  // As Delete, but the first <unbacked> pages of s, a whole number of
+  // hugepages, have no memory behind them because MovePages remapped their
+  // contents away.  They are returned as released rather than backed.
+  // REQUIRES: ReserveMove(s.r.p) returned true.
+  virtual void DeleteMoved(AllocationState s, Length unbacked,
+                           SpanAllocInfo span_alloc_info)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
+
   virtual BackingStats stats() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
 
@@ -96,6 +134,16 @@ class PageAllocatorInterface {
   virtual PageReleaseStats GetReleaseStats() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
 
+  // Returns where the NUMA placement pass found this page allocator's
+  // hugepages, and how many it migrated.
+  virtual NumaPlacementStats GetNumaPlacementStats() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
+
+  // Returns the number of pages that recent demand history predicts will be in
+  // use.  This is at least the number of pages currently in use.
+  virtual Length GetRecentDemand()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) = 0;
+
   virtual void TreatHugepageTrackers(EnableCollapse enable_collapse)
       ABSL_LOCKS_EXCLUDED(pageheap_lock) = 0;
 
@@ -251,6 +251,40 @@ TEST_F(PageAllocatorTest, b270916852) {
   Parameters::set_hpaa_subrelease(old_subrelease);
 }
 
+TEST_F(PageAllocatorTest, ReleaseEagerly) {
+  const bool old_release_eagerly = Parameters::partition_release_eagerly(0);
+  Parameters::set_partition_release_eagerly(0, true);
+
+  constexpr SpanAllocInfo kSpanInfo = {/*objects_per_span=*/1,
+                                       AccessDensityPrediction::kSparse};
+  Span* a = New(kPagesPerHugePage, kSpanInfo, MemoryTag::kNormal);
+  Span* b = New(kPagesPerHugePage, kSpanInfo, MemoryTag::kNormal);
+  Delete(a, kSpanInfo, MemoryTag::kNormal);
+  Delete(b, kSpanInfo, MemoryTag::kNormal);
+
+  BackingStats before;
+  {
+    PageHeapSpinLockHolder l;
+    before = allocator_.stats();
+  }
+  ASSERT_GT(before.free_bytes, kHugePageSize);
+
+  // Asking for a single page returns every free page of the partition.
+  Length released =
+      Release(Length(1), PageReleaseReason::kReleaseMemoryToSystem);
+  EXPECT_GE(released.in_bytes(), before.free_bytes);
+
+  BackingStats after;
+  {
+    PageHeapSpinLockHolder l;
+    after = allocator_.stats();
+  }
+  EXPECT_EQ(after.free_bytes, 0);
+  EXPECT_EQ(after.unmapped_bytes, before.unmapped_bytes + before.free_bytes);
+
+  Parameters::set_partition_release_eagerly(0, old_release_eagerly);
+}
+
 struct HookRecord {
   size_t start_page_index;
   size_t n;
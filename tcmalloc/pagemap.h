@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <atomic>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -53,8 +54,19 @@ namespace tcmalloc_internal {
 typedef void* (*PagemapAllocator)(size_t);
 void* MetaDataAlloc(size_t bytes);
 
+// Length and donation state of a large, unsampled allocation, which the
+// pagemap records in place of a Span.  See PageMap::SetCompactLargeSpan.
+struct CompactLargeSpan {
+  Length num_pages;
+  bool donated;
+};
+
 // Convenience wrapper around a uintptr that packs a Span pointer and its
 // size class into a single word.
+//
+// Alternatively, the word holds a CompactLargeSpan, tagged by its least
+// significant bit.  Spans are cacheline aligned, so that bit is always clear in
+// a Span pointer.
 class PackedSpanAndSizeclass {
  public:
   void set(Span* absl_nullable span, CompactSizeClass sizeclass) {
@@ -62,18 +74,41 @@ class PackedSpanAndSizeclass {
                     reinterpret_cast<uintptr_t>(span);
   }
 
+  void set_compact_large(CompactLargeSpan large) {
+    TC_ASSERT_LT(large.num_pages.raw_num(),
+                 uintptr_t{1} << (kSizeclassShift - kCompactPagesShift));
+    packed_value_ = kCompactTag |
+                    (static_cast<uintptr_t>(large.donated) << kDonatedShift) |
+                    (large.num_pages.raw_num() << kCompactPagesShift);
+  }
+
+  // Returns nullptr for a CompactLargeSpan.
   Span* absl_nullable span() const {
-    return reinterpret_cast<Span*>(packed_value_ & kSpanMask);
+    return reinterpret_cast<Span*>(packed_value_ & kSpanMask &
+                                   ((packed_value_ & kCompactTag) - 1));
   }
   CompactSizeClass sizeclass() const {
     return static_cast<CompactSizeClass>(packed_value_ >> kSizeclassShift);
   }
 
+  bool is_compact_large() const { return packed_value_ & kCompactTag; }
+  CompactLargeSpan compact_large() const {
+    TC_ASSERT(is_compact_large());
+    return {Length((packed_value_ & kSpanMask) >> kCompactPagesShift),
+            static_cast<bool>((packed_value_ >> kDonatedShift) & 1)};
+  }
+
+  bool empty() const { return packed_value_ == 0; }
+
  private:
   uintptr_t packed_value_;
   static_assert(sizeof(CompactSizeClass) <= 2);
   static constexpr uintptr_t kSizeclassShift = 48;
   static constexpr uintptr_t kSpanMask = (uintptr_t{1} << kSizeclassShift) - 1;
+  static constexpr uintptr_t kCompactTag = 1;
+  static constexpr uintptr_t kDonatedShift = 1;
+  static constexpr uintptr_t kCompactPagesShift = 2;
+  static_assert(alignof(Span) > kCompactTag);
 };
 
 // Three-level radix tree
@@ -157,7 +192,7 @@ class PageMap3 {
       for (; i2 < kMidLength; ++i2, i3 = 0) {
         if (root_[i1]->leafs[i2] == nullptr) continue;
         for (; i3 < kLeafLength; ++i3) {
-          if (root_[i1]->leafs[i2]->span(i3) != nullptr)
+          if (!root_[i1]->leafs[i2]->span_and_sizeclass[i3].empty())
             return (i1 << (kLeafBits + kMidBits)) | (i2 << kLeafBits) | i3;
         }
       }
@@ -235,7 +270,25 @@ class PageMap3 {
     return ret;
   }
 
-  void set(Number k, Span* s) {
+  // No locks required.  See SYNCHRONIZATION explanation at top of tcmalloc.cc.
+  std::optional<CompactLargeSpan> get_compact_large(Number k) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    const Number i1 = k >> (kLeafBits + kMidBits);
+    const Number i2 = (k >> kLeafBits) & (kMidLength - 1);
+    const Number i3 = k & (kLeafLength - 1);
+    if (ABSL_PREDICT_FALSE((k >> BITS) > 0) ||
+        ABSL_PREDICT_FALSE(root_[i1] == nullptr) ||
+        ABSL_PREDICT_FALSE(root_[i1]->leafs[i2] == nullptr)) {
+      return std::nullopt;
+    }
+    const PackedSpanAndSizeclass entry =
+        root_[i1]->leafs[i2]->span_and_sizeclass[i3];
+    if (!entry.is_compact_large()) return std::nullopt;
+    return entry.compact_large();
+  }
+
+  // Returns whether the entry for k held a CompactLargeSpan.
+  bool set(Number k, Span* s) {
     const Number i1 = k >> (kLeafBits + kMidBits);
     const Number i2 = (k >> kLeafBits) & (kMidLength - 1);
     const Number i3 = k & (kLeafLength - 1);
@@ -245,7 +298,22 @@ class PageMap3 {
     // old span was deallocated/unregistered (or it would have been zero
     // at initialization time.)
     TC_ASSERT_EQ(leaf->sizeclass[i3], 0);
+    const bool was_compact = leaf->span_and_sizeclass[i3].is_compact_large();
     leaf->span_and_sizeclass[i3].set(s, 0);
+    return was_compact;
+  }
+
+  // Returns whether the entry for k already held a CompactLargeSpan.
+  bool set_compact_large(Number k, CompactLargeSpan large) {
+    TC_ASSERT_EQ(k >> BITS, 0);
+    const Number i1 = k >> (kLeafBits + kMidBits);
+    const Number i2 = (k >> kLeafBits) & (kMidLength - 1);
+    const Number i3 = k & (kLeafLength - 1);
+    Leaf* leaf = root_[i1]->leafs[i2];
+    TC_ASSERT_EQ(leaf->sizeclass[i3], 0);
+    const bool was_compact = leaf->span_and_sizeclass[i3].is_compact_large();
+    leaf->span_and_sizeclass[i3].set_compact_large(large);
+    return was_compact;
   }
 
   void set_with_sizeclass(Number k, Span* s, CompactSizeClass sc) {
@@ -347,7 +415,33 @@ class PageMap {
     return map_.sizeclass(p.index());
   }
 
-  void Set(PageId p, Span* span) { map_.set(p.index(), span); }
+  void Set(PageId p, Span* span) {
+    if (ABSL_PREDICT_FALSE(map_.set(p.index(), span))) {
+      compact_large_spans_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Records the large allocation starting at p without a Span: GetDescriptor
+  // returns nullptr for p, and GetCompactLargeSpan returns large.  This saves
+  // a Span for each large allocation that is not sampled.  Setting a Span for
+  // p (including on deletion) replaces the record.
+  void SetCompactLargeSpan(PageId p, CompactLargeSpan large) {
+    if (ABSL_PREDICT_TRUE(!map_.set_compact_large(p.index(), large))) {
+      compact_large_spans_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns the CompactLargeSpan starting at p, if any.
+  // No locks required.  See SYNCHRONIZATION explanation at top of tcmalloc.cc.
+  [[nodiscard]] std::optional<CompactLargeSpan> GetCompactLargeSpan(
+      PageId p) const ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return map_.get_compact_large(p.index());
+  }
+
+  // Number of live allocations recorded by SetCompactLargeSpan.
+  size_t compact_large_spans() const {
+    return compact_large_spans_.load(std::memory_order_relaxed);
+  }
 
   [[nodiscard]] bool Ensure(Range r)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
@@ -425,6 +519,17 @@ class PageMap {
     for (std::optional<uintptr_t> i = 0; i.has_value();
          i = map_.get_next_set_page(i.value())) {
       PageId page_id = PageId{i.value()};
+      if (std::optional<CompactLargeSpan> large =
+              map_.get_compact_large(page_id.index());
+          large.has_value()) {
+        if (allocated_spans.capacity() > allocated_spans.size()) {
+          allocated_spans.push_back(
+              {page_id.start_uintptr(), large->num_pages.in_bytes(), 0});
+        }
+        ++allocated_span_count;
+        i = (page_id + large->num_pages).index() - 1;
+        continue;
+      }
       Span* s = GetDescriptor(page_id);
       if (s == nullptr || s == &tc_globals.invalid_span()) {
         continue;
@@ -450,6 +555,7 @@ class PageMap {
 
  private:
   PageMap3<kAddressBits - kPageShift, MetaDataAlloc> map_;
+  std::atomic<size_t> compact_large_spans_{0};
 };
 
 }  // namespace tcmalloc_internal
@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <new>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -39,8 +40,11 @@ namespace tcmalloc {
 namespace tcmalloc_internal {
 namespace {
 
-// Pick span pointer to use for page numbered i
-Span* span(intptr_t i) { return reinterpret_cast<Span*>(i + 1); }
+// Pick span pointer to use for page numbered i.  Like real Spans, these are
+// suitably aligned, leaving the low bits free to tag CompactLargeSpans.
+Span* span(intptr_t i) {
+  return reinterpret_cast<Span*>((i + 1) * alignof(Span));
+}
 
 // Pick sizeclass to use for page numbered i
 uint8_t sc(intptr_t i) { return i % 16; }
@@ -141,6 +145,38 @@ TEST_P(PageMapTest, RandomAccess) {
   }
 }
 
+TEST_P(PageMapTest, CompactLargeSpan) {
+  const intptr_t limit = GetParam();
+
+  map->Ensure(0, limit);
+  for (intptr_t i = 0; i < limit; i++) {
+    ASSERT_FALSE(map->set_compact_large(i, {Length(i + 1), i % 2 == 0}));
+    ASSERT_EQ(map->get(i), nullptr);
+    ASSERT_EQ(map->sizeclass(i), 0);
+    ASSERT_EQ(map->get_existing_with_sizeclass<false>(i),
+              (std::pair<Span*, int>(nullptr, 0)));
+
+    std::optional<CompactLargeSpan> large = map->get_compact_large(i);
+    ASSERT_TRUE(large.has_value());
+    EXPECT_EQ(large->num_pages, Length(i + 1));
+    EXPECT_EQ(large->donated, i % 2 == 0);
+    if (i > 0) {
+      EXPECT_EQ(map->get_next_set_page(i - 1), std::optional<uintptr_t>(i));
+    }
+  }
+
+  // Updating the entry keeps it compact.
+  ASSERT_TRUE(map->set_compact_large(0, {Length(limit), true}));
+  EXPECT_EQ(map->get_compact_large(0)->num_pages, Length(limit));
+
+  // Setting a Span replaces the entry.
+  for (intptr_t i = 0; i < limit; i++) {
+    ASSERT_TRUE(map->set(i, span(i)));
+    ASSERT_EQ(map->get(i), span(i));
+    ASSERT_FALSE(map->get_compact_large(i).has_value());
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(Limits, PageMapTest, ::testing::Values(100, 1 << 16));
 
 // Surround pagemap with unused memory. This isolates it so that it does not
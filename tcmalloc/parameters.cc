@@ -13,11 +13,14 @@
 // limitations under the License.
 #include "tcmalloc/parameters.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <limits>
+#include <utility>
 
 #include "absl/base/attributes.h"
 #include "absl/base/call_once.h"
@@ -46,6 +49,12 @@ GOOGLE_MALLOC_SECTION_BEGIN
 namespace tcmalloc {
 namespace tcmalloc_internal {
 
+template <typename T, size_t... Partitions>
+static constexpr std::array<std::atomic<T>, sizeof...(Partitions)>
+PerPartitionValue(T value, std::index_sequence<Partitions...>) {
+  return {((void)Partitions, value)...};
+}
+
 template <typename T>
 static constexpr T DefaultOrDebugValue(T default_val, T debug_val) {
 #ifdef NDEBUG
@@ -166,6 +175,32 @@ SubreleaseUnbackedMode Parameters::subrelease_unbacked_hugepages() {
              : SubreleaseUnbackedMode::kDisabled;
 }
 
+SeparateSpanLifetimes Parameters::filler_separate_span_lifetimes() {
+  ABSL_CONST_INIT static absl::once_flag flag;
+  absl::base_internal::LowLevelCallOnce(&flag, [&]() {
+    if (IsExperimentActive(
+            Experiment::TEST_ONLY_TCMALLOC_SEPARATE_SPAN_LIFETIMES)) {
+      filler_separate_span_lifetimes_.store(true, std::memory_order_relaxed);
+    }
+  });
+  return filler_separate_span_lifetimes_.load(std::memory_order_relaxed)
+             ? SeparateSpanLifetimes::kEnabled
+             : SeparateSpanLifetimes::kDisabled;
+}
+
+HugeRegionPreferBacked Parameters::huge_region_prefer_backed() {
+  ABSL_CONST_INIT static absl::once_flag flag;
+  absl::base_internal::LowLevelCallOnce(&flag, [&]() {
+    if (IsExperimentActive(
+            Experiment::TEST_ONLY_TCMALLOC_HUGE_REGION_PREFER_BACKED)) {
+      huge_region_prefer_backed_.store(true, std::memory_order_relaxed);
+    }
+  });
+  return huge_region_prefer_backed_.load(std::memory_order_relaxed)
+             ? HugeRegionPreferBacked::kEnabled
+             : HugeRegionPreferBacked::kDisabled;
+}
+
 std::atomic<MallocExtension::BytesPerSecond>& background_release_rate_ptr() {
   ABSL_CONST_INIT static absl::once_flag flag;
   ABSL_CONST_INIT static std::atomic<MallocExtension::BytesPerSecond> v{
@@ -186,9 +221,13 @@ void Parameters::set_background_release_rate(
   TCMalloc_Internal_SetBackgroundReleaseRate(static_cast<size_t>(value));
 }
 
+ABSL_CONST_INIT std::atomic<bool> Parameters::background_release_adaptive_(
+    false);
+ABSL_CONST_INIT std::atomic<double> Parameters::memory_pressure_(0);
 ABSL_CONST_INIT std::atomic<int64_t> Parameters::guarded_sampling_interval_(
     DefaultOrDebugValue(/*default_val=*/50, /*debug_val=*/5) *
     kDefaultProfileSamplingInterval);
+ABSL_CONST_INIT std::atomic<int64_t> Parameters::sampled_quarantine_bytes_(0);
 // TODO(b/285379004):  Remove this opt-out.
 ABSL_CONST_INIT std::atomic<bool> Parameters::release_partial_alloc_pages_(
     true);
@@ -223,6 +262,10 @@ ABSL_CONST_INIT std::atomic<int64_t> Parameters::profile_sampling_interval_(
 
 ABSL_CONST_INIT std::atomic<bool> Parameters::subrelease_unbacked_hugepages_(
     false);
+ABSL_CONST_INIT std::atomic<bool> Parameters::filler_separate_span_lifetimes_(
+    false);
+ABSL_CONST_INIT std::atomic<bool> Parameters::huge_region_prefer_backed_(
+    false);
 
 // TODO: b/134694141 - Remove this opt out.
 ABSL_CONST_INIT std::atomic<bool> Parameters::back_small_allocations_(false);
@@ -235,6 +278,19 @@ ABSL_CONST_INIT std::atomic<int64_t> Parameters::event_trace_memory_limit_(
     16 << 20);
 ABSL_CONST_INIT
 std::atomic<bool> Parameters::release_drained_slab_metadata_(false);
+ABSL_CONST_INIT
+std::atomic<bool> Parameters::per_cpu_caches_on_demand_steal_(false);
+ABSL_CONST_INIT
+std::atomic<bool> Parameters::per_cpu_caches_follow_cpuset_(false);
+ABSL_CONST_INIT
+std::atomic<bool> Parameters::numa_migrate_remote_hugepages_(false);
+ABSL_CONST_INIT std::array<std::atomic<int32_t>, kNormalPartitions>
+    Parameters::partition_per_cpu_cache_percent_ = PerPartitionValue<int32_t>(
+        100, std::make_index_sequence<kNormalPartitions>());
+ABSL_CONST_INIT std::array<std::atomic<bool>, kNormalPartitions>
+    Parameters::partition_release_eagerly_ =
+        PerPartitionValue<bool>(false,
+                                std::make_index_sequence<kNormalPartitions>());
 
 static std::atomic<MadviseRegionsNoHugepage>&
 madvise_cold_regions_nohugepage_enabled() {
@@ -389,6 +445,14 @@ void MallocExtension_Internal_SetGuardedSamplingInterval(int64_t value) {
   Parameters::set_guarded_sampling_interval(value);
 }
 
+int64_t MallocExtension_Internal_GetSampledQuarantineBytes() {
+  return Parameters::sampled_quarantine_bytes();
+}
+
+void MallocExtension_Internal_SetSampledQuarantineBytes(int64_t value) {
+  Parameters::set_sampled_quarantine_bytes(value);
+}
+
 int64_t MallocExtension_Internal_GetMaxTotalThreadCacheBytes() {
   return Parameters::max_total_thread_cache_bytes();
 }
@@ -452,6 +516,39 @@ void TCMalloc_Internal_SetBackgroundReleaseRate(size_t value) {
       static_cast<tcmalloc::MallocExtension::BytesPerSecond>(value));
 }
 
+bool MallocExtension_Internal_GetBackgroundReleaseAdaptive() {
+  return Parameters::background_release_adaptive();
+}
+
+void MallocExtension_Internal_SetBackgroundReleaseAdaptive(bool value) {
+  Parameters::set_background_release_adaptive(value);
+}
+
+double MallocExtension_Internal_GetMemoryPressure() {
+  return Parameters::memory_pressure();
+}
+
+void MallocExtension_Internal_SetMemoryPressure(double value) {
+  Parameters::set_memory_pressure(value);
+}
+
+bool TCMalloc_Internal_GetBackgroundReleaseAdaptive() {
+  return Parameters::background_release_adaptive();
+}
+
+void TCMalloc_Internal_SetBackgroundReleaseAdaptive(bool v) {
+  Parameters::background_release_adaptive_.store(v, std::memory_order_relaxed);
+}
+
+double TCMalloc_Internal_GetMemoryPressure() {
+  return Parameters::memory_pressure();
+}
+
+void TCMalloc_Internal_SetMemoryPressure(double v) {
+  Parameters::memory_pressure_.store(std::clamp(v, 0.0, 100.0),
+                                     std::memory_order_relaxed);
+}
+
 uint64_t TCMalloc_Internal_GetHeapSizeHardLimit() {
   // Under ASan we could get here before globals have been initialized.
   tc_globals.InitIfNecessary();
@@ -495,6 +592,17 @@ void TCMalloc_Internal_SetGuardedSamplingInterval(int64_t v) {
   Parameters::guarded_sampling_interval_.store(v, std::memory_order_relaxed);
 }
 
+void TCMalloc_Internal_SetSampledQuarantineBytes(int64_t v) {
+  const int64_t budget = std::max<int64_t>(v, 0);
+  Parameters::sampled_quarantine_bytes_.store(budget,
+                                              std::memory_order_relaxed);
+  // Release what no longer fits, oldest first.  Objects quarantined
+  // concurrently are evicted as later ones arrive, or by the next call.
+  if (tc_globals.IsInited()) {
+    tc_globals.sampled_quarantine().ShrinkTo(budget);
+  }
+}
+
 // update_lock guards changes via SetHeapSizeHardLimit.
 ABSL_CONST_INIT static absl::base_internal::SpinLock update_lock(
     absl::base_internal::SCHEDULE_KERNEL_ONLY);
@@ -675,6 +783,37 @@ void TCMalloc_Internal_SetReleaseDrainedSlabMetadata(bool v) {
   Parameters::release_drained_slab_metadata_.store(v,
                                                    std::memory_order_relaxed);
 }
+
+void TCMalloc_Internal_SetPerCpuCachesOnDemandSteal(bool v) {
+  Parameters::per_cpu_caches_on_demand_steal_.store(v,
+                                                    std::memory_order_relaxed);
+}
+
+void TCMalloc_Internal_SetPerCpuCachesFollowCpuset(bool v) {
+  Parameters::per_cpu_caches_follow_cpuset_.store(v, std::memory_order_relaxed);
+}
+
+void TCMalloc_Internal_SetNumaMigrateRemoteHugepages(bool v) {
+  Parameters::numa_migrate_remote_hugepages_.store(v,
+                                                   std::memory_order_relaxed);
+}
+
+void TCMalloc_Internal_SetPartitionPerCpuCachePercent(size_t partition,
+                                                      int32_t v) {
+  if (partition >= tcmalloc::tcmalloc_internal::kNormalPartitions) {
+    return;
+  }
+  Parameters::partition_per_cpu_cache_percent_[partition].store(
+      std::clamp<int32_t>(v, 0, 100), std::memory_order_relaxed);
+}
+
+void TCMalloc_Internal_SetPartitionReleaseEagerly(size_t partition, bool v) {
+  if (partition >= tcmalloc::tcmalloc_internal::kNormalPartitions) {
+    return;
+  }
+  Parameters::partition_release_eagerly_[partition].store(
+      v, std::memory_order_relaxed);
+}
 }  // extern "C"
 
 GOOGLE_MALLOC_SECTION_END
@@ -15,6 +15,7 @@
 #ifndef TCMALLOC_PARAMETERS_H_
 #define TCMALLOC_PARAMETERS_H_
 
+#include <array>
 #include <atomic>
 #include <cmath>
 #include <cstddef>
@@ -23,6 +24,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "tcmalloc/central_freelist.h"
+#include "tcmalloc/common.h"
 #include "tcmalloc/huge_page_filler.h"
 #include "tcmalloc/huge_page_options.h"
 #include "tcmalloc/internal/config.h"
@@ -52,6 +54,22 @@ class Parameters {
   static void set_background_release_rate(
       MallocExtension::BytesPerSecond value);
 
+  static bool background_release_adaptive() {
+    return background_release_adaptive_.load(std::memory_order_relaxed);
+  }
+
+  static void set_background_release_adaptive(bool value) {
+    TCMalloc_Internal_SetBackgroundReleaseAdaptive(value);
+  }
+
+  static double memory_pressure() {
+    return memory_pressure_.load(std::memory_order_relaxed);
+  }
+
+  static void set_memory_pressure(double value) {
+    TCMalloc_Internal_SetMemoryPressure(value);
+  }
+
   static uint64_t heap_size_hard_limit();
   static void set_heap_size_hard_limit(uint64_t value);
 
@@ -68,6 +86,14 @@ class Parameters {
     TCMalloc_Internal_SetGuardedSamplingInterval(value);
   }
 
+  static int64_t sampled_quarantine_bytes() {
+    return sampled_quarantine_bytes_.load(std::memory_order_relaxed);
+  }
+
+  static void set_sampled_quarantine_bytes(int64_t value) {
+    TCMalloc_Internal_SetSampledQuarantineBytes(value);
+  }
+
   static int32_t max_per_cpu_cache_size();
 
   static void set_max_per_cpu_cache_size(int32_t value) {
@@ -106,6 +132,8 @@ class Parameters {
 
   static SubreleaseUnbackedMode subrelease_unbacked_hugepages();
 
+  static SeparateSpanLifetimes filler_separate_span_lifetimes();
+
   static bool back_small_allocations() {
     return back_small_allocations_.load(std::memory_order_relaxed);
   }
@@ -134,6 +162,8 @@ class Parameters {
 
   static bool huge_region_adaptive_release();
 
+  static HugeRegionPreferBacked huge_region_prefer_backed();
+
   static bool release_max_cold_pages() {
     return release_max_cold_pages_.load(std::memory_order_relaxed);
   }
@@ -217,6 +247,56 @@ class Parameters {
     TCMalloc_Internal_SetReleaseDrainedSlabMetadata(value);
   }
 
+  static bool per_cpu_caches_on_demand_steal() {
+    return per_cpu_caches_on_demand_steal_.load(std::memory_order_relaxed);
+  }
+
+  static void set_per_cpu_caches_on_demand_steal(bool value) {
+    TCMalloc_Internal_SetPerCpuCachesOnDemandSteal(value);
+  }
+
+  static bool per_cpu_caches_follow_cpuset() {
+    return per_cpu_caches_follow_cpuset_.load(std::memory_order_relaxed);
+  }
+
+  static void set_per_cpu_caches_follow_cpuset(bool value) {
+    TCMalloc_Internal_SetPerCpuCachesFollowCpuset(value);
+  }
+
+  static bool numa_migrate_remote_hugepages() {
+    return numa_migrate_remote_hugepages_.load(std::memory_order_relaxed);
+  }
+
+  static void set_numa_migrate_remote_hugepages(bool value) {
+    TCMalloc_Internal_SetNumaMigrateRemoteHugepages(value);
+  }
+
+  // The share of the per-CPU cache limit, in percent, that the size classes
+  // of a heap partition may hold on each CPU.  Lowering it shrinks capacity
+  // already held on the next per-CPU cache resize.
+  static int32_t partition_per_cpu_cache_percent(size_t partition) {
+    TC_ASSERT_LT(partition, kNormalPartitions);
+    return partition_per_cpu_cache_percent_[partition].load(
+        std::memory_order_relaxed);
+  }
+
+  static void set_partition_per_cpu_cache_percent(size_t partition,
+                                                  int32_t value) {
+    TCMalloc_Internal_SetPartitionPerCpuCachePercent(partition, value);
+  }
+
+  // Whether memory release returns all free pages of a heap partition's page
+  // heap before releasing from the other partitions.
+  static bool partition_release_eagerly(size_t partition) {
+    TC_ASSERT_LT(partition, kNormalPartitions);
+    return partition_release_eagerly_[partition].load(
+        std::memory_order_relaxed);
+  }
+
+  static void set_partition_release_eagerly(size_t partition, bool value) {
+    TCMalloc_Internal_SetPartitionReleaseEagerly(partition, value);
+  }
+
   static HeapPartitioningMode heap_partitioning_mode();
 
   // TODO: b/527473378 - Remove this function once the experiment is cleaned up.
@@ -224,7 +304,10 @@ class Parameters {
 
  private:
   friend void ::TCMalloc_Internal_SetBackgroundReleaseRate(size_t v);
+  friend void ::TCMalloc_Internal_SetBackgroundReleaseAdaptive(bool v);
+  friend void ::TCMalloc_Internal_SetMemoryPressure(double v);
   friend void ::TCMalloc_Internal_SetGuardedSamplingInterval(int64_t v);
+  friend void ::TCMalloc_Internal_SetSampledQuarantineBytes(int64_t v);
   friend void ::TCMalloc_Internal_SetHPAASubrelease(bool v);
   friend void ::TCMalloc_Internal_SetReleasePartialAllocPagesEnabled(bool v);
   friend void ::TCMalloc_Internal_SetUsermodeHugepageCollapse(bool v);
@@ -258,8 +341,18 @@ class Parameters {
   friend void ::TCMalloc_Internal_SetReleaseMaxColdPages(bool v);
   friend void ::TCMalloc_Internal_SetEventTraceMemoryLimit(int64_t v);
   friend void ::TCMalloc_Internal_SetReleaseDrainedSlabMetadata(bool v);
-
+  friend void ::TCMalloc_Internal_SetPerCpuCachesOnDemandSteal(bool v);
+  friend void ::TCMalloc_Internal_SetPerCpuCachesFollowCpuset(bool v);
+  friend void ::TCMalloc_Internal_SetNumaMigrateRemoteHugepages(bool v);
+  friend void ::TCMalloc_Internal_SetPartitionPerCpuCachePercent(
+      size_t partition, int32_t v);
+  friend void ::TCMalloc_Internal_SetPartitionReleaseEagerly(size_t partition,
+                                                             bool v);
+
+  static std::atomic<bool> background_release_adaptive_;
+  static std::atomic<double> memory_pressure_;
   static std::atomic<int64_t> guarded_sampling_interval_;
+  static std::atomic<int64_t> sampled_quarantine_bytes_;
   static std::atomic<int32_t> max_per_cpu_cache_size_;
   static std::atomic<int64_t> max_total_thread_cache_bytes_;
   static std::atomic<double> peak_sampling_heap_growth_fraction_;
@@ -273,6 +366,8 @@ class Parameters {
   static std::atomic<double> per_cpu_caches_dynamic_slab_grow_threshold_;
   static std::atomic<double> per_cpu_caches_dynamic_slab_shrink_threshold_;
   static std::atomic<bool> subrelease_unbacked_hugepages_;
+  static std::atomic<bool> filler_separate_span_lifetimes_;
+  static std::atomic<bool> huge_region_prefer_backed_;
   static std::atomic<bool> usermode_hugepage_collapse_enabled_;
   static std::atomic<bool> back_small_allocations_;
   static std::atomic<int32_t> back_size_threshold_bytes_;
@@ -280,6 +375,13 @@ class Parameters {
   static std::atomic<bool> release_max_cold_pages_;
   static std::atomic<int64_t> event_trace_memory_limit_;
   static std::atomic<bool> release_drained_slab_metadata_;
+  static std::atomic<bool> per_cpu_caches_on_demand_steal_;
+  static std::atomic<bool> per_cpu_caches_follow_cpuset_;
+  static std::atomic<bool> numa_migrate_remote_hugepages_;
+  static std::array<std::atomic<int32_t>, kNormalPartitions>
+      partition_per_cpu_cache_percent_;
+  static std::array<std::atomic<bool>, kNormalPartitions>
+      partition_release_eagerly_;
 };
 
 }  // namespace tcmalloc_internal
@@ -16,6 +16,7 @@
 #include "tcmalloc/common.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/size_class_info.h"
+#include "tcmalloc/sizemap.h"
 
 GOOGLE_MALLOC_SECTION_BEGIN
 namespace tcmalloc {
@@ -510,6 +511,8 @@ static constexpr SizeClassInfo List[] = {
 
 static_assert(sizeof(List) / sizeof(List[0]) <= kNumBaseClasses);
 extern constexpr SizeClasses kReuseRelaxedBelow64SizeClasses{List, Assumptions};
+extern constexpr SizeMap::ClassIndexTable
+    kReuseRelaxedBelow64SizeClassesIndex = SizeMap::BuildClassIndexTable(List);
 
 // clang-format off
 static_assert(SizeClassesAreDivisibleByPageSize(
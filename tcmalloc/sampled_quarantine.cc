@@ -0,0 +1,287 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tcmalloc/sampled_quarantine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "absl/base/internal/spinlock.h"
+#include "absl/base/optimization.h"
+#include "absl/debugging/stacktrace.h"
+#include "absl/types/span.h"
+#include "tcmalloc/common.h"
+#include "tcmalloc/error_reporting.h"
+#include "tcmalloc/internal/allocation_guard.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/memory_tag.h"
+#include "tcmalloc/internal/percpu.h"
+#include "tcmalloc/page_allocator_interface.h"
+#include "tcmalloc/pagemap.h"
+#include "tcmalloc/pages.h"
+#include "tcmalloc/parameters.h"
+#include "tcmalloc/span.h"
+#include "tcmalloc/static_vars.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+namespace {
+
+// Returns the offset of the first byte in [p, p + size) that is not
+// SampledQuarantine::kPattern, or size if there is none.
+size_t FindOverwrite(const void* p, size_t size) {
+  constexpr uint64_t kWord =
+      uint64_t{0x0101010101010101} * SampledQuarantine::kPattern;
+  const char* bytes = static_cast<const char*>(p);
+  size_t offset = 0;
+  for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + offset, sizeof(word));
+    if (ABSL_PREDICT_FALSE(word != kWord)) break;
+  }
+  for (; offset < size; ++offset) {
+    if (static_cast<uint8_t>(bytes[offset]) != SampledQuarantine::kPattern) {
+      return offset;
+    }
+  }
+  return size;
+}
+
+}  // namespace
+
+void SampledQuarantine::Init(int num_cpus) {
+  TC_CHECK_EQ(shards_, nullptr);
+  TC_CHECK_GT(num_cpus, 0);
+  auto* shards = static_cast<Shard*>(tc_globals.arena().Alloc(
+      sizeof(Shard) * num_cpus, std::align_val_t{ABSL_CACHELINE_SIZE}));
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    new (&shards[cpu]) Shard;
+  }
+  num_shards_ = num_cpus;
+  shards_ = shards;
+}
+
+bool SampledQuarantine::enabled() {
+  return Parameters::sampled_quarantine_bytes() > 0;
+}
+
+int SampledQuarantine::CurrentShard() {
+  int cpu = subtle::percpu::GetRealCpuUnsafe();
+  if (ABSL_PREDICT_FALSE(cpu < 0 || cpu >= num_shards_)) {
+    cpu = 0;
+  }
+  return cpu;
+}
+
+bool SampledQuarantine::Quarantine(void* ptr, Span* span, MemoryTag tag,
+                                   const StackTrace& allocation) {
+  if (ABSL_PREDICT_FALSE(shards_ == nullptr)) return false;
+  const int64_t budget = Parameters::sampled_quarantine_bytes();
+  if (budget <= 0) return false;
+  const size_t size = allocation.allocated_size;
+  if (size > kMaxObjectSize || size > static_cast<size_t>(budget)) {
+    skipped_too_large_.Add(1);
+    return false;
+  }
+
+  // Reserve room in the shared budget, evicting the oldest objects of this
+  // CPU and then of the others.  Entries are verified and freed outside of
+  // their shard's lock.
+  const int home = CurrentShard();
+  Entry evicted;
+  size_t held = bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+  for (int shard = home, empty = 0;
+       held > static_cast<size_t>(budget) && empty < num_shards_;) {
+    if (TryPopOldest(shards_[shard], evicted)) {
+      VerifyAndFree(evicted);
+      empty = 0;
+    } else {
+      shard = (shard + 1) % num_shards_;
+      ++empty;
+    }
+    held = bytes_.load(std::memory_order_relaxed);
+  }
+  if (ABSL_PREDICT_FALSE(held > static_cast<size_t>(budget))) {
+    // Other CPUs filled the room we made.
+    bytes_.fetch_sub(size, std::memory_order_relaxed);
+    skipped_too_large_.Add(1);
+    return false;
+  }
+
+  // Unwind and fill outside of the shard lock.  Once the pattern is written,
+  // any later write to the object is a use-after-free.
+  void* deallocation_stack[kMaxStackDepth];
+  const size_t deallocation_depth =
+      absl::GetStackTrace(deallocation_stack, kMaxStackDepth, 2);
+  memset(ptr, kPattern, size);
+
+  // Make a second free of ptr report a double free, as it would have had the
+  // span gone back to the page heap.
+  {
+#ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
+    PageHeapSpinLockHolder l;
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+    tc_globals.pagemap().Set(span->first_page(),
+                             const_cast<Span*>(&tc_globals.invalid_span()));
+  }
+
+  bool full;
+  {
+    Shard& shard = shards_[home];
+    AllocationGuardSpinLockHolder h(shard.lock);
+    if (ABSL_PREDICT_FALSE(shard.entries == nullptr)) {
+      PageHeapSpinLockHolder l;
+      shard.entries = static_cast<Entry*>(
+          tc_globals.arena().Alloc(sizeof(Entry) * kMaxObjectsPerCpu));
+    }
+    full = shard.count == kMaxObjectsPerCpu;
+    if (full) {
+      PopOldest(shard, evicted);
+    }
+
+    Entry& e = shard.entries[(shard.head + shard.count) % kMaxObjectsPerCpu];
+    e.ptr = ptr;
+    e.size = size;
+    e.span = span;
+    e.tag = tag;
+    e.allocation_depth = std::min<size_t>(allocation.depth, kMaxStackDepth);
+    memcpy(e.allocation_stack, allocation.stack,
+           e.allocation_depth * sizeof(e.allocation_stack[0]));
+    e.deallocation_depth = deallocation_depth;
+    memcpy(e.deallocation_stack, deallocation_stack,
+           deallocation_depth * sizeof(e.deallocation_stack[0]));
+    ++shard.count;
+    shard.bytes += size;
+  }
+  objects_.fetch_add(1, std::memory_order_relaxed);
+  quarantined_.Add(1);
+
+  if (full) {
+    VerifyAndFree(evicted);
+  }
+  return true;
+}
+
+void SampledQuarantine::PopOldest(Shard& shard, Entry& out) {
+  TC_ASSERT_GT(shard.count, 0);
+  const Entry& e = shard.entries[shard.head];
+  out.ptr = e.ptr;
+  out.size = e.size;
+  out.span = e.span;
+  out.tag = e.tag;
+  out.allocation_depth = e.allocation_depth;
+  memcpy(out.allocation_stack, e.allocation_stack,
+         e.allocation_depth * sizeof(e.allocation_stack[0]));
+  out.deallocation_depth = e.deallocation_depth;
+  memcpy(out.deallocation_stack, e.deallocation_stack,
+         e.deallocation_depth * sizeof(e.deallocation_stack[0]));
+
+  shard.head = (shard.head + 1) % kMaxObjectsPerCpu;
+  --shard.count;
+  shard.bytes -= e.size;
+  objects_.fetch_sub(1, std::memory_order_relaxed);
+  bytes_.fetch_sub(e.size, std::memory_order_relaxed);
+}
+
+bool SampledQuarantine::TryPopOldest(Shard& shard, Entry& out) {
+  AllocationGuardSpinLockHolder h(shard.lock);
+  if (shard.count == 0) return false;
+  PopOldest(shard, out);
+  return true;
+}
+
+void SampledQuarantine::VerifyAndFree(const Entry& e) {
+  if (const size_t offset = FindOverwrite(e.ptr, e.size);
+      ABSL_PREDICT_FALSE(offset != e.size)) {
+    ReportUseAfterFreeWrite(
+        tc_globals, e.ptr, offset, e.size,
+        absl::MakeSpan(e.allocation_stack, e.allocation_depth),
+        absl::MakeSpan(e.deallocation_stack, e.deallocation_depth));
+  }
+  verified_.Add(1);
+
+  Span* span = e.span;
+  const MemoryTag tag = e.tag;
+  // Free the span the way InvokeHooksAndFreePages would have.
+#ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  PageHeapSpinLockHolder l;
+  tc_globals.pagemap().Set(span->first_page(), span);
+  tc_globals.page_allocator().Delete(
+      span, tag,
+      {.objects_per_span = 1, .density = AccessDensityPrediction::kSparse});
+#else
+  tc_globals.pagemap().Set(span->first_page(), span);
+  PageAllocatorInterface::AllocationState a{
+      Range(span->first_page(), span->num_pages()),
+      span->donated(),
+  };
+  Span::Delete(span);
+  PageHeapSpinLockHolder l;
+  tc_globals.page_allocator().Delete(
+      a, tag,
+      {.objects_per_span = 1, .density = AccessDensityPrediction::kSparse});
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+}
+
+void SampledQuarantine::ShrinkTo(size_t limit) {
+  // bytes() includes room reserved by concurrent Quarantine() calls, so stop
+  // once every shard has been seen empty.
+  Entry evicted;
+  for (int shard = 0, empty = 0; bytes() > limit && empty < num_shards_;
+       shard = (shard + 1) % num_shards_) {
+    if (TryPopOldest(shards_[shard], evicted)) {
+      VerifyAndFree(evicted);
+      empty = 0;
+    } else {
+      ++empty;
+    }
+  }
+}
+
+void SampledQuarantine::Print(Printer& out) const {
+  out.printf(
+      "\n"
+      "------------------------------------------------\n"
+      "Sampled Quarantine Status\n"
+      "------------------------------------------------\n"
+      "Currently Quarantined: %zu objects, %zu bytes\n"
+      "Total Quarantined: %zu\n"
+      "Total Verified: %zu\n"
+      "Skipped (Too Large): %zu\n"
+      "PARAMETER tcmalloc_sampled_quarantine_bytes %lld\n",
+      objects_.load(std::memory_order_relaxed), bytes(), quarantined_.value(),
+      verified_.value(), skipped_too_large_.value(),
+      static_cast<long long>(Parameters::sampled_quarantine_bytes()));
+}
+
+void SampledQuarantine::PrintInPbtxt(PbtxtRegion& region) const {
+  region.PrintI64("quarantined_objects",
+                  objects_.load(std::memory_order_relaxed));
+  region.PrintI64("quarantined_bytes", bytes());
+  region.PrintI64("total_quarantined", quarantined_.value());
+  region.PrintI64("total_verified", verified_.value());
+  region.PrintI64("skipped_too_large", skipped_too_large_.value());
+  region.PrintI64("tcmalloc_sampled_quarantine_bytes",
+                  Parameters::sampled_quarantine_bytes());
+}
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
@@ -0,0 +1,146 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TCMALLOC_SAMPLED_QUARANTINE_H_
+#define TCMALLOC_SAMPLED_QUARANTINE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/internal/spinlock.h"
+#include "absl/base/thread_annotations.h"
+#include "tcmalloc/common.h"
+#include "tcmalloc/internal/atomic_stats_counter.h"
+#include "tcmalloc/internal/config.h"
+#include "tcmalloc/internal/logging.h"
+#include "tcmalloc/internal/memory_tag.h"
+#include "tcmalloc/span.h"
+
+GOOGLE_MALLOC_SECTION_BEGIN
+namespace tcmalloc {
+namespace tcmalloc_internal {
+
+// Holds freed sampled objects for a while to catch writes after free.
+//
+// When enabled (Parameters::sampled_quarantine_bytes() > 0), a sampled object
+// of up to kMaxObjectSize that is not guarded by GWP-ASan is filled with a
+// pattern on free, and its span is kept out of the page heap in a bounded
+// per-CPU FIFO.  The byte budget is shared by all CPUs.  When the object is
+// evicted, to make room for newer ones or by ShrinkTo(), the pattern is
+// verified before the span is returned to the page heap.  A mismatch is
+// reported as a use-after-free with the allocation and deallocation stacks.
+//
+// Sampling probability grows with object size, so nearly every large object is
+// sampled.  Capping the object size, as GWP-ASan does, keeps the fill and the
+// scan to at most a page per sampled free.  Unlike GWP-ASan, reads after free
+// are not detected, and writes are detected only at eviction.
+class SampledQuarantine {
+ public:
+  // Bounds the objects held per CPU, so that the metadata for each CPU stays
+  // small however large the byte budget is.
+  static constexpr size_t kMaxObjectsPerCpu = 16;
+
+  // Larger objects are freed directly.
+  static constexpr size_t kMaxObjectSize = kPageSize;
+
+  // Byte written over quarantined objects.
+  static constexpr uint8_t kPattern = 0xf5;
+
+  constexpr SampledQuarantine() = default;
+
+  SampledQuarantine(const SampledQuarantine&) = delete;
+  SampledQuarantine& operator=(const SampledQuarantine&) = delete;
+
+  // Sets up one shard per CPU.  Must be called once before Quarantine().
+  void Init(int num_cpus) ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock);
+
+  // Returns true if freed sampled objects should be offered to Quarantine().
+  static bool enabled();
+
+  // Takes ownership of span, which holds the sampled object at ptr described
+  // by allocation.  Returns false, leaving span to the caller, if the
+  // quarantine is disabled, the object is larger than kMaxObjectSize, or it
+  // does not fit in the budget.  Older
+  // objects evicted to make room, this CPU's first, are verified and freed.
+  bool Quarantine(void* ptr, Span* span, MemoryTag tag,
+                  const StackTrace& allocation)
+      ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
+  // Verifies and frees the oldest objects of each CPU in turn until at most
+  // limit bytes are held.  ShrinkTo(0) releases everything.
+  void ShrinkTo(size_t limit) ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
+  // Returns the number of bytes currently held.
+  size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+  void Print(Printer& out) const;
+  void PrintInPbtxt(PbtxtRegion& region) const;
+
+ private:
+  struct Entry {
+    void* ptr;
+    size_t size;
+    Span* span;
+    MemoryTag tag;
+    size_t allocation_depth;
+    size_t deallocation_depth;
+    void* allocation_stack[kMaxStackDepth];
+    void* deallocation_stack[kMaxStackDepth];
+  };
+
+  struct Shard {
+    absl::base_internal::SpinLock lock{
+        absl::base_internal::SCHEDULE_KERNEL_ONLY};
+    // Ring of kMaxObjectsPerCpu entries, allocated on first use.
+    Entry* entries ABSL_GUARDED_BY(lock) = nullptr;
+    size_t head ABSL_GUARDED_BY(lock) = 0;  // Oldest entry.
+    size_t count ABSL_GUARDED_BY(lock) = 0;
+    size_t bytes ABSL_GUARDED_BY(lock) = 0;
+  };
+
+  int CurrentShard();
+
+  // Moves the oldest entry of shard to out.  The entry is verified and freed
+  // by VerifyAndFree, after shard.lock is released.
+  void PopOldest(Shard& shard, Entry& out)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard.lock);
+
+  // Moves the oldest entry of shard to out and returns true, or returns false
+  // if shard is empty.
+  bool TryPopOldest(Shard& shard, Entry& out) ABSL_LOCKS_EXCLUDED(shard.lock);
+
+  // Verifies the pattern of a popped entry and frees its span.
+  void VerifyAndFree(const Entry& e) ABSL_LOCKS_EXCLUDED(pageheap_lock);
+
+  Shard* shards_ = nullptr;
+  int num_shards_ = 0;
+
+  // Objects and bytes currently held across all shards.
+  std::atomic<size_t> objects_ = 0;
+  std::atomic<size_t> bytes_ = 0;
+
+  // Objects quarantined and verified since startup.
+  StatsCounter quarantined_;
+  StatsCounter verified_;
+  // Objects freed directly because they were larger than kMaxObjectSize or
+  // did not fit in the budget.
+  StatsCounter skipped_too_large_;
+};
+
+}  // namespace tcmalloc_internal
+}  // namespace tcmalloc
+GOOGLE_MALLOC_SECTION_END
+
+#endif  // TCMALLOC_SAMPLED_QUARANTINE_H_
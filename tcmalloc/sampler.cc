@@ -60,8 +60,18 @@ ABSL_ATTRIBUTE_NOINLINE void Sampler::Init(uint64_t seed) {
   for (int i = 0; i < 20; i++) {
     rnd_ = ExponentialBiased::NextRandom(rnd_);
   }
-  // Initialize counters
+  // Initialize counters.  Nothing has been recorded yet: the allocation that
+  // triggered initialization is subtracted by our caller.
   bytes_until_sample_ = PickNextSamplingPoint();
+  allocated_bytes_ = bytes_until_sample_;
+}
+
+// Starts a new sampling interval of "bytes" bytes, keeping
+// RecordedAllocatedBytes() unchanged.
+void Sampler::ResetBytesUntilSample(ssize_t bytes) {
+  allocated_bytes_ += static_cast<uint64_t>(bytes) -
+                      static_cast<uint64_t>(bytes_until_sample_);
+  bytes_until_sample_ = bytes;
 }
 
 ssize_t Sampler::PickNextSamplingPoint() {
@@ -149,7 +159,7 @@ size_t Sampler::RecordAllocationSlow(size_t k) {
           sample_interval_, bytes_until_sample_ + kIntervalOffset, &weight))) {
     weight = std::numeric_limits<ssize_t>::max();
   }
-  bytes_until_sample_ = PickNextSamplingPoint();
+  ResetBytesUntilSample(PickNextSamplingPoint());
   return GetSampleInterval() <= 0 ? 0 : weight;
 }
 
@@ -111,6 +111,21 @@ class Sampler {
   // Returns the current sample interval.
   static ssize_t GetSampleInterval();
 
+  // Returns the number of bytes recorded by RecordAllocation and its variants,
+  // i.e. the sum of (k + 1) over all recorded allocations of k bytes.
+  //
+  // Only the slow path maintains allocated_bytes_; the bytes consumed from the
+  // current sampling interval are recovered from bytes_until_sample_.
+  uint64_t RecordedAllocatedBytes() const {
+    return allocated_bytes_ - static_cast<uint64_t>(bytes_until_sample_);
+  }
+
+  // Returns the number of bytes credited via RecordFree.
+  uint64_t RecordedFreedBytes() const { return freed_bytes_; }
+
+  // Credits "k" bytes as freed by the owning thread.
+  void RecordFree(size_t k) { freed_bytes_ += k; }
+
   // The following are public for the purposes of testing
 
   // Used to ensure that the hot fields are collocated in the same cache line
@@ -122,6 +137,8 @@ class Sampler {
   constexpr Sampler()
       : sample_interval_(0),
         rnd_(0),
+        allocated_bytes_(0),
+        freed_bytes_(0),
         initialized_(false),
         bytes_until_sample_(0) {}
 
@@ -132,6 +149,13 @@ class Sampler {
   ssize_t sample_interval_;
 
   uint64_t rnd_;  // Cheap random number generator
+
+  // allocated_bytes_ - bytes_until_sample_ is the number of bytes recorded so
+  // far.  allocated_bytes_ is advanced by the full sampling interval whenever
+  // bytes_until_sample_ is reset, so the fast path never touches it.
+  uint64_t allocated_bytes_;
+  uint64_t freed_bytes_;
+
   bool initialized_;
 
   // Bytes until we sample next.
@@ -150,6 +174,7 @@ class Sampler {
   void Init(uint64_t seed);
 
   size_t RecordAllocationSlow(size_t k);
+  void ResetBytesUntilSample(ssize_t bytes);
   ssize_t GetGeometricVariable(ssize_t mean);
 };
 
@@ -19,6 +19,7 @@
 #include <cstdio>
 #include <cstring>
 #include <new>
+#include <utility>
 #include <vector>
 
 #include "absl/base/macros.h"
@@ -57,6 +58,25 @@ const SizeClasses& SizeMap::CurrentClasses() {
   TC_BUG("unreachable");
 }
 
+const SizeMap::ClassIndexTable* absl_nullable
+SizeMap::PrecomputedClassIndexTable(
+    absl::Span<const SizeClassInfo> size_classes) {
+  const std::pair<const SizeClasses*, const ClassIndexTable*> kBuiltin[] = {
+      {&kSizeClasses, &kSizeClassesIndex},
+      {&kExperimentalPow2SizeClasses, &kExperimentalPow2SizeClassesIndex},
+      {&kLegacySizeClasses, &kLegacySizeClassesIndex},
+      {&kReuseRelaxedBelow64SizeClasses,
+       &kReuseRelaxedBelow64SizeClassesIndex},
+  };
+  for (const auto& [classes, table] : kBuiltin) {
+    if (classes->classes.data() == size_classes.data() &&
+        classes->classes.size() == size_classes.size()) {
+      return table;
+    }
+  }
+  return nullptr;
+}
+
 bool SizeMap::CheckAssumptions() {
   bool failed = false;
   auto a = CurrentClasses().assumptions;
@@ -246,16 +266,23 @@ bool SizeMap::Init(absl::Span<const SizeClassInfo> size_classes) {
   }
 
   int next_size = 0;
-  for (int c = 1; c < kNumClasses; c++) {
-    const int max_size_in_class = class_to_size_[c];
+  if (const ClassIndexTable* table = PrecomputedClassIndexTable(size_classes);
+      table != nullptr) {
+    static_assert(sizeof(table->entries) ==
+                  kClassArraySize * sizeof(class_array_[0]));
+    memcpy(class_array_, table->entries, sizeof(table->entries));
+  } else {
+    for (int c = 1; c < kNumClasses; c++) {
+      const int max_size_in_class = class_to_size_[c];
 
-    for (int s = next_size; s <= max_size_in_class;
-         s += static_cast<size_t>(kAlignment)) {
-      class_array_[ClassIndex(s)] = c;
-    }
-    next_size = max_size_in_class + static_cast<size_t>(kAlignment);
-    if (next_size > kMaxSize) {
-      break;
+      for (int s = next_size; s <= max_size_in_class;
+           s += static_cast<size_t>(kAlignment)) {
+        class_array_[ClassIndex(s)] = c;
+      }
+      next_size = max_size_in_class + static_cast<size_t>(kAlignment);
+      if (next_size > kMaxSize) {
+        break;
+      }
     }
   }
 
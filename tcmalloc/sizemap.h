@@ -22,6 +22,7 @@
 #include <utility>
 
 #include "absl/base/attributes.h"
+#include "absl/base/nullability.h"
 #include "absl/base/optimization.h"
 #include "absl/numeric/bits.h"
 #include "absl/types/span.h"
@@ -134,8 +135,8 @@ class SizeMap {
   // If size is no more than kMaxSize, compute index of the
   // class_array[] entry for it, putting the class index in output
   // parameter idx and returning true. Otherwise return false.
-  ABSL_ATTRIBUTE_ALWAYS_INLINE static inline bool ClassIndexMaybe(size_t s,
-                                                                  size_t& idx) {
+  ABSL_ATTRIBUTE_ALWAYS_INLINE static constexpr bool ClassIndexMaybe(
+      size_t s, size_t& idx) {
     if (ABSL_PREDICT_TRUE(s <= kLargeSize)) {
       idx = (s + 7) >> 3;
       return true;
@@ -169,6 +170,43 @@ class SizeMap {
   size_t cold_sizes_count_ = 0;
 
  public:
+  // Size class for each ClassIndex(size) of the base (hot, partition 0) size
+  // classes, i.e. the contents of class_array_[0, kClassArraySize).
+  struct ClassIndexTable {
+    CompactSizeClass entries[kClassArraySize];
+  };
+
+  // Computes the ClassIndexTable for <size_classes>.  This is evaluated at
+  // compile time for the built-in size class configurations, so Init() only
+  // has to copy the table rather than visit every size up to kMaxSize.
+  static constexpr ClassIndexTable BuildClassIndexTable(
+      absl::Span<const SizeClassInfo> size_classes) {
+    ClassIndexTable table{};
+    const size_t num_classes = size_classes.size() < kNumBaseClasses
+                                   ? size_classes.size()
+                                   : kNumBaseClasses;
+    size_t next_size = 0;
+    for (size_t c = 1; c < num_classes; c++) {
+      const size_t max_size_in_class = size_classes[c].size;
+      for (size_t s = next_size; s <= max_size_in_class;
+           s += static_cast<size_t>(kAlignment)) {
+        size_t idx = 0;
+        if (!ClassIndexMaybe(s, idx)) break;
+        table.entries[idx] = c;
+      }
+      next_size = max_size_in_class + static_cast<size_t>(kAlignment);
+      if (next_size > kMaxSize) {
+        break;
+      }
+    }
+    return table;
+  }
+
+  // Returns the precomputed ClassIndexTable for <size_classes> if it is one of
+  // the built-in configurations, nullptr otherwise.
+  static const ClassIndexTable* absl_nullable PrecomputedClassIndexTable(
+      absl::Span<const SizeClassInfo> size_classes);
+
   // Returns size classes to use in the current process.
   static const SizeClasses& CurrentClasses();
 
@@ -343,6 +381,13 @@ class SizeMap {
                                              size_t num_objects_to_move);
 };
 
+// Precomputed class index tables for the size classes above, defined next to
+// them.
+extern const SizeMap::ClassIndexTable kSizeClassesIndex;
+extern const SizeMap::ClassIndexTable kExperimentalPow2SizeClassesIndex;
+extern const SizeMap::ClassIndexTable kLegacySizeClassesIndex;
+extern const SizeMap::ClassIndexTable kReuseRelaxedBelow64SizeClassesIndex;
+
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
 GOOGLE_MALLOC_SECTION_END
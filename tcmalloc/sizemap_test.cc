@@ -259,6 +259,30 @@ TEST(SizeMapTest, HeapPartitioningSizeZero) {
   }
 }
 
+TEST(SizeMapTest, PrecomputedClassIndexTable) {
+  for (const SizeClasses* sc : kAllSizeClassesConfigs) {
+    const auto& classes = sc->classes;
+    ASSERT_NE(SizeMap::PrecomputedClassIndexTable(classes), nullptr);
+
+    // A copy of the same size classes is not recognized as built-in, so it
+    // takes the runtime path through Init().
+    std::vector<SizeClassInfo> copy(classes.begin(), classes.end());
+    ASSERT_EQ(SizeMap::PrecomputedClassIndexTable(copy), nullptr);
+
+    SizeMap precomputed, computed;
+    ASSERT_TRUE(precomputed.Init(classes));
+    ASSERT_TRUE(computed.Init(copy));
+    for (size_t size = 0; size <= kMaxSize; ++size) {
+      ASSERT_EQ(precomputed.SizeClass(CppPolicy(), size),
+                computed.SizeClass(CppPolicy(), size))
+          << size;
+      ASSERT_EQ(precomputed.SizeClass(MallocPolicy(), size),
+                computed.SizeClass(MallocPolicy(), size))
+          << size;
+    }
+  }
+}
+
 TEST(SizeMapTest, SpecificClassRanges) {
   // Verify kReuseRelaxedBelow64SizeClasses (with 24/48)
   {
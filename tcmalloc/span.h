@@ -60,9 +60,18 @@ enum AccessDensityPrediction {
   kPredictionCounts
 };
 
+enum SpanLifetimePrediction {
+  // Predict that the span would outlive recently freed spans of its size class.
+  kLongLived = 0,
+  // Predict that the span would be freed soon after it is allocated.
+  kShortLived = 1,
+  kLifetimePredictionCounts
+};
+
 struct SpanAllocInfo {
   size_t objects_per_span;
   AccessDensityPrediction density;
+  SpanLifetimePrediction lifetime = SpanLifetimePrediction::kLongLived;
 };
 
 // Information kept for a span (a contiguous run of pages).
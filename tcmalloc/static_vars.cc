@@ -16,6 +16,7 @@
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 
@@ -23,6 +24,7 @@
 #include "absl/base/const_init.h"
 #include "absl/base/internal/spinlock.h"
 #include "absl/base/optimization.h"
+#include "absl/strings/numbers.h"
 #include "absl/types/span.h"
 #include "tcmalloc/allocation_sample.h"
 #include "tcmalloc/arena.h"
@@ -53,6 +55,7 @@
 #include "tcmalloc/pagemap.h"
 #include "tcmalloc/parameters.h"
 #include "tcmalloc/peak_heap_tracker.h"
+#include "tcmalloc/sampled_quarantine.h"
 #include "tcmalloc/sizemap.h"
 #include "tcmalloc/span.h"
 #include "tcmalloc/stack_trace_table.h"
@@ -104,6 +107,7 @@ ABSL_CONST_INIT std::atomic<bool> Static::cpu_cache_active_{false};
 ABSL_CONST_INIT Static::PageAllocatorStorage Static::page_allocator_;
 ABSL_CONST_INIT PageMap Static::pagemap_;
 ABSL_CONST_INIT GuardedPageAllocator Static::guardedpage_allocator_;
+ABSL_CONST_INIT SampledQuarantine Static::sampled_quarantine_;
 ABSL_CONST_INIT NumaTopology<kNumaPartitions, kNumBaseClasses>
     Static::numa_topology_;
 ABSL_CONST_INIT GwpAsanState Static::gwp_asan_state_;
@@ -143,10 +147,10 @@ size_t Static::metadata_bytes() {
       sizeof(sampled_internal_fragmentation_) + sizeof(total_sampled_count_) +
       sizeof(allocation_samples) + sizeof(deallocation_samples) +
       sizeof(sampled_alloc_handle_generator) + sizeof(peak_heap_tracker_) +
-      sizeof(guardedpage_allocator_) + sizeof(numa_topology_) +
-      sizeof(CacheTopology::Instance()) + sizeof(gwp_asan_state_) +
-      sizeof(per_size_class_counts_) + sizeof(system_allocator_) +
-      sizeof(kInvalidSpan);
+      sizeof(guardedpage_allocator_) + sizeof(sampled_quarantine_) +
+      sizeof(numa_topology_) + sizeof(CacheTopology::Instance()) +
+      sizeof(gwp_asan_state_) + sizeof(per_size_class_counts_) +
+      sizeof(system_allocator_) + sizeof(kInvalidSpan);
   // LINT.ThenChange(:static_vars)
 
   const size_t internal_dependencies_size = sizeof(PerCpuState::state());
@@ -206,6 +210,20 @@ SizeClassConfiguration Static::size_class_configuration() {
   return SizeClassConfiguration::kReuseRelaxedBelow64;
 }
 
+// Returns the size of the guarded sampling pool, in pages.  Canary jobs that
+// want more concurrently guarded allocations can raise it with
+// TCMALLOC_GUARDED_SAMPLING_PAGES, up to GuardedPageAllocator::kGpaMaxPages.
+static size_t GuardedSamplingPages() {
+  constexpr size_t kDefaultPages = 128;
+  const char* e = thread_safe_getenv("TCMALLOC_GUARDED_SAMPLING_PAGES");
+  if (e == nullptr) return kDefaultPages;
+  size_t pages;
+  if (!absl::SimpleAtoi(e, &pages) || pages == 0) {
+    TC_BUG("bad TCMALLOC_GUARDED_SAMPLING_PAGES env var '%s'", e);
+  }
+  return std::min(pages, GuardedPageAllocator::kGpaMaxPages);
+}
+
 ABSL_ATTRIBUTE_COLD ABSL_ATTRIBUTE_NOINLINE void Static::SlowInitIfNecessary() {
   PageHeapSpinLockHolder l;
 
@@ -237,8 +255,13 @@ ABSL_ATTRIBUTE_COLD ABSL_ATTRIBUTE_NOINLINE void Static::SlowInitIfNecessary() {
     // state.
     sharded_transfer_cache_.Init();
     new (page_allocator_.memory) PageAllocator;
-    guardedpage_allocator_.Init(/*max_allocated_pages=*/64,
-                                /*total_pages=*/128);
+    // Allow half of the pool to be live at once, so that freed slots are not
+    // immediately reused.
+    const size_t guarded_pages = GuardedSamplingPages();
+    guardedpage_allocator_.Init(
+        /*max_allocated_pages=*/std::max<size_t>(guarded_pages / 2, 1),
+        /*total_pages=*/guarded_pages);
+    sampled_quarantine_.Init(NumCPUsMaybe().value_or(1));
 
     inited_.store(true, std::memory_order_release);
   }
@@ -48,6 +48,7 @@
 #include "tcmalloc/pages.h"
 #include "tcmalloc/parameters.h"
 #include "tcmalloc/peak_heap_tracker.h"
+#include "tcmalloc/sampled_quarantine.h"
 #include "tcmalloc/sizemap.h"
 #include "tcmalloc/span.h"
 #include "tcmalloc/stack_trace_table.h"
@@ -133,6 +134,8 @@ class Static final {
     return guardedpage_allocator_;
   }
 
+  static SampledQuarantine& sampled_quarantine() { return sampled_quarantine_; }
+
   static MetadataObjectAllocator<SampledAllocation>&
   sampledallocation_allocator() {
     return sampledallocation_allocator_;
@@ -227,6 +230,7 @@ class Static final {
   ABSL_CONST_INIT static ShardedTransferCacheManager sharded_transfer_cache_;
   ABSL_CONST_INIT static CpuCache<Static> cpu_cache_;
   ABSL_CONST_INIT static GuardedPageAllocator guardedpage_allocator_;
+  ABSL_CONST_INIT static SampledQuarantine sampled_quarantine_;
   static MetadataObjectAllocator<SampledAllocation>
       sampledallocation_allocator_;
   static MetadataObjectAllocator<Span> span_allocator_;
@@ -169,6 +169,27 @@ struct PageReleaseStats {
   }
 };
 
+// Counts of the NUMA nodes found backing sampled, highly utilized hugepages of
+// a NUMA partition, and of the migrations of those found on remote nodes.
+struct NumaPlacementStats {
+  // Hugepages backed by a node of their partition.
+  size_t hits = 0;
+  // Hugepages backed by a node of another partition.
+  size_t misses = 0;
+  // Remote hugepages moved to a node of their partition, and those that could
+  // not be moved.
+  size_t migrated = 0;
+  size_t migration_failures = 0;
+
+  constexpr NumaPlacementStats& operator+=(const NumaPlacementStats& other) {
+    hits += other.hits;
+    misses += other.misses;
+    migrated += other.migrated;
+    migration_failures += other.migration_failures;
+    return *this;
+  }
+};
+
 class PageAllocInfo {
  private:
   struct Counts;
@@ -84,6 +84,7 @@
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "tcmalloc/alloc_at_least.h"
 #include "tcmalloc/allocation_sample.h"
@@ -96,7 +97,9 @@
 #include "tcmalloc/global_stats.h"
 #include "tcmalloc/guarded_allocations.h"
 #include "tcmalloc/guarded_page_allocator.h"
+#include "tcmalloc/huge_page_tracker.h"
 #include "tcmalloc/internal/allocation_guard.h"
+#include "tcmalloc/internal/clock.h"
 #include "tcmalloc/internal/config.h"
 #include "tcmalloc/internal/is_aligned_to.h"
 #include "tcmalloc/internal/logging.h"
@@ -104,12 +107,16 @@
 #include "tcmalloc/internal/optimization.h"
 #include "tcmalloc/internal/overflow.h"
 #include "tcmalloc/internal/page_allocation_status.h"
+#include "tcmalloc/internal/page_allocator_hooks.h"
+#include "tcmalloc/internal/page_heap_tracer.h"
 #include "tcmalloc/internal/page_size.h"
 #include "tcmalloc/internal/percpu.h"
 #include "tcmalloc/internal/range_tracker.h"
 #include "tcmalloc/internal/sampled_allocation.h"
+#include "tcmalloc/internal/sysinfo.h"
 #include "tcmalloc/internal/system_allocator.h"
 #include "tcmalloc/internal_malloc_extension.h"
+#include "tcmalloc/internal_malloc_tracing_extension.h"
 #include "tcmalloc/malloc_extension.h"
 #include "tcmalloc/malloc_hook.h"
 #include "tcmalloc/malloc_tracing_extension.h"
@@ -119,6 +126,7 @@
 #include "tcmalloc/pagemap.h"
 #include "tcmalloc/pages.h"
 #include "tcmalloc/parameters.h"
+#include "tcmalloc/sampled_quarantine.h"
 #include "tcmalloc/sampler.h"
 #include "tcmalloc/segv_handler.h"
 #include "tcmalloc/span.h"
@@ -308,7 +316,9 @@ MallocExtension_Internal_StartEventTracing() {
 MallocExtension::Ownership GetOwnership(const void* ptr) {
   const PageId p = PageIdContainingTagged(ptr);
   Span* span = tc_globals.pagemap().GetDescriptor(p);
-  if (span != nullptr && span != &tc_globals.invalid_span()) {
+  if (span != nullptr
+          ? span != &tc_globals.invalid_span()
+          : tc_globals.pagemap().GetCompactLargeSpan(p).has_value()) {
     return MallocExtension::Ownership::kOwned;
   } else {
     return MallocExtension::Ownership::kNotOwned;
@@ -341,6 +351,37 @@ extern "C" void MallocExtension_Internal_SetMemoryLimit(
       limit, static_cast<PageAllocator::LimitKind>(limit_kind));
 }
 
+static_assert(
+    static_cast<int>(tcmalloc::MallocExtension::HardLimitAction::kAbort) ==
+    PageAllocator::kAbort);
+static_assert(static_cast<int>(
+                  tcmalloc::MallocExtension::HardLimitAction::kFailAllocation) ==
+              PageAllocator::kFailAllocation);
+
+extern "C" tcmalloc::MallocExtension::HardLimitAction
+MallocExtension_Internal_GetHardLimitAction() {
+  return static_cast<tcmalloc::MallocExtension::HardLimitAction>(
+      tc_globals.page_allocator().hard_limit_action());
+}
+
+extern "C" void MallocExtension_Internal_SetHardLimitAction(
+    tcmalloc::MallocExtension::HardLimitAction action) {
+  tc_globals.page_allocator().set_hard_limit_action(
+      static_cast<PageAllocator::HardLimitAction>(action));
+}
+
+extern "C" bool MallocExtension_Internal_AddMemoryLimitCallback(
+    tcmalloc::MallocExtension::LimitKind limit_kind, double fraction,
+    tcmalloc::MallocExtension::MemoryLimitCallback callback) {
+  return tc_globals.page_allocator().limit_notifier().Add(limit_kind, fraction,
+                                                          callback);
+}
+
+extern "C" bool MallocExtension_Internal_RemoveMemoryLimitCallback(
+    tcmalloc::MallocExtension::MemoryLimitCallback callback) {
+  return tc_globals.page_allocator().limit_notifier().Remove(callback);
+}
+
 extern "C" void MallocExtension_Internal_MarkThreadIdle() {
   ThreadCache::BecomeIdle();
 }
@@ -416,6 +457,17 @@ extern "C" MallocExtension::Ownership MallocExtension_Internal_GetOwnership(
   return GetOwnership(ptr);
 }
 
+extern "C" bool MallocExtension_Internal_ShouldRelocate(const void* ptr) {
+  if (ptr == nullptr) return false;
+  const PageId p = PageIdContainingTagged(ptr);
+  if (!tc_globals.pagemap().HasLeaf(p)) return false;
+  // Only hugepages owned by a HugePageFiller have a PageTracker.  Trackers are
+  // never unmapped, so reading a stale one is harmless.
+  const auto* pt =
+      static_cast<const PageTracker*>(tc_globals.pagemap().GetHugepage(p));
+  return pt != nullptr && pt->relocation_donor();
+}
+
 extern "C" void MallocExtension_Internal_GetProperties(
     tcmalloc::MallocExtension::PropertyMap* result) {
   TCMallocStats stats;
@@ -499,6 +551,8 @@ extern "C" void MallocExtension_Internal_GetProperties(
   (*result)["tcmalloc.successful_shrinks_after_hard_limit_hit"].value =
       tc_globals.page_allocator().successful_shrinks_after_limit_hit(
           PageAllocator::kHard);
+  (*result)["tcmalloc.hard_limit_failed_allocations"].value =
+      tc_globals.page_allocator().hard_limit_failed_allocations();
 
   (*result)["tcmalloc.num_released_total_bytes"].value =
       stats.num_released_total.in_bytes();
@@ -510,6 +564,11 @@ extern "C" void MallocExtension_Internal_GetProperties(
       stats.num_released_soft_limit_exceeded.in_bytes();
   (*result)["tcmalloc.num_released_hard_limit_exceeded_bytes"].value =
       stats.num_released_hard_limit_exceeded.in_bytes();
+  (*result)["tcmalloc.numa_hits"].value = stats.numa_placement.hits;
+  (*result)["tcmalloc.numa_misses"].value = stats.numa_placement.misses;
+  (*result)["tcmalloc.numa_migrated"].value = stats.numa_placement.migrated;
+  (*result)["tcmalloc.numa_migration_failures"].value =
+      stats.numa_placement.migration_failures;
   (*result)["tcmalloc.security_partitioning_active"].value =
       kSecurityPartitions > 1
           ? static_cast<int>(Parameters::heap_partitioning_mode())
@@ -553,6 +612,18 @@ inline size_t GetLargeSize(const void* ptr, const Span& span) {
   return GetLargeSizeAndSampled(ptr, span).size;
 }
 
+// Returns the CompactLargeSpan starting at p, the page containing ptr, whose
+// pagemap entry holds no Span.  Reports ptr as corrupted if there is none.
+inline CompactLargeSpan GetCompactLargeSpanOrReport(const void* ptr,
+                                                    PageId p) {
+  std::optional<CompactLargeSpan> large =
+      tc_globals.pagemap().GetCompactLargeSpan(p);
+  if (ABSL_PREDICT_FALSE(!large.has_value())) {
+    ReportCorruptedFree(tc_globals, ptr);
+  }
+  return *large;
+}
+
 inline SizeAndSampled GetSizeAndSampled(const void* ptr) {
   if (ptr == nullptr) return SizeAndSampled{0, false};
   const PageId p = PageIdContainingTagged(ptr);
@@ -561,8 +632,10 @@ inline SizeAndSampled GetSizeAndSampled(const void* ptr) {
   if (size_class != 0) {
     return SizeAndSampled{tc_globals.sizemap().class_to_size(size_class),
                           false};
-  } else if (ABSL_PREDICT_FALSE(span == nullptr)) {
-    ReportCorruptedFree(tc_globals, ptr);
+  } else if (span == nullptr) {
+    // Large allocations that are not sampled have no Span.
+    return SizeAndSampled{
+        GetCompactLargeSpanOrReport(ptr, p).num_pages.in_bytes(), false};
   } else if (ABSL_PREDICT_FALSE(span == &tc_globals.invalid_span())) {
     ReportDoubleFree(tc_globals, ptr);
   } else {
@@ -641,6 +714,19 @@ inline sized_ptr_t do_malloc_pages(size_t size, size_t weight, Policy policy) {
   } else if (tc_globals.active_partitions() > 1) {
     tag = MultiNormalTag(policy.partition());
   }
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
+  if (weight == 0) {
+    // Only sampled allocations need a Span; the pagemap records the length of
+    // the others.
+    PageAllocatorInterface::AllocationState s =
+        tc_globals.page_allocator().NewLarge(
+            num_pages, BytesToLengthCeil(policy.align()),
+            {1, AccessDensityPrediction::kSparse}, tag);
+    if (!s) return {nullptr, 0};
+    TC_ASSERT(!ColdFeatureActive() || tag == GetMemoryTag(s.r.p.start_addr()));
+    return {s.r.p.start_addr(), num_pages.in_bytes()};
+  }
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
   Span* span = tc_globals.page_allocator().NewAligned(
       num_pages, BytesToLengthCeil(policy.align()),
       {1, AccessDensityPrediction::kSparse}, tag);
@@ -660,13 +746,49 @@ inline sized_ptr_t do_malloc_pages(size_t size, size_t weight, Policy policy) {
   return res;
 }
 
+// Returns the pages of a large allocation to the page allocator.  The first
+// <unbacked> of them were remapped away by MoveAndFreeAllocation.
+static void DeleteLargePages(PageAllocatorInterface::AllocationState a,
+                             MemoryTag tag, Length unbacked)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(pageheap_lock) {
+  constexpr SpanAllocInfo kInfo = {
+      .objects_per_span = 1, .density = AccessDensityPrediction::kSparse};
+  if (ABSL_PREDICT_FALSE(unbacked > Length(0))) {
+    tc_globals.page_allocator().DeleteMoved(a, tag, unbacked, kInfo);
+  } else {
+    tc_globals.page_allocator().Delete(a, tag, kInfo);
+  }
+}
+
+// Frees the large allocation at ptr, which starts page p and has no Span.
+template <typename Policy>
+static void FreeCompactLargeSpan(void* ptr, std::optional<size_t> size,
+                                 Policy policy, PageId p, Length unbacked) {
+  const CompactLargeSpan large = GetCompactLargeSpanOrReport(ptr, p);
+  if (ABSL_PREDICT_FALSE(ptr != p.start_addr())) {
+    ReportCorruptedFree(tc_globals, static_cast<std::align_val_t>(kPageSize),
+                        ptr);
+  }
+  const size_t bytes = large.num_pages.in_bytes();
+  MallocHook::InvokeDeleteHook({ptr, size, bytes, HookMemoryMutable::kMutable});
+  CheckUnsampledLargeSize(tc_globals, policy, ptr, size, bytes);
+
+  PageHeapSpinLockHolder l;
+  DeleteLargePages({Range(p, large.num_pages), large.donated},
+                   GetMemoryTag(ptr), unbacked);
+}
+
 // Handles freeing object that doesn't have size class, i.e. which
 // is either large or sampled. We explicitly prevent inlining it to
 // keep it out of fast-path. This helps avoid expensive
 // prologue/epilogue for fast-path freeing functions.
+//
+// <unbacked> is the number of leading pages that MoveAndFreeAllocation
+// remapped away.
 template <typename Policy>
 ABSL_ATTRIBUTE_NOINLINE static void InvokeHooksAndFreePages(
-    void* ptr, std::optional<size_t> size, Policy policy) {
+    void* ptr, std::optional<size_t> size, Policy policy,
+    Length unbacked = Length(0)) {
   const PageId p = PageIdContaining(ptr);
 
   // We use GetDescriptor rather than GetExistingDescriptor here, since `ptr`
@@ -674,15 +796,17 @@ ABSL_ATTRIBUTE_NOINLINE static void InvokeHooksAndFreePages(
   // cost of the lookup comes from pointer chasing, so the well-predicted
   // branches have minimal cost anyways.
   auto [span, size_class] = tc_globals.pagemap().GetDescriptorAndSizeClass(p);
-  // We have two potential failure modes here:
+  // Large allocations that are not sampled have no Span.  Otherwise, we have
+  // two potential failure modes here:
   // * span is nullptr:  We are freeing a pointer to a page which we have never
   //                     allocated as part of the first page of a Span (an
   //                     interior pointer, it's corrupted, etc.) or our data
-  //                     structures are corrupt.
+  //                     structures are corrupt.  FreeCompactLargeSpan reports
+  //                     these.
   // * span is invalid:  We double-freed the span.  In the page heap, we set the
   //                     descriptor on Delete(span) to a sentinel.
-  if (ABSL_PREDICT_FALSE(span == nullptr)) {
-    ReportCorruptedFree(tc_globals, ptr);
+  if (span == nullptr) {
+    return FreeCompactLargeSpan(ptr, size, policy, p, unbacked);
   } else if (ABSL_PREDICT_FALSE(span == &tc_globals.invalid_span())) {
     ReportDoubleFree(tc_globals, ptr);
   }
@@ -707,6 +831,14 @@ ABSL_ATTRIBUTE_NOINLINE static void InvokeHooksAndFreePages(
         {ptr, size, GetLargeSize(ptr, *span), HookMemoryMutable::kMutable});
   }
 
+  // MaybeUnsampleAllocation releases the sample, so keep the allocation stack
+  // for the quarantine's report.
+  std::optional<StackTrace> quarantine_sample;
+  if (ABSL_PREDICT_FALSE(!is_gwp_asan_ptr && span->sampled()) &&
+      SampledQuarantine::enabled()) {
+    quarantine_sample.emplace(span->sampled_allocation().sampled_stack);
+  }
+
   MaybeUnsampleAllocation(tc_globals, policy, ptr, size, *span);
 
   if (ABSL_PREDICT_FALSE(size_class != 0)) {
@@ -733,22 +865,29 @@ ABSL_ATTRIBUTE_NOINLINE static void InvokeHooksAndFreePages(
       ReportCorruptedFree(tc_globals, static_cast<std::align_val_t>(kPageSize),
                           ptr);
     }
+    if (quarantine_sample.has_value() &&
+        tc_globals.sampled_quarantine().Quarantine(
+            ptr, span, GetMemoryTag(ptr), *quarantine_sample)) {
+      return;
+    }
 #ifdef TCMALLOC_INTERNAL_LEGACY_LOCKING
     PageHeapSpinLockHolder l;
-    tc_globals.page_allocator().Delete(
-        span, GetMemoryTag(ptr),
-        {.objects_per_span = 1, .density = AccessDensityPrediction::kSparse});
-#else
+    if (ABSL_PREDICT_TRUE(unbacked == Length(0))) {
+      tc_globals.page_allocator().Delete(
+          span, GetMemoryTag(ptr),
+          {.objects_per_span = 1, .density = AccessDensityPrediction::kSparse});
+      return;
+    }
+#endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
     PageAllocatorInterface::AllocationState a{
         Range(p, span->num_pages()),
         span->donated(),
     };
     Span::Delete(span);
+#ifndef TCMALLOC_INTERNAL_LEGACY_LOCKING
     PageHeapSpinLockHolder l;
-    tc_globals.page_allocator().Delete(
-        a, GetMemoryTag(ptr),
-        {.objects_per_span = 1, .density = AccessDensityPrediction::kSparse});
 #endif  // TCMALLOC_INTERNAL_LEGACY_LOCKING
+    DeleteLargePages(a, GetMemoryTag(ptr), unbacked);
   }
   // We expect to crash in GuardedPageAllocator::Delete or in
   // ReportCorruptedFree if the pointer was invalid.  We shouldn't make it here.
@@ -764,14 +903,15 @@ static constexpr uintptr_t kBadDeallocationHighMask =
     ~((uintptr_t{1} << kAddressBits) - 1u);
 static constexpr uintptr_t kBadAlignmentMask =
     static_cast<uintptr_t>(kAlignment) - 1u;
-// kNormalMask covers both kNormal and kNormalP1 because they share an
-// overlapping tag bit.  This is the same property IsNormalMemory relies on.
+// kNormalMask covers the tags of all normal partitions because they share the
+// kNormal tag bit.  This is the same property IsNormalMemory relies on.
 static constexpr uintptr_t kNormalMask =
     static_cast<uintptr_t>(MemoryTag::kNormal) << kTagShift;
 static constexpr uintptr_t kColdMask = static_cast<uintptr_t>(MemoryTag::kCold)
                                        << kTagShift;
+static_assert(IsNormalTag(NormalTag(kNormalPartitions - 1)));
 static_assert((static_cast<uintptr_t>(MemoryTag::kNormal) &
-               static_cast<uintptr_t>(MemoryTag::kNormalP1)) != 0);
+               static_cast<uintptr_t>(NormalTag(kNormalPartitions - 1))) != 0);
 
 static constexpr uintptr_t kNormalOrBadDeallocationMask =
     kBadDeallocationHighMask | kNormalMask | kBadAlignmentMask;
@@ -809,8 +949,8 @@ inline ABSL_ATTRIBUTE_ALWAYS_INLINE void do_free(void* ptr, Policy policy) {
 
   // We need to check for nullptr to avoid a PageMap walk that will not find a
   // leaf successfully (and segfault).  We overload this check because most
-  // objects will be tagged kNormal/kNormalP1, allowing us to keep most
-  // deallocations on the fast path with only 1 branch.
+  // objects will be tagged with the tag of a normal partition, allowing us to
+  // keep most deallocations on the fast path with only 1 branch.
   //
   // For more rare cases (actual bugs, non-normal, etc.), we can go to a
   // slightly slower path to handle those, in order to look for clearly
@@ -849,8 +989,7 @@ ABSL_ATTRIBUTE_NOINLINE static void handle_sampled_or_illformed_ptrs(
   auto tag = GetMemoryTag(ptr);
   const uintptr_t uptr = absl::bit_cast<uintptr_t>(ptr);
   TC_ASSERT((uptr & (kBadAlignmentMask | kBadDeallocationHighMask)) != 0 ||
-            (tag != MemoryTag::kNormal && tag != MemoryTag::kNormalP1 &&
-             tag != MemoryTag::kCold));
+            (!IsNormalTag(tag) && tag != MemoryTag::kCold));
 
   if (ABSL_PREDICT_TRUE(IsSampledMemory(ptr))) {
     // we don't know true class size of the ptr
@@ -1012,16 +1151,19 @@ bool CorrectSize(const void* ptr, const size_t provided_size, Policy policy) {
   if (ABSL_PREDICT_TRUE(size_class != 0)) {
     std::tie(minimum_size, maximum_size) =
         tc_globals.sizemap().class_to_size_range(size_class);
-  } else if (ABSL_PREDICT_FALSE(span == nullptr)) {
-    ReportCorruptedFree(tc_globals, ptr);
   } else if (ABSL_PREDICT_FALSE(span == &tc_globals.invalid_span())) {
     ReportDoubleFree(tc_globals, ptr);
   } else {
-    if (tc_globals.guardedpage_allocator().PointerIsMine(ptr)) {
+    if (span != nullptr &&
+        tc_globals.guardedpage_allocator().PointerIsMine(ptr)) {
       minimum_size = maximum_size =
           tc_globals.guardedpage_allocator().GetRequestedSize(ptr);
     } else {
-      maximum_size = span->bytes_in_span();
+      // Large allocations that are not sampled have no Span.
+      maximum_size =
+          span != nullptr
+              ? span->bytes_in_span()
+              : GetCompactLargeSpanOrReport(ptr, p).num_pages.in_bytes();
       minimum_size = maximum_size - kPageSize + 1;
       if (ABSL_PREDICT_FALSE(static_cast<size_t>(policy.align()) > kPageSize) &&
           maximum_size == kPageSize) {
@@ -1092,8 +1234,10 @@ bool CorrectAlignment(void* ptr, std::align_val_t alignment) {
     // bound on the possible alignment.  No size class-ful size can have more
     // than a page of alignment, though.
     align = std::max(align, std::min(size & -size, kPageSize));
-  } else if (ABSL_PREDICT_FALSE(span == nullptr)) {
-    ReportCorruptedFree(tc_globals, ptr);
+  } else if (span == nullptr) {
+    // Large allocations that are not sampled have no Span.
+    GetCompactLargeSpanOrReport(ptr, p);
+    align = std::max(align, kPageSize);
   } else if (ABSL_PREDICT_FALSE(span == &tc_globals.invalid_span())) {
     ReportDoubleFree(tc_globals, ptr);
   } else if (!tc_globals.guardedpage_allocator().PointerIsMine(ptr)) {
@@ -1163,6 +1307,119 @@ inline struct mallinfo2 do_mallinfo2() {
 }
 #endif
 
+// Serializes starting and stopping page heap tracing.
+ABSL_CONST_INIT absl::base_internal::SpinLock page_heap_tracing_lock(
+    absl::base_internal::SCHEDULE_KERNEL_ONLY);
+
+// Page allocator hooks that feed span allocations to page_heap_tracer.  They
+// are only installed while tracing runs.
+void TracePageHeapNew(size_t start_page_index, size_t n, size_t align,
+                      size_t objects_per_span, uint8_t density, MemoryTag tag) {
+  if (start_page_index == 0) return;
+  page_heap_tracer.Record(PageHeapEventType::kNew, tag,
+                          start_page_index << kPageShift, n << kPageShift);
+}
+
+void TracePageHeapDelete(size_t start_page_index, size_t n,
+                         size_t objects_per_span, uint8_t density,
+                         MemoryTag tag) {
+  page_heap_tracer.Record(PageHeapEventType::kDelete, tag,
+                          start_page_index << kPageShift, n << kPageShift);
+}
+
+absl::Status StartPageHeapTracing(size_t events_per_cpu) {
+  // Bounds the buffers to 1 MiB per CPU.
+  constexpr size_t kMaxEventsPerCpu = 1 << 15;
+  if (events_per_cpu == 0 || events_per_cpu > kMaxEventsPerCpu) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "events_per_cpu must be in [1, ", kMaxEventsPerCpu, "]"));
+  }
+  events_per_cpu = absl::bit_ceil(events_per_cpu);
+
+  tc_globals.InitIfNecessary();
+  AllocationGuardSpinLockHolder l(page_heap_tracing_lock);
+  if (!page_heap_tracer.initialized()) {
+    const int num_cpus = NumCPUs();
+    void* buffer = tc_globals.arena().Alloc(
+        PageHeapTracer::BufferSize(num_cpus, events_per_cpu),
+        std::align_val_t{ABSL_CACHELINE_SIZE});
+    page_heap_tracer.Init(buffer, num_cpus, events_per_cpu);
+  } else if (events_per_cpu > page_heap_tracer.events_per_cpu()) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("Page heap tracing buffers already hold ",
+                     page_heap_tracer.events_per_cpu(), " events per CPU"));
+  }
+  if (page_heap_tracer.enabled()) return absl::OkStatus();
+
+  if (!page_allocator_new_hooks.Add(&TracePageHeapNew)) {
+    return absl::ResourceExhaustedError("Too many page allocator hooks");
+  }
+  if (!page_allocator_delete_hooks.Add(&TracePageHeapDelete)) {
+    TC_CHECK(page_allocator_new_hooks.Remove(&TracePageHeapNew));
+    return absl::ResourceExhaustedError("Too many page allocator hooks");
+  }
+  page_heap_tracer.Start();
+  return absl::OkStatus();
+}
+
+absl::Status StopPageHeapTracing() {
+  AllocationGuardSpinLockHolder l(page_heap_tracing_lock);
+  if (!page_heap_tracer.enabled()) return absl::OkStatus();
+
+  page_heap_tracer.Stop();
+  TC_CHECK(page_allocator_new_hooks.Remove(&TracePageHeapNew));
+  TC_CHECK(page_allocator_delete_hooks.Remove(&TracePageHeapDelete));
+  return absl::OkStatus();
+}
+
+absl::StatusOr<malloc_tracing_extension::PageHeapEvents>
+DrainPageHeapEvents() {
+  using malloc_tracing_extension::PageHeapEvent;
+
+  if (!page_heap_tracer.initialized()) {
+    return absl::FailedPreconditionError("Page heap tracing was never started");
+  }
+
+  // Convert ticks to wall time relative to a single reference point.
+  const Clock& clock = page_heap_tracer.clock();
+  const double freq = clock.freq();
+  const int64_t now_ticks = clock.now();
+  const absl::Time now = absl::Now();
+
+  // Drain through a small buffer on the stack rather than one sized for
+  // every CPU's ring.  Stop after a full ring's worth, so that a steady
+  // stream of new events cannot keep us here.
+  constexpr size_t kChunk = 128;
+  PageHeapTraceEvent chunk[kChunk];
+  const size_t limit = page_heap_tracer.capacity();
+  malloc_tracing_extension::PageHeapEvents result;
+  result.dropped = 0;
+  for (size_t total = 0; total < limit;) {
+    const PageHeapTracer::DrainResult drained = page_heap_tracer.Drain(
+        absl::MakeSpan(chunk, std::min(kChunk, limit - total)));
+    result.dropped += drained.dropped;
+    total += drained.events;
+    for (size_t i = 0; i < drained.events; ++i) {
+      const PageHeapTraceEvent& e = chunk[i];
+      PageHeapEvent& out = result.events.emplace_back();
+      out.type = static_cast<PageHeapEvent::Type>(e.type);
+      out.time = now - absl::Seconds((now_ticks - e.ticks) / freq);
+      out.heap = MemoryTagToLabel(e.tag);
+      out.start_addr = e.start_addr;
+      out.size = e.bytes;
+    }
+    // A short chunk means every CPU's ring is empty.
+    if (drained.events < kChunk) break;
+  }
+
+  // Each CPU's events are in order, but the buffers need merging.
+  std::stable_sort(result.events.begin(), result.events.end(),
+                   [](const PageHeapEvent& a, const PageHeapEvent& b) {
+                     return a.time < b.time;
+                   });
+  return result;
+}
+
 }  // namespace
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
@@ -1308,6 +1565,112 @@ static inline Pointer ABSL_ATTRIBUTE_ALWAYS_INLINE fast_alloc(size_t size,
   return Policy::to_pointer(ret, size_class);
 }
 
+// Tries to grow the page allocation at ptr to new_size bytes by taking the
+// free pages that follow it.  Returns false, leaving the allocation unchanged,
+// if ptr is not a whole-span allocation or its neighbor is in use.
+//
+// Sampled allocations are resampled at their new size, just as reallocating
+// them would.
+static bool TryGrowInPlace(void* ptr, size_t new_size, TokenId token_id) {
+  if (!IsNormalMemory(ptr) ||
+      tc_globals.guardedpage_allocator().PointerIsMine(ptr)) {
+    return false;
+  }
+  const PageId p = PageIdContaining(ptr);
+  auto [span, size_class] = tc_globals.pagemap().GetDescriptorAndSizeClass(p);
+  if (size_class != 0 || ptr != p.start_addr()) return false;
+  PageAllocatorInterface::AllocationState s;
+  if (span != nullptr) {
+    if (ptr != span->start_address()) return false;
+    s = {Range(p, span->num_pages()), span->donated()};
+  } else if (std::optional<CompactLargeSpan> large =
+                 tc_globals.pagemap().GetCompactLargeSpan(p);
+             large.has_value()) {
+    s = {Range(p, large->num_pages), large->donated};
+  } else {
+    return false;
+  }
+  const Length n = BytesToLengthCeil(new_size);
+  if (n <= s.r.n) return false;
+
+  if (!tc_globals.page_allocator().TryGrow(
+          s, n, {1, AccessDensityPrediction::kSparse}, GetMemoryTag(ptr))) {
+    return false;
+  }
+
+  if (span != nullptr) {
+    // Unsampling restores the span's page count to its small-span encoding, so
+    // resize the span only afterwards.
+    MaybeUnsampleAllocation(tc_globals, MallocPolicy(), ptr, std::nullopt,
+                            *span);
+    span->set_num_pages(s.r.n);
+    span->set_donated(s.donated);
+  }
+
+  if (size_t weight = GetThreadSampler().RecordAllocation(new_size);
+      weight != 0) {
+    if (span == nullptr) {
+      // Sampled allocations need a Span.
+      span = Span::New(s.r);
+      span->set_donated(s.donated);
+      tc_globals.pagemap().Set(p, span);
+    }
+    auto res = SampleLargeAllocation(
+        tc_globals,
+        MallocPolicy().InPartitionWithToken(PartitionFromPointer(ptr),
+                                            token_id),
+        new_size, weight, span);
+    TC_CHECK_EQ(res.p, ptr);
+  } else if (span == nullptr) {
+    tc_globals.pagemap().SetCompactLargeSpan(p, {s.r.n, s.donated});
+  }
+  return true;
+}
+
+// Remaps the pages backing [src, src + length) to dst, if both allocations
+// allow it (see PageAllocatorInterface::ReserveMove).  HugeRegions name their
+// mappings apart from the rest of the heap, and each move may split the
+// mappings on both sides, which is counted against the VMA budget of each.
+static bool MovePages(void* dst, void* src, size_t length) {
+  PageAllocator& page_allocator = tc_globals.page_allocator();
+  const PageId to = PageIdContaining(dst);
+  const PageId from = PageIdContaining(src);
+  const MemoryTag to_tag = GetMemoryTag(dst);
+  const MemoryTag from_tag = GetMemoryTag(src);
+  if (!page_allocator.ReserveMove(to, to_tag)) return false;
+  if (page_allocator.ReserveMove(from, from_tag)) {
+    if (tc_globals.system_allocator().MovePages(src, dst, length)) return true;
+    page_allocator.UnreserveMove(from, from_tag);
+  }
+  page_allocator.UnreserveMove(to, to_tag);
+  return false;
+}
+
+// Copies size bytes from src to dst, and frees src.  Whole hugepages are moved
+// by remapping them instead, which is much cheaper than copying for large
+// reallocations.  The moved pages of src are left without memory behind them,
+// so they are freed as released.
+static void MoveAndFreeAllocation(void* dst, void* src, size_t size) {
+  size_t moved = 0;
+  if (size >= kHugePageSize &&
+      (reinterpret_cast<uintptr_t>(dst) & (kHugePageSize - 1)) == 0 &&
+      (reinterpret_cast<uintptr_t>(src) & (kHugePageSize - 1)) == 0 &&
+      MovePages(dst, src, size & ~(kHugePageSize - 1))) {
+    moved = size & ~(kHugePageSize - 1);
+  }
+  memcpy(static_cast<char*>(dst) + moved, static_cast<char*>(src) + moved,
+         size - moved);
+  // We could use a variant of do_free() that leverages the fact that we
+  // already know the sizeclass of src.  The benefit would be small, so don't
+  // bother.
+  if (moved == 0) {
+    do_free(src, MallocPolicy());
+  } else {
+    InvokeHooksAndFreePages(src, std::nullopt, MallocPolicy(),
+                            BytesToLengthFloor(moved));
+  }
+}
+
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
 
@@ -1426,6 +1789,20 @@ MallocTracingExtension_Internal_GetAllocatedAddressRanges() {
       "output vector.");
 }
 
+absl::Status MallocTracingExtension_Internal_StartPageHeapTracing(
+    size_t events_per_cpu) {
+  return tcmalloc::tcmalloc_internal::StartPageHeapTracing(events_per_cpu);
+}
+
+absl::Status MallocTracingExtension_Internal_StopPageHeapTracing() {
+  return tcmalloc::tcmalloc_internal::StopPageHeapTracing();
+}
+
+absl::StatusOr<tcmalloc::malloc_tracing_extension::PageHeapEvents>
+MallocTracingExtension_Internal_DrainPageHeapEvents() {
+  return tcmalloc::tcmalloc_internal::DrainPageHeapEvents();
+}
+
 tcmalloc::tcmalloc_internal::MadvisePreference TCMalloc_Internal_GetMadvise() {
   return tc_globals.system_allocator().madvise_preference();
 }
@@ -1447,7 +1824,9 @@ using tcmalloc::tcmalloc_internal::do_free_with_size;
 using tcmalloc::tcmalloc_internal::GetPageSize;
 using tcmalloc::tcmalloc_internal::GetSizeAndSampled;
 using tcmalloc::tcmalloc_internal::kMaxSize;
+using tcmalloc::tcmalloc_internal::MoveAndFreeAllocation;
 using tcmalloc::tcmalloc_internal::MultiplyOverflow;
+using tcmalloc::tcmalloc_internal::TryGrowInPlace;
 
 // depends on TCMALLOC_HAVE_STRUCT_MALLINFO, so needs to come after that.
 #ifndef TCMALLOC_INTERNAL_METHODS_ONLY
@@ -1604,6 +1983,19 @@ static inline ABSL_ATTRIBUTE_ALWAYS_INLINE void* do_realloc(void* old_ptr,
 
   if (changes_correct_size || was_sampled || will_sample ||
       tc_globals.guardedpage_allocator().PointerIsMine(old_ptr)) {
+    // Large allocations may be able to grow into the free pages that follow
+    // them, avoiding the copy entirely.
+    if (new_size > old_size && new_size > kMaxSize &&
+        TryGrowInPlace(old_ptr, new_size, token_id)) {
+      tcmalloc::MallocHook::InvokeDeleteHook(
+          {old_ptr, std::nullopt, old_size,
+           tcmalloc::HookMemoryMutable::kImmutable});
+      tcmalloc::MallocHook::InvokeNewHook(
+          {old_ptr, new_size, BytesToLengthCeil(new_size).in_bytes(),
+           tcmalloc::HookMemoryMutable::kImmutable});
+      return old_ptr;
+    }
+
     // Need to reallocate.
     void* new_ptr = fast_alloc(
         new_size,
@@ -1613,11 +2005,8 @@ static inline ABSL_ATTRIBUTE_ALWAYS_INLINE void* do_realloc(void* old_ptr,
     if (new_ptr == nullptr) {
       return nullptr;
     }
-    memcpy(new_ptr, old_ptr, ((old_size < new_size) ? old_size : new_size));
-    // We could use a variant of do_free() that leverages the fact
-    // that we already know the sizeclass of old_ptr.  The benefit
-    // would be small, so don't bother.
-    do_free(old_ptr, MallocPolicy());
+    MoveAndFreeAllocation(new_ptr, old_ptr,
+                          ((old_size < new_size) ? old_size : new_size));
     return new_ptr;
   } else {
     // We still need to call hooks to report the updated size:
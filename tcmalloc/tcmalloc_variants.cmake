@@ -71,6 +71,14 @@ function(tcmalloc_cc_library_variants)
     LINKOPTS ${TCMALLOC_LINKOPTS}
     DEPS ${TCMALLOC_DEPS}
   )
+  tcmalloc_cc_library(NAME ${TCMALLOC_NAME}_numa_aware_4_partitions
+    ALIAS ${TCMALLOC_ALIAS}_numa_aware_4_partitions
+    SRCS ${TCMALLOC_SRCS}
+    HDRS ${TCMALLOC_HDRS}
+    COPTS ${TCMALLOC_COPTS} -DTCMALLOC_INTERNAL_8K_PAGES -DTCMALLOC_INTERNAL_NUMA_AWARE -DTCMALLOC_INTERNAL_NUMA_PARTITIONS=4
+    LINKOPTS ${TCMALLOC_LINKOPTS}
+    DEPS ${TCMALLOC_DEPS}
+  )
   tcmalloc_cc_library(NAME ${TCMALLOC_NAME}_legacy_locking
     ALIAS ${TCMALLOC_ALIAS}_legacy_locking
     SRCS ${TCMALLOC_SRCS}
@@ -89,6 +97,15 @@ function(tcmalloc_cc_library_variants)
   )
 endfunction()
 
+# Fails the configuration if MODE is not a PERCPU_VCPU_MODE value that
+# SelectRseqVcpuMode accepts.
+function(tcmalloc_check_percpu_vcpu_mode MODE)
+  set(TCMALLOC_PERCPU_VCPU_MODES none mm flat)
+  if(NOT MODE IN_LIST TCMALLOC_PERCPU_VCPU_MODES)
+    message(FATAL_ERROR "Unknown PERCPU_VCPU_MODE '${MODE}', expected one of ${TCMALLOC_PERCPU_VCPU_MODES}")
+  endif()
+endfunction()
+
 function(tcmalloc_cc_test_variants)
   cmake_parse_arguments(TCMALLOC "" "NAME;ALIAS" "SRCS;HDRS;COPTS;LINKOPTS;DEPS" ${ARGN})
   tcmalloc_cc_test(NAME ${TCMALLOC_NAME}_8k_pages
@@ -187,6 +204,14 @@ function(tcmalloc_cc_test_variants)
     DEPS ${TCMALLOC_DEPS} $<LINK_LIBRARY:WHOLE_ARCHIVE,tcmalloc::tcmalloc_256k_pages_numa_aware,tcmalloc::common_256k_pages_numa_aware,tcmalloc::want_numa_aware>
   )
   set_tests_properties(${TCMALLOC_NAME}_256k_pages_numa_aware PROPERTIES ENVIRONMENT "TEST_TMPDIR=${CMAKE_CURRENT_BINARY_DIR};TEST_SRCDIR=${CMAKE_SOURCE_DIR}")
+  tcmalloc_cc_test(NAME ${TCMALLOC_NAME}_numa_aware_4_partitions
+    SRCS ${TCMALLOC_SRCS}
+    HDRS ${TCMALLOC_HDRS}
+    COPTS ${TCMALLOC_COPTS} -DTCMALLOC_INTERNAL_NUMA_AWARE -DTCMALLOC_INTERNAL_NUMA_PARTITIONS=4
+    LINKOPTS ${TCMALLOC_LINKOPTS}
+    DEPS ${TCMALLOC_DEPS} $<LINK_LIBRARY:WHOLE_ARCHIVE,tcmalloc::tcmalloc_numa_aware_4_partitions,tcmalloc::common_numa_aware_4_partitions,tcmalloc::want_numa_aware>
+  )
+  set_tests_properties(${TCMALLOC_NAME}_numa_aware_4_partitions PROPERTIES ENVIRONMENT "TEST_TMPDIR=${CMAKE_CURRENT_BINARY_DIR};TEST_SRCDIR=${CMAKE_SOURCE_DIR}")
   tcmalloc_cc_test(NAME ${TCMALLOC_NAME}_256k_pages_pow2_sharded_transfer_cache
     SRCS ${TCMALLOC_SRCS}
     HDRS ${TCMALLOC_HDRS}
@@ -250,6 +275,7 @@ function(tcmalloc_cc_test_variants)
     LINKOPTS ${TCMALLOC_LINKOPTS}
     DEPS ${TCMALLOC_DEPS} $<LINK_LIBRARY:WHOLE_ARCHIVE,tcmalloc::tcmalloc,tcmalloc::common_8k_pages>
   )
+  tcmalloc_check_percpu_vcpu_mode(flat)
   set_tests_properties(${TCMALLOC_NAME}_flat_cpu_caches PROPERTIES ENVIRONMENT "PERCPU_VCPU_MODE=flat;TEST_TMPDIR=${CMAKE_CURRENT_BINARY_DIR};TEST_SRCDIR=${CMAKE_SOURCE_DIR}")
   tcmalloc_cc_test(NAME ${TCMALLOC_NAME}_real_cpu_caches
     SRCS ${TCMALLOC_SRCS}
@@ -258,6 +284,7 @@ function(tcmalloc_cc_test_variants)
     LINKOPTS ${TCMALLOC_LINKOPTS}
     DEPS ${TCMALLOC_DEPS} $<LINK_LIBRARY:WHOLE_ARCHIVE,tcmalloc::tcmalloc,tcmalloc::common_8k_pages>
   )
+  tcmalloc_check_percpu_vcpu_mode(none)
   set_tests_properties(${TCMALLOC_NAME}_real_cpu_caches PROPERTIES ENVIRONMENT "PERCPU_VCPU_MODE=none;TEST_TMPDIR=${CMAKE_CURRENT_BINARY_DIR};TEST_SRCDIR=${CMAKE_SOURCE_DIR}")
   tcmalloc_cc_test(NAME ${TCMALLOC_NAME}_no_glibc_rseq
     SRCS ${TCMALLOC_SRCS}
@@ -274,7 +301,8 @@ function(tcmalloc_cc_test_variants)
     LINKOPTS ${TCMALLOC_LINKOPTS}
     DEPS ${TCMALLOC_DEPS} $<LINK_LIBRARY:WHOLE_ARCHIVE,tcmalloc::tcmalloc,tcmalloc::common_8k_pages>
   )
-  set_tests_properties(${TCMALLOC_NAME}_mm_vcpu_cpu_caches PROPERTIES ENVIRONMENT "BORG_EXPERIMENTS=TEST_ONLY_MM_VCPU;GLIBC_TUNABLES=glibc.pthread.rseq=0;TEST_TMPDIR=${CMAKE_CURRENT_BINARY_DIR};TEST_SRCDIR=${CMAKE_SOURCE_DIR}")
+  tcmalloc_check_percpu_vcpu_mode(mm)
+  set_tests_properties(${TCMALLOC_NAME}_mm_vcpu_cpu_caches PROPERTIES ENVIRONMENT "GLIBC_TUNABLES=glibc.pthread.rseq=0;PERCPU_VCPU_MODE=mm;TEST_TMPDIR=${CMAKE_CURRENT_BINARY_DIR};TEST_SRCDIR=${CMAKE_SOURCE_DIR}")
   tcmalloc_cc_test(NAME ${TCMALLOC_NAME}_legacy_locking
     SRCS ${TCMALLOC_SRCS}
     HDRS ${TCMALLOC_HDRS}
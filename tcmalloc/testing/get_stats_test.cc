@@ -160,6 +160,13 @@ TEST_F(GetStatsTest, Pbtxt) {
   }
 
   EXPECT_THAT(buf, HasSubstr("tcmalloc_release_drained_slab_metadata: false"));
+  EXPECT_THAT(buf, HasSubstr("tcmalloc_per_cpu_caches_on_demand_steal: false"));
+  EXPECT_THAT(buf, HasSubstr("tcmalloc_per_cpu_caches_follow_cpuset: false"));
+  EXPECT_THAT(buf,
+              HasSubstr("tcmalloc_numa_migrate_remote_hugepages: false"));
+  EXPECT_THAT(buf, HasSubstr("tcmalloc_partition {"));
+  EXPECT_THAT(buf, HasSubstr("per_cpu_cache_percent: 100"));
+  EXPECT_THAT(buf, HasSubstr("release_eagerly: false"));
 
   sized_delete(alloc, kSize);
 }
@@ -294,6 +301,19 @@ TEST_F(GetStatsTest, Parameters) {
     EXPECT_THAT(
         buf,
         HasSubstr(R"(PARAMETER tcmalloc_release_drained_slab_metadata 0)"));
+    EXPECT_THAT(
+        buf,
+        HasSubstr(R"(PARAMETER tcmalloc_per_cpu_caches_on_demand_steal 0)"));
+    EXPECT_THAT(
+        buf, HasSubstr(R"(PARAMETER tcmalloc_per_cpu_caches_follow_cpuset 0)"));
+    EXPECT_THAT(
+        buf,
+        HasSubstr(R"(PARAMETER tcmalloc_numa_migrate_remote_hugepages 0)"));
+    EXPECT_THAT(
+        buf,
+        HasSubstr(R"(PARAMETER tcmalloc_partition_0_per_cpu_cache_percent 100)"));
+    EXPECT_THAT(
+        buf, HasSubstr(R"(PARAMETER tcmalloc_partition_0_release_eagerly 0)"));
   }
 
   Parameters::set_hpaa_subrelease(true);
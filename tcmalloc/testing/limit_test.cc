@@ -12,12 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <errno.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <limits>
+#include <new>
 #include <string>
 #include <utility>
 #include <vector>
@@ -61,6 +63,7 @@ class LimitTest : public ::testing::Test {
   void LimitChangeTriggersReleaseSmallAllocs();
   void LimitRespected();
   void ExceedingSoftLimitDoesntCrashWithHardLimit();
+  void HardLimitFailsAllocation();
 
   void ReleaseMemory() {
     MallocExtension::SetMemoryLimit(0, MallocExtension::LimitKind::kSoft);
@@ -467,6 +470,78 @@ void LimitTest::ExceedingSoftLimitDoesntCrashWithHardLimit() {
   exit(testing::Test::HasFailure());
 }
 
+void LimitTest::HardLimitFailsAllocation() {
+  // Needed to see what expectation failed (if any).
+  testing::UnitTest::GetInstance()->listeners().SuppressEventForwarding(false);
+
+  // Large enough to bypass the per-CPU caches, but small enough to be served
+  // from the filler, which keeps freed pages backed.
+  constexpr size_t kChunk = 1 << 20;
+  std::vector<void*> ptrs;
+  ptrs.reserve(4096);
+
+  MallocExtension::SetHardLimitAction(
+      MallocExtension::HardLimitAction::kFailAllocation);
+  MallocExtension::SetMemoryLimit(physical_memory_used() + (64 << 20),
+                                  MallocExtension::LimitKind::kHard);
+
+  bool failed = false;
+  while (ptrs.size() < ptrs.capacity()) {
+    errno = 0;
+    void* ptr = malloc(kChunk);
+    if (ptr == nullptr) {
+      EXPECT_EQ(errno, ENOMEM);
+      failed = true;
+      break;
+    }
+    ptrs.push_back(ptr);
+  }
+  EXPECT_TRUE(failed);
+  EXPECT_EQ(::operator new(kChunk, std::nothrow), nullptr);
+  EXPECT_GT(*MallocExtension::GetNumericProperty(
+                "tcmalloc.hard_limit_failed_allocations"),
+            0);
+
+  // Reusing memory that is already backed does not raise usage, so it is
+  // allowed while over the limit.
+  ASSERT_FALSE(ptrs.empty());
+  free(ptrs.back());
+  ptrs.pop_back();
+  void* ptr = malloc(kChunk);
+  EXPECT_NE(ptr, nullptr);
+  ptrs.push_back(ptr);
+
+  for (void* p : ptrs) {
+    free(p);
+  }
+
+  // Exit status indicates whether we've failed any of the expectations above.
+  exit(testing::Test::HasFailure());
+}
+
+TEST_F(LimitTest, HardLimitFailsAllocation) {
+  // Run the test in a separate subprocess, so it doesn't interfere with other
+  // tests.
+  EXPECT_EXIT(HardLimitFailsAllocation(), testing::ExitedWithCode(0), "");
+}
+
+TEST_F(LimitDeathTest, HardLimitFailsAllocationNew) {
+  // operator new has no way to return the failure, so it reports OOM.
+  ASSERT_DEATH(
+      [this]() {
+        MallocExtension::SetHardLimitAction(
+            MallocExtension::HardLimitAction::kFailAllocation);
+        MallocExtension::SetMemoryLimit(physical_memory_used() + (64 << 20),
+                                        MallocExtension::LimitKind::kHard);
+        std::vector<void*> ptrs;
+        ptrs.reserve(4096);
+        while (ptrs.size() < ptrs.capacity()) {
+          ptrs.push_back(::operator new(1 << 20));
+        }
+      }(),
+      "Unable to allocate");
+}
+
 TEST_F(LimitTest, ExceedingSoftLimitDoesntCrashWithHardLimit) {
   // Run the test in a separate subprocess, so it doesn't interfere with other
   // tests.
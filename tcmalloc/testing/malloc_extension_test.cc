@@ -17,10 +17,14 @@
 #include "tcmalloc/malloc_extension.h"
 
 #include <stddef.h>
+#include <stdlib.h>
 
+#include <cstdint>
 #include <map>
 #include <optional>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -86,6 +90,21 @@ TEST(MallocExtension, SkipSubreleaseIntervals) {
 }
 
 
+TEST(MallocExtension, ShouldRelocate) {
+  EXPECT_FALSE(MallocExtension::ShouldRelocate(nullptr));
+
+  // Whether a live allocation is nominated depends on the rest of the heap,
+  // but the query must be safe for any of them.
+  std::vector<void*> ptrs;
+  for (size_t size = 8; size <= (4 << 20); size *= 2) {
+    ptrs.push_back(::operator new(size));
+    (void)MallocExtension::ShouldRelocate(ptrs.back());
+  }
+  for (void* ptr : ptrs) {
+    ::operator delete(ptr);
+  }
+}
+
 TEST(MallocExtension, Properties) {
   // Verify that every property under GetProperties also works with
   // GetNumericProperty.
@@ -149,6 +168,10 @@ TEST(MallocExtension, Properties) {
             "tcmalloc.num_released_release_memory_to_system_bytes",
             "tcmalloc.num_released_soft_limit_exceeded_bytes",
             "tcmalloc.num_released_total_bytes",
+            "tcmalloc.numa_hits",
+            "tcmalloc.numa_migrated",
+            "tcmalloc.numa_migration_failures",
+            "tcmalloc.numa_misses",
             "tcmalloc.page_heap_free",
             "tcmalloc.page_heap_unmapped",
             "tcmalloc.required_bytes",
@@ -198,6 +221,74 @@ TEST(MallocExtension, DynamicSlabMallocMetadata) {
       testing::Field(&MallocExtension::Property::value, testing::Gt(0)));
 }
 
+// Allocates and frees kCount objects of various sizes on a fresh thread, and
+// returns the thread's counters across the frees along with the expected
+// number of bytes.
+struct ThreadAccountingResult {
+  MallocExtension::ThreadAllocatedBytes before, after_alloc, after_free;
+  uint64_t expected;
+};
+
+ThreadAccountingResult RunThreadAccounting() {
+  constexpr int kCount = 100000;
+  ThreadAccountingResult result;
+  std::thread t([&]() {
+    std::vector<std::pair<void*, size_t>> ptrs;
+    ptrs.reserve(kCount);
+    result.expected = 0;
+    result.before = *MallocExtension::GetThreadAllocatedBytes();
+    for (int i = 0; i < kCount; ++i) {
+      const size_t size = 1 + (i * 7919) % 4096;
+      ptrs.emplace_back(malloc(size), size);
+      result.expected += size + 1;
+    }
+    result.after_alloc = *MallocExtension::GetThreadAllocatedBytes();
+    for (auto [ptr, size] : ptrs) {
+      sdallocx(ptr, size, 0);
+    }
+    result.after_free = *MallocExtension::GetThreadAllocatedBytes();
+  });
+  t.join();
+  return result;
+}
+
+TEST(MallocExtension, ThreadAllocatedBytesSampled) {
+  if (tcmalloc_internal::kSanitizerPresent) {
+    GTEST_SKIP() << "Running under sanitizers";
+  }
+
+  ScopedProfileSamplingInterval s(4096);
+  MallocExtension::SetThreadAccountingMode(
+      MallocExtension::ThreadAccountingMode::kSampled);
+  const ThreadAccountingResult r = RunThreadAccounting();
+
+  EXPECT_EQ(r.after_alloc.allocated - r.before.allocated, r.expected);
+  EXPECT_EQ(r.after_free.allocated, r.after_alloc.allocated);
+  // The standard deviation of the estimate is sqrt(expected * 4096), under 0.2%
+  // of expected.
+  const double freed = r.after_free.freed - r.after_alloc.freed;
+  EXPECT_NEAR(freed, r.expected, 0.02 * r.expected);
+}
+
+TEST(MallocExtension, ThreadAllocatedBytesExact) {
+  if (tcmalloc_internal::kSanitizerPresent) {
+    GTEST_SKIP() << "Running under sanitizers";
+  }
+
+  MallocExtension::SetThreadAccountingMode(
+      MallocExtension::ThreadAccountingMode::kExact);
+  EXPECT_EQ(MallocExtension::GetThreadAccountingMode(),
+            MallocExtension::ThreadAccountingMode::kExact);
+  const ThreadAccountingResult r = RunThreadAccounting();
+  MallocExtension::SetThreadAccountingMode(
+      MallocExtension::ThreadAccountingMode::kSampled);
+  EXPECT_EQ(MallocExtension::GetThreadAccountingMode(),
+            MallocExtension::ThreadAccountingMode::kSampled);
+
+  EXPECT_EQ(r.after_alloc.allocated - r.before.allocated, r.expected);
+  EXPECT_EQ(r.after_free.freed - r.after_alloc.freed, r.expected);
+}
+
 }  // namespace
 }  // namespace tcmalloc_internal
 }  // namespace tcmalloc
@@ -20,10 +20,14 @@
 #include "tcmalloc/malloc_tracing_extension.h"
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include <optional>
 
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 
 #ifndef MALLOC_TRACING_EXTENSION_NOT_SUPPORTED
 #include "gmock/gmock.h"
@@ -43,6 +47,16 @@ TEST(MallocTracingExtension, GetAllocatedAddressRanges) {
   ASSERT_FALSE(allocated.ok());
   EXPECT_EQ(allocated.status().code(), absl::StatusCode::kUnimplemented);
 }
+
+TEST(MallocTracingExtension, PageHeapTracing) {
+  EXPECT_EQ(tcmalloc::malloc_tracing_extension::StartPageHeapTracing().code(),
+            absl::StatusCode::kUnimplemented);
+  EXPECT_EQ(tcmalloc::malloc_tracing_extension::StopPageHeapTracing().code(),
+            absl::StatusCode::kUnimplemented);
+  EXPECT_EQ(
+      tcmalloc::malloc_tracing_extension::DrainPageHeapEvents().status().code(),
+      absl::StatusCode::kUnimplemented);
+}
 #else
 
 using ::tcmalloc::malloc_tracing_extension::AllocatedAddressRanges;
@@ -106,6 +120,56 @@ TEST(MallocTracingExtension, GetAllocatedAddressRanges) {
     }
   }
 }
+
+TEST(MallocTracingExtension, PageHeapTracing) {
+  using ::tcmalloc::malloc_tracing_extension::PageHeapEvent;
+  using ::tcmalloc::malloc_tracing_extension::PageHeapEvents;
+
+  EXPECT_EQ(tcmalloc::malloc_tracing_extension::StartPageHeapTracing(0).code(),
+            absl::StatusCode::kInvalidArgument);
+  ASSERT_TRUE(tcmalloc::malloc_tracing_extension::StartPageHeapTracing().ok());
+  // Starting again is a no-op.
+  ASSERT_TRUE(tcmalloc::malloc_tracing_extension::StartPageHeapTracing().ok());
+  // Discard whatever was recorded before this test.
+  ASSERT_TRUE(tcmalloc::malloc_tracing_extension::DrainPageHeapEvents().ok());
+
+  // Large enough to come straight from the page heap.
+  constexpr size_t kSize = 4 << 20;
+  void* ptr = ::operator new(kSize);
+  ::operator delete(ptr);
+  ASSERT_TRUE(tcmalloc::malloc_tracing_extension::StopPageHeapTracing().ok());
+
+  absl::StatusOr<PageHeapEvents> drained =
+      tcmalloc::malloc_tracing_extension::DrainPageHeapEvents();
+  ASSERT_TRUE(drained.ok()) << drained.status();
+
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+  auto covers = [&](const PageHeapEvent& e) {
+    return e.start_addr <= addr && addr + kSize <= e.start_addr + e.size;
+  };
+  std::optional<absl::Time> new_time, delete_time;
+  absl::Time last = absl::InfinitePast();
+  for (const PageHeapEvent& e : drained->events) {
+    EXPECT_GE(e.time, last);
+    last = e.time;
+    EXPECT_FALSE(e.heap.empty());
+    if (!covers(e)) continue;
+    if (e.type == PageHeapEvent::Type::kNew) new_time = e.time;
+    if (e.type == PageHeapEvent::Type::kDelete) delete_time = e.time;
+  }
+  if (drained->dropped == 0) {
+    ASSERT_TRUE(new_time.has_value());
+    ASSERT_TRUE(delete_time.has_value());
+    EXPECT_LE(*new_time, *delete_time);
+  }
+
+  // Nothing is recorded once tracing stops.
+  ptr = ::operator new(kSize);
+  ::operator delete(ptr);
+  drained = tcmalloc::malloc_tracing_extension::DrainPageHeapEvents();
+  ASSERT_TRUE(drained.ok()) << drained.status();
+  EXPECT_TRUE(drained->events.empty());
+}
 #endif
 
 }  // namespace
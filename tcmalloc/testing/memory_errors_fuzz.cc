@@ -127,9 +127,7 @@ void WildPointerSizedDelete(uintptr_t ptr, size_t size) {
 
   // The pointer must either be non-normal or larger than kMaxSize.  We don't
   // expect to have lightweight checks otherwise.
-  if (auto tag = GetMemoryTag(p);
-      (tag == MemoryTag::kNormal || tag == MemoryTag::kNormalP1) &&
-      size <= kMaxSize) {
+  if (IsNormalTag(GetMemoryTag(p)) && size <= kMaxSize) {
     return;
   }
 
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 #include <new>
 #include <optional>
@@ -452,6 +453,70 @@ TEST_F(TcMallocTest, LargeDoubleFree) {
                    ")|attempting double-free"));
 }
 
+TEST_F(TcMallocTest, SampledQuarantineUseAfterFreeDetected) {
+#if ABSL_HAVE_ADDRESS_SANITIZER || ABSL_HAVE_HWADDRESS_SANITIZER
+  GTEST_SKIP() << "Test requires the sampled quarantine";
+#endif  // ABSL_HAVE_ADDRESS_SANITIZER || ABSL_HAVE_HWADDRESS_SANITIZER
+
+  ScopedGuardedSamplingInterval gs(-1);
+  ScopedProfileSamplingInterval s(1);
+  auto UseAfterFree = []() {
+    MallocExtension::SetSampledQuarantineBytes(int64_t{1} << 30);
+    char* buf = static_cast<char*>(::operator new(1000));
+    benchmark::DoNotOptimize(buf);
+    ::operator delete(buf);
+    benchmark::DoNotOptimize(buf);
+    buf[10] = 'x';
+    benchmark::DoNotOptimize(buf);
+    // Releases the quarantine, verifying buf.
+    MallocExtension::SetSampledQuarantineBytes(0);
+  };
+  EXPECT_DEATH(UseAfterFree(), "Use-after-free write detected");
+}
+
+TEST_F(TcMallocTest, SampledQuarantineDoubleFreeDetected) {
+#if ABSL_HAVE_ADDRESS_SANITIZER || ABSL_HAVE_HWADDRESS_SANITIZER
+  GTEST_SKIP() << "Test requires the sampled quarantine";
+#endif  // ABSL_HAVE_ADDRESS_SANITIZER || ABSL_HAVE_HWADDRESS_SANITIZER
+
+  ScopedGuardedSamplingInterval gs(-1);
+  ScopedProfileSamplingInterval s(1);
+  auto DoubleFree = []() {
+    MallocExtension::SetSampledQuarantineBytes(int64_t{1} << 30);
+    void* buf = ::operator new(1000);
+    benchmark::DoNotOptimize(buf);
+    ::operator delete(buf);
+    benchmark::DoNotOptimize(buf);
+    // buf is still quarantined, so its span has not gone back to the page
+    // heap.
+    ::operator delete(buf);
+  };
+  EXPECT_DEATH(DoubleFree(), absl::StrCat("(Possible double free detected"
+                                          ")|attempting double-free"));
+}
+
+TEST_F(TcMallocTest, SampledQuarantineNoFalsePositive) {
+#if ABSL_HAVE_ADDRESS_SANITIZER || ABSL_HAVE_HWADDRESS_SANITIZER
+  GTEST_SKIP() << "Test requires the sampled quarantine";
+#endif  // ABSL_HAVE_ADDRESS_SANITIZER || ABSL_HAVE_HWADDRESS_SANITIZER
+
+  ScopedGuardedSamplingInterval gs(-1);
+  ScopedProfileSamplingInterval s(1);
+  MallocExtension::SetSampledQuarantineBytes(1 << 20);
+  for (size_t i = 0; i < 1000; ++i) {
+    const size_t size = 1 + (i * 97) % 5000;
+    void* buf = ::operator new(size);
+    memset(buf, static_cast<int>(i), size);
+    benchmark::DoNotOptimize(buf);
+    ::operator delete(buf, size);
+  }
+  // Releasing the quarantine verifies everything it still holds.
+  MallocExtension::SetSampledQuarantineBytes(0);
+  const std::string stats = GetStatsInPbTxt();
+  EXPECT_THAT(stats, testing::ContainsRegex(R"(total_quarantined: [1-9])"));
+  EXPECT_THAT(stats, testing::ContainsRegex(R"(total_verified: [1-9])"));
+}
+
 TEST_F(TcMallocTest, ReallocLarger) {
   // Note: sizes are chosen so that size + 2 access below
   // does not write out of actual allocation bounds.
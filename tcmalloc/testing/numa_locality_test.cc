@@ -14,6 +14,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <linux/mempolicy.h>
 #include <string.h>
 #include <syscall.h>
 #include <unistd.h>
@@ -34,11 +35,14 @@
 #include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
 #include "tcmalloc/common.h"
+#include "tcmalloc/huge_page_options.h"
+#include "tcmalloc/huge_pages.h"
 #include "tcmalloc/internal/affinity.h"
 #include "tcmalloc/internal/logging.h"
 #include "tcmalloc/internal/numa.h"
 #include "tcmalloc/internal/page_size.h"
 #include "tcmalloc/malloc_extension.h"
+#include "tcmalloc/parameters.h"
 #include "tcmalloc/static_vars.h"
 #include "tcmalloc/testing/testutil.h"
 
@@ -75,6 +79,23 @@ size_t BackingNode(void* const ptr) {
   return status;
 }
 
+// Moves the hugepage containing ptr to node.  Returns false if the kernel could
+// not move it, e.g. because the node has no memory.
+bool MoveHugepage(void* const ptr, const int node) {
+  static const size_t page_size = GetPageSize();
+  const uintptr_t start =
+      reinterpret_cast<uintptr_t>(ptr) & ~(kHugePageSize - 1);
+  std::vector<void*> pages;
+  for (uintptr_t addr = start; addr < start + kHugePageSize;
+       addr += page_size) {
+    pages.push_back(reinterpret_cast<void*>(addr));
+  }
+  std::vector<int> nodes(pages.size(), node);
+  std::vector<int> status(pages.size(), -1);
+  return syscall(__NR_move_pages, /*pid=*/0, pages.size(), pages.data(),
+                 nodes.data(), status.data(), MPOL_MF_MOVE) == 0;
+}
+
 class FakeNumaAwareRegionFactory final : public tcmalloc::AddressRegionFactory {
  public:
   static constexpr size_t kAddrsAndHintsSize = 8;
@@ -129,12 +150,13 @@ class FakeNumaAwareRegionFactory final : public tcmalloc::AddressRegionFactory {
         ++found_;
         // Ignore "special" hints, e.x. kInfrequentAllocation and
         // kInfrequentAccess.
-        if (hint != UsageHint::kNormalNumaAwareS0 &&
-            hint != UsageHint::kNormalNumaAwareS1) {
+        if (hint < UsageHint::kNormalNumaAwareS0 ||
+            hint > UsageHint::kNormalNumaAwareS7) {
           return;
         }
         const int hinted_partition =
-            hint == UsageHint::kNormalNumaAwareS1 ? 1 : 0;
+            static_cast<int>(hint) -
+            static_cast<int>(UsageHint::kNormalNumaAwareS0);
         EXPECT_EQ(expected_partition, hinted_partition);
         return;
       }
@@ -230,6 +252,84 @@ TEST(NumaLocalityTest, AllocationsAreLocal) {
 #endif  // TCMALLOC_TEST_DISABLE_FAKE_NUMA_FACTORY
 }
 
+// Test that the background NUMA placement pass counts normal hugepages backed
+// by another partition's nodes, and moves them back when migration is enabled.
+TEST(NumaLocalityTest, RemoteHugepagesAreMigrated) {
+  if (!tc_globals.numa_topology().numa_aware()) {
+    GTEST_SKIP() << "NUMA awareness is disabled";
+  }
+  ScopedNeverSample never_sample;
+
+  std::vector<int> allowed = AllowedCpus();
+  ScopedAffinityMask mask(allowed[0]);
+  unsigned int local_node;
+  ASSERT_EQ(syscall(__NR_getcpu, nullptr, &local_node, nullptr), 0);
+  const size_t local_partition = NodeToPartition(local_node, kNumaPartitions);
+
+  // Fill whole hugepages with small allocations, so that they are managed by
+  // the filler and qualify as highly utilized.
+  constexpr size_t kSize = 4096;
+  constexpr size_t kCount = (size_t{64} << 20) / kSize;
+  std::vector<void*> ptrs;
+  ptrs.reserve(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    void* ptr = ::operator new(kSize);
+    memset(ptr, 42, kSize);
+    ptrs.push_back(ptr);
+  }
+  if (mask.Tampered()) {
+    GTEST_SKIP() << "Migrated off the chosen CPU";
+  }
+
+  // Pick a hugepage in the middle, which is full, and move it to a node of
+  // another partition.
+  void* const victim = ptrs[kCount / 2];
+  ASSERT_EQ(NodeToPartition(BackingNode(victim), kNumaPartitions),
+            local_partition);
+  int remote_node = -1;
+  for (int node = 0; node < 64 && remote_node < 0; ++node) {
+    if (NodeToPartition(node, kNumaPartitions) != local_partition &&
+        MoveHugepage(victim, node)) {
+      remote_node = node;
+    }
+  }
+  if (remote_node < 0) {
+    GTEST_SKIP() << "No node of another partition to move memory to";
+  }
+  ASSERT_EQ(BackingNode(victim), remote_node);
+
+  const size_t misses_before =
+      *MallocExtension::GetNumericProperty("tcmalloc.numa_misses");
+  const size_t migrated_before =
+      *MallocExtension::GetNumericProperty("tcmalloc.numa_migrated");
+  const bool old_migrate = Parameters::numa_migrate_remote_hugepages();
+  Parameters::set_numa_migrate_remote_hugepages(true);
+
+  // Each pass visits a bounded number of hugepages, so it may take a few
+  // passes to get to ours.
+  for (int pass = 0; pass < 64; ++pass) {
+    tc_globals.page_allocator().TreatHugepageTrackers(
+        EnableCollapse::kDisabled);
+    if (NodeToPartition(BackingNode(victim), kNumaPartitions) ==
+        local_partition) {
+      break;
+    }
+  }
+  Parameters::set_numa_migrate_remote_hugepages(old_migrate);
+
+  EXPECT_EQ(NodeToPartition(BackingNode(victim), kNumaPartitions),
+            local_partition);
+  EXPECT_GT(*MallocExtension::GetNumericProperty("tcmalloc.numa_misses"),
+            misses_before);
+  EXPECT_GT(*MallocExtension::GetNumericProperty("tcmalloc.numa_migrated"),
+            migrated_before);
+  EXPECT_GT(*MallocExtension::GetNumericProperty("tcmalloc.numa_hits"), 0);
+
+  for (void* ptr : ptrs) {
+    ::operator delete(ptr);
+  }
+}
+
 #ifndef TCMALLOC_TEST_DISABLE_FAKE_NUMA_FACTORY
 static void install_factory() {
   // Install fake region factory to log hints for verification.
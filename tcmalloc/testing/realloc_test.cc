@@ -22,6 +22,8 @@
 #include <utility>
 
 #include "gtest/gtest.h"
+#include "absl/base/config.h"
+#include "tcmalloc/internal/config.h"
 
 namespace tcmalloc {
 namespace {
@@ -96,5 +98,58 @@ TEST(ReallocTest, AlignedAllocRealloc) {
   }
 }
 
+TEST(ReallocTest, LargeGrowth) {
+  // Large reallocations may grow in place or move whole hugepages rather than
+  // copying.  Either way, the contents must survive.  Interleave a second
+  // allocation so that some steps cannot grow in place.
+  constexpr size_t kMaxSize = size_t{64} << 20;
+  for (bool interleave : {false, true}) {
+    size_t size = size_t{1} << 20;
+    auto buf = static_cast<unsigned char*>(malloc(size));
+    ASSERT_NE(buf, nullptr);
+    Fill(buf, size);
+    void* blocker = nullptr;
+    while (size < kMaxSize) {
+      const size_t new_size = size + size / 2 + 12345;
+      if (interleave) {
+        free(blocker);
+        blocker = malloc(size);
+      }
+      buf = static_cast<unsigned char*>(realloc(buf, new_size));
+      ASSERT_NE(buf, nullptr);
+      ExpectValid(buf, size);
+      Fill(buf, new_size);
+      size = new_size;
+    }
+    free(blocker);
+    free(buf);
+  }
+}
+
+TEST(ReallocTest, LargeGrowthInPlace) {
+#if defined(ABSL_HAVE_ADDRESS_SANITIZER) ||  \
+    defined(ABSL_HAVE_HWADDRESS_SANITIZER) || \
+    defined(ABSL_HAVE_MEMORY_SANITIZER) || defined(ABSL_HAVE_THREAD_SANITIZER)
+  GTEST_SKIP() << "realloc is provided by the sanitizer";
+#endif
+  using tcmalloc_internal::kHugePageSize;
+
+  // Free a range of hugepages and reallocate its start, so that the hugepage
+  // that follows is free and a realloc into it can grow in place.
+  int in_place = 0;
+  for (int i = 0; i < 10; ++i) {
+    free(malloc(4 * kHugePageSize));
+    auto buf = static_cast<unsigned char*>(malloc(2 * kHugePageSize));
+    ASSERT_NE(buf, nullptr);
+    Fill(buf, 2 * kHugePageSize);
+    auto grown = static_cast<unsigned char*>(realloc(buf, 3 * kHugePageSize));
+    ASSERT_NE(grown, nullptr);
+    ExpectValid(grown, 2 * kHugePageSize);
+    if (grown == buf) ++in_place;
+    free(grown);
+  }
+  EXPECT_GT(in_place, 0);
+}
+
 }  // namespace
 }  // namespace tcmalloc
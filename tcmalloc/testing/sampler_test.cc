@@ -225,6 +225,25 @@ TEST(Sampler, size_of_class) {
   EXPECT_LE(sizeof(sampler), 48);
 }
 
+TEST(Sampler, RecordedAllocatedBytes) {
+  Sampler sampler;
+  EXPECT_EQ(sampler.RecordedAllocatedBytes(), 0);
+
+  // Span many sampling points, with allocations both smaller and larger than
+  // the sampling interval.
+  uint64_t expected = 0;
+  for (int i = 0; i < 100000; ++i) {
+    const size_t size = (i * uint64_t{7919}) % (4 * kSamplingInterval);
+    sampler.RecordAllocation(size);
+    expected += size + 1;
+    ASSERT_EQ(sampler.RecordedAllocatedBytes(), expected) << i;
+  }
+
+  EXPECT_EQ(sampler.RecordedFreedBytes(), 0);
+  sampler.RecordFree(100);
+  EXPECT_EQ(sampler.RecordedFreedBytes(), 100);
+}
+
 TEST(Sampler, stirring) {
   // Lets test that we get somewhat random values from sampler even when we're
   // dealing with Samplers that have same addresses, as we see when thread's TLS
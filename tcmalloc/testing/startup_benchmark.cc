@@ -0,0 +1,169 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures TCMalloc startup: wall time of a process that initializes TCMalloc,
+// the latency of its first malloc, and RSS / metadata after kAllocations
+// allocations on each of its CPUs.  Startup state cannot be reset within a
+// process, so every iteration runs startup_benchmark_helper in a fresh child
+// restricted to the first N allowed CPUs.
+
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "tcmalloc/internal/affinity.h"
+
+namespace tcmalloc {
+namespace {
+
+// Returns the path of startup_benchmark_helper: $STARTUP_BENCHMARK_HELPER if
+// set, otherwise a binary of that name next to this one.
+std::string HelperPath() {
+  if (const char* path = getenv("STARTUP_BENCHMARK_HELPER"); path != nullptr) {
+    return path;
+  }
+  char self[4096];
+  ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+  if (len <= 0) {
+    return "";
+  }
+  std::string dir(self, len);
+  dir.resize(dir.rfind('/') + 1);
+  for (const char* name : {"startup_benchmark_helper",
+                           "tcmalloc_testing_startup_benchmark_helper"}) {
+    std::string candidate = absl::StrCat(dir, name);
+    if (access(candidate.c_str(), X_OK) == 0) {
+      return candidate;
+    }
+  }
+  return "";
+}
+
+struct HelperResult {
+  bool ok = false;
+  int64_t first_malloc_ns = 0;
+  int64_t rss = 0;
+  int64_t metadata = 0;
+};
+
+// Runs the helper restricted to <cpus> and parses its report.
+HelperResult RunHelper(const std::string& helper, const cpu_set_t& cpus) {
+  HelperResult result;
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return result;
+  }
+  char* const argv[] = {const_cast<char*>(helper.c_str()), nullptr};
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Only async-signal-safe calls between fork and exec.
+    close(fds[0]);
+    dup2(fds[1], STDOUT_FILENO);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+    execv(helper.c_str(), argv);
+    _exit(127);
+  }
+  close(fds[1]);
+  if (pid < 0) {
+    close(fds[0]);
+    return result;
+  }
+
+  FILE* out = fdopen(fds[0], "r");
+  long long first_malloc_ns, rss, metadata;
+  const bool parsed =
+      out != nullptr &&
+      fscanf(out, "%lld %lld %lld", &first_malloc_ns, &rss, &metadata) == 3;
+  if (out != nullptr) {
+    fclose(out);
+  } else {
+    close(fds[0]);
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0 || !parsed) {
+    return result;
+  }
+  result.ok = true;
+  result.first_malloc_ns = first_malloc_ns;
+  result.rss = rss;
+  result.metadata = metadata;
+  return result;
+}
+
+void BM_Startup(benchmark::State& state) {
+  const std::string helper = HelperPath();
+  if (helper.empty()) {
+    state.SkipWithError("startup_benchmark_helper not found");
+    return;
+  }
+
+  const std::vector<int> allowed = tcmalloc_internal::AllowedCpus();
+  const int num_cpus = state.range(0);
+  if (num_cpus > static_cast<int>(allowed.size())) {
+    state.SkipWithError("not enough allowed CPUs");
+    return;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int i = 0; i < num_cpus; ++i) {
+    CPU_SET(allowed[i], &cpus);
+  }
+
+  int64_t first_malloc_ns = 0, rss = 0, metadata = 0;
+  for (auto s : state) {
+    const absl::Time start = absl::Now();
+    HelperResult result = RunHelper(helper, cpus);
+    state.SetIterationTime(absl::ToDoubleSeconds(absl::Now() - start));
+    if (!result.ok) {
+      state.SkipWithError("startup_benchmark_helper failed");
+      return;
+    }
+    first_malloc_ns += result.first_malloc_ns;
+    rss = std::max(rss, result.rss);
+    metadata = std::max(metadata, result.metadata);
+  }
+
+  state.counters["first_malloc_ns"] = benchmark::Counter(
+      first_malloc_ns, benchmark::Counter::kAvgIterations);
+  state.counters["max_rss"] = rss;
+  state.counters["max_metadata"] = metadata;
+}
+
+void StartupArgs(benchmark::internal::Benchmark* b) {
+  const int max_cpus = tcmalloc_internal::AllowedCpus().size();
+  for (int n = 1; n < max_cpus; n *= 2) {
+    b->Arg(n);
+  }
+  b->Arg(max_cpus);
+}
+
+BENCHMARK(BM_Startup)->Apply(StartupArgs)->UseManualTime();
+
+}  // namespace
+}  // namespace tcmalloc
@@ -0,0 +1,97 @@
+// Copyright 2026 The TCMalloc Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Child process for startup_benchmark.  It times the first malloc, performs
+// kAllocations allocations on every CPU it is allowed to run on, and prints
+// "<first malloc ns> <rss bytes> <metadata bytes>" to stdout.
+//
+// This binary intentionally avoids static initializers that could allocate, so
+// that the first malloc in main() is (usually) the one that initializes
+// TCMalloc.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "tcmalloc/internal/affinity.h"
+#include "tcmalloc/internal/memory_stats.h"
+#include "tcmalloc/malloc_extension.h"
+
+namespace tcmalloc {
+namespace {
+
+constexpr int kAllocations = 1000;
+
+// Keeps the compiler from eliding allocations.
+void* volatile sink;
+
+int64_t MonotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void AllocateOnCpu(int cpu) {
+  tcmalloc_internal::ScopedAffinityMask mask(cpu);
+  std::vector<void*> ptrs;
+  ptrs.reserve(kAllocations);
+  for (int i = 0; i < kAllocations; ++i) {
+    // Cycle through a spread of small sizes so that several size classes in
+    // the per-CPU cache get populated.
+    void* ptr = malloc(8 + (i % 64) * 16);
+    sink = ptr;
+    ptrs.push_back(ptr);
+  }
+  for (void* ptr : ptrs) {
+    free(ptr);
+  }
+}
+
+int Main() {
+  const int64_t start = MonotonicNanos();
+  void* first = malloc(1);
+  sink = first;
+  const int64_t first_malloc_ns = MonotonicNanos() - start;
+  free(first);
+
+  std::vector<std::thread> threads;
+  for (int cpu : tcmalloc_internal::AllowedCpus()) {
+    threads.emplace_back(AllocateOnCpu, cpu);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  tcmalloc_internal::MemoryStats stats;
+  if (!tcmalloc_internal::GetMemoryStats(stats)) {
+    return 1;
+  }
+  const size_t metadata =
+      MallocExtension::GetNumericProperty("tcmalloc.metadata_bytes")
+          .value_or(0);
+
+  printf("%lld %lld %zu\n", static_cast<long long>(first_malloc_ns),
+         static_cast<long long>(stats.rss), metadata);
+  return 0;
+}
+
+}  // namespace
+}  // namespace tcmalloc
+
+int main() { return tcmalloc::Main(); }
@@ -41,6 +41,9 @@ extern "C" ABSL_ATTRIBUTE_WEAK void MallocExtension_Internal_GetStats(
     std::string* ret);
 extern "C" ABSL_ATTRIBUTE_WEAK int MallocExtension_Internal_GetStatsInPbtxt(
     char* buffer, int buffer_length);
+extern "C" ABSL_ATTRIBUTE_WEAK void
+TCMalloc_Internal_SetPartitionPerCpuCachePercent(size_t partition, int32_t v);
+extern "C" ABSL_ATTRIBUTE_WEAK void* __alloc_token_1__Znwm(size_t size);
 
 namespace tcmalloc {
 namespace {
@@ -269,6 +272,59 @@ static void BM_random_malloc_pages(benchmark::State& state) {
 
 BENCHMARK(BM_random_malloc_pages);
 
+// Grows a buffer geometrically to state.range(0) bytes, as a vector or string
+// builder would.
+static void BM_realloc_growth(benchmark::State& state) {
+  const size_t max_size = state.range(0);
+
+  for (auto s : state) {
+    size_t size = 4096;
+    void* ptr = malloc(size);
+    while (size < max_size) {
+      size += size / 2;
+      ptr = realloc(ptr, size);
+      benchmark::DoNotOptimize(ptr);
+    }
+    free(ptr);
+  }
+}
+
+BENCHMARK(BM_realloc_growth)->Range(1 << 20, 256 << 20);
+
+// Interleaves small, latency-critical allocations with bulk allocations made
+// through an allocation token, as in partitioning_fuzz_test.  With heap
+// partitioning enabled (TCMALLOC_HEAP_PARTITIONING), the bulk allocations land
+// in partition 1, whose share of each per-CPU cache is limited to
+// state.range(0) percent.
+static void BM_partitioned_new_delete(benchmark::State& state) {
+  if (&__alloc_token_1__Znwm == nullptr ||
+      &TCMalloc_Internal_SetPartitionPerCpuCachePercent == nullptr) {
+    // Sanitizer builds don't provide these functions.
+    return;
+  }
+  TCMalloc_Internal_SetPartitionPerCpuCachePercent(1, state.range(0));
+
+  constexpr size_t kHotSize = 64;
+  constexpr size_t kBulkSize = 4096;
+  std::vector<void*> bulk(64);
+  for (auto s : state) {
+    for (void*& ptr : bulk) {
+      ptr = __alloc_token_1__Znwm(kBulkSize);
+    }
+    for (size_t i = 0; i < bulk.size(); ++i) {
+      void* ptr = ::operator new(kHotSize);
+      benchmark::DoNotOptimize(ptr);
+      ::operator delete(ptr, kHotSize);
+    }
+    for (void* ptr : bulk) {
+      ::operator delete(ptr, kBulkSize);
+    }
+  }
+
+  TCMalloc_Internal_SetPartitionPerCpuCachePercent(1, 100);
+}
+BENCHMARK(BM_partitioned_new_delete)->Arg(100)->Arg(25);
+
 static void BM_random_new_delete(benchmark::State& state) {
   const int kMaxOnHeap = 5000;
   const int kMaxRequestSize = 5000;
@@ -48,6 +48,10 @@ build_variants = [
         "name": "256k_pages_numa_aware",
         "copts": ["-DTCMALLOC_INTERNAL_256K_PAGES", "-DTCMALLOC_INTERNAL_NUMA_AWARE"],
     },
+    {
+        "name": "numa_aware_4_partitions",
+        "copts": ["-DTCMALLOC_INTERNAL_8K_PAGES", "-DTCMALLOC_INTERNAL_NUMA_AWARE", "-DTCMALLOC_INTERNAL_NUMA_PARTITIONS=4"],
+    },
     {
         "name": "legacy_locking",
         "copts": ["-DTCMALLOC_INTERNAL_8K_PAGES", "-DTCMALLOC_INTERNAL_LEGACY_LOCKING"],
@@ -58,6 +62,9 @@ build_variants = [
     },
 ]
 
+# The values of PERCPU_VCPU_MODE that SelectRseqVcpuMode accepts.
+_PERCPU_VCPU_MODES = ["none", "mm", "flat"]
+
 test_variants = [
     {
         "name": "8k_pages",
@@ -164,6 +171,16 @@ test_variants = [
         "copts": ["-DTCMALLOC_INTERNAL_256K_PAGES", "-DTCMALLOC_INTERNAL_NUMA_AWARE"],
         "tags": ["noubsan"],
     },
+    {
+        "name": "numa_aware_4_partitions",
+        "malloc": "//tcmalloc:tcmalloc_numa_aware_4_partitions",
+        "deps": [
+            "//tcmalloc:common_numa_aware_4_partitions",
+            "//tcmalloc:want_numa_aware",
+        ],
+        "copts": ["-DTCMALLOC_INTERNAL_NUMA_AWARE", "-DTCMALLOC_INTERNAL_NUMA_PARTITIONS=4"],
+        "tags": ["noubsan"],
+    },
     {
         "name": "256k_pages_pow2_sharded_transfer_cache",
         "malloc": "//tcmalloc:tcmalloc_256k_pages",
@@ -253,8 +270,8 @@ test_variants = [
             "//tcmalloc:common_8k_pages",
         ],
         "env": {
-            "BORG_EXPERIMENTS": "TEST_ONLY_MM_VCPU",
             "GLIBC_TUNABLES": "glibc.pthread.rseq=0",
+            "PERCPU_VCPU_MODE": "mm",
         },
     },
     {
@@ -381,6 +398,10 @@ def create_tcmalloc_test_variant_targets(create_one, name, srcs = [], **kwargs):
         variant_targets.append(inner_target_name)
         env = dict(variant.get("env", {}))
         env.update(env0)
+        vcpu_mode = env.get("PERCPU_VCPU_MODE")
+        if vcpu_mode != None and vcpu_mode not in _PERCPU_VCPU_MODES:
+            fail("%s: unknown PERCPU_VCPU_MODE %r, expected one of %s" %
+                 (inner_target_name, vcpu_mode, _PERCPU_VCPU_MODES))
 
         build_variant = variant.get("build_variant")
         if not build_variant: